@@ -10,8 +10,10 @@
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
+#include "cast/streaming/congestion_controller.h"
 #include "cast/streaming/constants.h"
 #include "cast/streaming/environment.h"
 #include "cast/streaming/sender.h"
@@ -43,6 +45,11 @@ namespace {
 // The values defined here are constants that correspond to the standalone Cast
 // Receiver app. In a production environment, these should ABSOLUTELY NOT be
 // fixed! Instead a sender↔receiver OFFER/ANSWER exchange should establish them.
+//
+// The standalone Cast Receiver app accepts FEC Parity packets for every stream
+// whose OFFER lists them (see kFecRtpExtensionName), so they are enabled here
+// as if offered and accepted. A Sender that performs the exchange should
+// instead use Answer::IsFecEnabled() for each stream.
 
 // In a production environment, this would start-out at some initial value
 // appropriate to the networking environment, and then be adjusted by the
@@ -63,6 +70,7 @@ const SessionConfig kSampleAudioAnswerConfig{
     /* .aes_iv_mask = */
     {0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x90, 0x80, 0x70, 0x60, 0x50, 0x40,
      0x30, 0x20, 0x10, 0x00},
+    /* .fec_enabled = */ true,
 };
 
 const SessionConfig kSampleVideoAnswerConfig{
@@ -77,6 +85,7 @@ const SessionConfig kSampleVideoAnswerConfig{
     /* .aes_iv_mask = */
     {0xf1, 0xe1, 0xd1, 0xc1, 0xb1, 0xa1, 0x91, 0x81, 0x71, 0x61, 0x51, 0x41,
      0x31, 0x21, 0x11, 0x01},
+    /* .fec_enabled = */ true,
 };
 
 // End of Sender Configuration.
@@ -145,6 +154,10 @@ class LoopingFileSender final : public SimulatedAudioCapturer::Client,
     OSP_LOG_INFO << "Max allowed media bitrate (audio + video) will be "
                  << max_bitrate_;
     bandwidth_being_utilized_ = max_bitrate_ / 2;
+    packet_router_.SetCongestionController(
+        std::make_unique<DelayAndLossCongestionController>(
+            kMinRequiredBitrate, bandwidth_being_utilized_, max_bitrate_,
+            env_.now()));
     UpdateEncoderBitrates();
 
     next_task_.Schedule([this] { SendFileAgain(); }, Alarm::kImmediately);
@@ -165,31 +178,14 @@ class LoopingFileSender final : public SimulatedAudioCapturer::Client,
 
   void ControlForNetworkCongestion() {
     bandwidth_estimate_ = packet_router_.ComputeNetworkBandwidth();
-    if (bandwidth_estimate_ > 0) {
-      // Don't ever try to use *all* of the network bandwidth! However, don't go
-      // below the absolute minimum requirement either.
-      constexpr double kGoodNetworkCitizenFactor = 0.8;
-      const int usable_bandwidth = std::max<int>(
-          kGoodNetworkCitizenFactor * bandwidth_estimate_, kMinRequiredBitrate);
-
-      // See "congestion control" discussion in the class header comments for
-      // BandwidthEstimator.
-      if (usable_bandwidth > bandwidth_being_utilized_) {
-        constexpr double kConservativeIncrease = 1.1;
-        bandwidth_being_utilized_ =
-            std::min<int>(bandwidth_being_utilized_ * kConservativeIncrease,
-                          usable_bandwidth);
-      } else {
-        bandwidth_being_utilized_ = usable_bandwidth;
-      }
-
-      // Repsect the user's maximum bitrate setting.
-      bandwidth_being_utilized_ =
-          std::min(bandwidth_being_utilized_, max_bitrate_);
 
+    // The packet router's congestion controller decides the target bitrate
+    // from the network feedback, and paces the packets accordingly. The
+    // encoders just need to follow it.
+    const int target_bitrate = packet_router_.GetTargetBitrate();
+    if (target_bitrate != bandwidth_being_utilized_) {
+      bandwidth_being_utilized_ = target_bitrate;
       UpdateEncoderBitrates();
-    } else {
-      // There is no current bandwidth estimate. So, nothing should be adjusted.
     }
 
     next_task_.ScheduleFromNow([this] { ControlForNetworkCongestion(); },
@@ -45,6 +45,10 @@ constexpr int kLowestEncodingSpeed = 6;
 // This is the equivalent change in encoding speed per one quantizer step.
 constexpr double kEquivalentEncodingSpeedStepPerQuantizerStep = 1 / 20.0;
 
+// The maximum number of encoded frames waiting to be taken in by the Sender.
+// Frames are normally taken in well before this many have been encoded.
+constexpr int kFrameQueueCapacity = 16;
+
 }  // namespace
 
 StreamingVp8Encoder::StreamingVp8Encoder(const Parameters& params,
@@ -53,6 +57,7 @@ StreamingVp8Encoder::StreamingVp8Encoder(const Parameters& params,
     : params_(params),
       main_task_runner_(task_runner),
       sender_(sender),
+      frame_queue_(sender_->CreateFrameQueue(kFrameQueueCapacity)),
       ideal_speed_setting_(kHighestEncodingSpeed),
       encode_thread_([this] { ProcessWorkUnitsUntilTimeToQuit(); }) {
   OSP_DCHECK_LE(1, params_.num_encode_threads);
@@ -237,10 +242,7 @@ void StreamingVp8Encoder::ProcessWorkUnitsUntilTimeToQuit() {
                             &work_unit);
     UpdateSpeedSettingForNextFrame(work_unit.stats);
 
-    main_task_runner_->PostTask(
-        [this, results = std::move(work_unit)]() mutable {
-          SendEncodedFrame(std::move(results));
-        });
+    SendEncodedFrame(std::move(work_unit));
   }
 
   DestroyEncoder();
@@ -413,10 +415,10 @@ void StreamingVp8Encoder::UpdateSpeedSettingForNextFrame(const Stats& stats) {
 }
 
 void StreamingVp8Encoder::SendEncodedFrame(WorkUnitWithResults results) {
-  OSP_DCHECK(main_task_runner_->IsRunningOnTaskRunner());
+  OSP_DCHECK(!main_task_runner_->IsRunningOnTaskRunner());
 
   EncodedFrame frame;
-  frame.frame_id = sender_->GetNextFrameId();
+  frame.frame_id = frame_queue_->GetNextFrameId();
   if (results.is_key_frame) {
     frame.dependency = EncodedFrame::KEY_FRAME;
     frame.referenced_frame_id = frame.frame_id;
@@ -428,7 +430,7 @@ void StreamingVp8Encoder::SendEncodedFrame(WorkUnitWithResults results) {
   frame.reference_time = results.reference_time;
   frame.data = absl::Span<uint8_t>(results.payload);
 
-  if (sender_->EnqueueFrame(frame) != Sender::OK) {
+  if (!frame_queue_->SubmitFrame(frame)) {
     // Since the frame will not be sent, the encoder's frame dependency chain
     // has been broken. Force a key frame for the next frame.
     std::unique_lock<std::mutex> lock(mutex_);
@@ -437,7 +439,9 @@ void StreamingVp8Encoder::SendEncodedFrame(WorkUnitWithResults results) {
 
   if (results.stats_callback) {
     results.stats.frame_id = frame.frame_id;
-    results.stats_callback(results.stats);
+    main_task_runner_->PostTask(
+        [callback = std::move(results.stats_callback),
+         stats = results.stats] { callback(stats); });
   }
 }
 
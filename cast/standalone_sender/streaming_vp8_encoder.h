@@ -20,6 +20,7 @@
 #include "absl/base/thread_annotations.h"
 #include "cast/streaming/frame_id.h"
 #include "cast/streaming/rtp_time.h"
+#include "cast/streaming/sender.h"
 #include "platform/api/task_runner.h"
 #include "platform/api/time.h"
 
@@ -29,8 +30,6 @@ class TaskRunner;
 
 namespace cast {
 
-class Sender;
-
 // Uses libvpx to encode VP8 video and streams it to a Sender. Includes
 // extensive logic for fine-tuning the encoder parameters in real-time, to
 // provide the best quality results given external, uncontrollable factors:
@@ -174,8 +173,8 @@ class StreamingVp8Encoder {
 
   // Encode |frame| using the VP8 encoder, assemble an EncodedFrame, and enqueue
   // into the Sender. The frame may be dropped if too many frames are in-flight.
-  // If provided, the |stats_callback| is run after the frame is enqueued in the
-  // Sender (via the main TaskRunner).
+  // If provided, the |stats_callback| is run after the frame is handed off to
+  // the Sender (via the main TaskRunner).
   void EncodeAndSend(const VideoFrame& frame,
                      Clock::time_point reference_time,
                      std::function<void(Stats)> stats_callback);
@@ -238,7 +237,8 @@ class StreamingVp8Encoder {
   // encode, based on the given performance |stats|.
   void UpdateSpeedSettingForNextFrame(const Stats& stats);
 
-  // Assembles and enqueues an EncodedFrame with the Sender on the main thread.
+  // Assembles an EncodedFrame and hands it off to the Sender, encrypting it on
+  // the encode thread.
   void SendEncodedFrame(WorkUnitWithResults results);
 
   // Allocates a vpx_image_t and copies the content from |frame| to it.
@@ -248,6 +248,10 @@ class StreamingVp8Encoder {
   TaskRunner* const main_task_runner_;
   Sender* const sender_;
 
+  // Through which the encode thread hands off frames to the |sender_|, without
+  // having to post a task to the main thread for each one.
+  Sender::FrameQueue* const frame_queue_;
+
   // The reference time of the first frame passed to EncodeAndSend().
   Clock::time_point start_time_ = Clock::time_point::min();
 
@@ -4,6 +4,7 @@
 
 #include "cast/streaming/answer_messages.h"
 
+#include <algorithm>
 #include <utility>
 
 #include "absl/strings/str_cat.h"
@@ -50,6 +51,66 @@ Json::Value PrimitiveVectorToJson(const std::vector<T>& vec) {
   return array;
 }
 
+// Parses the array of integers in the |field|, returning an error if it is
+// missing or has any non-integer elements.
+ErrorOr<std::vector<int>> ParseIntArray(const Json::Value& parent,
+                                        const std::string& field) {
+  const Json::Value& value = parent[field];
+  if (!value.isArray()) {
+    return CreateParseError("integer array field: " + field);
+  }
+  std::vector<int> result;
+  for (Json::ArrayIndex i = 0; i < value.size(); ++i) {
+    if (!value[i].isInt()) {
+      return CreateParseError("integer array field: " + field);
+    }
+    result.push_back(value[i].asInt());
+  }
+  return result;
+}
+
+// Parses the array of SSRCs in the |field|, returning an error if it is
+// missing or has any elements that are not valid SSRCs.
+ErrorOr<std::vector<Ssrc>> ParseSsrcArray(const Json::Value& parent,
+                                          const std::string& field) {
+  const Json::Value& value = parent[field];
+  if (!value.isArray()) {
+    return CreateParseError("SSRC array field: " + field);
+  }
+  std::vector<Ssrc> result;
+  for (Json::ArrayIndex i = 0; i < value.size(); ++i) {
+    if (!value[i].isUInt()) {
+      return CreateParseError("SSRC array field: " + field);
+    }
+    result.push_back(value[i].asUInt());
+  }
+  return result;
+}
+
+// Parses the optional array of strings in the |field|, ignoring any elements
+// that are not strings.
+std::vector<std::string> ParseStringArray(const Json::Value& parent,
+                                          const std::string& field) {
+  std::vector<std::string> result;
+  const Json::Value& value = parent[field];
+  if (!value.isArray()) {
+    return result;
+  }
+  for (Json::ArrayIndex i = 0; i < value.size(); ++i) {
+    if (value[i].isString()) {
+      result.push_back(value[i].asString());
+    }
+  }
+  return result;
+}
+
+// Returns true if every element of |subset| is also in |set|.
+bool ContainsAll(const std::vector<int>& set, const std::vector<int>& subset) {
+  return std::all_of(subset.begin(), subset.end(), [&set](int value) {
+    return std::find(set.begin(), set.end(), value) != set.end();
+  });
+}
+
 }  // namespace
 
 ErrorOr<Json::Value> AudioConstraints::ToJson() const {
@@ -141,10 +202,68 @@ ErrorOr<Json::Value> DisplayDescription::ToJson() const {
   return root;
 }
 
+// static
+ErrorOr<Answer> Answer::Parse(const Json::Value& root) {
+  const CastMode cast_mode = CastMode::Parse(root["castMode"].asString());
+
+  auto udp_port = ParseInt(root, "udpPort");
+  if (!udp_port) {
+    return udp_port.error();
+  }
+  if (udp_port.value() <= 0 || udp_port.value() > 65535) {
+    return CreateParseError("Answer - UDP Port number");
+  }
+
+  auto send_indexes = ParseIntArray(root, "sendIndexes");
+  if (!send_indexes) {
+    return send_indexes.error();
+  }
+
+  auto ssrcs = ParseSsrcArray(root, "ssrcs");
+  if (!ssrcs) {
+    return ssrcs.error();
+  }
+  if (ssrcs.value().size() != send_indexes.value().size()) {
+    return CreateParseError("Answer - SSRCs");
+  }
+
+  const ErrorOr<bool> get_status = ParseBool(root, "receiverGetStatus");
+
+  std::vector<int> fec_send_indexes;
+  if (root.isMember("fecSendIndexes")) {
+    auto parsed = ParseIntArray(root, "fecSendIndexes");
+    if (!parsed) {
+      return parsed.error();
+    }
+    if (!ContainsAll(send_indexes.value(), parsed.value())) {
+      return CreateParseError("Answer - FEC send indexes");
+    }
+    fec_send_indexes = std::move(parsed.value());
+  }
+
+  Answer answer;
+  answer.cast_mode = cast_mode;
+  answer.udp_port = udp_port.value();
+  answer.send_indexes = std::move(send_indexes.value());
+  answer.ssrcs = std::move(ssrcs.value());
+  answer.supports_wifi_status_reporting = get_status.value({});
+  answer.rtp_extensions = ParseStringArray(root, "rtpExtensions");
+  answer.fec_send_indexes = std::move(fec_send_indexes);
+  return answer;
+}
+
+bool Answer::IsFecEnabled(int send_index) const {
+  return std::find(fec_send_indexes.begin(), fec_send_indexes.end(),
+                   send_index) != fec_send_indexes.end();
+}
+
 ErrorOr<Json::Value> Answer::ToJson() const {
   if (udp_port <= 0 || udp_port > 65535) {
     return CreateParameterError("Answer - UDP Port number");
   }
+  if (!ContainsAll(send_indexes, fec_send_indexes)) {
+    return CreateParameterError("Answer - FEC send indexes");
+  }
 
   Json::Value root;
   if (constraints) {
@@ -178,6 +297,9 @@ ErrorOr<Json::Value> Answer::ToJson() const {
   if (!rtp_extensions.empty()) {
     root["rtpExtensions"] = PrimitiveVectorToJson(rtp_extensions);
   }
+  if (!fec_send_indexes.empty()) {
+    root["fecSendIndexes"] = PrimitiveVectorToJson(fec_send_indexes);
+  }
   return root;
 }
 
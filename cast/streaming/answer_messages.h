@@ -98,6 +98,21 @@ struct Answer {
   // RTP extensions should be empty, but not null.
   std::vector<std::string> rtp_extensions = {};
 
+  // The |send_indexes| of the streams for which the Receiver accepted FEC
+  // Parity packets (see kFecRtpExtensionName in rtp_defines.h). This is
+  // serialized separately from |rtp_extensions|, as "fecSendIndexes", so that
+  // Senders unaware of FEC are unaffected.
+  std::vector<int> fec_send_indexes;
+
+  // Parses the fields of an ANSWER that a Sender needs to configure its
+  // streams. The optional constraints and display description are not parsed.
+  static ErrorOr<Answer> Parse(const Json::Value& root);
+
+  // Returns true if the Receiver accepted FEC Parity packets (see
+  // kFecRtpExtensionName in rtp_defines.h) for the stream having the given
+  // |send_index|. Senders use this to set SessionConfig::fec_enabled.
+  bool IsFecEnabled(int send_index) const;
+
   // ToJson performs a standard serialization, returning an error if this
   // instance failed to serialize properly.
   ErrorOr<Json::Value> ToJson() const;
@@ -54,10 +54,11 @@ const Answer kValidAnswer{
         AspectRatio{16, 9},             // aspect_ratio
         AspectRatioConstraint::kFixed,  // scaling
     },
-    std::vector<int>{7, 8, 9},              // receiver_rtcp_event_log
-    std::vector<int>{11, 12, 13},           // receiver_rtcp_dscp
-    true,                                   // receiver_get_status
-    std::vector<std::string>{"foo", "bar"}  // rtp_extensions
+    std::vector<int>{7, 8, 9},     // receiver_rtcp_event_log
+    std::vector<int>{11, 12, 13},  // receiver_rtcp_dscp
+    true,                          // receiver_get_status
+    std::vector<std::string>{"foo", "bar"},  // rtp_extensions
+    std::vector<int>{3}                      // fec_send_indexes
 };
 
 }  // anonymous namespace
@@ -138,6 +139,11 @@ TEST(AnswerMessagesTest, ProperlyPopulatedAnswerSerializesProperly) {
   EXPECT_EQ(rtp_extensions.type(), Json::ValueType::arrayValue);
   EXPECT_EQ(rtp_extensions[0], "foo");
   EXPECT_EQ(rtp_extensions[1], "bar");
+
+  Json::Value fec_send_indexes = std::move(root["fecSendIndexes"]);
+  EXPECT_EQ(fec_send_indexes.type(), Json::ValueType::arrayValue);
+  EXPECT_EQ(fec_send_indexes.size(), 1u);
+  EXPECT_EQ(fec_send_indexes[0], 3);
 }
 
 TEST(AnswerMessagesTest, InvalidDimensionsCauseError) {
@@ -176,5 +182,73 @@ TEST(AnswerMessagesTest, InvalidUdpPortsCauseError) {
   EXPECT_TRUE(value_or_error.is_error());
 }
 
+TEST(AnswerMessagesTest, UnknownFecSendIndexesCauseError) {
+  Answer invalid_fec = kValidAnswer;
+  invalid_fec.fec_send_indexes.push_back(4);
+  auto value_or_error = invalid_fec.ToJson();
+  EXPECT_TRUE(value_or_error.is_error());
+}
+
+TEST(AnswerMessagesTest, ParsesFecPerStream) {
+  constexpr char kAnswer[] = R"({
+    "castMode": "mirroring",
+    "udpPort": 1234,
+    "receiverGetStatus": true,
+    "sendIndexes": [1337, 31338],
+    "ssrcs": [19088748, 19088746],
+    "rtpExtensions": ["adaptive_playout_delay"],
+    "fecSendIndexes": [31338]
+  })";
+  const auto root = json::Parse(kAnswer);
+  ASSERT_TRUE(root.is_value());
+  const ErrorOr<Answer> answer = Answer::Parse(root.value());
+  ASSERT_TRUE(answer.is_value()) << answer.error();
+
+  EXPECT_EQ(CastMode::Type::kMirroring, answer.value().cast_mode.type);
+  EXPECT_EQ(1234, answer.value().udp_port);
+  EXPECT_THAT(answer.value().send_indexes, testing::ElementsAre(1337, 31338));
+  EXPECT_THAT(answer.value().ssrcs,
+              testing::ElementsAre(19088748u, 19088746u));
+  EXPECT_TRUE(answer.value().supports_wifi_status_reporting);
+  EXPECT_THAT(answer.value().rtp_extensions,
+              testing::ElementsAre("adaptive_playout_delay"));
+
+  EXPECT_FALSE(answer.value().IsFecEnabled(1337));
+  EXPECT_TRUE(answer.value().IsFecEnabled(31338));
+  EXPECT_FALSE(answer.value().IsFecEnabled(42));
+}
+
+TEST(AnswerMessagesTest, ParsesAnswerWithoutRtpExtensions) {
+  constexpr char kAnswer[] = R"({
+    "castMode": "mirroring",
+    "udpPort": 1234,
+    "sendIndexes": [1337],
+    "ssrcs": [19088748]
+  })";
+  const auto root = json::Parse(kAnswer);
+  ASSERT_TRUE(root.is_value());
+  const ErrorOr<Answer> answer = Answer::Parse(root.value());
+  ASSERT_TRUE(answer.is_value()) << answer.error();
+  EXPECT_TRUE(answer.value().rtp_extensions.empty());
+  EXPECT_TRUE(answer.value().fec_send_indexes.empty());
+  EXPECT_FALSE(answer.value().IsFecEnabled(1337));
+}
+
+TEST(AnswerMessagesTest, MalformedAnswersCauseParseError) {
+  for (const char* malformed : {
+           R"({"udpPort": 1234, "sendIndexes": [1], "ssrcs": []})",
+           R"({"udpPort": 0, "sendIndexes": [1], "ssrcs": [2]})",
+           R"({"udpPort": 1234, "ssrcs": [2]})",
+           R"({"udpPort": 1234, "sendIndexes": [1], "ssrcs": [2],
+               "fecSendIndexes": [3]})",
+           R"({"udpPort": 1234, "sendIndexes": [1], "ssrcs": [2],
+               "fecSendIndexes": ["1"]})",
+       }) {
+    const auto root = json::Parse(malformed);
+    ASSERT_TRUE(root.is_value()) << malformed;
+    EXPECT_TRUE(Answer::Parse(root.value()).is_error()) << malformed;
+  }
+}
+
 }  // namespace cast
 }  // namespace openscreen
@@ -5,6 +5,7 @@
 #include "cast/streaming/bandwidth_estimator.h"
 
 #include <algorithm>
+#include <iterator>
 
 #include "util/osp_logging.h"
 #include "util/saturate_cast.h"
@@ -37,21 +38,33 @@ int ToClampedBitsPerSecond(int32_t bytes, Clock::duration time_window) {
 BandwidthEstimator::BandwidthEstimator(int max_packets_per_timeslice,
                                        Clock::duration timeslice_duration,
                                        Clock::time_point start_time)
-    : max_packets_per_history_window_(max_packets_per_timeslice *
-                                      kNumTimeslices),
+    : timeslice_duration_(timeslice_duration),
       history_window_(timeslice_duration * kNumTimeslices),
       burst_history_(timeslice_duration, start_time),
-      feedback_history_(timeslice_duration, start_time) {
+      feedback_history_(timeslice_duration, start_time),
+      capacity_history_(timeslice_duration,
+                        start_time,
+                        ComputeTimesliceCapacity(max_packets_per_timeslice,
+                                                 timeslice_duration)) {
   OSP_DCHECK_GT(max_packets_per_timeslice, 0);
   OSP_DCHECK_GT(timeslice_duration, Clock::duration::zero());
 }
 
 BandwidthEstimator::~BandwidthEstimator() = default;
 
+void BandwidthEstimator::SetPacing(int max_packets_per_burst,
+                                   Clock::duration burst_interval) {
+  OSP_DCHECK_GT(max_packets_per_burst, 0);
+  OSP_DCHECK_GT(burst_interval, Clock::duration::zero());
+  capacity_history_.set_initial_amount(
+      ComputeTimesliceCapacity(max_packets_per_burst, burst_interval));
+}
+
 void BandwidthEstimator::OnBurstComplete(int num_packets_sent,
                                          Clock::time_point when) {
   OSP_DCHECK_GE(num_packets_sent, 0);
   burst_history_.Accumulate(num_packets_sent, when);
+  capacity_history_.AdvanceToIncludeTime(when);
 }
 
 void BandwidthEstimator::OnRtcpReceived(
@@ -94,19 +107,42 @@ int BandwidthEstimator::ComputeNetworkBandwidth() const {
     // Cannot estimate because there have been no transmissions recently.
     return 0;
   }
-  const Clock::duration transmit_duration = history_window_ *
-                                            num_packets_transmitted /
-                                            max_packets_per_history_window_;
+  const int32_t capacity = capacity_history_.Sum();
+  if (capacity <= 0) {
+    return 0;
+  }
+  const Clock::duration transmit_duration =
+      history_window_ * (int64_t{num_packets_transmitted} * kCapacityScale) /
+      capacity;
+  if (transmit_duration <= Clock::duration::zero()) {
+    return 0;
+  }
   const int32_t num_bytes_received = feedback_history_.Sum();
   return ToClampedBitsPerSecond(num_bytes_received, transmit_duration);
 }
 
+int32_t BandwidthEstimator::ComputeTimesliceCapacity(
+    int max_packets_per_burst,
+    Clock::duration burst_interval) const {
+  return saturate_cast<int32_t>(int64_t{max_packets_per_burst} *
+                                kCapacityScale * timeslice_duration_ /
+                                burst_interval);
+}
+
 // static
 constexpr int BandwidthEstimator::kNumTimeslices;
+// static
+constexpr int BandwidthEstimator::kCapacityScale;
 
 BandwidthEstimator::FlowTracker::FlowTracker(Clock::duration timeslice_duration,
-                                             Clock::time_point begin_time)
-    : timeslice_duration_(timeslice_duration), begin_time_(begin_time) {}
+                                             Clock::time_point begin_time,
+                                             int32_t initial_amount)
+    : timeslice_duration_(timeslice_duration),
+      begin_time_(begin_time),
+      initial_amount_(initial_amount) {
+  std::fill(std::begin(history_ring_), std::end(history_ring_),
+            initial_amount_);
+}
 
 BandwidthEstimator::FlowTracker::~FlowTracker() = default;
 
@@ -124,7 +160,7 @@ void BandwidthEstimator::FlowTracker::AdvanceToIncludeTime(
   // ones initialized to zero.
   const int shift_count = std::min<int64_t>(num_periods, kNumTimeslices);
   for (int i = 0; i < shift_count; ++i) {
-    history_ring_[tail_++] = 0;
+    history_ring_[tail_++] = initial_amount_;
   }
 }
 
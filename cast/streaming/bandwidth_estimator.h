@@ -74,6 +74,14 @@ class BandwidthEstimator {
   // data flows are being tracked.
   Clock::duration history_window() const { return history_window_; }
 
+  // Informs the estimator that, from now on, at most |max_packets_per_burst|
+  // packets are sent every |burst_interval| (e.g., because SenderPacketRouter
+  // is pacing its bursts to the congestion controller's target bitrate). This
+  // sets the modeled capacity of the timeslices that the history window
+  // advances into from now on, so that sending at the paced rate is seen as
+  // full utilization of the network time available to the Senders.
+  void SetPacing(int max_packets_per_burst, Clock::duration burst_interval);
+
   // Records |when| burst-sending was active or inactive. For the active case,
   // |num_packets_sent| should include all network packets sent, including
   // non-payload packets (since both affect the modeled utilization/capacity).
@@ -114,8 +122,11 @@ class BandwidthEstimator {
   // move the history window forward) are added.
   class FlowTracker {
    public:
+    // All timeslices, including those added as the window advances, begin with
+    // |initial_amount|.
     FlowTracker(Clock::duration timeslice_duration,
-                Clock::time_point begin_time);
+                Clock::time_point begin_time,
+                int32_t initial_amount = 0);
     ~FlowTracker();
 
     Clock::time_point begin_time() const { return begin_time_; }
@@ -123,9 +134,12 @@ class BandwidthEstimator {
       return begin_time_ + timeslice_duration_ * kNumTimeslices;
     }
 
+    // Changes the amount that new timeslices begin with.
+    void set_initial_amount(int32_t amount) { initial_amount_ = amount; }
+
     // Advance the end of the time window being tracked such that the
     // most-recent timeslice includes |until|. Too-old timeslices are dropped
-    // and new ones are initialized to a zero amount.
+    // and new ones are initialized to the initial amount.
     void AdvanceToIncludeTime(Clock::time_point until);
 
     // Accumulate the given |amount| into the timeslice that includes |when|.
@@ -149,11 +163,22 @@ class BandwidthEstimator {
     // be thought of, equivalently, as the index just after the most-recent
     // timeslice.
     index_mod_256_t tail_ = 0;
+
+    // The amount that new timeslices begin with.
+    int32_t initial_amount_;
   };
 
-  // The maximum number of packet sends that could possibly be attempted during
-  // the recent-history time window.
-  const int max_packets_per_history_window_;
+  // The capacity of a timeslice is tracked in units of 1/kCapacityScale
+  // packets, since pacing may allow less than one packet per timeslice.
+  static constexpr int kCapacityScale = 1000;
+
+  // Returns the capacity of one timeslice when at most |max_packets_per_burst|
+  // packets are sent every |burst_interval|.
+  int32_t ComputeTimesliceCapacity(int max_packets_per_burst,
+                                   Clock::duration burst_interval) const;
+
+  // The duration of each timeslice.
+  const Clock::duration timeslice_duration_;
 
   // The range of time being tracked.
   const Clock::duration history_window_;
@@ -162,6 +187,11 @@ class BandwidthEstimator {
   // are in terms of when packets have left the Senders.
   FlowTracker burst_history_;
   FlowTracker feedback_history_;
+
+  // History tracking for the maximum number of packet sends that could have
+  // been attempted (scaled by kCapacityScale), which changes with the pacing.
+  // This is advanced in lock-step with |burst_history_|.
+  FlowTracker capacity_history_;
 };
 
 }  // namespace cast
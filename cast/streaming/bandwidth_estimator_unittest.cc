@@ -135,6 +135,57 @@ TEST_F(BandwidthEstimatorTest, EstimatesAtVariousBurstSaturations) {
   }
 }
 
+// Tests that, when the bursts are paced below the maximum, the network
+// bandwidth estimates are based on the paced capacity. So, bursting at the full
+// paced rate is seen as full utilization, just like bursting at the maximum
+// rate without pacing.
+TEST_F(BandwidthEstimatorTest, EstimatesRelativeToPacedCapacity) {
+  struct Pacing {
+    int packets_per_burst;
+    int timeslices_per_burst;
+  };
+  constexpr Pacing kPacings[] = {
+      {kMaxPacketsPerTimeslice / 2, 1},  // Smaller bursts.
+      {1, 5},                            // One packet every fifth timeslice.
+  };
+
+  const Clock::duration kRoundTripTime = milliseconds(1);
+
+  constexpr int kReceivedBytesPerSecond = 256000;
+  constexpr int kReceivedBytesPerTimeslice =
+      kReceivedBytesPerSecond / kTimeslicesPerSecond;
+  static_assert(kReceivedBytesPerSecond % kTimeslicesPerSecond == 0,
+                "Test expectations won't account for rounding errors.");
+
+  Clock::time_point now = kStartTime;
+  for (const Pacing& pacing : kPacings) {
+    SCOPED_TRACE(testing::Message()
+                 << "packets_per_burst=" << pacing.packets_per_burst
+                 << ", timeslices_per_burst=" << pacing.timeslices_per_burst);
+
+    const Clock::duration burst_interval =
+        kTimesliceDuration * pacing.timeslices_per_burst;
+    estimator()->SetPacing(pacing.packets_per_burst, burst_interval);
+
+    // Simulate bursting at the paced rate until the entire history window has
+    // moved past the pacing change.
+    const Clock::time_point end = now + 2 * estimator()->history_window();
+    for (; now < end; now += burst_interval) {
+      estimator()->OnBurstComplete(pacing.packets_per_burst, now);
+      const Clock::time_point rtcp_arrival_time = now + kRoundTripTime;
+      estimator()->OnPayloadReceived(
+          kReceivedBytesPerTimeslice * pacing.timeslices_per_burst,
+          rtcp_arrival_time, kRoundTripTime);
+      estimator()->OnRtcpReceived(rtcp_arrival_time, kRoundTripTime);
+    }
+    now = end;
+
+    const int estimate = estimator()->ComputeNetworkBandwidth();
+    EXPECT_NEAR(kReceivedBytesPerSecond * CHAR_BIT, estimate,
+                kReceivedBytesPerSecond * CHAR_BIT / 100);
+  }
+}
+
 // Tests that magnitude of the network round trip times, as well as random
 // variance in packet arrival times, do not have a significant effect on the
 // bandwidth estimates.
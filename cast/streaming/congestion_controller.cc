@@ -0,0 +1,171 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cast/streaming/congestion_controller.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+
+#include "util/osp_logging.h"
+
+namespace openscreen {
+namespace cast {
+
+namespace {
+
+using SecondsAsDouble = std::chrono::duration<double>;
+
+// Packet loss above this fraction decreases the target bitrate, and below
+// kLowLossFraction allows it to increase. In between, the target bitrate is
+// held steady.
+constexpr double kHighLossFraction = 0.10;
+constexpr double kLowLossFraction = 0.02;
+
+// The round trip time trend (seconds per second) above which the network is
+// considered to be over-used, provided there is also more queueing delay than
+// kMinQueueingDelayForOveruse. The trend is ignored if the queueing delay
+// exceeds kMaxQueueingDelay, since that alone means the network is over-used.
+constexpr double kOveruseTrend = 0.01;
+constexpr auto kMinQueueingDelayForOveruse = milliseconds(10);
+constexpr auto kMaxQueueingDelay = milliseconds(100);
+
+// The multiplier applied to the target bitrate when over-use is detected.
+constexpr double kOveruseBackoffFactor = 0.85;
+
+// The rate at which the target bitrate increases, in fraction per second.
+constexpr double kIncreasePerSecond = 0.08;
+
+}  // namespace
+
+CongestionController::~CongestionController() = default;
+
+DelayAndLossCongestionController::DelayAndLossCongestionController(
+    int min_bitrate,
+    int start_bitrate,
+    int max_bitrate,
+    Clock::time_point start_time)
+    : min_bitrate_(min_bitrate),
+      max_bitrate_(max_bitrate),
+      target_bitrate_(start_bitrate),
+      last_update_time_(start_time) {
+  OSP_DCHECK_GT(min_bitrate, 0);
+  OSP_DCHECK_LE(min_bitrate, start_bitrate);
+  OSP_DCHECK_LE(start_bitrate, max_bitrate);
+}
+
+DelayAndLossCongestionController::~DelayAndLossCongestionController() = default;
+
+void DelayAndLossCongestionController::OnReceiverReport(
+    Clock::time_point arrival_time,
+    Clock::duration round_trip_time,
+    double fraction_lost) {
+  OSP_DCHECK_GE(fraction_lost, 0.0);
+  OSP_DCHECK_LE(fraction_lost, 1.0);
+
+  // Apply any increase for the time elapsed under the prior conditions.
+  AdvanceTo(arrival_time);
+
+  if (round_trip_time > Clock::duration::zero()) {
+    delay_samples_[num_delay_samples_ % kTrendWindowSize] =
+        DelaySample{arrival_time, round_trip_time};
+    ++num_delay_samples_;
+    min_round_trip_time_ = std::min(min_round_trip_time_, round_trip_time);
+    queueing_delay_ = round_trip_time - min_round_trip_time_;
+  }
+
+  const bool delay_overuse =
+      (queueing_delay_ > kMaxQueueingDelay) ||
+      (queueing_delay_ > kMinQueueingDelayForOveruse &&
+       ComputeDelayTrend() > kOveruseTrend);
+  if (delay_overuse) {
+    // Decrease at most once per round trip, since the effects of a decrease
+    // cannot be observed any sooner.
+    if (last_delay_decrease_time_ + round_trip_time <= arrival_time) {
+      target_bitrate_ *= kOveruseBackoffFactor;
+      last_delay_decrease_time_ = arrival_time;
+    }
+    increase_allowed_ = false;
+  } else if (fraction_lost > kHighLossFraction) {
+    target_bitrate_ *= (1.0 - 0.5 * fraction_lost);
+    increase_allowed_ = false;
+  } else {
+    // While the queues are draining (a falling round trip time trend), or
+    // while there is moderate loss, hold steady.
+    increase_allowed_ = fraction_lost < kLowLossFraction &&
+                        ComputeDelayTrend() > -kOveruseTrend;
+  }
+
+  ClampTargetBitrate();
+}
+
+void DelayAndLossCongestionController::OnNetworkBandwidthEstimate(
+    Clock::time_point now,
+    int network_bandwidth) {
+  OSP_DCHECK_GE(network_bandwidth, 0);
+  AdvanceTo(now);
+  network_bandwidth_ = network_bandwidth;
+  ClampTargetBitrate();
+}
+
+int DelayAndLossCongestionController::GetTargetBitrate() const {
+  return static_cast<int>(target_bitrate_);
+}
+
+double DelayAndLossCongestionController::ComputeDelayTrend() const {
+  const int count = std::min(num_delay_samples_, kTrendWindowSize);
+  constexpr int kMinSamplesForTrend = 4;
+  if (count < kMinSamplesForTrend) {
+    return 0.0;
+  }
+
+  // Compute the least-squares fit, with times relative to the oldest sample
+  // to preserve precision.
+  const int oldest = (num_delay_samples_ - count) % kTrendWindowSize;
+  const Clock::time_point origin = delay_samples_[oldest].when;
+  double sum_x = 0.0;
+  double sum_y = 0.0;
+  double sum_xx = 0.0;
+  double sum_xy = 0.0;
+  for (int i = 0; i < count; ++i) {
+    const DelaySample& sample =
+        delay_samples_[(oldest + i) % kTrendWindowSize];
+    const double x = SecondsAsDouble(sample.when - origin).count();
+    const double y = SecondsAsDouble(sample.round_trip_time).count();
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+  const double denominator = count * sum_xx - sum_x * sum_x;
+  if (denominator <= 0.0) {
+    return 0.0;
+  }
+  return (count * sum_xy - sum_x * sum_y) / denominator;
+}
+
+void DelayAndLossCongestionController::AdvanceTo(Clock::time_point now) {
+  if (now <= last_update_time_) {
+    return;
+  }
+  if (increase_allowed_) {
+    const double elapsed = SecondsAsDouble(now - last_update_time_).count();
+    target_bitrate_ *= 1.0 + kIncreasePerSecond * std::min(elapsed, 1.0);
+  }
+  last_update_time_ = now;
+  ClampTargetBitrate();
+}
+
+void DelayAndLossCongestionController::ClampTargetBitrate() {
+  double ceiling = max_bitrate_;
+  if (network_bandwidth_ > 0) {
+    ceiling = std::min<double>(ceiling, network_bandwidth_);
+  }
+  target_bitrate_ = std::max(min_bitrate_, std::min(target_bitrate_, ceiling));
+}
+
+// static
+constexpr int DelayAndLossCongestionController::kTrendWindowSize;
+
+}  // namespace cast
+}  // namespace openscreen
@@ -0,0 +1,129 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CAST_STREAMING_CONGESTION_CONTROLLER_H_
+#define CAST_STREAMING_CONGESTION_CONTROLLER_H_
+
+#include <array>
+
+#include "platform/api/time.h"
+
+namespace openscreen {
+namespace cast {
+
+// Interface for the logic that decides the target bitrate for all of the media
+// sent through a SenderPacketRouter. The SenderPacketRouter feeds the
+// controller with the network feedback it has, paces its bursts according to
+// the resulting target bitrate, and provides the target bitrate to the
+// application (to configure its encoders).
+class CongestionController {
+ public:
+  virtual ~CongestionController();
+
+  // Called each time a Receiver Report arrives, with a new |round_trip_time|
+  // measurement and the fraction of RTP packets the Receiver reported as lost
+  // since its prior report (in the range [0.0,1.0]).
+  virtual void OnReceiverReport(Clock::time_point arrival_time,
+                                Clock::duration round_trip_time,
+                                double fraction_lost) = 0;
+
+  // Called after each burst-send with the BandwidthEstimator's latest
+  // |network_bandwidth| estimate, in bits per second, or zero if there is none.
+  virtual void OnNetworkBandwidthEstimate(Clock::time_point now,
+                                          int network_bandwidth) = 0;
+
+  // Returns the current target bitrate, in bits per second.
+  virtual int GetTargetBitrate() const = 0;
+};
+
+// A congestion controller that combines a delay-based and a loss-based
+// controller, in the spirit of Google Congestion Control (GCC):
+//
+//   * Delay: The trend of recent round trip times is tracked. A consistently
+//     rising round trip time, along with a significant amount of queueing
+//     delay (the round trip time above the lowest ever seen), means the Senders
+//     are sending faster than the network can deliver. In that case, the
+//     target bitrate is decreased multiplicatively, at most once per round
+//     trip.
+//
+//   * Loss: High packet loss decreases the target bitrate in proportion to the
+//     fraction lost. Moderate packet loss holds the target bitrate steady.
+//
+//   * Otherwise, the target bitrate increases by a fixed percentage per second.
+//     It never exceeds the BandwidthEstimator's network bandwidth estimate,
+//     when there is one (see discussion in bandwidth_estimator.h).
+class DelayAndLossCongestionController final : public CongestionController {
+ public:
+  // The target bitrate starts at |start_bitrate| and is always kept within the
+  // range [min_bitrate,max_bitrate].
+  DelayAndLossCongestionController(int min_bitrate,
+                                   int start_bitrate,
+                                   int max_bitrate,
+                                   Clock::time_point start_time);
+  ~DelayAndLossCongestionController() final;
+
+  // Returns the current estimate of the amount of time packets spend waiting in
+  // network queues.
+  Clock::duration queueing_delay() const { return queueing_delay_; }
+
+  // CongestionController implementation.
+  void OnReceiverReport(Clock::time_point arrival_time,
+                        Clock::duration round_trip_time,
+                        double fraction_lost) final;
+  void OnNetworkBandwidthEstimate(Clock::time_point now,
+                                  int network_bandwidth) final;
+  int GetTargetBitrate() const final;
+
+  // The number of recent round trip time measurements used to compute the
+  // delay trend.
+  static constexpr int kTrendWindowSize = 8;
+
+ private:
+  // Returns the slope of the least-squares fit line through the recent round
+  // trip time measurements, in units of seconds per second; or zero if too few
+  // measurements have been made.
+  double ComputeDelayTrend() const;
+
+  // Increases the target bitrate, if allowed, according to the amount of time
+  // elapsed since the last update.
+  void AdvanceTo(Clock::time_point now);
+
+  // Clamps the target bitrate to the configured range and the most-recent
+  // network bandwidth estimate.
+  void ClampTargetBitrate();
+
+  const double min_bitrate_;
+  const double max_bitrate_;
+  double target_bitrate_;
+
+  // Whether the most-recent feedback indicated the target bitrate may increase.
+  bool increase_allowed_ = true;
+
+  // The time of the last AdvanceTo() call, and of the last decrease of the
+  // target bitrate because of rising delay.
+  Clock::time_point last_update_time_;
+  Clock::time_point last_delay_decrease_time_ = Clock::time_point::min();
+
+  // The most-recent network bandwidth estimate, or zero if unknown.
+  int network_bandwidth_ = 0;
+
+  // Ring buffer of the recent round trip time measurements, and when they were
+  // made.
+  struct DelaySample {
+    Clock::time_point when;
+    Clock::duration round_trip_time;
+  };
+  std::array<DelaySample, kTrendWindowSize> delay_samples_{};
+  int num_delay_samples_ = 0;
+
+  // The lowest round trip time ever measured, assumed to be the round trip
+  // time when network queues are empty.
+  Clock::duration min_round_trip_time_ = Clock::duration::max();
+  Clock::duration queueing_delay_{};
+};
+
+}  // namespace cast
+}  // namespace openscreen
+
+#endif  // CAST_STREAMING_CONGESTION_CONTROLLER_H_
@@ -0,0 +1,266 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cast/streaming/congestion_controller.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace cast {
+namespace {
+
+// Receiver Reports arrive at about the same rate as the Sender Reports they
+// respond to.
+constexpr auto kReportInterval = milliseconds(500);
+
+// The granularity of the network simulation.
+constexpr auto kSimulationStep = milliseconds(5);
+
+constexpr int kMinBitrate = 256 << 10;  // 256 kbps.
+constexpr int kMaxBitrate = 24 << 20;   // 24 Mbps.
+constexpr int kStartBitrate = 1 << 20;  // 1 Mbps.
+
+// A simulated network path with a bottleneck link: Packets wait in a drop-tail
+// FIFO queue that is drained at the link's capacity, and then take a fixed
+// amount of time to propagate. This is modeled as a fluid (bits, not packets),
+// which is accurate enough for the sending rates of interest.
+class SimulatedBottleneckLink {
+ public:
+  SimulatedBottleneckLink(int capacity,
+                          Clock::duration base_round_trip_time,
+                          Clock::duration max_queueing_delay)
+      : capacity_(capacity),
+        base_round_trip_time_(base_round_trip_time),
+        max_queueing_delay_(max_queueing_delay) {}
+
+  void set_capacity(int capacity) { capacity_ = capacity; }
+
+  // The time a packet sent now would wait in the queue.
+  Clock::duration queueing_delay() const {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(backlog_bits_ / capacity_));
+  }
+
+  Clock::duration round_trip_time() const {
+    return base_round_trip_time_ + queueing_delay();
+  }
+
+  // Simulates sending at |bitrate| for one kSimulationStep, and returns the
+  // number of bits dropped because the queue was full.
+  double Transmit(int bitrate) {
+    const double step_seconds =
+        std::chrono::duration<double>(kSimulationStep).count();
+    backlog_bits_ = std::max(
+        0.0, backlog_bits_ + (static_cast<double>(bitrate) - capacity_) *
+                                 step_seconds);
+    const double max_backlog_bits =
+        std::chrono::duration<double>(max_queueing_delay_).count() * capacity_;
+    const double dropped = std::max(0.0, backlog_bits_ - max_backlog_bits);
+    backlog_bits_ -= dropped;
+    return dropped;
+  }
+
+ private:
+  double capacity_;
+  const Clock::duration base_round_trip_time_;
+  const Clock::duration max_queueing_delay_;
+  double backlog_bits_ = 0;
+};
+
+// Statistics collected over the measured portion of a simulation.
+struct SimulationResult {
+  double mean_bitrate = 0;
+  Clock::duration mean_queueing_delay{};
+  double loss_fraction = 0;
+};
+
+// Runs a simulated session, where the Senders transmit at the |controller|'s
+// target bitrate (or at |fixed_bitrate| if |controller| is null), and the
+// Receiver reports loss and round trip times at regular intervals. Statistics
+// are collected after the first |warm_up| of the |duration| has elapsed.
+class CongestionControlSimulation {
+ public:
+  CongestionControlSimulation(SimulatedBottleneckLink* link,
+                              CongestionController* controller,
+                              int fixed_bitrate = 0)
+      : link_(link), controller_(controller), fixed_bitrate_(fixed_bitrate) {}
+
+  SimulationResult Run(Clock::duration duration, Clock::duration warm_up) {
+    const Clock::time_point end_time = now_ + duration;
+    const Clock::time_point measure_start_time = now_ + warm_up;
+    const double step_seconds =
+        std::chrono::duration<double>(kSimulationStep).count();
+    Clock::time_point next_report_time = now_ + kReportInterval;
+    double interval_bits_sent = 0;
+    double interval_bits_dropped = 0;
+
+    double total_bits_sent = 0;
+    double total_bits_dropped = 0;
+    Clock::duration total_queueing_delay{};
+    int num_steps = 0;
+
+    while (now_ < end_time) {
+      const int bitrate =
+          controller_ ? controller_->GetTargetBitrate() : fixed_bitrate_;
+      const double bits = step_seconds * bitrate;
+      const double dropped = link_->Transmit(bitrate);
+      interval_bits_sent += bits;
+      interval_bits_dropped += dropped;
+      now_ += kSimulationStep;
+
+      if (now_ >= measure_start_time) {
+        total_bits_sent += bits;
+        total_bits_dropped += dropped;
+        total_queueing_delay += link_->queueing_delay();
+        ++num_steps;
+      }
+
+      if (now_ >= next_report_time) {
+        if (controller_) {
+          const double fraction_lost =
+              (interval_bits_sent > 0)
+                  ? (interval_bits_dropped / interval_bits_sent)
+                  : 0.0;
+          controller_->OnReceiverReport(now_, link_->round_trip_time(),
+                                        fraction_lost);
+        }
+        interval_bits_sent = 0;
+        interval_bits_dropped = 0;
+        next_report_time += kReportInterval;
+      }
+    }
+
+    SimulationResult result;
+    if (num_steps > 0) {
+      result.mean_bitrate = total_bits_sent / (step_seconds * num_steps);
+      result.mean_queueing_delay = total_queueing_delay / num_steps;
+      result.loss_fraction = total_bits_dropped / total_bits_sent;
+    }
+    return result;
+  }
+
+ private:
+  SimulatedBottleneckLink* const link_;
+  CongestionController* const controller_;
+  const int fixed_bitrate_;
+  Clock::time_point now_{};
+};
+
+// Tests that the target bitrate converges near the capacity of a bottleneck
+// link, while keeping the link's queue nearly empty.
+TEST(DelayAndLossCongestionControllerTest, ConvergesToBottleneckCapacity) {
+  constexpr int kCapacity = 4 << 20;
+  SimulatedBottleneckLink link(kCapacity, milliseconds(20), milliseconds(500));
+  DelayAndLossCongestionController controller(kMinBitrate, kStartBitrate,
+                                              kMaxBitrate, Clock::time_point());
+  CongestionControlSimulation simulation(&link, &controller);
+
+  const SimulationResult result = simulation.Run(seconds(90), seconds(45));
+  EXPECT_GT(result.mean_bitrate, 0.75 * kCapacity);
+  EXPECT_LT(result.mean_bitrate, 1.05 * kCapacity);
+  EXPECT_LT(result.mean_queueing_delay, milliseconds(100));
+  EXPECT_LT(result.loss_fraction, 0.01);
+}
+
+// Tests that, compared to pacing at a fixed bitrate that exceeds the
+// bottleneck's capacity, congestion control drastically reduces the queueing
+// delay and avoids loss.
+TEST(DelayAndLossCongestionControllerTest, ReducesQueueingDelay) {
+  constexpr int kCapacity = 8 << 20;
+
+  SimulatedBottleneckLink fixed_link(kCapacity, milliseconds(20),
+                                     milliseconds(500));
+  CongestionControlSimulation fixed_simulation(&fixed_link, nullptr,
+                                               kMaxBitrate);
+  const SimulationResult fixed_result =
+      fixed_simulation.Run(seconds(90), seconds(45));
+
+  SimulatedBottleneckLink link(kCapacity, milliseconds(20), milliseconds(500));
+  DelayAndLossCongestionController controller(kMinBitrate, kStartBitrate,
+                                              kMaxBitrate, Clock::time_point());
+  CongestionControlSimulation simulation(&link, &controller);
+  const SimulationResult result = simulation.Run(seconds(90), seconds(45));
+
+  EXPECT_GT(fixed_result.mean_queueing_delay, milliseconds(400));
+  EXPECT_GT(fixed_result.loss_fraction, 0.5);
+  EXPECT_LT(result.mean_queueing_delay * 4, fixed_result.mean_queueing_delay);
+  EXPECT_LT(result.loss_fraction, 0.01);
+  EXPECT_GT(result.mean_bitrate, 0.75 * kCapacity);
+}
+
+// Tests that the target bitrate follows a sudden drop in the bottleneck's
+// capacity, and that the queue drains afterwards.
+TEST(DelayAndLossCongestionControllerTest, AdaptsToReducedCapacity) {
+  SimulatedBottleneckLink link(8 << 20, milliseconds(40), milliseconds(300));
+  DelayAndLossCongestionController controller(kMinBitrate, kStartBitrate,
+                                              kMaxBitrate, Clock::time_point());
+  CongestionControlSimulation simulation(&link, &controller);
+  simulation.Run(seconds(60), seconds(0));
+  EXPECT_GT(controller.GetTargetBitrate(), 6 << 20);
+
+  constexpr int kReducedCapacity = 2 << 20;
+  link.set_capacity(kReducedCapacity);
+  simulation.Run(seconds(10), seconds(0));
+  EXPECT_LT(controller.GetTargetBitrate(), kReducedCapacity * 1.1);
+
+  const SimulationResult result = simulation.Run(seconds(30), seconds(0));
+  EXPECT_GT(result.mean_bitrate, 0.6 * kReducedCapacity);
+  EXPECT_LT(result.mean_queueing_delay, milliseconds(100));
+}
+
+// Tests that heavy packet loss decreases the target bitrate, even when there is
+// no sign of delay; and that moderate packet loss holds it steady.
+TEST(DelayAndLossCongestionControllerTest, RespondsToPacketLoss) {
+  DelayAndLossCongestionController controller(kMinBitrate, 4 << 20,
+                                              kMaxBitrate, Clock::time_point());
+  Clock::time_point now{};
+  const auto report = [&](double fraction_lost) {
+    now += kReportInterval;
+    controller.OnReceiverReport(now, milliseconds(30), fraction_lost);
+  };
+
+  report(0.0);
+  const int initial_bitrate = controller.GetTargetBitrate();
+  report(0.0);
+  EXPECT_GT(controller.GetTargetBitrate(), initial_bitrate);
+
+  int prior_bitrate = controller.GetTargetBitrate();
+  report(0.25);
+  EXPECT_LT(controller.GetTargetBitrate(), prior_bitrate * 0.95);
+
+  prior_bitrate = controller.GetTargetBitrate();
+  report(0.05);
+  report(0.05);
+  EXPECT_EQ(prior_bitrate, controller.GetTargetBitrate());
+
+  for (int i = 0; i < 100; ++i) {
+    report(0.5);
+  }
+  EXPECT_EQ(kMinBitrate, controller.GetTargetBitrate());
+}
+
+// Tests that the target bitrate never exceeds the configured maximum, nor the
+// most-recent network bandwidth estimate.
+TEST(DelayAndLossCongestionControllerTest, IsBoundedByBandwidthEstimate) {
+  DelayAndLossCongestionController controller(kMinBitrate, 4 << 20,
+                                              kMaxBitrate, Clock::time_point());
+  Clock::time_point now{};
+  controller.OnNetworkBandwidthEstimate(now, 3 << 20);
+  EXPECT_EQ(3 << 20, controller.GetTargetBitrate());
+
+  // With no estimate, the target bitrate increases up to the maximum.
+  controller.OnNetworkBandwidthEstimate(now, 0);
+  for (int i = 0; i < 300; ++i) {
+    now += kReportInterval;
+    controller.OnReceiverReport(now, milliseconds(30), 0.0);
+  }
+  EXPECT_EQ(kMaxBitrate, controller.GetTargetBitrate());
+}
+
+}  // namespace
+}  // namespace cast
+}  // namespace openscreen
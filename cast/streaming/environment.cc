@@ -4,6 +4,8 @@
 
 #include "cast/streaming/environment.h"
 
+#include <algorithm>
+
 #include "cast/streaming/rtp_defines.h"
 #include "platform/api/task_runner.h"
 #include "util/osp_logging.h"
@@ -11,9 +13,31 @@
 namespace openscreen {
 namespace cast {
 
+namespace {
+
+// The maximum number of packets to read from the socket at once. During
+// high-bitrate streaming, many RTP packets arrive in quick succession, and so
+// reading them in batches greatly reduces the system call overhead.
+constexpr int kMaxPacketsPerRead = 32;
+
+// The size of each buffer in the packet buffer pool. The larger of the two
+// maximum RTP packet sizes is used here, since the remote endpoint's IP version
+// is not yet known when the pool is created.
+constexpr int kPacketBufferSize =
+    std::max(kMaxRtpPacketSizeForIpv4UdpOnEthernet,
+             kMaxRtpPacketSizeForIpv6UdpOnEthernet);
+
+// The maximum number of unused packet buffers retained by the pool. This is
+// enough for a few large video key frames to be in-flight at once.
+constexpr int kMaxPooledPacketBuffers = 1024;
+
+}  // namespace
+
 Environment::Environment(ClockNowFunctionPtr now_function,
                          TaskRunner* task_runner)
-    : now_function_(now_function), task_runner_(task_runner) {
+    : now_function_(now_function),
+      task_runner_(task_runner),
+      packet_buffer_pool_(kPacketBufferSize, kMaxPooledPacketBuffers) {
   OSP_DCHECK(now_function_);
   OSP_DCHECK(task_runner_);
 }
@@ -27,6 +51,8 @@ Environment::Environment(ClockNowFunctionPtr now_function,
   const_cast<std::unique_ptr<UdpSocket>&>(socket_) = std::move(result.value());
   if (socket_) {
     socket_->Bind();
+    socket_->SetReceiveBatching(kMaxPacketsPerRead, kPacketBufferSize);
+    socket_->SetReceiveBufferPool(&packet_buffer_pool_);
   } else {
     OSP_LOG_ERROR << "Unable to create a UDP socket bound to " << local_endpoint
                   << ": " << result.error();
@@ -76,6 +102,36 @@ void Environment::SendPacket(absl::Span<const uint8_t> packet) {
   }
 }
 
+void Environment::SendPackets(
+    absl::Span<const absl::Span<const uint8_t>> packets) {
+  OSP_DCHECK(remote_endpoint_.address);
+  OSP_DCHECK_NE(remote_endpoint_.port, 0);
+  if (!socket_) {
+    for (absl::Span<const uint8_t> packet : packets) {
+      SendPacket(packet);
+    }
+    return;
+  }
+
+  outgoing_messages_.clear();
+  for (absl::Span<const uint8_t> packet : packets) {
+    outgoing_messages_.push_back(
+        UdpSocket::MessageBuffer{packet.data(), packet.size()});
+  }
+  socket_->SendMessages(outgoing_messages_.data(), outgoing_messages_.size(),
+                        remote_endpoint_);
+}
+
+void Environment::PacketConsumer::OnReceivedPackets(
+    Clock::time_point arrival_time,
+    std::vector<UdpPacket> packets) {
+  for (UdpPacket& packet : packets) {
+    const IPEndpoint source = packet.source();
+    OnReceivedPacket(source, arrival_time,
+                     std::move(static_cast<std::vector<uint8_t>&>(packet)));
+  }
+}
+
 Environment::PacketConsumer::~PacketConsumer() = default;
 
 void Environment::OnError(UdpSocket* socket, Error error) {
@@ -126,5 +182,16 @@ void Environment::OnRead(UdpSocket* socket,
       std::move(static_cast<std::vector<uint8_t>&>(packet)));
 }
 
+void Environment::OnReadBatch(UdpSocket* socket,
+                              std::vector<UdpPacket> packets) {
+  if (!packet_consumer_ || packets.empty()) {
+    return;
+  }
+
+  // See comments in OnRead(). All packets in the batch were read from the
+  // socket at the same time, and so they share the same "arrival time."
+  packet_consumer_->OnReceivedPackets(now_function_(), std::move(packets));
+}
+
 }  // namespace cast
 }  // namespace openscreen
@@ -9,11 +9,13 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "absl/types/span.h"
 #include "platform/api/time.h"
 #include "platform/api/udp_socket.h"
 #include "platform/base/ip_address.h"
+#include "platform/base/packet_buffer_pool.h"
 
 namespace openscreen {
 namespace cast {
@@ -28,6 +30,14 @@ class Environment : public UdpSocket::Client {
                                   Clock::time_point arrival_time,
                                   std::vector<uint8_t> packet) = 0;
 
+    // Called instead of OnReceivedPacket() when a batch of |packets| has been
+    // read from the socket all at once, all sharing the same |arrival_time|.
+    // The |packets| are in arrival order. The default implementation calls
+    // OnReceivedPacket() once for each packet; PacketConsumers that can
+    // amortize per-packet work across the whole batch should override this.
+    virtual void OnReceivedPackets(Clock::time_point arrival_time,
+                                   std::vector<UdpPacket> packets);
+
    protected:
     virtual ~PacketConsumer();
   };
@@ -45,6 +55,11 @@ class Environment : public UdpSocket::Client {
   Clock::time_point now() const { return now_function_(); }
   TaskRunner* task_runner() const { return task_runner_; }
 
+  // Returns the pool from which the buffers of received packets are taken.
+  // PacketConsumers should return the buffers of the packets they are done
+  // with to this pool, so that they can be re-used for later packets.
+  PacketBufferPool* packet_buffer_pool() { return &packet_buffer_pool_; }
+
   // Returns the local endpoint the socket is bound to, or the zero IPEndpoint
   // if socket creation/binding failed.
   //
@@ -86,6 +101,15 @@ class Environment : public UdpSocket::Client {
   // before they actually head-out through the socket.
   virtual void SendPacket(absl::Span<const uint8_t> packet);
 
+  // Sends all of the given |packets|, in order, to the remote endpoint,
+  // best-effort. This is more efficient than calling SendPacket() for each,
+  // since the socket can hand them all to the operating system at once.
+  //
+  // Note: When there is no socket (e.g., in unit tests that use the protected
+  // constructor), this calls SendPacket() for each packet instead, so that
+  // subclasses only need to intercept that one method.
+  virtual void SendPackets(absl::Span<const absl::Span<const uint8_t>> packets);
+
  protected:
   // Common constructor that just stores the injected dependencies and does not
   // create a socket. Subclasses use this to provide an alternative packet
@@ -97,10 +121,14 @@ class Environment : public UdpSocket::Client {
   void OnError(UdpSocket* socket, Error error) final;
   void OnSendError(UdpSocket* socket, Error error) final;
   void OnRead(UdpSocket* socket, ErrorOr<UdpPacket> packet_or_error) final;
+  void OnReadBatch(UdpSocket* socket, std::vector<UdpPacket> packets) final;
 
   const ClockNowFunctionPtr now_function_;
   TaskRunner* const task_runner_;
 
+  // Declared before |socket_|, since the socket takes buffers from the pool.
+  PacketBufferPool packet_buffer_pool_;
+
   // The UDP socket bound to the local endpoint that was passed into the
   // constructor, or null if socket creation failed.
   const std::unique_ptr<UdpSocket> socket_;
@@ -110,6 +138,10 @@ class Environment : public UdpSocket::Client {
   std::function<void(Error)> socket_error_handler_;
   IPEndpoint remote_endpoint_{};
   PacketConsumer* packet_consumer_ = nullptr;
+
+  // Scratch space used by SendPackets(), retained to avoid re-allocating it
+  // for every call.
+  std::vector<UdpSocket::MessageBuffer> outgoing_messages_;
 };
 
 }  // namespace cast
@@ -6,9 +6,10 @@
 
 #include <algorithm>
 #include <limits>
-#include <numeric>
+#include <utility>
 
 #include "cast/streaming/frame_id.h"
+#include "cast/streaming/packet_util.h"
 #include "cast/streaming/rtp_defines.h"
 #include "util/osp_logging.h"
 
@@ -23,7 +24,7 @@ constexpr int kUnknownNumberOfPackets = std::numeric_limits<int>::max();
 }  // namespace
 
 FrameCollector::FrameCollector()
-    : num_missing_packets_(kUnknownNumberOfPackets) {}
+    : num_missing_packets_(kUnknownNumberOfPackets), payload_size_(0) {}
 
 FrameCollector::~FrameCollector() = default;
 
@@ -43,6 +44,7 @@ bool FrameCollector::CollectRtpPacket(const RtpPacketParser::ParseResult& part,
     // This is the first packet being processed for the frame.
     num_missing_packets_ = frame_packet_count;
     chunks_.resize(num_missing_packets_);
+    missing_packets_.Resize(num_missing_packets_, YetAnotherBitVector::SET);
   } else {
     // Since this is not the first packet being processed, sanity-check that the
     // "frame ID" and "max packet ID" are the expected values.
@@ -63,8 +65,20 @@ bool FrameCollector::CollectRtpPacket(const RtpPacketParser::ParseResult& part,
     return false;
   }
 
-  // Don't process duplicate packets.
-  if (chunks_[part.packet_id].has_data()) {
+  // FEC Parity packets are set aside, and then used to recover the missing
+  // packet they protect, if possible. Note that the Parity packet protecting
+  // packet 0 contains the same metadata as packet 0 (see below).
+  const bool is_parity = part.fec_num_protected_packets > 0;
+  if (is_parity) {
+    if (int{part.packet_id} + part.fec_num_protected_packets >
+        static_cast<int>(chunks_.size())) {
+      OSP_LOG_WARN << "Ignoring potentially corrupt FEC Parity packet "
+                      "protecting packets beyond the end of the frame.";
+      return false;
+    }
+  } else if (!missing_packets_.IsSet(part.packet_id)) {
+    // Don't process duplicate packets.
+    //
     // Note: No logging here because this is a common occurrence that is not
     // indicative of any problem in the system.
     return true;
@@ -88,16 +102,33 @@ bool FrameCollector::CollectRtpPacket(const RtpPacketParser::ParseResult& part,
   // Take ownership of the contents of the |buffer| (no copy!), and record the
   // region of the buffer containing the payload data. The payload region is
   // usually all but the first few dozen bytes of the buffer.
-  PayloadChunk& chunk = chunks_[part.packet_id];
-  chunk.buffer.swap(*buffer);
-  chunk.payload = part.payload;
-  OSP_DCHECK_GE(chunk.payload.data(), chunk.buffer.data());
-  OSP_DCHECK_LE(chunk.payload.data() + chunk.payload.size(),
-                chunk.buffer.data() + chunk.buffer.size());
+  PayloadChunk* chunk;
+  if (is_parity) {
+    parity_chunks_.emplace_back();
+    ParityChunk& parity = parity_chunks_.back();
+    parity.first_packet_id = part.packet_id;
+    parity.num_protected = part.fec_num_protected_packets;
+    parity.payload_size_xor = part.fec_payload_size_xor;
+    chunk = &parity;
+  } else {
+    chunk = &chunks_[part.packet_id];
+  }
+  chunk->buffer.swap(*buffer);
+  chunk->payload = part.payload;
+  OSP_DCHECK_GE(chunk->payload.data(), chunk->buffer.data());
+  OSP_DCHECK_LE(chunk->payload.data() + chunk->payload.size(),
+                chunk->buffer.data() + chunk->buffer.size());
 
   // Success!
-  --num_missing_packets_;
-  OSP_DCHECK_GE(num_missing_packets_, 0);
+  if (!is_parity) {
+    payload_size_ += static_cast<int>(chunk->payload.size());
+    missing_packets_.Clear(part.packet_id);
+    --num_missing_packets_;
+    OSP_DCHECK_GE(num_missing_packets_, 0);
+  }
+  if (!parity_chunks_.empty()) {
+    RecoverMissingPackets();
+  }
   return true;
 }
 
@@ -114,25 +145,40 @@ void FrameCollector::GetMissingPackets(std::vector<PacketNack>* nacks) const {
     return;
   }
 
-  for (int packet_id = 0; packet_id < frame_packet_count; ++packet_id) {
-    if (!chunks_[packet_id].has_data()) {
+  // Walk the runs of consecutive missing packets, skipping over the received
+  // ones a whole word of the bit vector at a time.
+  nacks->reserve(nacks->size() + num_missing_packets_);
+  for (int begin = missing_packets_.FindFirstSet(); begin < frame_packet_count;
+       begin = missing_packets_.FindFirstSet(begin)) {
+    const int end = missing_packets_.FindFirstClear(begin);
+    for (; begin < end; ++begin) {
       nacks->push_back(
-          PacketNack{frame_.frame_id, static_cast<FramePacketId>(packet_id)});
+          PacketNack{frame_.frame_id, static_cast<FramePacketId>(begin)});
     }
   }
 }
 
+int FrameCollector::GetNumLeadingPacketsCollected() const {
+  if (num_missing_packets_ == kUnknownNumberOfPackets) {
+    return 0;
+  }
+  return missing_packets_.FindFirstSet();
+}
+
+absl::Span<const uint8_t> FrameCollector::GetPacketPayload(
+    FramePacketId packet_id) const {
+  OSP_DCHECK_LT(int{packet_id}, missing_packets_.size());
+  OSP_DCHECK(!missing_packets_.IsSet(packet_id));
+  return chunks_[packet_id].payload;
+}
+
 const EncryptedFrame& FrameCollector::PeekAtAssembledFrame() {
   OSP_DCHECK_EQ(num_missing_packets_, 0);
 
   if (!frame_.data.data()) {
     // Allocate the frame's payload buffer once, right-sized to the sum of all
     // chunk sizes.
-    frame_.owned_data_.reserve(
-        std::accumulate(chunks_.cbegin(), chunks_.cend(), size_t{0},
-                        [](size_t num_bytes_so_far, const PayloadChunk& chunk) {
-                          return num_bytes_so_far + chunk.payload.size();
-                        }));
+    frame_.owned_data_.reserve(payload_size_);
     // Now, populate the frame's payload buffer with each chunk of data.
     for (const PayloadChunk& chunk : chunks_) {
       frame_.owned_data_.insert(frame_.owned_data_.end(), chunk.payload.begin(),
@@ -144,13 +190,121 @@ const EncryptedFrame& FrameCollector::PeekAtAssembledFrame() {
   return frame_;
 }
 
+const EncodedFrame& FrameCollector::PeekAtFrameMetadata() const {
+  OSP_DCHECK_GT(GetNumLeadingPacketsCollected(), 0);
+  return frame_;
+}
+
+int FrameCollector::GetPayloadSize() const {
+  OSP_DCHECK_EQ(num_missing_packets_, 0);
+  return payload_size_;
+}
+
+absl::Span<const absl::Span<const uint8_t>> FrameCollector::GetPayloadChunks() {
+  OSP_DCHECK_EQ(num_missing_packets_, 0);
+
+  if (payload_chunks_.empty()) {
+    payload_chunks_.reserve(chunks_.size());
+    for (const PayloadChunk& chunk : chunks_) {
+      payload_chunks_.push_back(chunk.payload);
+    }
+  }
+  return payload_chunks_;
+}
+
+void FrameCollector::RecoverMissingPackets() {
+  // Recovering one packet might allow another to be recovered, if the Parity
+  // packets protect overlapping sets of packets. So, repeat until no further
+  // progress is made.
+  bool recovered_any;
+  do {
+    recovered_any = false;
+    for (auto it = parity_chunks_.begin(); it != parity_chunks_.end();) {
+      const int begin = it->first_packet_id;
+      const int end = begin + it->num_protected;
+      const int num_missing = missing_packets_.CountBitsSet(begin, end);
+      if (num_missing > 1) {
+        ++it;
+        continue;  // Cannot recover yet.
+      }
+      if (num_missing == 1 &&
+          RecoverPacket(&*it, static_cast<FramePacketId>(
+                                  missing_packets_.FindFirstSet(begin)))) {
+        recovered_any = true;
+      }
+      // The Parity packet has either been used-up, was corrupt, or is no longer
+      // needed.
+      ReleaseBuffer(std::move(it->buffer));
+      it = parity_chunks_.erase(it);
+    }
+  } while (recovered_any && !parity_chunks_.empty());
+}
+
+bool FrameCollector::RecoverPacket(ParityChunk* parity,
+                                   FramePacketId packet_id) {
+  // Determine the size of the missing packet's payload from the XOR of all the
+  // sizes. Only the frame's last packet may be smaller than the Parity packet's
+  // payload.
+  int payload_size = parity->payload_size_xor;
+  for (int i = 0; i < parity->num_protected; ++i) {
+    const PayloadChunk& chunk = chunks_[parity->first_packet_id + i];
+    if (chunk.has_data()) {
+      payload_size ^= static_cast<uint16_t>(chunk.payload.size());
+    }
+  }
+  if (payload_size > static_cast<int>(parity->payload.size()) ||
+      (payload_size < static_cast<int>(parity->payload.size()) &&
+       int{packet_id} != static_cast<int>(chunks_.size()) - 1)) {
+    OSP_LOG_WARN << "Ignoring potentially corrupt FEC Parity packet (bad "
+                    "payload size).";
+    return false;
+  }
+
+  // XOR all the other packets' payloads into the Parity packet's payload, in
+  // its buffer. What remains is the missing packet's payload.
+  const absl::Span<uint8_t> recovered(
+      parity->buffer.data() + (parity->payload.data() - parity->buffer.data()),
+      payload_size);
+  for (int i = 0; i < parity->num_protected; ++i) {
+    const PayloadChunk& chunk = chunks_[parity->first_packet_id + i];
+    if (chunk.has_data()) {
+      XorInto(chunk.payload.subspan(0, recovered.size()), recovered);
+    }
+  }
+
+  PayloadChunk& chunk = chunks_[packet_id];
+  chunk.buffer.swap(parity->buffer);
+  chunk.payload = recovered;
+  payload_size_ += payload_size;
+  missing_packets_.Clear(packet_id);
+  --num_missing_packets_;
+  OSP_DCHECK_GE(num_missing_packets_, 0);
+  return true;
+}
+
+void FrameCollector::ReleaseBuffer(std::vector<uint8_t> buffer) {
+  if (buffer_pool_) {
+    buffer_pool_->Release(std::move(buffer));
+  }
+}
+
 void FrameCollector::Reset() {
   num_missing_packets_ = kUnknownNumberOfPackets;
   frame_.frame_id = FrameId();
   frame_.owned_data_.clear();
   frame_.owned_data_.shrink_to_fit();
   frame_.data = absl::Span<uint8_t>();
+  for (PayloadChunk& chunk : chunks_) {
+    ReleaseBuffer(std::move(chunk.buffer));
+  }
   chunks_.clear();
+  missing_packets_.Resize(0, YetAnotherBitVector::CLEARED);
+  for (ParityChunk& parity : parity_chunks_) {
+    ReleaseBuffer(std::move(parity.buffer));
+  }
+  parity_chunks_.clear();
+  payload_size_ = 0;
+  payload_chunks_.clear();
 }
 
 FrameCollector::PayloadChunk::PayloadChunk() = default;
@@ -12,6 +12,8 @@
 #include "cast/streaming/frame_id.h"
 #include "cast/streaming/rtcp_common.h"
 #include "cast/streaming/rtp_packet_parser.h"
+#include "platform/base/packet_buffer_pool.h"
+#include "util/yet_another_bit_vector.h"
 
 namespace openscreen {
 namespace cast {
@@ -27,11 +29,21 @@ class FrameCollector {
   // each Reset(), and before any of the other methods.
   void set_frame_id(FrameId frame_id) { frame_.frame_id = frame_id; }
 
+  // Sets the pool to which Reset() returns the packet buffers taken by
+  // CollectRtpPacket(). If not set, the buffers are freed instead.
+  void set_buffer_pool(PacketBufferPool* buffer_pool) {
+    buffer_pool_ = buffer_pool;
+  }
+
   // Examine the parsed packet, representing part of the whole frame, and
   // collect any data/metadata from it that helps complete the frame. Returns
   // false if the |part| contained invalid data. On success, this method takes
   // the data contained within the |buffer|, into which |part.payload| is
   // pointing, in lieu of copying the data.
+  //
+  // FEC Parity packets are also collected here. Whenever all but one of the
+  // packets protected by a FEC Parity packet have been collected, the missing
+  // one is reconstructed, and no longer needs to be re-transmitted.
   [[nodiscard]] bool CollectRtpPacket(const RtpPacketParser::ParseResult& part,
                                       std::vector<uint8_t>* buffer);
 
@@ -43,9 +55,19 @@ class FrameCollector {
   // yet collected. If all packets for the frame are missing, this appends a
   // single element containing the special kAllPacketsLost packet ID. Otherwise,
   // one element is appended for each missing packet, in increasing order of
-  // packet ID.
+  // packet ID. The cost of this is proportional to the number of missing
+  // packets, not the total number of packets in the frame.
   void GetMissingPackets(std::vector<PacketNack>* nacks) const;
 
+  // Returns the number of packets, starting from packet 0, that have all been
+  // collected (or recovered). This is the part of the frame that can already
+  // be processed in-order, before the rest of the packets arrive.
+  int GetNumLeadingPacketsCollected() const;
+
+  // Returns the payload of the collected (or recovered) packet having the given
+  // |packet_id|. The span is invalidated by Reset().
+  absl::Span<const uint8_t> GetPacketPayload(FramePacketId packet_id) const;
+
   // Returns a read-only reference to the completely-collected frame, assembling
   // it if necessary. The caller should reset the FrameCollector (see Reset()
   // below) to free-up memory once it has finished reading from the returned
@@ -55,7 +77,23 @@ class FrameCollector {
   // called.
   const EncryptedFrame& PeekAtAssembledFrame();
 
-  // Resets the FrameCollector back to its initial state, freeing-up memory.
+  // Alternatives to PeekAtAssembledFrame() that do not assemble the frame,
+  // meant for passing to the scatter-gather FrameCrypto::Decrypt() overload:
+  // PeekAtFrameMetadata() returns the frame's metadata, but its |data| member
+  // may be empty; GetPayloadSize() returns the total payload size in bytes; and
+  // GetPayloadChunks() returns the payload of each packet, in order. The spans
+  // are invalidated by Reset().
+  //
+  // Precondition: is_complete() must return true before these methods can be
+  // called. Exception: PeekAtFrameMetadata() only requires that packet 0, which
+  // carries the metadata, has been collected (i.e.,
+  // GetNumLeadingPacketsCollected() returns a value greater than zero).
+  const EncodedFrame& PeekAtFrameMetadata() const;
+  int GetPayloadSize() const;
+  absl::Span<const absl::Span<const uint8_t>> GetPayloadChunks();
+
+  // Resets the FrameCollector back to its initial state, freeing-up memory (or
+  // returning the packet buffers to the buffer pool).
   void Reset();
 
  private:
@@ -69,6 +107,26 @@ class FrameCollector {
     bool has_data() const { return !!payload.data(); }
   };
 
+  // A collected FEC Parity packet, protecting the |num_protected| packets
+  // starting at |first_packet_id|.
+  struct ParityChunk : public PayloadChunk {
+    FramePacketId first_packet_id = 0;
+    int num_protected = 0;
+    uint16_t payload_size_xor = 0;
+  };
+
+  // Reconstructs any missing packets that can be recovered using the collected
+  // FEC Parity packets.
+  void RecoverMissingPackets();
+
+  // Reconstructs the packet having |packet_id|, which must be the only packet
+  // protected by |parity| that is missing, re-using the |parity|'s buffer to
+  // hold it. Returns false if |parity| contained invalid data.
+  bool RecoverPacket(ParityChunk* parity, FramePacketId packet_id);
+
+  // Returns the |buffer| of a chunk to the buffer pool, if set.
+  void ReleaseBuffer(std::vector<uint8_t> buffer);
+
   // Storage for frame metadata and data. Once the frame has been completely
   // collected and assembled, |frame_.data| is set to non-null, and this is
   // exposed externally (read-only).
@@ -82,6 +140,24 @@ class FrameCollector {
   // correspond 1:1 with packet IDs. When the first part is collected, this is
   // resized to match the total number of packets being expected.
   std::vector<PayloadChunk> chunks_;
+
+  // Which of the |chunks_| have not yet been collected (or recovered), where
+  // bit positions correspond 1:1 with packet IDs. This is resized along with
+  // |chunks_|.
+  YetAnotherBitVector missing_packets_;
+
+  // The sum of the sizes of the payloads in |chunks_| collected so far.
+  int payload_size_;
+
+  // The FEC Parity packets that have been collected, but not yet used to
+  // recover a missing packet.
+  std::vector<ParityChunk> parity_chunks_;
+
+  // Populated by GetPayloadChunks(). This is cleared, but not freed, by
+  // Reset(), so that its storage is re-used for subsequent frames.
+  std::vector<absl::Span<const uint8_t>> payload_chunks_;
+
+  PacketBufferPool* buffer_pool_ = nullptr;
 };
 
 }  // namespace cast
@@ -11,6 +11,7 @@
 
 #include "cast/streaming/encoded_frame.h"
 #include "cast/streaming/frame_id.h"
+#include "cast/streaming/packet_util.h"
 #include "cast/streaming/rtcp_common.h"
 #include "cast/streaming/rtp_time.h"
 #include "gtest/gtest.h"
@@ -114,6 +115,8 @@ TEST(FrameCollectorTest, CollectsFrameWithMultiplePartsArrivingOutOfOrder) {
 
   // Collect all six packets, out-of-order, and with some duplicates.
   constexpr FramePacketId kPacketIds[] = {2, 0, 1, 2, 4, 3, 5, 5, 5, 0};
+  EXPECT_EQ(0, collector.GetNumLeadingPacketsCollected());
+  bool collected[6] = {};
   for (FramePacketId packet_id : kPacketIds) {
     RtpPacketParser::ParseResult part{};
     part.rtp_timestamp = kSomeRtpTimestamp;
@@ -140,12 +143,34 @@ TEST(FrameCollectorTest, CollectsFrameWithMultiplePartsArrivingOutOfOrder) {
                        }),
         remaining_nacks.end());
     EXPECT_HAS_NACKS(remaining_nacks, collector);
+
+    // Check that the leading, contiguous, run of packets is tracked, and that
+    // their payloads are available.
+    collected[packet_id] = true;
+    const int expected_leading_count = static_cast<int>(
+        std::find(std::begin(collected), std::end(collected), false) -
+        std::begin(collected));
+    EXPECT_EQ(expected_leading_count,
+              collector.GetNumLeadingPacketsCollected());
+    EXPECT_EQ(absl::Span<const uint8_t>(payloads[packet_id]),
+              collector.GetPacketPayload(packet_id));
   }
 
   // Confirm there are no missing packets and no NACKs generated.
   EXPECT_TRUE(collector.is_complete());
   EXPECT_HAS_NACKS(std::vector<PacketNack>(), collector);
 
+  // Confirm the payload chunks, which are available without assembling the
+  // frame, are each packet's payload in order.
+  EXPECT_EQ(999 + 998 * 3 + 42, collector.GetPayloadSize());
+  EXPECT_EQ(kSomeFrameId, collector.PeekAtFrameMetadata().frame_id);
+  const absl::Span<const absl::Span<const uint8_t>> chunks =
+      collector.GetPayloadChunks();
+  ASSERT_EQ(6u, chunks.size());
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(absl::Span<const uint8_t>(payloads[i]), chunks[i]) << "i=" << i;
+  }
+
   // Examine the assembled frame, and confirm its metadata and payload match
   // what was put into the collector via the packets above, and that the payload
   // bytes are in-order.
@@ -165,6 +190,64 @@ TEST(FrameCollectorTest, CollectsFrameWithMultiplePartsArrivingOutOfOrder) {
   ASSERT_TRUE(remaining_data.empty());
 }
 
+// Tests that the NACKs are correct for a large frame (spanning multiple words
+// of the missing-packet bit vector) with runs of missing packets crossing the
+// word boundaries.
+TEST(FrameCollectorTest, GeneratesNacksForRunsOfMissingPacketsInLargeFrame) {
+  constexpr int kNumPackets = 300;
+  FrameCollector collector;
+  collector.set_frame_id(kSomeFrameId);
+
+  // Collect all but packets [60,70), [127,129) and the last packet.
+  const auto is_lost = [](int packet_id) {
+    return (packet_id >= 60 && packet_id < 70) ||
+           (packet_id >= 127 && packet_id < 129) ||
+           packet_id == kNumPackets - 1;
+  };
+  std::vector<PacketNack> expected_nacks;
+  for (int i = 0; i < kNumPackets; ++i) {
+    const FramePacketId packet_id = static_cast<FramePacketId>(i);
+    if (is_lost(i)) {
+      expected_nacks.push_back(PacketNack{kSomeFrameId, packet_id});
+      continue;
+    }
+    RtpPacketParser::ParseResult part{};
+    part.rtp_timestamp = kSomeRtpTimestamp;
+    part.is_key_frame = false;
+    part.frame_id = kSomeFrameId;
+    part.packet_id = packet_id;
+    part.max_packet_id = kNumPackets - 1;
+    part.referenced_frame_id = kSomeFrameId;
+    std::vector<uint8_t> buffer(8, static_cast<uint8_t>(i));
+    part.payload = absl::Span<uint8_t>(buffer);
+    ASSERT_TRUE(collector.CollectRtpPacket(part, &buffer));
+  }
+  EXPECT_HAS_NACKS(expected_nacks, collector);
+
+  // Existing NACKs in the output vector are left untouched.
+  std::vector<PacketNack> nacks = {{kSomeFrameId - 1, 3}};
+  collector.GetMissingPackets(&nacks);
+  ASSERT_EQ(expected_nacks.size() + 1, nacks.size());
+  EXPECT_EQ((PacketNack{kSomeFrameId - 1, 3}), nacks.front());
+
+  // After a Reset(), the collector can be re-used for a smaller frame.
+  collector.Reset();
+  collector.set_frame_id(kSomeFrameId + 1);
+  RtpPacketParser::ParseResult part{};
+  part.rtp_timestamp = kSomeRtpTimestamp;
+  part.is_key_frame = false;
+  part.frame_id = kSomeFrameId + 1;
+  part.packet_id = 1;
+  part.max_packet_id = 2;
+  part.referenced_frame_id = kSomeFrameId;
+  std::vector<uint8_t> buffer(8, uint8_t{42});
+  part.payload = absl::Span<uint8_t>(buffer);
+  ASSERT_TRUE(collector.CollectRtpPacket(part, &buffer));
+  EXPECT_HAS_NACKS(
+      (std::vector<PacketNack>{{kSomeFrameId + 1, 0}, {kSomeFrameId + 1, 2}}),
+      collector);
+}
+
 TEST(FrameCollectorTest, RejectsInvalidParts) {
   FrameCollector collector;
 
@@ -206,6 +289,110 @@ TEST(FrameCollectorTest, RejectsInvalidParts) {
   ASSERT_TRUE(buffer.size() == 1 && buffer[0] == 'A');
 }
 
+TEST(FrameCollectorTest, ReturnsPacketBuffersToPoolOnReset) {
+  PacketBufferPool pool(64, 8);
+  FrameCollector collector;
+  collector.set_buffer_pool(&pool);
+  collector.set_frame_id(kSomeFrameId);
+
+  const uint8_t* storage[2];
+  for (int i = 0; i < 2; ++i) {
+    RtpPacketParser::ParseResult part{};
+    part.rtp_timestamp = kSomeRtpTimestamp;
+    part.is_key_frame = true;
+    part.frame_id = kSomeFrameId;
+    part.packet_id = static_cast<FramePacketId>(i);
+    part.max_packet_id = 1;
+    part.referenced_frame_id = kSomeFrameId;
+    std::vector<uint8_t> buffer = pool.Acquire(64);
+    storage[i] = buffer.data();
+    part.payload = absl::Span<uint8_t>(buffer).subspan(12);
+    EXPECT_TRUE(collector.CollectRtpPacket(part, &buffer));
+  }
+  ASSERT_TRUE(collector.is_complete());
+  EXPECT_EQ(0u, pool.GetPooledBufferCount());
+
+  collector.Reset();
+  EXPECT_EQ(2u, pool.GetPooledBufferCount());
+  const std::vector<uint8_t> reused[2] = {pool.Acquire(64), pool.Acquire(64)};
+  EXPECT_TRUE((reused[0].data() == storage[0] &&
+               reused[1].data() == storage[1]) ||
+              (reused[0].data() == storage[1] &&
+               reused[1].data() == storage[0]));
+}
+
+// Tests that missing packets are recovered from FEC Parity packets, whether
+// the Parity packets arrive before or after the other packets they protect.
+TEST(FrameCollectorTest, RecoversMissingPacketsFromFecParity) {
+  // A frame of 5 packets, where the last one is smaller.
+  constexpr int kNumPackets = 5;
+  constexpr int kPacketPayloadSize = 100;
+  constexpr int kLastPacketPayloadSize = 37;
+  std::vector<uint8_t> payloads[kNumPackets];
+  for (int i = 0; i < kNumPackets; ++i) {
+    payloads[i].resize((i == kNumPackets - 1) ? kLastPacketPayloadSize
+                                              : kPacketPayloadSize);
+    for (size_t j = 0; j < payloads[i].size(); ++j) {
+      payloads[i][j] = static_cast<uint8_t>(i * 31 + j);
+    }
+  }
+
+  FrameCollector collector;
+  collector.set_frame_id(kSomeFrameId);
+  const auto collect = [&](FramePacketId packet_id, int num_protected) {
+    RtpPacketParser::ParseResult part;
+    part.rtp_timestamp = kSomeRtpTimestamp;
+    part.is_key_frame = true;
+    part.frame_id = kSomeFrameId;
+    part.packet_id = packet_id;
+    part.max_packet_id = kNumPackets - 1;
+    part.referenced_frame_id = kSomeFrameId;
+    std::vector<uint8_t> buffer;
+    if (num_protected == 0) {
+      buffer = payloads[packet_id];
+    } else {
+      // Compute the Parity packet's payload.
+      part.fec_num_protected_packets = num_protected;
+      for (int i = packet_id; i < packet_id + num_protected; ++i) {
+        buffer.resize(std::max(buffer.size(), payloads[i].size()));
+        XorInto(payloads[i], absl::Span<uint8_t>(buffer));
+        part.fec_payload_size_xor ^= static_cast<uint16_t>(payloads[i].size());
+      }
+    }
+    part.payload = absl::Span<uint8_t>(buffer);
+    return collector.CollectRtpPacket(part, &buffer);
+  };
+
+  // Parity packets protect packets 0-2 and packets 3-4. Packets 1 and 4 are
+  // lost.
+  EXPECT_TRUE(collect(0, 0));
+  EXPECT_TRUE(collect(3, 2));  // Parity arrives before the packets.
+  EXPECT_HAS_NACKS((std::vector<PacketNack>{{kSomeFrameId, 1},
+                                            {kSomeFrameId, 2},
+                                            {kSomeFrameId, 3},
+                                            {kSomeFrameId, 4}}),
+                   collector);
+  EXPECT_TRUE(collect(2, 0));
+  EXPECT_TRUE(collect(3, 0));  // Packet 4 is recovered.
+  EXPECT_HAS_NACKS((std::vector<PacketNack>{{kSomeFrameId, 1}}), collector);
+  EXPECT_FALSE(collector.is_complete());
+  EXPECT_TRUE(collect(0, 3));  // Parity arrives after the packets.
+  ASSERT_TRUE(collector.is_complete());
+  EXPECT_HAS_NACKS(std::vector<PacketNack>(), collector);
+
+  // The recovered packets' payloads, including the smaller last packet, must
+  // match those that were lost.
+  const EncryptedFrame& frame = collector.PeekAtAssembledFrame();
+  std::vector<uint8_t> expected_data;
+  for (const std::vector<uint8_t>& payload : payloads) {
+    expected_data.insert(expected_data.end(), payload.begin(), payload.end());
+  }
+  EXPECT_EQ(absl::Span<const uint8_t>(expected_data),
+            absl::Span<const uint8_t>(frame.data));
+  EXPECT_EQ(static_cast<int>(expected_data.size()),
+            collector.GetPayloadSize());
+}
+
 }  // namespace
 }  // namespace cast
 }  // namespace openscreen
@@ -5,6 +5,7 @@
 #include "cast/streaming/frame_crypto.h"
 
 #include <random>
+#include <utility>
 
 #include "openssl/crypto.h"
 #include "openssl/err.h"
@@ -37,19 +38,51 @@ EncryptedFrame& EncryptedFrame::operator=(EncryptedFrame&& other)
   return *this;
 }
 
+FrameCrypto::StreamCipher::StreamCipher(
+    bssl::UniquePtr<EVP_CIPHER_CTX> context)
+    : context_(std::move(context)) {}
+
+FrameCrypto::StreamCipher::StreamCipher(StreamCipher&& other) MAYBE_NOEXCEPT =
+    default;
+
+FrameCrypto::StreamCipher& FrameCrypto::StreamCipher::operator=(
+    StreamCipher&& other) MAYBE_NOEXCEPT = default;
+
+FrameCrypto::StreamCipher::~StreamCipher() = default;
+
+void FrameCrypto::StreamCipher::Process(absl::Span<const uint8_t> in,
+                                        absl::Span<uint8_t> out) {
+  OSP_DCHECK(context_);
+  OSP_DCHECK_LE(in.size(), out.size());
+  OSP_DCHECK(in.data() == out.data() || in.data() + in.size() <= out.data() ||
+             out.data() + in.size() <= in.data());
+  if (in.empty()) {
+    return;
+  }
+  // Note: The counter, key stream block, and offset within it carry over from
+  // one call to the next, so the slices are processed as one continuous
+  // stream.
+  int out_size = 0;
+  if (EVP_EncryptUpdate(context_.get(), out.data(), &out_size, in.data(),
+                        static_cast<int>(in.size())) != 1) {
+    ClearOpenSSLERRStack(CURRENT_LOCATION);
+    OSP_LOG_FATAL << "Failure when encrypting; unsafe to continue.";
+    OSP_NOTREACHED();
+  }
+  OSP_DCHECK_EQ(out_size, static_cast<int>(in.size()));
+}
+
 FrameCrypto::FrameCrypto(const std::array<uint8_t, 16>& aes_key,
                          const std::array<uint8_t, 16>& cast_iv_mask)
-    : aes_key_{}, cast_iv_mask_(cast_iv_mask) {
+    : key_context_(EVP_CIPHER_CTX_new()), cast_iv_mask_(cast_iv_mask) {
   // Ensure that the library has been initialized. CRYPTO_library_init() may be
   // safely called multiple times during the life of a process.
   CRYPTO_library_init();
 
-  // Initialize the 244-byte AES_KEY struct once, here at construction time. The
-  // const_cast<> is reasonable as this is a one-time-ctor-initialized value
-  // that will remain constant from here onward.
-  const int return_code = AES_set_encrypt_key(
-      aes_key.data(), aes_key.size() * 8, const_cast<AES_KEY*>(&aes_key_));
-  if (return_code != 0) {
+  // Compute the key schedule once, here at construction time.
+  if (!key_context_ ||
+      EVP_EncryptInit_ex(key_context_.get(), EVP_aes_128_ctr(), nullptr,
+                         aes_key.data(), nullptr) != 1) {
     ClearOpenSSLERRStack(CURRENT_LOCATION);
     OSP_LOG_FATAL << "Failure when setting encryption key; unsafe to continue.";
     OSP_NOTREACHED();
@@ -63,43 +96,93 @@ EncryptedFrame FrameCrypto::Encrypt(const EncodedFrame& encoded_frame) const {
   encoded_frame.CopyMetadataTo(&result);
   result.owned_data_.resize(encoded_frame.data.size());
   result.data = absl::Span<uint8_t>(result.owned_data_);
-  EncryptCommon(encoded_frame.frame_id, encoded_frame.data, result.data);
+  StartFrame(encoded_frame.frame_id).Process(encoded_frame.data, result.data);
   return result;
 }
 
-void FrameCrypto::Decrypt(const EncryptedFrame& encrypted_frame,
-                          EncodedFrame* encoded_frame) const {
-  encrypted_frame.CopyMetadataTo(encoded_frame);
-  // AES-CTC is symmetric. Thus, decryption back to the plaintext is the same as
-  // encrypting the ciphertext; and both are the same size.
-  if (encrypted_frame.data.size() < encoded_frame->data.size()) {
-    encoded_frame->data = absl::Span<uint8_t>(encoded_frame->data.data(),
-                                              encrypted_frame.data.size());
-  }
-  EncryptCommon(encrypted_frame.frame_id, encrypted_frame.data,
-                encoded_frame->data);
+EncryptedFrame FrameCrypto::Encrypt(const EncodedFrame& frame_metadata,
+                                    std::vector<uint8_t> payload) const {
+  EncryptedFrame result;
+  frame_metadata.CopyMetadataTo(&result);
+  result.owned_data_ = std::move(payload);
+  result.data = absl::Span<uint8_t>(result.owned_data_);
+  StartFrame(frame_metadata.frame_id).ProcessInPlace(result.data);
+  return result;
 }
 
-void FrameCrypto::EncryptCommon(FrameId frame_id,
-                                absl::Span<const uint8_t> in,
-                                absl::Span<uint8_t> out) const {
+FrameCrypto::StreamCipher FrameCrypto::StartFrame(FrameId frame_id,
+                                                  size_t offset) const {
   OSP_DCHECK(!frame_id.is_null());
-  OSP_DCHECK_EQ(in.size(), out.size());
 
   // Compute the AES nonce for Cast Streaming payload encryption, which is based
   // on the |frame_id|.
   std::array<uint8_t, 16> aes_nonce{/* zero initialized */};
-  static_assert(AES_BLOCK_SIZE == sizeof(aes_nonce),
-                "AES_BLOCK_SIZE is not 16 bytes.");
   WriteBigEndian<uint32_t>(frame_id.lower_32_bits(), aes_nonce.data() + 8);
   for (size_t i = 0; i < aes_nonce.size(); ++i) {
     aes_nonce[i] ^= cast_iv_mask_[i];
   }
 
-  std::array<uint8_t, 16> ecount_buf{/* zero initialized */};
-  unsigned int block_offset = 0;
-  AES_ctr128_encrypt(in.data(), out.data(), in.size(), &aes_key_,
-                     aes_nonce.data(), ecount_buf.data(), &block_offset);
+  // The nonce is the initial value of the 128-bit big-endian counter, which is
+  // incremented once per AES block. Advance it to the block containing the
+  // |offset|.
+  constexpr size_t kAesBlockSize = 16;
+  uint64_t blocks_to_skip = offset / kAesBlockSize;
+  for (int i = aes_nonce.size() - 1; i >= 0 && blocks_to_skip > 0; --i) {
+    const uint64_t sum = aes_nonce[i] + (blocks_to_skip & 0xff);
+    aes_nonce[i] = static_cast<uint8_t>(sum);
+    blocks_to_skip = (blocks_to_skip >> 8) + (sum >> 8);
+  }
+
+  // Copy the key schedule, and then start a new stream with the nonce as the
+  // initial counter block.
+  bssl::UniquePtr<EVP_CIPHER_CTX> context(EVP_CIPHER_CTX_new());
+  if (!context ||
+      EVP_CIPHER_CTX_copy(context.get(), key_context_.get()) != 1 ||
+      EVP_EncryptInit_ex(context.get(), nullptr, nullptr, nullptr,
+                         aes_nonce.data()) != 1) {
+    ClearOpenSSLERRStack(CURRENT_LOCATION);
+    OSP_LOG_FATAL << "Failure when initializing cipher; unsafe to continue.";
+    OSP_NOTREACHED();
+  }
+  StreamCipher cipher(std::move(context));
+
+  // Discard the part of the key stream block that precedes the |offset|.
+  std::array<uint8_t, kAesBlockSize> discarded{};
+  cipher.ProcessInPlace(
+      absl::Span<uint8_t>(discarded.data(), offset % kAesBlockSize));
+
+  return cipher;
+}
+
+void FrameCrypto::Decrypt(const EncryptedFrame& encrypted_frame,
+                          EncodedFrame* encoded_frame) const {
+  const absl::Span<const uint8_t> in = encrypted_frame.data;
+  Decrypt(encrypted_frame, {&in, 1}, encoded_frame);
+}
+
+void FrameCrypto::Decrypt(
+    const EncodedFrame& frame_metadata,
+    absl::Span<const absl::Span<const uint8_t>> encrypted_chunks,
+    EncodedFrame* encoded_frame) const {
+  frame_metadata.CopyMetadataTo(encoded_frame);
+  // AES-CTC is symmetric. Thus, decryption back to the plaintext is the same as
+  // encrypting the ciphertext; and both are the same size.
+  size_t encrypted_size = 0;
+  for (absl::Span<const uint8_t> chunk : encrypted_chunks) {
+    encrypted_size += chunk.size();
+  }
+  if (encrypted_size < encoded_frame->data.size()) {
+    encoded_frame->data =
+        absl::Span<uint8_t>(encoded_frame->data.data(), encrypted_size);
+  }
+  OSP_DCHECK_EQ(encrypted_size, encoded_frame->data.size());
+
+  StreamCipher cipher = StartFrame(frame_metadata.frame_id);
+  absl::Span<uint8_t> out = encoded_frame->data;
+  for (absl::Span<const uint8_t> chunk : encrypted_chunks) {
+    cipher.Process(chunk, out);
+    out.remove_prefix(chunk.size());
+  }
 }
 
 // static
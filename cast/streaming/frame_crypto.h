@@ -13,7 +13,9 @@
 
 #include "absl/types/span.h"
 #include "cast/streaming/encoded_frame.h"
-#include "openssl/aes.h"
+#include "cast/streaming/frame_id.h"
+#include "openssl/base.h"
+#include "openssl/evp.h"
 #include "platform/base/macros.h"
 
 namespace openscreen {
@@ -47,6 +49,35 @@ struct EncryptedFrame : public EncodedFrame {
 // been received.
 class FrameCrypto {
  public:
+  // Encrypts or decrypts the payload of one frame incrementally. AES-CTR is a
+  // stream cipher, and so the payload may be processed in any number of
+  // slices (e.g., one per RTP packet, as each is generated), as long as they
+  // are processed in order. The output of each slice may overwrite its input.
+  class StreamCipher {
+   public:
+    StreamCipher(StreamCipher&& other) MAYBE_NOEXCEPT;
+    StreamCipher& operator=(StreamCipher&& other) MAYBE_NOEXCEPT;
+    ~StreamCipher();
+
+    // Encrypts (or decrypts) the next |in.size()| bytes of the payload, writing
+    // the result to |out|. |out| must either not overlap |in|, or start at the
+    // same address (for in-place operation).
+    void Process(absl::Span<const uint8_t> in, absl::Span<uint8_t> out);
+
+    // Convenience to process the next |data.size()| bytes of the payload
+    // in-place.
+    void ProcessInPlace(absl::Span<uint8_t> data) { Process(data, data); }
+
+   private:
+    friend class FrameCrypto;
+
+    explicit StreamCipher(bssl::UniquePtr<EVP_CIPHER_CTX> context);
+
+    bssl::UniquePtr<EVP_CIPHER_CTX> context_;
+
+    OSP_DISALLOW_COPY_AND_ASSIGN(StreamCipher);
+  };
+
   // Construct with the given 16-bytes AES key and IV mask. Both arguments
   // should be randomly-generated for each new streaming session.
   // GenerateRandomBytes() can be used to create them.
@@ -57,12 +88,36 @@ class FrameCrypto {
 
   EncryptedFrame Encrypt(const EncodedFrame& encoded_frame) const;
 
+  // Same as the above, except that the payload is provided in a caller-owned
+  // |payload| buffer, which is encrypted in-place and then moved into the
+  // result. This avoids allocating and copying into a separate buffer for the
+  // encrypted payload. |frame_metadata| provides the frame ID and all other
+  // metadata, and its |data| member is ignored.
+  EncryptedFrame Encrypt(const EncodedFrame& frame_metadata,
+                         std::vector<uint8_t> payload) const;
+
+  // Returns a StreamCipher for encrypting or decrypting the payload of the
+  // frame having the given |frame_id|, starting at the given byte |offset|
+  // within the payload. AES-CTR allows random access to the key stream, and so
+  // any part of a payload can be processed independently of the rest.
+  StreamCipher StartFrame(FrameId frame_id, size_t offset = 0) const;
+
   // Decrypt the given |encrypted_frame| into the output |encoded_frame|. The
   // caller must provide a sufficiently-sized data buffer (see
   // GetPlaintextSize()).
   void Decrypt(const EncryptedFrame& encrypted_frame,
                EncodedFrame* encoded_frame) const;
 
+  // Same as the above, except that the encrypted payload data is provided as a
+  // sequence of |encrypted_chunks| (e.g., the payloads of a frame's RTP
+  // packets) instead of one contiguous buffer. The chunks are decrypted
+  // directly into |encoded_frame->data|, in one pass, so there is no need to
+  // first assemble them. |frame_metadata| provides the frame ID and all other
+  // metadata, and its |data| member is ignored.
+  void Decrypt(const EncodedFrame& frame_metadata,
+               absl::Span<const absl::Span<const uint8_t>> encrypted_chunks,
+               EncodedFrame* encoded_frame) const;
+
   // AES crypto inputs and outputs (for either encrypting or decrypting) are
   // always the same size in bytes. The following are just "documentative code."
   static int GetEncryptedSize(const EncodedFrame& encoded_frame) {
@@ -76,19 +131,17 @@ class FrameCrypto {
   static std::array<uint8_t, 16> GenerateRandomBytes();
 
  private:
-  // The 244-byte AES_KEY struct, derived from the |aes_key| passed to the ctor,
-  // and initialized by boringssl's AES_set_encrypt_key() function.
-  const AES_KEY aes_key_;
+  // An EVP AES-128-CTR cipher context holding the key schedule derived from
+  // the |aes_key| passed to the ctor, but no IV. StartFrame() copies it, so
+  // that the key schedule is only computed once. The EVP interface chooses the
+  // fastest available implementation (e.g., using AES-NI instructions).
+  const bssl::UniquePtr<EVP_CIPHER_CTX> key_context_;
 
   // Random bytes used in the custom heuristic to generate a different
   // initialization vector for each frame.
   const std::array<uint8_t, 16> cast_iv_mask_;
 
-  // AES-CTR is symmetric. Thus, the "meat" of both Encrypt() and Decrypt() is
-  // the same.
-  void EncryptCommon(FrameId frame_id,
-                     absl::Span<const uint8_t> in,
-                     absl::Span<uint8_t> out) const;
+  OSP_DISALLOW_COPY_AND_ASSIGN(FrameCrypto);
 };
 
 }  // namespace cast
@@ -4,8 +4,10 @@
 
 #include "cast/streaming/frame_crypto.h"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -75,6 +77,144 @@ TEST(FrameCryptoTest, EncryptsAndDecryptsFrames) {
                       frame1.data.size()));
 }
 
+TEST(FrameCryptoTest, DecryptsFramesSplitIntoChunks) {
+  EncodedFrame frame;
+  frame.frame_id = FrameId::first() + 7;
+  frame.dependency = EncodedFrame::KEY_FRAME;
+  std::vector<uint8_t> buffer(1000);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<uint8_t>(i * 31);
+  }
+  frame.data = absl::Span<uint8_t>(buffer);
+
+  const FrameCrypto crypto(FrameCrypto::GenerateRandomBytes(),
+                           FrameCrypto::GenerateRandomBytes());
+  const EncryptedFrame encrypted_frame = crypto.Encrypt(frame);
+
+  // Split the encrypted payload into chunks whose sizes are not multiples of
+  // the AES block size, including an empty chunk.
+  const absl::Span<const uint8_t> encrypted = encrypted_frame.data;
+  const absl::Span<const uint8_t> chunks[] = {
+      encrypted.subspan(0, 5),   encrypted.subspan(5, 300),
+      encrypted.subspan(305, 0), encrypted.subspan(305, 16),
+      encrypted.subspan(321, 679)};
+
+  EncodedFrame decrypted_frame;
+  std::vector<uint8_t> decrypted_buffer(buffer.size());
+  decrypted_frame.data = absl::Span<uint8_t>(decrypted_buffer);
+  crypto.Decrypt(encrypted_frame, chunks, &decrypted_frame);
+  EXPECT_EQ(frame.frame_id, decrypted_frame.frame_id);
+  EXPECT_EQ(EncodedFrame::KEY_FRAME, decrypted_frame.dependency);
+  EXPECT_EQ(buffer, decrypted_buffer);
+}
+
+// Tests that the ciphertext is exactly what Cast Streaming Receivers expect,
+// for a given key, IV mask, and FrameId.
+TEST(FrameCryptoTest, ProducesExpectedCiphertext) {
+  constexpr std::array<uint8_t, 16> kKey{{0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+                                          0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+                                          0x0c, 0x0d, 0x0e, 0x0f}};
+  constexpr std::array<uint8_t, 16> kIvMask{{0xf0, 0xe1, 0xd2, 0xc3, 0xb4,
+                                             0xa5, 0x96, 0x87, 0x78, 0x69,
+                                             0x5a, 0x4b, 0x3c, 0x2d, 0x1e,
+                                             0x0f}};
+  constexpr uint8_t kExpectedCiphertext[40] = {
+      0xa9, 0xdb, 0x92, 0x0b, 0xfa, 0x47, 0x30, 0xd9, 0xd9, 0x7d,
+      0x6c, 0x38, 0xfd, 0x62, 0x51, 0xe2, 0xcc, 0xb0, 0x24, 0x6e,
+      0xc0, 0x12, 0x2f, 0x0b, 0xe5, 0x53, 0xc7, 0x8b, 0x5c, 0xbc,
+      0x64, 0xae, 0x2f, 0xf9, 0x6f, 0xf9, 0x8b, 0x8f, 0x34, 0x46};
+
+  EncodedFrame frame;
+  frame.frame_id = FrameId::first() + 0x12345;
+  std::vector<uint8_t> buffer(sizeof(kExpectedCiphertext));
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<uint8_t>(i);
+  }
+  frame.data = absl::Span<uint8_t>(buffer);
+
+  const FrameCrypto crypto(kKey, kIvMask);
+  const EncryptedFrame encrypted_frame = crypto.Encrypt(frame);
+  EXPECT_EQ(absl::Span<const uint8_t>(kExpectedCiphertext),
+            absl::Span<const uint8_t>(encrypted_frame.data));
+}
+
+TEST(FrameCryptoTest, EncryptsInPlace) {
+  EncodedFrame frame;
+  frame.frame_id = FrameId::first() + 3;
+  std::vector<uint8_t> buffer(777);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<uint8_t>(i * 7);
+  }
+  frame.data = absl::Span<uint8_t>(buffer);
+
+  const FrameCrypto crypto(FrameCrypto::GenerateRandomBytes(),
+                           FrameCrypto::GenerateRandomBytes());
+  const EncryptedFrame expected = crypto.Encrypt(frame);
+
+  // Encrypting a caller-owned buffer should produce the same result, re-using
+  // the buffer's storage.
+  std::vector<uint8_t> payload = buffer;
+  const uint8_t* const storage = payload.data();
+  const EncryptedFrame encrypted_frame =
+      crypto.Encrypt(frame, std::move(payload));
+  EXPECT_EQ(frame.frame_id, encrypted_frame.frame_id);
+  EXPECT_EQ(storage, encrypted_frame.data.data());
+  EXPECT_EQ(expected.data, encrypted_frame.data);
+}
+
+TEST(FrameCryptoTest, EncryptsSlicesWithStreamCipher) {
+  EncodedFrame frame;
+  frame.frame_id = FrameId::first() + 11;
+  std::vector<uint8_t> buffer(1000);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<uint8_t>(i * 13);
+  }
+  frame.data = absl::Span<uint8_t>(buffer);
+
+  const FrameCrypto crypto(FrameCrypto::GenerateRandomBytes(),
+                           FrameCrypto::GenerateRandomBytes());
+  const EncryptedFrame expected = crypto.Encrypt(frame);
+
+  // Encrypt slices whose sizes are not multiples of the AES block size, some
+  // in-place and some into a separate buffer.
+  std::vector<uint8_t> encrypted(buffer.size());
+  FrameCrypto::StreamCipher cipher = crypto.StartFrame(frame.frame_id);
+  const absl::Span<uint8_t> in(buffer);
+  const absl::Span<uint8_t> out(encrypted);
+  cipher.Process(in.subspan(0, 7), out.subspan(0, 7));
+  cipher.ProcessInPlace(in.subspan(7, 500));
+  std::copy(buffer.begin() + 7, buffer.begin() + 507, encrypted.begin() + 7);
+  cipher.Process(in.subspan(507, 0), out.subspan(507, 0));
+  cipher.Process(in.subspan(507, 493), out.subspan(507, 493));
+  EXPECT_EQ(expected.data, absl::Span<const uint8_t>(encrypted));
+}
+
+TEST(FrameCryptoTest, EncryptsFromAnyOffset) {
+  EncodedFrame frame;
+  frame.frame_id = FrameId::first() + 255;
+  std::vector<uint8_t> buffer(5000);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<uint8_t>(i * 3);
+  }
+  frame.data = absl::Span<uint8_t>(buffer);
+
+  // An IV mask of all 0xff bytes means the counter overflows into its higher
+  // bytes right away.
+  std::array<uint8_t, 16> iv_mask;
+  iv_mask.fill(0xff);
+  const FrameCrypto crypto(FrameCrypto::GenerateRandomBytes(), iv_mask);
+  const EncryptedFrame expected = crypto.Encrypt(frame);
+
+  const absl::Span<const uint8_t> in(buffer);
+  for (size_t offset : {0, 1, 15, 16, 17, 1400, 4096 + 5}) {
+    SCOPED_TRACE(testing::Message() << "offset=" << offset);
+    std::vector<uint8_t> out(buffer.size() - offset);
+    crypto.StartFrame(frame.frame_id, offset)
+        .Process(in.subspan(offset), absl::Span<uint8_t>(out));
+    EXPECT_EQ(expected.data.subspan(offset), absl::Span<const uint8_t>(out));
+  }
+}
+
 }  // namespace
 }  // namespace cast
 }  // namespace openscreen
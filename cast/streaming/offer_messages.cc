@@ -94,6 +94,23 @@ ErrorOr<std::array<uint8_t, kAesBytesSize>> ParseAesHexBytes(
   return CreateParseError("AES hex string bytes");
 }
 
+// Parses the optional array of strings in the |field|, ignoring any elements
+// that are not strings.
+std::vector<std::string> ParseStringArray(const Json::Value& parent,
+                                          const std::string& field) {
+  std::vector<std::string> result;
+  const Json::Value& value = parent[field];
+  if (!value.isArray()) {
+    return result;
+  }
+  for (Json::ArrayIndex i = 0; i < value.size(); ++i) {
+    if (value[i].isString()) {
+      result.push_back(value[i].asString());
+    }
+  }
+  return result;
+}
+
 ErrorOr<Stream> ParseStream(const Json::Value& value, Stream::Type type) {
   auto index = ParseInt(value, "index");
   if (!index) {
@@ -159,7 +176,8 @@ ErrorOr<Stream> ParseStream(const Json::Value& value, Stream::Type type) {
                 aes_iv_mask.value(),
                 receiver_rtcp_event_log.value({}),
                 receiver_rtcp_dscp.value({}),
-                rtp_timebase.value()};
+                rtp_timebase.value(),
+                ParseStringArray(value, "rtpExtensions")};
 }
 
 ErrorOr<AudioStream> ParseAudioStream(const Json::Value& value) {
@@ -297,6 +315,13 @@ ErrorOr<Json::Value> Stream::ToJson() const {
   root["ReceiverRtcpEventLog"] = receiver_rtcp_event_log;
   root["receiverRtcpDscp"] = receiver_rtcp_dscp;
   root["timeBase"] = "1/" + std::to_string(rtp_timebase);
+  if (!rtp_extensions.empty()) {
+    Json::Value extensions(Json::ValueType::arrayValue);
+    for (const std::string& extension : rtp_extensions) {
+      extensions.append(extension);
+    }
+    root["rtpExtensions"] = std::move(extensions);
+  }
   return root;
 }
 
@@ -63,6 +63,10 @@ struct Stream {
   bool receiver_rtcp_event_log = {};
   std::string receiver_rtcp_dscp = {};
   int rtp_timebase = 0;
+
+  // The optional RTP extensions the Sender supports for this stream, such as
+  // kFecRtpExtensionName (see rtp_defines.h).
+  std::vector<std::string> rtp_extensions = {};
 };
 
 struct AudioStream {
@@ -268,6 +268,32 @@ TEST(OfferTest, CanParseValidZeroBitRateAudioOffer) {
   EXPECT_TRUE(Offer::Parse(std::move(root.value())).is_value());
 }
 
+TEST(OfferTest, CanParseAudioOfferWithRtpExtensions) {
+  ErrorOr<Json::Value> root = json::Parse(R"({
+    "castMode": "mirroring",
+    "supportedStreams": [{
+      "index": 2,
+      "type": "audio_source",
+      "codecName": "opus",
+      "rtpProfile": "cast",
+      "rtpPayloadType": 96,
+      "ssrc": 19088743,
+      "bitRate": 124000,
+      "timeBase": "1/48000",
+      "channels": 2,
+      "aesKey": "51027e4e2347cbcb49d57ef10177aebc",
+      "aesIvMask": "7f12a19be62a36c04ae4116caaeff6d1",
+      "rtpExtensions": ["adaptive_playout_delay", "xor_fec_parity"]
+    }]
+  })");
+  ASSERT_TRUE(root.is_value());
+  ErrorOr<Offer> offer = Offer::Parse(std::move(root.value()));
+  ASSERT_TRUE(offer.is_value());
+  ASSERT_EQ(1u, offer.value().audio_streams.size());
+  EXPECT_THAT(offer.value().audio_streams[0].stream.rtp_extensions,
+              ElementsAre("adaptive_playout_delay", "xor_fec_parity"));
+}
+
 TEST(OfferTest, ErrorOnMissingVideoStreamMandatoryField) {
   ExpectFailureOnParse(R"({
     "castMode": "mirroring",
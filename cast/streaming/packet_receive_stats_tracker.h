@@ -37,6 +37,14 @@ class PacketReceiveStatsTracker {
   // loss, jitter, and the latest-known RTP packet sequence number.
   void PopulateNextReport(RtcpReportBlock* report);
 
+  // Returns the current interarrival jitter estimate, or zero if no packets
+  // have been tracked yet. This is the same value reported in the |jitter|
+  // field of the RTCP Receiver Report block.
+  Clock::duration jitter() const {
+    return (num_rtp_packets_received_ > 0) ? jitter_
+                                           : Clock::duration::zero();
+  }
+
  private:
   // Expands the 16-bit raw packet sequence counter values into full-form,
   // initially constructed from a "first" value.
@@ -68,6 +68,7 @@ TEST(PacketReceiveStatsTrackerTest, DoesNotPopulateReportWithoutData) {
   RtcpReportBlock report = GetSentinel();
   tracker.PopulateNextReport(&report);
   EXPECT_FIELDS_NOT_POPULATED(report);
+  EXPECT_EQ(Clock::duration::zero(), tracker.jitter());
 }
 
 TEST(PacketReceiveStatsTrackerTest, PopulatesReportWithOnePacketTracked) {
@@ -201,6 +202,8 @@ TEST(PacketReceiveStatsTrackerTest, ComputesJitterCorrectly) {
   constexpr auto kMaxDiffAtEnd =
       std::chrono::duration_cast<Clock::duration>(std::chrono::milliseconds(2));
   EXPECT_NEAR(0, diff.count(), kMaxDiffAtEnd.count());
+  EXPECT_NEAR(0, (kTrueJitter - tracker.jitter()).count(),
+              kMaxDiffAtEnd.count());
 }
 
 }  // namespace
@@ -4,12 +4,39 @@
 
 #include "cast/streaming/packet_util.h"
 
+#include <string.h>
+
 #include "cast/streaming/rtcp_common.h"
 #include "cast/streaming/rtp_defines.h"
+#include "util/osp_logging.h"
 
 namespace openscreen {
 namespace cast {
 
+void XorInto(absl::Span<const uint8_t> source,
+             absl::Span<uint8_t> destination) {
+  OSP_DCHECK_LE(source.size(), destination.size());
+
+  // Process 8 bytes at a time, which compilers readily vectorize, and then the
+  // remaining few bytes one at a time.
+  const uint8_t* src = source.data();
+  uint8_t* dst = destination.data();
+  size_t remaining = source.size();
+  for (; remaining >= sizeof(uint64_t); remaining -= sizeof(uint64_t)) {
+    uint64_t a;
+    uint64_t b;
+    memcpy(&a, src, sizeof(a));
+    memcpy(&b, dst, sizeof(b));
+    b ^= a;
+    memcpy(dst, &b, sizeof(b));
+    src += sizeof(uint64_t);
+    dst += sizeof(uint64_t);
+  }
+  for (; remaining > 0; --remaining) {
+    *(dst++) ^= *(src++);
+  }
+}
+
 std::pair<ApparentPacketType, Ssrc> InspectPacketForRouting(
     absl::Span<const uint8_t> packet) {
   // Check for RTP packets first, since they are more frequent.
@@ -47,6 +47,11 @@ inline absl::Span<uint8_t> ReserveSpace(int num_bytes,
   return reserved;
 }
 
+// XORs the bytes of |source| into the front of |destination|, which must be at
+// least as large. This is used for computing, and recovering from, FEC Parity
+// packets (see rtp_defines.h).
+void XorInto(absl::Span<const uint8_t> source, absl::Span<uint8_t> destination);
+
 // Performs a quick-scan of the packet data for the purposes of routing it to an
 // appropriate parser. Identifies whether the packet is a RTP packet, RTCP
 // packet, or unknown; and provides the originator's SSRC. This only performs a
@@ -0,0 +1,70 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cast/streaming/playout_delay_estimator.h"
+
+#include <algorithm>
+
+#include "util/osp_logging.h"
+
+namespace openscreen {
+namespace cast {
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+
+PlayoutDelayEstimator::PlayoutDelayEstimator(milliseconds min_delay,
+                                             milliseconds max_delay)
+    : min_delay_(min_delay), max_delay_(max_delay) {
+  OSP_DCHECK_GT(min_delay_, milliseconds::zero());
+  OSP_DCHECK_LE(min_delay_, max_delay_);
+}
+
+PlayoutDelayEstimator::~PlayoutDelayEstimator() = default;
+
+void PlayoutDelayEstimator::OnFrameCompleted(Clock::duration arrival_delay) {
+  // A negative delay is possible, due to error in the estimation of the clock
+  // offset between Sender and Receiver.
+  arrival_delays_[next_index_] =
+      std::max(Clock::duration::zero(), arrival_delay);
+  next_index_ = (next_index_ + 1) % kWindowSize;
+  num_frames_observed_ = std::min(num_frames_observed_ + 1, kWindowSize);
+}
+
+milliseconds PlayoutDelayEstimator::ProposePlayoutDelay(
+    milliseconds current,
+    Clock::duration jitter,
+    Clock::duration processing_time) const {
+  if (num_frames_observed_ < kMinFramesForEstimate) {
+    return current;
+  }
+
+  const Clock::duration max_arrival_delay = *std::max_element(
+      arrival_delays_.begin(), arrival_delays_.begin() + num_frames_observed_);
+  const Clock::duration needed =
+      max_arrival_delay + kJitterMultiplier * jitter + processing_time;
+
+  // Round up to the next multiple of kGranularity, and then clamp to the
+  // allowed range.
+  const auto granularity = duration_cast<Clock::duration>(kGranularity);
+  const auto num_steps =
+      (needed + granularity - Clock::duration(1)) / granularity;
+  const milliseconds proposed =
+      std::min(std::max(kGranularity * num_steps, min_delay_), max_delay_);
+
+  if (proposed > current || proposed + kMinDecrease <= current) {
+    return proposed;
+  }
+  return current;
+}
+
+// static
+constexpr int PlayoutDelayEstimator::kWindowSize;
+constexpr int PlayoutDelayEstimator::kMinFramesForEstimate;
+constexpr milliseconds PlayoutDelayEstimator::kGranularity;
+constexpr milliseconds PlayoutDelayEstimator::kMinDecrease;
+constexpr int PlayoutDelayEstimator::kJitterMultiplier;
+
+}  // namespace cast
+}  // namespace openscreen
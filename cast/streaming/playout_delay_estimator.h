@@ -0,0 +1,83 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CAST_STREAMING_PLAYOUT_DELAY_ESTIMATOR_H_
+#define CAST_STREAMING_PLAYOUT_DELAY_ESTIMATOR_H_
+
+#include <array>
+#include <chrono>  // NOLINT
+
+#include "platform/api/time.h"
+
+namespace openscreen {
+namespace cast {
+
+// Used by a Receiver, in adaptive jitter buffer mode, to determine the minimal
+// target playout delay that would still allow nearly all frames to be
+// completely received before their playout time, given the recently-observed
+// network conditions.
+//
+// Each frame's "arrival delay" is the amount of time between its capture (as
+// estimated in terms of the Receiver's clock) and when its last packet was
+// received, which includes any time spent re-transmitting lost packets. The
+// estimate is the maximum arrival delay over a sliding window of recent frames,
+// plus margins for the current interarrival jitter and the player's processing
+// time.
+class PlayoutDelayEstimator {
+ public:
+  // Proposed playout delays will be clamped to [|min_delay|,|max_delay|].
+  PlayoutDelayEstimator(std::chrono::milliseconds min_delay,
+                        std::chrono::milliseconds max_delay);
+  ~PlayoutDelayEstimator();
+
+  std::chrono::milliseconds min_delay() const { return min_delay_; }
+  std::chrono::milliseconds max_delay() const { return max_delay_; }
+
+  // Records the |arrival_delay| of the latest frame to be completely received.
+  void OnFrameCompleted(Clock::duration arrival_delay);
+
+  // Returns the playout delay that should be requested, given the |current|
+  // setting, the current interarrival |jitter| and the player's
+  // |processing_time|. Returns |current| if it should not be changed, either
+  // because too few frames have been observed yet, or because the change would
+  // be too small to be worthwhile. Increases are proposed as soon as they are
+  // needed; but decreases only once the estimate has fallen by a meaningful
+  // amount, to avoid oscillating.
+  std::chrono::milliseconds ProposePlayoutDelay(
+      std::chrono::milliseconds current,
+      Clock::duration jitter,
+      Clock::duration processing_time) const;
+
+  // The number of recent frames whose arrival delays are considered.
+  static constexpr int kWindowSize = 120;
+
+  // No changes are proposed until at least this many frames have been observed.
+  static constexpr int kMinFramesForEstimate = 30;
+
+  // Proposed delays are rounded up to a multiple of this amount.
+  static constexpr std::chrono::milliseconds kGranularity{10};
+
+  // A decrease is only proposed if it is at least this large.
+  static constexpr std::chrono::milliseconds kMinDecrease{30};
+
+  // The number of multiples of the interarrival jitter added as a safety
+  // margin. This is a conventional choice for jitter buffers, which covers
+  // nearly all of the variance seen in practice.
+  static constexpr int kJitterMultiplier = 4;
+
+ private:
+  const std::chrono::milliseconds min_delay_;
+  const std::chrono::milliseconds max_delay_;
+
+  // A circular buffer of the arrival delays of the most-recent frames. Only the
+  // first |num_frames_observed_| elements are valid until the buffer is full.
+  std::array<Clock::duration, kWindowSize> arrival_delays_;
+  int num_frames_observed_ = 0;
+  int next_index_ = 0;
+};
+
+}  // namespace cast
+}  // namespace openscreen
+
+#endif  // CAST_STREAMING_PLAYOUT_DELAY_ESTIMATOR_H_
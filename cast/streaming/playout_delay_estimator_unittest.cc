@@ -0,0 +1,95 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "cast/streaming/playout_delay_estimator.h"
+
+#include <chrono>
+
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace cast {
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr milliseconds kMinDelay{100};
+constexpr milliseconds kMaxDelay{1000};
+constexpr milliseconds kCurrentDelay{400};
+constexpr Clock::duration kNoJitter = Clock::duration::zero();
+constexpr Clock::duration kNoProcessingTime = Clock::duration::zero();
+
+void RecordFrames(PlayoutDelayEstimator* estimator,
+                  int count,
+                  milliseconds arrival_delay) {
+  for (int i = 0; i < count; ++i) {
+    estimator->OnFrameCompleted(arrival_delay);
+  }
+}
+
+TEST(PlayoutDelayEstimatorTest, ProposesNoChangeUntilEnoughFramesObserved) {
+  PlayoutDelayEstimator estimator(kMinDelay, kMaxDelay);
+  EXPECT_EQ(kCurrentDelay, estimator.ProposePlayoutDelay(
+                               kCurrentDelay, kNoJitter, kNoProcessingTime));
+  RecordFrames(&estimator, PlayoutDelayEstimator::kMinFramesForEstimate - 1,
+               milliseconds(20));
+  EXPECT_EQ(kCurrentDelay, estimator.ProposePlayoutDelay(
+                               kCurrentDelay, kNoJitter, kNoProcessingTime));
+  RecordFrames(&estimator, 1, milliseconds(20));
+  EXPECT_EQ(kMinDelay, estimator.ProposePlayoutDelay(
+                           kCurrentDelay, kNoJitter, kNoProcessingTime));
+}
+
+TEST(PlayoutDelayEstimatorTest, AddsMarginsAndRoundsUp) {
+  PlayoutDelayEstimator estimator(kMinDelay, kMaxDelay);
+  RecordFrames(&estimator, PlayoutDelayEstimator::kMinFramesForEstimate,
+               milliseconds(80));
+  RecordFrames(&estimator, 1, milliseconds(101));
+
+  // 101 ms + 4 * 5 ms jitter + 3 ms processing = 124 ms, rounded up to 130 ms.
+  EXPECT_EQ(milliseconds(130),
+            estimator.ProposePlayoutDelay(kCurrentDelay, milliseconds(5),
+                                          milliseconds(3)));
+
+  // Never propose more than the maximum.
+  EXPECT_EQ(kMaxDelay,
+            estimator.ProposePlayoutDelay(kCurrentDelay, milliseconds(500),
+                                          kNoProcessingTime));
+}
+
+TEST(PlayoutDelayEstimatorTest, DecreasesOnlyWithHysteresis) {
+  PlayoutDelayEstimator estimator(kMinDelay, kMaxDelay);
+  RecordFrames(&estimator, PlayoutDelayEstimator::kMinFramesForEstimate,
+               milliseconds(140));
+  EXPECT_EQ(milliseconds(140), estimator.ProposePlayoutDelay(
+                                   milliseconds(130), kNoJitter,
+                                   kNoProcessingTime));
+  EXPECT_EQ(milliseconds(160), estimator.ProposePlayoutDelay(
+                                   milliseconds(160), kNoJitter,
+                                   kNoProcessingTime));
+  EXPECT_EQ(milliseconds(140), estimator.ProposePlayoutDelay(
+                                   milliseconds(170), kNoJitter,
+                                   kNoProcessingTime));
+}
+
+TEST(PlayoutDelayEstimatorTest, ForgetsFramesOutsideTheWindow) {
+  PlayoutDelayEstimator estimator(kMinDelay, kMaxDelay);
+
+  // A single slow frame dominates the estimate...
+  RecordFrames(&estimator, 1, milliseconds(300));
+  RecordFrames(&estimator, PlayoutDelayEstimator::kWindowSize - 1,
+               milliseconds(50));
+  EXPECT_EQ(milliseconds(300), estimator.ProposePlayoutDelay(
+                                   kCurrentDelay, kNoJitter,
+                                   kNoProcessingTime));
+
+  // ...until it falls out of the window.
+  RecordFrames(&estimator, 1, milliseconds(50));
+  EXPECT_EQ(kMinDelay, estimator.ProposePlayoutDelay(
+                           kCurrentDelay, kNoJitter, kNoProcessingTime));
+}
+
+}  // namespace
+}  // namespace cast
+}  // namespace openscreen
@@ -30,6 +30,7 @@ Receiver::Receiver(Environment* environment,
                    const SessionConfig& config)
     : now_(environment->now_function()),
       packet_router_(packet_router),
+      packet_buffer_pool_(environment->packet_buffer_pool()),
       rtcp_session_(config.sender_ssrc, config.receiver_ssrc, now_()),
       rtcp_parser_(&rtcp_session_),
       rtcp_builder_(&rtcp_session_),
@@ -37,6 +38,7 @@ Receiver::Receiver(Environment* environment,
       rtp_parser_(config.sender_ssrc),
       rtp_timebase_(config.rtp_timebase),
       crypto_(config.aes_secret_key, config.aes_iv_mask),
+      fec_enabled_(config.fec_enabled),
       rtcp_buffer_capacity_(environment->GetMaxPacketSize()),
       rtcp_buffer_(new uint8_t[rtcp_buffer_capacity_]),
       rtcp_alarm_(environment->now_function(), environment->task_runner()),
@@ -52,6 +54,10 @@ Receiver::Receiver(Environment* environment,
   playout_delay_changes_.emplace_back(FrameId::leader(),
                                       config.target_playout_delay);
 
+  for (PendingFrame& entry : pending_frames_) {
+    entry.collector.set_buffer_pool(packet_buffer_pool_);
+  }
+
   packet_router_->OnReceiverCreated(rtcp_session_.sender_ssrc(), this);
 }
 
@@ -64,10 +70,27 @@ void Receiver::SetConsumer(Consumer* consumer) {
   ScheduleFrameReadyCheck();
 }
 
+void Receiver::SetPartialFrameConsumer(PartialFrameConsumer* consumer) {
+  partial_frame_consumer_ = consumer;
+  partial_frame_id_ = FrameId();
+}
+
 void Receiver::SetPlayerProcessingTime(Clock::duration needed_time) {
   player_processing_time_ = std::max(Clock::duration::zero(), needed_time);
 }
 
+void Receiver::EnableAdaptivePlayoutDelay(milliseconds min_delay,
+                                          milliseconds max_delay) {
+  playout_delay_estimator_.emplace(min_delay, max_delay);
+  requested_playout_delay_ = milliseconds::zero();
+}
+
+void Receiver::DisableAdaptivePlayoutDelay() {
+  playout_delay_estimator_ = absl::nullopt;
+  requested_playout_delay_ = milliseconds::zero();
+  rtcp_builder_.SetPlayoutDelay(GetPlayoutDelayToReport(checkpoint_frame()));
+}
+
 void Receiver::RequestKeyFrame() {
   if (!last_key_frame_received_.is_null() &&
       last_frame_consumed_ >= last_key_frame_received_ &&
@@ -86,18 +109,18 @@ int Receiver::AdvanceToNextFrame() {
   for (FrameId f = immediate_next_frame; f <= latest_frame_expected_; ++f) {
     PendingFrame& entry = GetQueueEntry(f);
     if (entry.collector.is_complete()) {
-      const EncryptedFrame& encrypted_frame =
-          entry.collector.PeekAtAssembledFrame();
+      // Note: AES-CTR plaintext is the same size as the encrypted payload.
       if (f == immediate_next_frame) {  // Typical case.
         RECEIVER_VLOG << "AdvanceToNextFrame: Next in sequence (" << f << ')';
-        return FrameCrypto::GetPlaintextSize(encrypted_frame);
+        return entry.collector.GetPayloadSize();
       }
-      if (encrypted_frame.dependency != EncodedFrame::DEPENDS_ON_ANOTHER) {
+      if (entry.collector.PeekAtFrameMetadata().dependency !=
+          EncodedFrame::DEPENDS_ON_ANOTHER) {
         // Found a frame after skipping past some frames. Drop the ones being
         // skipped, advancing |last_frame_consumed_| before returning.
         RECEIVER_VLOG << "AdvanceToNextFrame: Skipping-ahead → " << f;
         DropAllFramesBefore(f);
-        return FrameCrypto::GetPlaintextSize(encrypted_frame);
+        return entry.collector.GetPayloadSize();
       }
       // Conclusion: The frame in the current queue entry is complete, but
       // depends on a prior incomplete frame. Continue scanning...
@@ -134,12 +157,15 @@ EncodedFrame Receiver::ConsumeNextFrame(absl::Span<uint8_t> buffer) {
   const FrameId frame_id = last_frame_consumed_ + 1;
   OSP_CHECK_LE(frame_id, checkpoint_frame());
 
-  // Decrypt the frame, populating the given output |frame|.
+  // Decrypt the frame, populating the given output |frame|. This reads
+  // directly from each packet's payload, so the encrypted frame is never
+  // assembled into one contiguous buffer.
   PendingFrame& entry = GetQueueEntry(frame_id);
   OSP_DCHECK(entry.collector.is_complete());
   EncodedFrame frame;
   frame.data = buffer;
-  crypto_.Decrypt(entry.collector.PeekAtAssembledFrame(), &frame);
+  crypto_.Decrypt(entry.collector.PeekAtFrameMetadata(),
+                  entry.collector.GetPayloadChunks(), &frame);
   OSP_DCHECK(entry.estimated_capture_time);
   frame.reference_time =
       *entry.estimated_capture_time + ResolveTargetPlayoutDelay(frame_id);
@@ -155,6 +181,7 @@ EncodedFrame Receiver::ConsumeNextFrame(absl::Span<uint8_t> buffer) {
 
   entry.Reset();
   last_frame_consumed_ = frame_id;
+  OnNextFrameChanged();
 
   // Ensure the Consumer is notified if there are already more frames ready for
   // consumption, and it hasn't explicitly called AdvanceToNextFrame() to check
@@ -166,16 +193,55 @@ EncodedFrame Receiver::ConsumeNextFrame(absl::Span<uint8_t> buffer) {
 
 void Receiver::OnReceivedRtpPacket(Clock::time_point arrival_time,
                                    std::vector<uint8_t> packet) {
+  ProcessRtpPacket(arrival_time, &packet);
+  // Unless a FrameCollector took the buffer, it can be re-used right away.
+  packet_buffer_pool_->Release(std::move(packet));
+}
+
+void Receiver::OnReceivedPackets(
+    Clock::time_point arrival_time,
+    absl::Span<std::pair<ApparentPacketType, std::vector<uint8_t>>> packets) {
+  OSP_DCHECK(!is_processing_batch_);
+  is_processing_batch_ = true;
+  for (auto& packet : packets) {
+    if (packet.first == ApparentPacketType::RTP) {
+      OnReceivedRtpPacket(arrival_time, std::move(packet.second));
+    } else {
+      OSP_DCHECK(packet.first == ApparentPacketType::RTCP);
+      OnReceivedRtcpPacket(arrival_time, std::move(packet.second));
+    }
+  }
+  is_processing_batch_ = false;
+
+  if (rtcp_send_deferred_) {
+    rtcp_send_deferred_ = false;
+    SendRtcp();
+  }
+  if (frame_ready_check_deferred_) {
+    frame_ready_check_deferred_ = false;
+    ScheduleFrameReadyCheck();
+  }
+}
+
+void Receiver::ProcessRtpPacket(Clock::time_point arrival_time,
+                                std::vector<uint8_t>* packet) {
   const absl::optional<RtpPacketParser::ParseResult> part =
-      rtp_parser_.Parse(packet);
+      rtp_parser_.Parse(*packet);
   if (!part) {
-    RECEIVER_LOG(WARN) << "Parsing of " << packet.size()
+    RECEIVER_LOG(WARN) << "Parsing of " << packet->size()
                        << " bytes as an RTP packet failed.";
     return;
   }
   stats_tracker_.OnReceivedValidRtpPacket(part->sequence_number,
                                           part->rtp_timestamp, arrival_time);
 
+  // Ignore FEC Parity packets unless they were negotiated for this stream.
+  if (part->fec_num_protected_packets > 0 && !fec_enabled_) {
+    RECEIVER_VLOG << "Ignoring FEC Parity packet for " << part->frame_id
+                  << ": FEC was not negotiated.";
+    return;
+  }
+
   // Ignore packets for frames the Receiver is no longer interested in.
   if (part->frame_id <= checkpoint_frame()) {
     return;
@@ -196,6 +262,7 @@ void Receiver::OnReceivedRtpPacket(Clock::time_point arrival_time,
       ++latest_frame_expected_;
       GetQueueEntry(latest_frame_expected_)
           .collector.set_frame_id(latest_frame_expected_);
+      frames_with_changed_loss_.Set(GetQueueIndex(latest_frame_expected_));
     } while (latest_frame_expected_ < part->frame_id);
     RECEIVER_VLOG << "Advanced latest frame expected to "
                   << latest_frame_expected_;
@@ -223,9 +290,13 @@ void Receiver::OnReceivedRtpPacket(Clock::time_point arrival_time,
     return;
   }
 
-  if (!collector.CollectRtpPacket(*part, &packet)) {
+  if (!collector.CollectRtpPacket(*part, packet)) {
     return;  // Bad data in the parsed packet. Ignore it.
   }
+  frames_with_changed_loss_.Set(GetQueueIndex(part->frame_id));
+  if (partial_frame_consumer_ && part->frame_id == last_frame_consumed_ + 1) {
+    DeliverPartialFrame();
+  }
 
   // The first packet in a frame contains timing information critical for
   // computing this frame's (and all future frames') playout time. Process that,
@@ -260,11 +331,15 @@ void Receiver::OnReceivedRtpPacket(Clock::time_point arrival_time,
   if (!collector.is_complete()) {
     return;  // Wait for the rest of the packets to come in.
   }
-  const EncryptedFrame& encrypted_frame = collector.PeekAtAssembledFrame();
+
+  if (playout_delay_estimator_) {
+    UpdateRequestedPlayoutDelay(*pending_frame.estimated_capture_time,
+                                arrival_time);
+  }
 
   // Whenever a key frame has been received, the decoder has what it needs to
   // recover. In this case, clear the PLI condition.
-  if (encrypted_frame.dependency == EncryptedFrame::KEY_FRAME) {
+  if (collector.PeekAtFrameMetadata().dependency == EncodedFrame::KEY_FRAME) {
     rtcp_builder_.SetPictureLossIndicator(false);
     last_key_frame_received_ = part->frame_id;
   }
@@ -284,8 +359,10 @@ void Receiver::OnReceivedRtcpPacket(Clock::time_point arrival_time,
                                     std::vector<uint8_t> packet) {
   absl::optional<SenderReportParser::SenderReportWithId> parsed_report =
       rtcp_parser_.Parse(packet);
+  const size_t packet_size = packet.size();
+  packet_buffer_pool_->Release(std::move(packet));
   if (!parsed_report) {
-    RECEIVER_LOG(WARN) << "Parsing of " << packet.size()
+    RECEIVER_LOG(WARN) << "Parsing of " << packet_size
                        << " bytes as an RTCP packet failed.";
     return;
   }
@@ -320,17 +397,30 @@ void Receiver::OnReceivedRtcpPacket(Clock::time_point arrival_time,
 }
 
 void Receiver::SendRtcp() {
-  // Collect ACK/NACK feedback for all active frames in the queue.
+  if (is_processing_batch_) {
+    rtcp_send_deferred_ = true;
+    return;
+  }
+
+  // Collect ACK/NACK feedback for all active frames in the queue. The NACKs
+  // for each incomplete frame are only re-generated if its loss state has
+  // changed since the last time.
   std::vector<PacketNack> packet_nacks;
   std::vector<FrameId> frame_acks;
   for (FrameId f = checkpoint_frame() + 1; f <= latest_frame_expected_; ++f) {
-    const FrameCollector& collector = GetQueueEntry(f).collector;
-    if (collector.is_complete()) {
+    PendingFrame& entry = GetQueueEntry(f);
+    if (entry.collector.is_complete()) {
       frame_acks.push_back(f);
-    } else {
-      collector.GetMissingPackets(&packet_nacks);
+      continue;
+    }
+    if (frames_with_changed_loss_.IsSet(GetQueueIndex(f))) {
+      entry.nacks.clear();
+      entry.collector.GetMissingPackets(&entry.nacks);
     }
+    packet_nacks.insert(packet_nacks.end(), entry.nacks.begin(),
+                        entry.nacks.end());
   }
+  frames_with_changed_loss_.ClearAll();
 
   // Build and send a compound RTCP packet.
   const bool no_nacks = packet_nacks.empty();
@@ -356,8 +446,12 @@ const Receiver::PendingFrame& Receiver::GetQueueEntry(FrameId frame_id) const {
 }
 
 Receiver::PendingFrame& Receiver::GetQueueEntry(FrameId frame_id) {
-  return pending_frames_[(frame_id - FrameId::first()) %
-                         pending_frames_.size()];
+  return pending_frames_[GetQueueIndex(frame_id)];
+}
+
+// static
+int Receiver::GetQueueIndex(FrameId frame_id) {
+  return static_cast<int>((frame_id - FrameId::first()) % kMaxUnackedFrames);
 }
 
 void Receiver::RecordNewTargetPlayoutDelay(FrameId as_of_frame,
@@ -384,6 +478,34 @@ void Receiver::RecordNewTargetPlayoutDelay(FrameId as_of_frame,
   OSP_DCHECK(AreElementsSortedAndUnique(playout_delay_changes_));
 }
 
+void Receiver::UpdateRequestedPlayoutDelay(
+    Clock::time_point estimated_capture_time,
+    Clock::time_point arrival_time) {
+  playout_delay_estimator_->OnFrameCompleted(arrival_time -
+                                             estimated_capture_time);
+  const milliseconds current = GetPlayoutDelayToReport(latest_frame_expected_);
+  const milliseconds proposed = playout_delay_estimator_->ProposePlayoutDelay(
+      current, stats_tracker_.jitter(), player_processing_time_);
+  if (proposed != current) {
+    RECEIVER_VLOG << "Requesting target playout delay change from "
+                  << current.count() << " to " << proposed.count() << " ms.";
+    requested_playout_delay_ = proposed;
+    rtcp_builder_.SetPlayoutDelay(proposed);
+  }
+}
+
+milliseconds Receiver::GetPlayoutDelayToReport(FrameId checkpoint) const {
+  if (requested_playout_delay_ > milliseconds::zero()) {
+    return requested_playout_delay_;
+  }
+  // If every frame up to the checkpoint has been consumed, the setting that was
+  // in-effect for it may have been pruned. Report the latest one known.
+  if (checkpoint == last_frame_consumed_) {
+    return playout_delay_changes_.back().second;
+  }
+  return ResolveTargetPlayoutDelay(checkpoint);
+}
+
 milliseconds Receiver::ResolveTargetPlayoutDelay(FrameId frame_id) const {
   OSP_DCHECK_GT(frame_id, last_frame_consumed_);
 
@@ -419,7 +541,7 @@ void Receiver::AdvanceCheckpoint(FrameId new_checkpoint) {
 
   RECEIVER_VLOG << "Advancing checkpoint to " << new_checkpoint;
   set_checkpoint_frame(new_checkpoint);
-  rtcp_builder_.SetPlayoutDelay(ResolveTargetPlayoutDelay(new_checkpoint));
+  rtcp_builder_.SetPlayoutDelay(GetPlayoutDelayToReport(new_checkpoint));
   SendRtcp();
 }
 
@@ -443,9 +565,62 @@ void Receiver::DropAllFramesBefore(FrameId first_kept_frame) {
 
   RECEIVER_LOG(INFO) << "Artificially advancing checkpoint after skipping.";
   AdvanceCheckpoint(first_kept_frame);
+  OnNextFrameChanged();
+}
+
+void Receiver::DeliverPartialFrame() {
+  const FrameId frame_id = last_frame_consumed_ + 1;
+  const FrameCollector& collector = GetQueueEntry(frame_id).collector;
+  const int num_packets_available = collector.GetNumLeadingPacketsCollected();
+
+  // Start over whenever the next frame to be consumed has changed. AES-CTR
+  // allows decrypting the payload in any number of slices, as long as they are
+  // processed in order.
+  if (frame_id != partial_frame_id_) {
+    partial_frame_id_ = frame_id;
+    partial_frame_packets_delivered_ = 0;
+    partial_frame_bytes_delivered_ = 0;
+    partial_frame_cipher_.emplace(crypto_.StartFrame(frame_id));
+  }
+  if (num_packets_available <= partial_frame_packets_delivered_) {
+    return;
+  }
+
+  partial_frame_buffer_.clear();
+  for (int i = partial_frame_packets_delivered_; i < num_packets_available;
+       ++i) {
+    const absl::Span<const uint8_t> payload =
+        collector.GetPacketPayload(static_cast<FramePacketId>(i));
+    const size_t offset = partial_frame_buffer_.size();
+    partial_frame_buffer_.resize(offset + payload.size());
+    partial_frame_cipher_->Process(
+        payload, absl::Span<uint8_t>(partial_frame_buffer_).subspan(offset));
+  }
+
+  const size_t offset = partial_frame_bytes_delivered_;
+  partial_frame_packets_delivered_ = num_packets_available;
+  partial_frame_bytes_delivered_ += partial_frame_buffer_.size();
+  partial_frame_consumer_->OnFramePayloadPrefix(
+      collector.PeekAtFrameMetadata(), offset, partial_frame_buffer_);
+}
+
+void Receiver::OnNextFrameChanged() {
+  if (!partial_frame_consumer_ ||
+      last_frame_consumed_ >= latest_frame_expected_) {
+    return;
+  }
+  if (GetQueueEntry(last_frame_consumed_ + 1).collector.is_complete()) {
+    return;
+  }
+  DeliverPartialFrame();
 }
 
 void Receiver::ScheduleFrameReadyCheck(Clock::time_point when) {
+  if (is_processing_batch_ && when == Alarm::kImmediately) {
+    frame_ready_check_deferred_ = true;
+    return;
+  }
+
   consumption_alarm_.Schedule(
       [this] {
         if (consumer_) {
@@ -460,12 +635,15 @@ void Receiver::ScheduleFrameReadyCheck(Clock::time_point when) {
 
 Receiver::Consumer::~Consumer() = default;
 
+Receiver::PartialFrameConsumer::~PartialFrameConsumer() = default;
+
 Receiver::PendingFrame::PendingFrame() = default;
 Receiver::PendingFrame::~PendingFrame() = default;
 
 void Receiver::PendingFrame::Reset() {
   collector.Reset();
   estimated_capture_time = absl::nullopt;
+  nacks.clear();
 }
 
 // static
@@ -18,8 +18,11 @@
 #include "cast/streaming/compound_rtcp_builder.h"
 #include "cast/streaming/environment.h"
 #include "cast/streaming/frame_collector.h"
+#include "cast/streaming/frame_crypto.h"
 #include "cast/streaming/frame_id.h"
+#include "cast/streaming/packet_util.h"
 #include "cast/streaming/packet_receive_stats_tracker.h"
+#include "cast/streaming/playout_delay_estimator.h"
 #include "cast/streaming/rtcp_common.h"
 #include "cast/streaming/rtcp_session.h"
 #include "cast/streaming/rtp_packet_parser.h"
@@ -27,6 +30,7 @@
 #include "cast/streaming/ssrc.h"
 #include "platform/api/time.h"
 #include "util/alarm.h"
+#include "util/yet_another_bit_vector.h"
 
 namespace openscreen {
 namespace cast {
@@ -117,6 +121,33 @@ class Receiver {
     virtual void OnFramesReady(int next_frame_buffer_size) = 0;
   };
 
+  // An optional, additional consumer interface for low-latency applications
+  // whose decoders accept partial input (e.g., slices or partitions). It is
+  // provided with the decrypted payload of the next frame to be consumed, in
+  // order, as its packets arrive; so decoding can begin before the whole frame
+  // has been received. The frame must still be consumed in the usual way (see
+  // Consumer), once it is complete.
+  class PartialFrameConsumer {
+   public:
+    virtual ~PartialFrameConsumer();
+
+    // Called whenever more of the payload of the next frame to be consumed has
+    // been received, in order. |frame_metadata| provides the frame's ID,
+    // dependency info, RTP timestamp, etc.; but its |data| and
+    // |reference_time| members are not meaningful. |data| is the newly-
+    // available part of the payload, which starts |offset| bytes into the
+    // payload (i.e., right after the data provided in earlier calls for the
+    // same frame), and is only valid for the duration of the call.
+    //
+    // This is not guaranteed to be called for every frame, nor to provide the
+    // whole payload of a frame (e.g., if the frame was already complete by the
+    // time it became the next one to be consumed). Implementations must not
+    // call back into the Receiver from within this method.
+    virtual void OnFramePayloadPrefix(const EncodedFrame& frame_metadata,
+                                      size_t offset,
+                                      absl::Span<const uint8_t> data) = 0;
+  };
+
   // Constructs a Receiver that attaches to the given |environment| and
   // |packet_router|. The config contains the settings that were
   // agreed-upon by both sides from the OFFER/ANSWER exchange (i.e., the part of
@@ -135,6 +166,10 @@ class Receiver {
   // the queue indefinitely.
   void SetConsumer(Consumer* consumer);
 
+  // Set the PartialFrameConsumer to be provided with the payloads of frames as
+  // they are being received, or nullptr to stop (the default).
+  void SetPartialFrameConsumer(PartialFrameConsumer* consumer);
+
   // Sets how much time the consumer will need to decode/buffer/render/etc., and
   // otherwise fully process a frame for on-time playback. This information is
   // used by the Receiver to decide whether to skip past frames that have
@@ -144,6 +179,18 @@ class Receiver {
   // Default setting: kDefaultPlayerProcessingTime
   void SetPlayerProcessingTime(Clock::duration needed_time);
 
+  // Enables/Disables adaptive jitter buffer mode. While enabled, the Receiver
+  // measures how long after capture each frame is completely received, along
+  // with the interarrival jitter, and computes the minimal target playout delay
+  // that is safe under the current network conditions (within the range
+  // [|min_delay|,|max_delay|]). Then, it requests that the Sender adopt that
+  // playout delay by reporting it in its RTCP feedback. The Sender remains in
+  // control: frames continue to play out according to the Sender's setting
+  // until it announces a change.
+  void EnableAdaptivePlayoutDelay(std::chrono::milliseconds min_delay,
+                                  std::chrono::milliseconds max_delay);
+  void DisableAdaptivePlayoutDelay();
+
   // Propagates a "picture loss indicator" notification to the Sender,
   // requesting a key frame so that decode/playout can recover. It is safe to
   // call this redundantly. The Receiver will clear the picture loss condition
@@ -188,6 +235,16 @@ class Receiver {
   void OnReceivedRtcpPacket(Clock::time_point arrival_time,
                             std::vector<uint8_t> packet);
 
+  // Called by ReceiverPacketRouter to provide this Receiver with a batch of
+  // RTP/RTCP |packets| meant for it, in arrival order, that were all read from
+  // the socket at |arrival_time|. This is equivalent to calling the above
+  // methods for each packet, except that any RTCP packet sends and checks for
+  // frames ready for consumption are coalesced into one each, at the end of the
+  // batch.
+  void OnReceivedPackets(
+      Clock::time_point arrival_time,
+      absl::Span<std::pair<ApparentPacketType, std::vector<uint8_t>>> packets);
+
  private:
   // An entry in the circular queue (see |pending_frames_|).
   struct PendingFrame {
@@ -199,6 +256,11 @@ class Receiver {
     // playout time.
     absl::optional<Clock::time_point> estimated_capture_time;
 
+    // The NACKs last generated for this frame by SendRtcp(). These are only
+    // re-generated when the frame's loss state has changed (see
+    // |frames_with_changed_loss_|). Reset() clears, but does not free, this.
+    std::vector<PacketNack> nacks;
+
     PendingFrame();
     ~PendingFrame();
 
@@ -225,12 +287,24 @@ class Receiver {
   // mutate any state (i.e., they are just look-ups).
   const PendingFrame& GetQueueEntry(FrameId frame_id) const;
   PendingFrame& GetQueueEntry(FrameId frame_id);
+  static int GetQueueIndex(FrameId frame_id);
 
   // Record that the target playout delay has changed starting with the given
   // FrameId.
   void RecordNewTargetPlayoutDelay(FrameId as_of_frame,
                                    std::chrono::milliseconds delay);
 
+  // Called in adaptive jitter buffer mode, when the frame having the given
+  // |estimated_capture_time| was completely received at |arrival_time|, to
+  // re-compute the playout delay to be requested from the Sender.
+  void UpdateRequestedPlayoutDelay(Clock::time_point estimated_capture_time,
+                                   Clock::time_point arrival_time);
+
+  // Returns the target playout delay to report in RTCP feedback as of the given
+  // checkpoint frame: Either the one requested in adaptive jitter buffer mode,
+  // or the one in-effect for that frame.
+  std::chrono::milliseconds GetPlayoutDelayToReport(FrameId checkpoint) const;
+
   // Examine the known target playout delay changes to determine what setting is
   // in-effect for the given frame.
   std::chrono::milliseconds ResolveTargetPlayoutDelay(FrameId frame_id) const;
@@ -249,6 +323,22 @@ class Receiver {
   // frames.
   void DropAllFramesBefore(FrameId first_kept_frame);
 
+  // Helper for OnReceivedRtpPacket(), which processes the |packet| and might
+  // take its buffer.
+  void ProcessRtpPacket(Clock::time_point arrival_time,
+                        std::vector<uint8_t>* packet);
+
+  // If the next frame to be consumed has more of its payload collected, in
+  // order, than what was last provided to the |partial_frame_consumer_|,
+  // decrypts the newly-available part and provides it.
+  void DeliverPartialFrame();
+
+  // Called whenever |last_frame_consumed_| advances, to immediately provide the
+  // |partial_frame_consumer_| with whatever part of the new next frame has
+  // already been received. Frames that are already complete are skipped, since
+  // they will be consumed in the usual way.
+  void OnNextFrameChanged();
+
   // Sets the |consumption_alarm_| to check whether any frames are ready,
   // including possibly skipping over late frames in order to make not-yet-late
   // frames become ready. The default argument value means "without delay."
@@ -256,6 +346,7 @@ class Receiver {
 
   const ClockNowFunctionPtr now_;
   ReceiverPacketRouter* const packet_router_;
+  PacketBufferPool* const packet_buffer_pool_;  // Recycles packet buffers.
   RtcpSession rtcp_session_;
   SenderReportParser rtcp_parser_;
   CompoundRtcpBuilder rtcp_builder_;
@@ -263,6 +354,7 @@ class Receiver {
   RtpPacketParser rtp_parser_;
   const int rtp_timebase_;    // RTP timestamp ticks per second.
   const FrameCrypto crypto_;  // Decrypts assembled frames.
+  const bool fec_enabled_;    // Whether FEC Parity packets were negotiated.
 
   // Buffer for serializing/sending RTCP packets.
   const int rtcp_buffer_capacity_;
@@ -310,6 +402,13 @@ class Receiver {
   // |latest_frame_expected_|.
   std::array<PendingFrame, kMaxUnackedFrames> pending_frames_{};
 
+  // The set of |pending_frames_| slots, by index, whose frame has become known
+  // or collected a packet since the last call to SendRtcp(). Only these have
+  // their |PendingFrame::nacks| re-generated, so that the cost of building the
+  // NACK feedback scales with the changes rather than the size of the queue.
+  YetAnotherBitVector frames_with_changed_loss_{kMaxUnackedFrames,
+                                                YetAnotherBitVector::CLEARED};
+
   // Tracks the recent changes to the target playout delay, which is controlled
   // by the Sender. The FrameId indicates the first frame where a new delay
   // setting takes effect. This vector is never empty, is kept sorted, and is
@@ -325,14 +424,41 @@ class Receiver {
   // ready to be consumed.
   Consumer* consumer_ = nullptr;
 
+  // The optional consumer of partially-received frames, along with the state
+  // of the partial delivery of the next frame to be consumed: The ID of the
+  // frame, the number of its packets and payload bytes provided so far, the
+  // cipher used to decrypt the next part of its payload, and a scratch buffer
+  // (re-used across calls) for the decrypted data.
+  PartialFrameConsumer* partial_frame_consumer_ = nullptr;
+  FrameId partial_frame_id_;
+  int partial_frame_packets_delivered_ = 0;
+  size_t partial_frame_bytes_delivered_ = 0;
+  absl::optional<FrameCrypto::StreamCipher> partial_frame_cipher_;
+  std::vector<uint8_t> partial_frame_buffer_;
+
   // The additional time needed to decode/play-out each frame after being
   // consumed from this Receiver.
   Clock::duration player_processing_time_ = kDefaultPlayerProcessingTime;
 
+  // Set only while in adaptive jitter buffer mode, to compute the playout delay
+  // to request from the Sender.
+  absl::optional<PlayoutDelayEstimator> playout_delay_estimator_;
+
+  // The target playout delay most-recently requested from the Sender in
+  // adaptive jitter buffer mode, or zero if none.
+  std::chrono::milliseconds requested_playout_delay_{0};
+
   // Scheduled to check whether there are frames ready and, if there are, to
   // notify the Consumer via OnFramesReady().
   Alarm consumption_alarm_;
 
+  // Set while OnReceivedPackets() is processing a batch. Meanwhile, SendRtcp()
+  // and ScheduleFrameReadyCheck() just set the corresponding "deferred" flag,
+  // and the deferred work is done once at the end of the batch.
+  bool is_processing_batch_ = false;
+  bool rtcp_send_deferred_ = false;
+  bool frame_ready_check_deferred_ = false;
+
   // The interval between sending ACK/NACK feedback RTCP messages while
   // incomplete frames exist in the queue.
   //
@@ -6,7 +6,6 @@
 
 #include <algorithm>
 
-#include "cast/streaming/packet_util.h"
 #include "cast/streaming/receiver.h"
 #include "util/osp_logging.h"
 #include "util/stringprintf.h"
@@ -26,7 +25,7 @@ ReceiverPacketRouter::~ReceiverPacketRouter() {
 void ReceiverPacketRouter::OnReceiverCreated(Ssrc sender_ssrc,
                                              Receiver* receiver) {
   OSP_DCHECK(FindEntry(sender_ssrc) == receivers_.end());
-  receivers_.emplace_back(sender_ssrc, receiver);
+  receivers_.push_back(ReceiverEntry{sender_ssrc, receiver, {}});
 
   // If there were no Receiver instances before, resume receiving packets for
   // dispatch. Reset/Clear the remote endpoint, in preparation for later setting
@@ -62,13 +61,53 @@ void ReceiverPacketRouter::SendRtcpPacket(absl::Span<const uint8_t> packet) {
 void ReceiverPacketRouter::OnReceivedPacket(const IPEndpoint& source,
                                             Clock::time_point arrival_time,
                                             std::vector<uint8_t> packet) {
+  ApparentPacketType packet_type;
+  const auto it = RoutePacket(source, packet, receivers_.end(), &packet_type);
+  if (it == receivers_.end()) {
+    return;
+  }
+  if (packet_type == ApparentPacketType::RTP) {
+    it->receiver->OnReceivedRtpPacket(arrival_time, std::move(packet));
+  } else {
+    it->receiver->OnReceivedRtcpPacket(arrival_time, std::move(packet));
+  }
+}
+
+void ReceiverPacketRouter::OnReceivedPackets(Clock::time_point arrival_time,
+                                             std::vector<UdpPacket> packets) {
+  // Group the packets by Receiver, preserving their order.
+  auto it = receivers_.end();
+  for (UdpPacket& packet : packets) {
+    ApparentPacketType packet_type;
+    it = RoutePacket(packet.source(), packet, it, &packet_type);
+    if (it != receivers_.end()) {
+      it->batch.emplace_back(
+          packet_type, std::move(static_cast<std::vector<uint8_t>&>(packet)));
+    }
+  }
+
+  // Then, have each Receiver process its group all at once.
+  for (ReceiverEntry& entry : receivers_) {
+    if (!entry.batch.empty()) {
+      entry.receiver->OnReceivedPackets(arrival_time,
+                                        absl::MakeSpan(entry.batch));
+      entry.batch.clear();
+    }
+  }
+}
+
+ReceiverPacketRouter::ReceiverEntries::iterator
+ReceiverPacketRouter::RoutePacket(const IPEndpoint& source,
+                                  absl::Span<const uint8_t> packet,
+                                  ReceiverEntries::iterator hint,
+                                  ApparentPacketType* packet_type) {
   OSP_DCHECK_NE(source.port, uint16_t{0});
 
   // If the sender endpoint is known, ignore any packet that did not come from
   // that same endpoint.
   if (environment_->remote_endpoint().port != 0) {
     if (source != environment_->remote_endpoint()) {
-      return;
+      return receivers_.end();
     }
   }
 
@@ -78,11 +117,13 @@ void ReceiverPacketRouter::OnReceivedPacket(const IPEndpoint& source,
     constexpr int kMaxPartiaHexDumpSize = 96;
     OSP_LOG_WARN << "UNKNOWN packet of " << packet.size()
                  << " bytes. Partial hex dump: "
-                 << HexEncode(absl::Span<const uint8_t>(packet).subspan(
-                        0, kMaxPartiaHexDumpSize));
-    return;
+                 << HexEncode(packet.subspan(0, kMaxPartiaHexDumpSize));
+    return receivers_.end();
   }
-  const auto it = FindEntry(seems_like.second);
+  const auto it = (hint != receivers_.end() &&
+                   hint->sender_ssrc == seems_like.second)
+                      ? hint
+                      : FindEntry(seems_like.second);
   if (it != receivers_.end()) {
     // At this point, a valid packet has been matched with a receiver. Lock-in
     // the remote endpoint as the |source| of this |packet| so that only packets
@@ -90,20 +131,16 @@ void ReceiverPacketRouter::OnReceivedPacket(const IPEndpoint& source,
     if (environment_->remote_endpoint().port == 0) {
       environment_->set_remote_endpoint(source);
     }
-
-    if (seems_like.first == ApparentPacketType::RTP) {
-      it->second->OnReceivedRtpPacket(arrival_time, std::move(packet));
-    } else if (seems_like.first == ApparentPacketType::RTCP) {
-      it->second->OnReceivedRtcpPacket(arrival_time, std::move(packet));
-    }
+    *packet_type = seems_like.first;
   }
+  return it;
 }
 
 ReceiverPacketRouter::ReceiverEntries::iterator ReceiverPacketRouter::FindEntry(
     Ssrc sender_ssrc) {
   return std::find_if(receivers_.begin(), receivers_.end(),
-                      [sender_ssrc](const ReceiverEntries::value_type& entry) {
-                        return entry.first == sender_ssrc;
+                      [sender_ssrc](const ReceiverEntry& entry) {
+                        return entry.sender_ssrc == sender_ssrc;
                       });
 }
 
@@ -12,6 +12,7 @@
 
 #include "absl/types/span.h"
 #include "cast/streaming/environment.h"
+#include "cast/streaming/packet_util.h"
 #include "cast/streaming/ssrc.h"
 
 namespace openscreen {
@@ -44,12 +45,31 @@ class ReceiverPacketRouter final : public Environment::PacketConsumer {
   void SendRtcpPacket(absl::Span<const uint8_t> packet);
 
  private:
-  using ReceiverEntries = std::vector<std::pair<Ssrc, Receiver*>>;
+  struct ReceiverEntry {
+    Ssrc sender_ssrc;
+    Receiver* receiver;
+
+    // Scratch space used by OnReceivedPackets() to group the packets of a
+    // batch meant for this Receiver. Always empty between calls.
+    std::vector<std::pair<ApparentPacketType, std::vector<uint8_t>>> batch;
+  };
+  using ReceiverEntries = std::vector<ReceiverEntry>;
 
   // Environment::PacketConsumer implementation.
   void OnReceivedPacket(const IPEndpoint& source,
                         Clock::time_point arrival_time,
                         std::vector<uint8_t> packet) final;
+  void OnReceivedPackets(Clock::time_point arrival_time,
+                         std::vector<UdpPacket> packets) final;
+
+  // Determines which Receiver the |packet| from |source| is meant for, and
+  // whether it is RTP or RTCP. Returns "end" if the packet should be dropped.
+  // |hint| is checked first, before searching all the entries, since
+  // consecutive packets are usually meant for the same Receiver.
+  ReceiverEntries::iterator RoutePacket(const IPEndpoint& source,
+                                        absl::Span<const uint8_t> packet,
+                                        ReceiverEntries::iterator hint,
+                                        ApparentPacketType* packet_type);
 
   // Helper to return an iterator pointing to the entry corresponding to the
   // given |sender_ssrc|, or "end" if not found.
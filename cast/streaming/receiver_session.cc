@@ -4,6 +4,7 @@
 
 #include "cast/streaming/receiver_session.h"
 
+#include <algorithm>
 #include <chrono>  // NOLINT
 #include <string>
 #include <utility>
@@ -15,6 +16,7 @@
 #include "cast/streaming/message_util.h"
 #include "cast/streaming/offer_messages.h"
 #include "cast/streaming/receiver.h"
+#include "cast/streaming/rtp_defines.h"
 #include "util/osp_logging.h"
 
 namespace openscreen {
@@ -77,6 +79,12 @@ const Stream* SelectStream(const std::vector<Codec>& preferred_codecs,
   return nullptr;
 }
 
+// Returns true if the Sender offered to send FEC Parity packets for |stream|.
+bool OffersFec(const Stream& stream) {
+  return std::find(stream.rtp_extensions.begin(), stream.rtp_extensions.end(),
+                   kFecRtpExtensionName) != stream.rtp_extensions.end();
+}
+
 }  // namespace
 
 Preferences::Preferences() = default;
@@ -201,7 +209,7 @@ ReceiverSession::ConstructReceiver(const Stream& stream) {
   SessionConfig config = {stream.ssrc,         stream.ssrc + 1,
                           stream.rtp_timebase, stream.channels,
                           stream.target_delay, stream.aes_key,
-                          stream.aes_iv_mask};
+                          stream.aes_iv_mask,  OffersFec(stream)};
   auto receiver =
       std::make_unique<Receiver>(environment_, &packet_router_, config);
 
@@ -254,14 +262,23 @@ Answer ReceiverSession::ConstructAnswer(
 
   std::vector<int> stream_indexes;
   std::vector<Ssrc> stream_ssrcs;
+  std::vector<int> fec_stream_indexes;
+  const auto add_stream = [&](const Stream& stream) {
+    stream_indexes.push_back(stream.index);
+    stream_ssrcs.push_back(stream.ssrc + 1);
+    // The Receiver always supports FEC, so accept it for each stream for which
+    // it was offered.
+    if (OffersFec(stream)) {
+      fec_stream_indexes.push_back(stream.index);
+    }
+  };
+
   if (selected_audio_stream) {
-    stream_indexes.push_back(selected_audio_stream->stream.index);
-    stream_ssrcs.push_back(selected_audio_stream->stream.ssrc + 1);
+    add_stream(selected_audio_stream->stream);
   }
 
   if (selected_video_stream) {
-    stream_indexes.push_back(selected_video_stream->stream.index);
-    stream_ssrcs.push_back(selected_video_stream->stream.ssrc + 1);
+    add_stream(selected_video_stream->stream);
   }
 
   absl::optional<Constraints> constraints;
@@ -282,7 +299,9 @@ Answer ReceiverSession::ConstructAnswer(
                 display,
                 std::vector<int>{},  // receiver_rtcp_event_log
                 std::vector<int>{},  // receiver_rtcp_dscp
-                supports_wifi_status_reporting_};
+                supports_wifi_status_reporting_,
+                std::vector<std::string>{},  // rtp_extensions
+                std::move(fec_stream_indexes)};
 }
 
 void ReceiverSession::SendMessage(Message* message) {
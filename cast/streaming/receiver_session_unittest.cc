@@ -146,6 +146,53 @@ constexpr char kNoVideoOfferMessage[] = R"({
   }
 })";
 
+constexpr char kFecOfferMessage[] = R"({
+  "type": "OFFER",
+  "seqNum": 1337,
+  "offer": {
+    "castMode": "mirroring",
+    "receiverGetStatus": true,
+    "supportedStreams": [
+      {
+        "index": 31338,
+        "type": "video_source",
+        "codecName": "vp8",
+        "rtpProfile": "cast",
+        "rtpPayloadType": 127,
+        "ssrc": 19088745,
+        "maxFrameRate": "60000/1000",
+        "timeBase": "1/90000",
+        "maxBitRate": 5000000,
+        "profile": "main",
+        "level": "4",
+        "aesKey": "040d756791711fd3adb939066e6d8690",
+        "aesIvMask": "9ff0f022a959150e70a2d05a6c184aed",
+        "resolutions": [
+          {
+            "width": 1280,
+            "height": 720
+          }
+        ],
+        "rtpExtensions": ["adaptive_playout_delay", "xor_fec_parity"]
+      },
+      {
+        "index": 1337,
+        "type": "audio_source",
+        "codecName": "opus",
+        "rtpProfile": "cast",
+        "rtpPayloadType": 97,
+        "ssrc": 19088747,
+        "bitRate": 124000,
+        "timeBase": "1/48000",
+        "channels": 2,
+        "aesKey": "51027e4e2347cbcb49d57ef10177aebc",
+        "aesIvMask": "7f12a19be62a36c04ae4116caaeff6d1",
+        "rtpExtensions": ["adaptive_playout_delay"]
+      }
+    ]
+  }
+})";
+
 constexpr char kNoAudioOrVideoOfferMessage[] = R"({
   "type": "OFFER",
   "seqNum": 1337,
@@ -328,6 +375,41 @@ TEST_F(ReceiverSessionTest, CanNegotiateWithDefaultPreferences) {
   EXPECT_TRUE(answer_body["display"].isNull());
 }
 
+TEST_F(ReceiverSessionTest, AcceptsFecPerStream) {
+  auto message_port = std::make_unique<SimpleMessagePort>();
+  StrictMock<FakeClient> client;
+  auto environment = MakeEnvironment();
+  ReceiverSession session(&client, environment.get(), message_port.get(),
+                          ReceiverSession::Preferences{});
+
+  // Only the video stream was offered with FEC Parity packets.
+  EXPECT_CALL(client, OnNegotiated(&session, _))
+      .WillOnce([](const ReceiverSession* session,
+                   ReceiverSession::ConfiguredReceivers cr) {
+        ASSERT_TRUE(cr.audio);
+        EXPECT_FALSE(cr.audio.value().receiver_config.fec_enabled);
+        ASSERT_TRUE(cr.video);
+        EXPECT_TRUE(cr.video.value().receiver_config.fec_enabled);
+      });
+  EXPECT_CALL(client, OnConfiguredReceiversDestroyed(&session)).Times(1);
+
+  message_port->ReceiveMessage(kFecOfferMessage);
+
+  const auto& messages = message_port->posted_messages();
+  ASSERT_EQ(1u, messages.size());
+  auto message_body = json::Parse(messages[0]);
+  ASSERT_TRUE(message_body.is_value());
+
+  // The ANSWER must accept FEC for the video stream only, so that the Sender
+  // only sends FEC Parity packets for that stream. This is done without
+  // changing the "rtpExtensions" that other Senders already understand.
+  const ErrorOr<Answer> answer = Answer::Parse(message_body.value()["answer"]);
+  ASSERT_TRUE(answer.is_value()) << answer.error();
+  EXPECT_TRUE(answer.value().rtp_extensions.empty());
+  EXPECT_FALSE(answer.value().IsFecEnabled(1337));
+  EXPECT_TRUE(answer.value().IsFecEnabled(31338));
+}
+
 TEST_F(ReceiverSessionTest, CanNegotiateWithCustomCodecPreferences) {
   auto message_port = std::make_unique<SimpleMessagePort>();
   StrictMock<FakeClient> client;
@@ -38,6 +38,7 @@
 #include "util/osp_logging.h"
 
 using testing::_;
+using testing::AnyNumber;
 using testing::AtLeast;
 using testing::Gt;
 using testing::Invoke;
@@ -222,6 +223,28 @@ class MockSender : public CompoundRtcpParser::Client {
     }
   }
 
+  // Send all the packets of the simulated frames |first| through |last|, in
+  // order, all together as one batch (as if they were all read from the socket
+  // at once).
+  void SendFramesAsOneBatch(Clock::time_point start_time, int first, int last) {
+    std::vector<UdpPacket> batch;
+    uint8_t buffer[kMaxRtpPacketSize];
+    for (int i = first; i <= last; ++i) {
+      SetFrameBeingSent(SimulatedFrame(start_time, i));
+      for (FramePacketId packet_id : GetAllPacketIds(0)) {
+        const auto span = rtp_packetizer_.GeneratePacket(frame_being_sent_,
+                                                         packet_id, buffer);
+        batch.emplace_back(span.begin(), span.end());
+        batch.back().set_source(sender_endpoint_);
+      }
+    }
+    task_runner_->PostTaskWithDelay(
+        [receiver = receiver_, batch = std::move(batch)]() mutable {
+          receiver->OnReadBatch(nullptr, std::move(batch));
+        },
+        kOneWayNetworkDelay);
+  }
+
   // Called to process a packet from the Receiver.
   void OnPacketFromReceiver(absl::Span<const uint8_t> packet) {
     EXPECT_TRUE(rtcp_parser_.Parse(packet, max_feedback_frame_id_));
@@ -259,6 +282,32 @@ class MockConsumer : public Receiver::Consumer {
   MOCK_METHOD1(OnFramesReady, void(int next_frame_buffer_size));
 };
 
+// Accumulates the partial frame payloads provided by the Receiver, checking
+// that they are provided in order.
+class FakePartialFrameConsumer : public Receiver::PartialFrameConsumer {
+ public:
+  FrameId frame_id() const { return frame_id_; }
+  const std::vector<uint8_t>& payload() const { return payload_; }
+  int num_calls() const { return num_calls_; }
+
+  void OnFramePayloadPrefix(const EncodedFrame& frame_metadata,
+                            size_t offset,
+                            absl::Span<const uint8_t> data) override {
+    if (frame_metadata.frame_id != frame_id_) {
+      frame_id_ = frame_metadata.frame_id;
+      payload_.clear();
+    }
+    EXPECT_EQ(payload_.size(), offset);
+    payload_.insert(payload_.end(), data.begin(), data.end());
+    ++num_calls_;
+  }
+
+ private:
+  FrameId frame_id_;
+  std::vector<uint8_t> payload_;
+  int num_calls_ = 0;
+};
+
 class ReceiverTest : public testing::Test {
  public:
   ReceiverTest()
@@ -466,6 +515,197 @@ TEST_F(ReceiverTest, ReceivesFramesInOrder) {
   EXPECT_EQ(Receiver::kNoFramesReady, receiver()->AdvanceToNextFrame());
 }
 
+// Tests that, in adaptive jitter buffer mode, the Receiver requests a shorter
+// target playout delay from the Sender once it has observed that frames are
+// consistently arriving much sooner than needed.
+TEST_F(ReceiverTest, RequestsShorterPlayoutDelayInAdaptiveMode) {
+  constexpr milliseconds kMinAdaptiveDelay{20};
+  constexpr milliseconds kMaxAdaptiveDelay{1000};
+  constexpr int kNumFrames = 40;
+
+  const Clock::time_point start_time = FakeClock::now();
+  ExchangeInitialReportPackets();
+  receiver()->EnableAdaptivePlayoutDelay(kMinAdaptiveDelay, kMaxAdaptiveDelay);
+
+  milliseconds reported_delay{0};
+  EXPECT_CALL(*sender(), OnReceiverCheckpoint(_, _))
+      .WillRepeatedly(SaveArg<1>(&reported_delay));
+  for (int i = 0; i < kNumFrames; ++i) {
+    sender()->SetFrameBeingSent(SimulatedFrame(start_time, i));
+    sender()->SendRtpPackets(sender()->GetAllPacketIds(0));
+    AdvanceClockAndRunTasks(SimulatedFrame::kFrameDuration);
+
+    // Until enough frames have been observed, the Receiver reports the
+    // Sender's setting.
+    if (i == SimulatedFrame::kPlayoutChangeAtFrame) {
+      EXPECT_EQ(kTargetPlayoutDelayChange, reported_delay);
+    }
+  }
+  EXPECT_GE(reported_delay, kMinAdaptiveDelay);
+  EXPECT_LT(reported_delay, kTargetPlayoutDelay);
+
+  // Once adaptive mode is disabled, the Receiver reports the Sender's setting
+  // again.
+  receiver()->DisableAdaptivePlayoutDelay();
+  AdvanceClockAndRunTasks(kRtcpReportInterval);
+  EXPECT_EQ(kTargetPlayoutDelayChange, reported_delay);
+  testing::Mock::VerifyAndClearExpectations(sender());
+
+  ConsumeAndVerifyFrames(0, kNumFrames - 1, start_time);
+}
+
+// Tests that adaptive jitter buffer mode can be disabled while there are no
+// unconsumed frames: Both before any frames have been received, and after all
+// of them have been consumed.
+TEST_F(ReceiverTest, DisablesAdaptiveModeWithNoUnconsumedFrames) {
+  constexpr milliseconds kMinAdaptiveDelay{20};
+  constexpr milliseconds kMaxAdaptiveDelay{1000};
+  constexpr int kNumFrames = 40;
+
+  receiver()->EnableAdaptivePlayoutDelay(kMinAdaptiveDelay, kMaxAdaptiveDelay);
+  receiver()->DisableAdaptivePlayoutDelay();
+
+  // The Receiver reports the Sender's setting in reply to the first Sender
+  // Report.
+  const Clock::time_point start_time = FakeClock::now();
+  ExchangeInitialReportPackets();
+
+  milliseconds reported_delay{0};
+  EXPECT_CALL(*sender(), OnReceiverCheckpoint(_, _))
+      .WillRepeatedly(SaveArg<1>(&reported_delay));
+  receiver()->EnableAdaptivePlayoutDelay(kMinAdaptiveDelay, kMaxAdaptiveDelay);
+  for (int i = 0; i < kNumFrames; ++i) {
+    sender()->SetFrameBeingSent(SimulatedFrame(start_time, i));
+    sender()->SendRtpPackets(sender()->GetAllPacketIds(0));
+    AdvanceClockAndRunTasks(SimulatedFrame::kFrameDuration);
+  }
+  EXPECT_LT(reported_delay, kTargetPlayoutDelay);
+  ConsumeAndVerifyFrames(0, kNumFrames - 1, start_time);
+  EXPECT_EQ(Receiver::kNoFramesReady, receiver()->AdvanceToNextFrame());
+
+  receiver()->DisableAdaptivePlayoutDelay();
+  AdvanceClockAndRunTasks(kRtcpReportInterval);
+  EXPECT_EQ(kTargetPlayoutDelayChange, reported_delay);
+  testing::Mock::VerifyAndClearExpectations(sender());
+}
+
+// Tests that the Receiver provides the decrypted payload of the next frame to
+// be consumed, in order, as its packets arrive.
+TEST_F(ReceiverTest, ProvidesPartialFramesInOrder) {
+  const Clock::time_point start_time = FakeClock::now();
+  ExchangeInitialReportPackets();
+  FakePartialFrameConsumer partial_consumer;
+  receiver()->SetPartialFrameConsumer(&partial_consumer);
+
+  for (int i = 0; i < 2; ++i) {
+    const SimulatedFrame frame(start_time, i);
+    const std::vector<uint8_t> expected_payload(frame.data.begin(),
+                                                frame.data.end());
+    sender()->SetFrameBeingSent(frame);
+    const std::vector<FramePacketId> packet_ids = sender()->GetAllPacketIds(0);
+    ASSERT_LE(3u, packet_ids.size());
+    const int calls_before = partial_consumer.num_calls();
+
+    // Packet 1 cannot be provided until packet 0 arrives.
+    sender()->SendRtpPackets({1});
+    AdvanceClockAndRunTasks(kOneWayNetworkDelay);
+    EXPECT_EQ(calls_before, partial_consumer.num_calls());
+
+    // Now packets 0 and 1 are provided together.
+    sender()->SendRtpPackets({0});
+    AdvanceClockAndRunTasks(kOneWayNetworkDelay);
+    EXPECT_EQ(calls_before + 1, partial_consumer.num_calls());
+    EXPECT_EQ(frame.frame_id, partial_consumer.frame_id());
+    ASSERT_LT(partial_consumer.payload().size(), expected_payload.size());
+    EXPECT_TRUE(std::equal(partial_consumer.payload().begin(),
+                           partial_consumer.payload().end(),
+                           expected_payload.begin()));
+
+    // Then, each of the rest is provided as it arrives.
+    for (size_t j = 2; j < packet_ids.size(); ++j) {
+      sender()->SendRtpPackets({packet_ids[j]});
+      AdvanceClockAndRunTasks(kOneWayNetworkDelay);
+    }
+    EXPECT_EQ(calls_before + static_cast<int>(packet_ids.size()) - 1,
+              partial_consumer.num_calls());
+    EXPECT_EQ(expected_payload, partial_consumer.payload());
+
+    // The complete frame is consumed in the usual way.
+    AdvanceClockAndRunTasks(kRoundTripNetworkDelay);
+    ConsumeAndVerifyFrame(frame);
+  }
+
+  receiver()->SetPartialFrameConsumer(nullptr);
+}
+
+// Tests that the Receiver provides the part of a frame that was received before
+// it became the next frame to be consumed, as soon as the prior frame is
+// consumed.
+TEST_F(ReceiverTest, ProvidesPartialFrameOnceItBecomesNext) {
+  const Clock::time_point start_time = FakeClock::now();
+  ExchangeInitialReportPackets();
+  FakePartialFrameConsumer partial_consumer;
+  receiver()->SetPartialFrameConsumer(&partial_consumer);
+
+  const SimulatedFrame frame0(start_time, 0);
+  sender()->SetFrameBeingSent(frame0);
+  sender()->SendRtpPackets(sender()->GetAllPacketIds(0));
+
+  const SimulatedFrame frame1(start_time, 1);
+  const std::vector<uint8_t> expected_payload(frame1.data.begin(),
+                                              frame1.data.end());
+  sender()->SetFrameBeingSent(frame1);
+  const std::vector<FramePacketId> packet_ids = sender()->GetAllPacketIds(0);
+  ASSERT_LE(2u, packet_ids.size());
+  sender()->SendRtpPackets({0});
+  AdvanceClockAndRunTasks(kRoundTripNetworkDelay);
+
+  // Only frame 0 has been provided so far.
+  EXPECT_EQ(frame0.frame_id, partial_consumer.frame_id());
+
+  // Consuming frame 0 makes frame 1 the next frame, and its first packet is
+  // provided right away.
+  const int calls_before = partial_consumer.num_calls();
+  ConsumeAndVerifyFrame(frame0);
+  EXPECT_EQ(calls_before + 1, partial_consumer.num_calls());
+  EXPECT_EQ(frame1.frame_id, partial_consumer.frame_id());
+  ASSERT_LT(partial_consumer.payload().size(), expected_payload.size());
+  EXPECT_TRUE(std::equal(partial_consumer.payload().begin(),
+                         partial_consumer.payload().end(),
+                         expected_payload.begin()));
+
+  // The rest of frame 1 is provided as it arrives.
+  std::vector<FramePacketId> rest(packet_ids.begin() + 1, packet_ids.end());
+  sender()->SendRtpPackets(rest);
+  AdvanceClockAndRunTasks(kRoundTripNetworkDelay);
+  EXPECT_EQ(expected_payload, partial_consumer.payload());
+  ConsumeAndVerifyFrame(frame1);
+
+  receiver()->SetPartialFrameConsumer(nullptr);
+}
+
+// Tests that the Receiver processes a batch of RTP packets, completing several
+// frames, and coalesces its feedback into one RTCP packet and its notifications
+// into one OnFramesReady() call.
+TEST_F(ReceiverTest, CoalescesFeedbackWhenReceivingBatches) {
+  const Clock::time_point start_time = FakeClock::now();
+  ExchangeInitialReportPackets();
+
+  EXPECT_CALL(*sender(), OnReceiverCheckpoint(_, _)).Times(0);
+  EXPECT_CALL(*sender(),
+              OnReceiverCheckpoint(FrameId::first() + 2, kTargetPlayoutDelay))
+      .Times(1);
+  EXPECT_CALL(*sender(), OnReceiverIsMissingPackets(_)).Times(0);
+  EXPECT_CALL(*consumer(), OnFramesReady(Gt(0))).Times(1);
+  sender()->SendFramesAsOneBatch(start_time, 0, 2);
+  AdvanceClockAndRunTasks(kRoundTripNetworkDelay);
+  testing::Mock::VerifyAndClearExpectations(sender());
+  testing::Mock::VerifyAndClearExpectations(consumer());
+
+  ConsumeAndVerifyFrames(0, 2, start_time);
+  EXPECT_EQ(Receiver::kNoFramesReady, receiver()->AdvanceToNextFrame());
+}
+
 // Tests that the Receiver processes RTP packets, can receive frames out of
 // order, and issues the appropriate ACK/NACK feedback to the Sender as it
 // realizes what it has and what it's missing.
@@ -584,6 +824,53 @@ TEST_F(ReceiverTest, ReceivesFramesOutOfOrder) {
   EXPECT_EQ(Receiver::kNoFramesReady, receiver()->AdvanceToNextFrame());
 }
 
+// Tests that the Receiver's NACK feedback tracks the individual packets still
+// missing from a frame, updating as each re-transmitted packet arrives.
+TEST_F(ReceiverTest, UpdatesNacksAsMissingPacketsArrive) {
+  const Clock::time_point start_time = FakeClock::now();
+  ExchangeInitialReportPackets();
+
+  sender()->SetFrameBeingSent(SimulatedFrame(start_time, 0));
+  std::vector<FramePacketId> packet_ids = sender()->GetAllPacketIds(0);
+  ASSERT_LE(4u, packet_ids.size());
+
+  // Note: Feedback already in-flight when each phase below begins may still
+  // reflect the prior state, and so it is allowed to arrive.
+  EXPECT_CALL(*sender(), OnReceiverIsMissingPackets(_)).Times(AnyNumber());
+
+  // Send all but packets 1 and 2.
+  EXPECT_CALL(*sender(), OnReceiverIsMissingPackets(std::vector<PacketNack>({
+                             PacketNack{FrameId::first(), 1},
+                             PacketNack{FrameId::first(), 2},
+                         })))
+      .Times(AtLeast(1));
+  std::vector<FramePacketId> first_send = packet_ids;
+  first_send.erase(first_send.begin() + 1, first_send.begin() + 3);
+  sender()->SendRtpPackets(first_send);
+  AdvanceClockAndRunTasks(kRtcpReportInterval);
+  testing::Mock::VerifyAndClearExpectations(sender());
+
+  // Re-transmit packet 2. Now, only packet 1 should be NACKed.
+  EXPECT_CALL(*sender(), OnReceiverIsMissingPackets(_)).Times(AnyNumber());
+  EXPECT_CALL(*sender(), OnReceiverIsMissingPackets(std::vector<PacketNack>(
+                             {PacketNack{FrameId::first(), 1}})))
+      .Times(AtLeast(1));
+  sender()->SendRtpPackets({2});
+  AdvanceClockAndRunTasks(kRtcpReportInterval);
+  testing::Mock::VerifyAndClearExpectations(sender());
+
+  // Re-transmit packet 1. The frame is complete, and so it is ACKed.
+  EXPECT_CALL(*sender(),
+              OnReceiverCheckpoint(FrameId::first(), kTargetPlayoutDelay))
+      .Times(AtLeast(1));
+  EXPECT_CALL(*consumer(), OnFramesReady(Gt(0))).Times(1);
+  sender()->SendRtpPackets({1});
+  AdvanceClockAndRunTasks(kRtcpReportInterval);
+  testing::Mock::VerifyAndClearExpectations(sender());
+
+  ConsumeAndVerifyFrames(0, 0, start_time);
+}
+
 // Tests that the Receiver will respond to a key frame request from its client
 // by sending a Picture Loss Indicator (PLI) to the Sender, and then will
 // automatically stop sending the PLI once a key frame has been received.
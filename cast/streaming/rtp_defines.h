@@ -110,8 +110,8 @@ constexpr uint8_t kRtpKeyFrameBitMask = 0b10000000;
 constexpr uint8_t kRtpHasReferenceFrameIdBitMask = 0b01000000;
 constexpr uint8_t kRtpExtensionCountMask = 0b00111111;
 
-// Cast extensions. This implementation supports only the Adaptive Latency
-// extension, and ignores all others:
+// Cast extensions. This implementation supports the Adaptive Latency and FEC
+// Parity extensions, and ignores all others:
 //
 //  0                   1                   2                   3
 //  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -123,6 +123,30 @@ constexpr uint8_t kRtpExtensionCountMask = 0b00111111;
 // delay of a single RTP stream.
 constexpr uint8_t kAdaptiveLatencyRtpExtensionType = 1;
 constexpr int kNumExtensionDataSizeFieldBits = 10;
+//
+//  0                   1                   2                   3
+//  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// |  TYPE = 5 | Ext data SIZE = 4 |   # of Protected Packets (N)  |
+// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+// |  XOR of Protected Payload Sizes|
+// +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//
+// The FEC Parity extension marks a packet as a forward error correction packet
+// rather than one of a frame's data packets. Its payload is the XOR of the
+// payloads of N data packets of the same frame (each zero-padded to the length
+// of the longest), starting at the packet having the PID found in the Cast
+// header. From this, a Receiver can reconstruct any one of those N packets that
+// was lost, without waiting for a re-transmit. All other header fields are the
+// same as those of the frame's data packets, except that the M bit is never
+// set.
+//
+// FEC Parity packets are offered by listing kFecRtpExtensionName in a stream's
+// "rtpExtensions" in the OFFER message, and are only sent for the streams whose
+// send index is listed in the "fecSendIndexes" of the Receiver's ANSWER
+// message. Receivers ignore them for all other streams.
+constexpr uint8_t kFecParityRtpExtensionType = 5;
+constexpr char kFecRtpExtensionName[] = "xor_fec_parity";
 
 // RTCP Common Header:
 //
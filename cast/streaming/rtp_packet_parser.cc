@@ -93,6 +93,19 @@ absl::optional<RtpPacketParser::ParseResult> RtpPacketParser::Parse(
       }
       result.new_playout_delay =
           std::chrono::milliseconds(ReadBigEndian<uint16_t>(buffer.data()));
+    } else if (type == kFecParityRtpExtensionType) {
+      if (size != 2 * sizeof(uint16_t)) {
+        return absl::nullopt;
+      }
+      result.fec_num_protected_packets = ReadBigEndian<uint16_t>(buffer.data());
+      result.fec_payload_size_xor =
+          ReadBigEndian<uint16_t>(buffer.data() + sizeof(uint16_t));
+      // The protected packets must all exist within the frame.
+      if (result.fec_num_protected_packets == 0 ||
+          int{result.packet_id} + result.fec_num_protected_packets >
+              int{result.max_packet_id} + 1) {
+        return absl::nullopt;
+      }
     }
     buffer.remove_prefix(size);
   }
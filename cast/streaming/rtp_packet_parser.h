@@ -42,6 +42,13 @@ class RtpPacketParser {
     FrameId referenced_frame_id;  // ID of frame required to decode this one.
     std::chrono::milliseconds new_playout_delay{};  // Ignore if non-positive.
 
+    // Non-zero only for a FEC Parity packet, whose payload is the XOR of the
+    // payloads of the packets [packet_id,packet_id+fec_num_protected_packets)
+    // of the frame, and |fec_payload_size_xor| is the XOR of their sizes. See
+    // rtp_defines.h.
+    int fec_num_protected_packets = 0;
+    uint16_t fec_payload_size_xor = 0;
+
     // Portion of the |packet| that was passed into Parse() that contains the
     // payload. WARNING: This memory region is only valid while the original
     // |packet| memory remains valid.
@@ -202,6 +202,53 @@ TEST(RtpPacketParserTest, ParsesPacketWithMultipleExtensions) {
   EXPECT_TRUE(expected_payload == result->payload);
 }
 
+// Tests that a FEC Parity packet can be parsed, and that it is rejected if it
+// claims to protect packets that do not exist.
+TEST(RtpPacketParserTest, ParsesFecParityPacket) {
+  // clang-format off
+  const uint8_t kInput[] = {
+    0b10000000,  // Version/Padding byte.
+    96,  // Payload type byte.
+    0xde, 0xad,  // Sequence number.
+    2, 4, 6, 8,  // RTP timestamp.
+    0, 0, 1, 1,  // SSRC.
+    0b01000001,  // Not a key frame, has ref frame ID; has one extension.
+    64,  // Frame ID.
+    0x0, 0x8,  // Packet ID (of the first protected packet).
+    0x0, 0xc,  // Max packet ID.
+    63,  // Reference Frame ID.
+    0x14, 4,  // Cast FEC Parity Extension header.
+    0x0, 0x4,  // Number of protected packets.
+    0x05, 0xa0,  // XOR of the protected payload sizes.
+    1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29  // Payload.
+  };
+  // clang-format on
+  const Ssrc kSenderSsrc = 0x00000101;
+
+  RtpPacketParser parser(kSenderSsrc);
+  const auto result = parser.Parse(kInput);
+  ASSERT_TRUE(result);
+  EXPECT_FALSE(result->is_key_frame);
+  EXPECT_EQ(FrameId::first() + 64, result->frame_id);
+  EXPECT_EQ(FramePacketId{8}, result->packet_id);
+  EXPECT_EQ(FramePacketId{0x000c}, result->max_packet_id);
+  EXPECT_EQ(FrameId::first() + 63, result->referenced_frame_id);
+  EXPECT_EQ(0, result->new_playout_delay.count());
+  EXPECT_EQ(4, result->fec_num_protected_packets);
+  EXPECT_EQ(UINT16_C(0x05a0), result->fec_payload_size_xor);
+  const absl::Span<const uint8_t> expected_payload(kInput + 25, 15);
+  EXPECT_EQ(expected_payload, result->payload);
+
+  // Protecting packets beyond the max packet ID, or no packets at all, is
+  // invalid.
+  uint8_t bad_input[sizeof(kInput)];
+  for (uint16_t num_protected : {0, 6}) {
+    memcpy(bad_input, kInput, sizeof(kInput));
+    WriteBigEndian<uint16_t>(num_protected, &bad_input[21]);
+    EXPECT_FALSE(parser.Parse(bad_input));
+  }
+}
+
 // Tests that the parser ignores packets from an unknown source.
 TEST(RtpPacketParserTest, IgnoresPacketWithWrongSsrc) {
   // clang-format off
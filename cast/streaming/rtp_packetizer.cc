@@ -8,6 +8,7 @@
 #include <limits>
 #include <random>
 
+#include "absl/types/optional.h"
 #include "cast/streaming/packet_util.h"
 #include "platform/api/time.h"
 #include "util/big_endian.h"
@@ -34,17 +35,39 @@ uint16_t GenerateRandomSequenceNumberStart() {
   return std::uniform_int_distribution<uint16_t>()(generator);
 }
 
+// Byte offsets of the packet-specific fields in RtpPacketizer::HeaderTemplate.
+// See rtp_defines.h for wire-format diagram.
+constexpr int kMarkerAndPayloadTypeOffset = 1;
+constexpr int kSequenceNumberOffset = 2;
+constexpr int kCastFlagsOffset = 12;
+constexpr int kPacketIdOffset = 14;
+
+// Appends the Cast Header extension for an Adaptive Latency change. See
+// rtp_defines.h for wire-format diagram.
+void AppendAdaptiveLatencyExtension(std::chrono::milliseconds playout_delay,
+                                    absl::Span<uint8_t>* out) {
+  OSP_DCHECK_LE(playout_delay.count(),
+                int{std::numeric_limits<uint16_t>::max()});
+  AppendField<uint16_t>(
+      (kAdaptiveLatencyRtpExtensionType << kNumExtensionDataSizeFieldBits) |
+          sizeof(uint16_t),
+      out);
+  AppendField<uint16_t>(playout_delay.count(), out);
+}
+
 }  // namespace
 
 RtpPacketizer::RtpPacketizer(RtpPayloadType payload_type,
                              Ssrc sender_ssrc,
-                             int max_packet_size)
+                             int max_packet_size,
+                             bool fec_enabled)
     : payload_type_7bits_(static_cast<uint8_t>(payload_type)),
       sender_ssrc_(sender_ssrc),
       max_packet_size_(max_packet_size),
+      fec_enabled_(fec_enabled),
       sequence_number_(GenerateRandomSequenceNumberStart()) {
   OSP_DCHECK(IsRtpPayloadType(payload_type_7bits_));
-  OSP_DCHECK_GT(max_packet_size_, kMaxRtpHeaderSize);
+  OSP_DCHECK_GT(max_packet_size_, kMaxRtpHeaderSizeWithFec);
 }
 
 RtpPacketizer::~RtpPacketizer() = default;
@@ -52,85 +75,329 @@ RtpPacketizer::~RtpPacketizer() = default;
 absl::Span<uint8_t> RtpPacketizer::GeneratePacket(const EncryptedFrame& frame,
                                                   FramePacketId packet_id,
                                                   absl::Span<uint8_t> buffer) {
+  return GeneratePacketInternal(frame, frame.data, nullptr, packet_id, buffer);
+}
+
+int RtpPacketizer::GeneratePackets(
+    const EncryptedFrame& frame,
+    absl::Span<const FramePacketId> packet_ids,
+    absl::Span<uint8_t> buffer,
+    std::vector<absl::Span<const uint8_t>>* packets) {
+  return GeneratePacketsInternal(frame, frame.data, nullptr, packet_ids, buffer,
+                                 packets);
+}
+
+absl::Span<uint8_t> RtpPacketizer::GeneratePacket(
+    const EncodedFrame& frame_metadata,
+    absl::Span<const uint8_t> plaintext,
+    const FrameCrypto& crypto,
+    FramePacketId packet_id,
+    absl::Span<uint8_t> buffer) {
+  return GeneratePacketInternal(frame_metadata, plaintext, &crypto, packet_id,
+                                buffer);
+}
+
+int RtpPacketizer::GeneratePackets(
+    const EncodedFrame& frame_metadata,
+    absl::Span<const uint8_t> plaintext,
+    const FrameCrypto& crypto,
+    absl::Span<const FramePacketId> packet_ids,
+    absl::Span<uint8_t> buffer,
+    std::vector<absl::Span<const uint8_t>>* packets) {
+  return GeneratePacketsInternal(frame_metadata, plaintext, &crypto,
+                                 packet_ids, buffer, packets);
+}
+
+absl::Span<uint8_t> RtpPacketizer::GenerateParityPacket(
+    const EncryptedFrame& frame,
+    FramePacketId first_packet_id,
+    int num_protected,
+    absl::Span<uint8_t> buffer) {
+  return GenerateParityPacketInternal(frame, frame.data, nullptr,
+                                      first_packet_id, num_protected, buffer);
+}
+
+absl::Span<uint8_t> RtpPacketizer::GenerateParityPacket(
+    const EncodedFrame& frame_metadata,
+    absl::Span<const uint8_t> plaintext,
+    const FrameCrypto& crypto,
+    FramePacketId first_packet_id,
+    int num_protected,
+    absl::Span<uint8_t> buffer) {
+  return GenerateParityPacketInternal(frame_metadata, plaintext, &crypto,
+                                      first_packet_id, num_protected, buffer);
+}
+
+int RtpPacketizer::ComputeNumberOfPackets(size_t payload_size) const {
+  // The total number of packets is computed by assuming the payload will be
+  // split-up across as few packets as possible.
+  if (payload_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    return -1;
+  }
+  int num_packets = DividePositivesRoundingUp(static_cast<int>(payload_size),
+                                              max_payload_size());
+  // Edge case: There must always be at least one packet, even when there are no
+  // payload bytes. Some audio codecs, for example, use zero bytes to represent
+  // a period of silence.
+  num_packets = std::max(1, num_packets);
+
+  // Ensure that the entire range of FramePacketIds can be represented.
+  return num_packets <= int{kMaxAllowedFramePacketId} ? num_packets : -1;
+}
+
+absl::Span<uint8_t> RtpPacketizer::GeneratePacketInternal(
+    const EncodedFrame& frame,
+    absl::Span<const uint8_t> payload,
+    const FrameCrypto* crypto,
+    FramePacketId packet_id,
+    absl::Span<uint8_t> buffer) {
   OSP_CHECK_GE(static_cast<int>(buffer.size()), max_packet_size_);
 
-  const int num_packets = ComputeNumberOfPackets(frame);
+  const int num_packets = ComputeNumberOfPackets(payload.size());
   OSP_DCHECK_GT(num_packets, 0);
-  OSP_DCHECK_LT(int{packet_id}, num_packets);
-  const bool is_last_packet = int{packet_id} == (num_packets - 1);
+  HeaderTemplate header;
+  PopulateHeaderTemplate(frame, num_packets, &header);
+  const absl::Span<uint8_t> packet = buffer.subspan(
+      0, ComputePacketSize(frame, static_cast<int>(payload.size()),
+                           num_packets, packet_id));
+  const absl::Span<uint8_t> packet_payload =
+      WritePacketHeaders(frame, num_packets, packet_id, header, packet);
 
-  // Compute the size of this packet, which is the number of bytes of header
-  // plus the number of bytes of payload. Note that the optional Adaptive
-  // Latency information is only added to the first packet.
-  int packet_size = kBaseRtpHeaderSize;
+  const int data_chunk_start = max_payload_size() * int{packet_id};
+  const absl::Span<const uint8_t> data_chunk =
+      payload.subspan(data_chunk_start, packet_payload.size());
+  OSP_DCHECK_EQ(data_chunk.size(), packet_payload.size());
+  if (crypto) {
+    crypto->StartFrame(frame.frame_id, data_chunk_start)
+        .Process(data_chunk, packet_payload);
+  } else if (!data_chunk.empty()) {
+    memcpy(packet_payload.data(), data_chunk.data(), data_chunk.size());
+  }
+  return packet;
+}
+
+int RtpPacketizer::GeneratePacketsInternal(
+    const EncodedFrame& frame,
+    absl::Span<const uint8_t> payload,
+    const FrameCrypto* crypto,
+    absl::Span<const FramePacketId> packet_ids,
+    absl::Span<uint8_t> buffer,
+    std::vector<absl::Span<const uint8_t>>* packets) {
+  OSP_DCHECK(packets);
+
+  const int payload_size = static_cast<int>(payload.size());
+  const int num_packets = ComputeNumberOfPackets(payload.size());
+  OSP_DCHECK_GT(num_packets, 0);
+  HeaderTemplate header;
+  PopulateHeaderTemplate(frame, num_packets, &header);
+
+  // When encrypting, a new StreamCipher is only started if the packets' payload
+  // slices are not contiguous (e.g., for re-transmits of a few packets).
+  absl::optional<FrameCrypto::StreamCipher> cipher;
+  int cipher_position = -1;
+
+  int num_generated = 0;
+  for (FramePacketId packet_id : packet_ids) {
+    const int packet_size =
+        ComputePacketSize(frame, payload_size, num_packets, packet_id);
+    if (static_cast<int>(buffer.size()) < packet_size) {
+      break;
+    }
+    const absl::Span<uint8_t> packet = buffer.subspan(0, packet_size);
+    const absl::Span<uint8_t> packet_payload =
+        WritePacketHeaders(frame, num_packets, packet_id, header, packet);
+
+    // Copy (or encrypt) the payload data into the packet.
+    const int data_chunk_start = max_payload_size() * int{packet_id};
+    const absl::Span<const uint8_t> data_chunk =
+        payload.subspan(data_chunk_start, packet_payload.size());
+    OSP_DCHECK_EQ(data_chunk.size(), packet_payload.size());
+    if (crypto) {
+      if (!cipher || cipher_position != data_chunk_start) {
+        cipher.emplace(crypto->StartFrame(frame.frame_id, data_chunk_start));
+      }
+      cipher->Process(data_chunk, packet_payload);
+      cipher_position = data_chunk_start + static_cast<int>(data_chunk.size());
+    } else if (!data_chunk.empty()) {
+      memcpy(packet_payload.data(), data_chunk.data(), data_chunk.size());
+    }
+
+    packets->push_back(packet);
+    buffer.remove_prefix(packet_size);
+    ++num_generated;
+  }
+  return num_generated;
+}
+
+absl::Span<uint8_t> RtpPacketizer::GenerateParityPacketInternal(
+    const EncodedFrame& frame,
+    absl::Span<const uint8_t> payload,
+    const FrameCrypto* crypto,
+    FramePacketId first_packet_id,
+    int num_protected,
+    absl::Span<uint8_t> buffer) {
+  OSP_DCHECK(fec_enabled_);
+  OSP_CHECK_GE(static_cast<int>(buffer.size()), max_packet_size_);
+  const int num_packets = ComputeNumberOfPackets(payload.size());
+  OSP_DCHECK_GT(num_protected, 0);
+  OSP_DCHECK_LE(int{first_packet_id} + num_protected, num_packets);
+
+  // The protected packets' payloads are contiguous in the frame's payload. All
+  // but the frame's last packet have the maximum payload size.
+  const int protected_start = max_payload_size() * int{first_packet_id};
+  const int protected_end =
+      std::min(static_cast<int>(payload.size()),
+               protected_start + max_payload_size() * num_protected);
+  const int parity_size =
+      std::min(max_payload_size(), protected_end - protected_start);
+  uint16_t payload_size_xor = 0;
+  for (int start = protected_start; start < protected_end;
+       start += max_payload_size()) {
+    payload_size_xor ^= static_cast<uint16_t>(
+        std::min(max_payload_size(), protected_end - start));
+  }
+
+  // Write the headers: The same as for the data packets, except the packet ID
+  // field identifies the first protected packet, the marker bit is never set,
+  // and the FEC Parity extension is added. The parity for the first packet
+  // also carries any Adaptive Latency change, since it may be used to recover
+  // the first packet.
+  HeaderTemplate header;
+  PopulateHeaderTemplate(frame, num_packets, &header);
   const bool include_adaptive_latency_change =
-      (packet_id == 0 &&
+      (first_packet_id == 0 &&
        frame.new_playout_delay > std::chrono::milliseconds(0));
+  const int packet_size =
+      kBaseRtpHeaderSize +
+      (include_adaptive_latency_change ? kAdaptiveLatencyHeaderSize : 0) +
+      kFecParityHeaderSize + parity_size;
+  OSP_DCHECK_LE(packet_size, max_packet_size_);
+  const absl::Span<uint8_t> packet = buffer.subspan(0, packet_size);
+  uint8_t* const packet_start = packet.data();
+  memcpy(packet_start, header.data(), header.size());
+  WriteBigEndian<uint16_t>(sequence_number_++,
+                           packet_start + kSequenceNumberOffset);
+  packet_start[kCastFlagsOffset] |= include_adaptive_latency_change ? 2 : 1;
+  WriteBigEndian<uint16_t>(first_packet_id, packet_start + kPacketIdOffset);
+  absl::Span<uint8_t> remaining = packet.subspan(header.size());
   if (include_adaptive_latency_change) {
-    OSP_DCHECK_LE(frame.new_playout_delay.count(),
-                  int{std::numeric_limits<uint16_t>::max()});
-    packet_size += kAdaptiveLatencyHeaderSize;
+    AppendAdaptiveLatencyExtension(frame.new_playout_delay, &remaining);
   }
-  int data_chunk_size = max_payload_size();
-  const int data_chunk_start = data_chunk_size * int{packet_id};
-  if (is_last_packet) {
-    data_chunk_size = static_cast<int>(frame.data.size()) - data_chunk_start;
+  AppendField<uint16_t>(
+      (kFecParityRtpExtensionType << kNumExtensionDataSizeFieldBits) |
+          (2 * sizeof(uint16_t)),
+      &remaining);
+  AppendField<uint16_t>(static_cast<uint16_t>(num_protected), &remaining);
+  AppendField<uint16_t>(payload_size_xor, &remaining);
+  OSP_DCHECK_EQ(static_cast<int>(remaining.size()), parity_size);
+
+  // XOR the protected payloads together. When encrypting, each chunk of the
+  // ciphertext is produced in the scratch buffer first.
+  std::fill(remaining.begin(), remaining.end(), uint8_t{0});
+  absl::optional<FrameCrypto::StreamCipher> cipher;
+  if (crypto) {
+    cipher.emplace(crypto->StartFrame(frame.frame_id, protected_start));
+    parity_scratch_.resize(max_payload_size());
   }
-  packet_size += data_chunk_size;
-  OSP_DCHECK_LE(packet_size, max_packet_size_);
-  const absl::Span<uint8_t> packet(buffer.data(), packet_size);
+  for (int start = protected_start; start < protected_end;
+       start += max_payload_size()) {
+    absl::Span<const uint8_t> chunk = payload.subspan(
+        start, std::min(max_payload_size(), protected_end - start));
+    if (cipher) {
+      const absl::Span<uint8_t> encrypted =
+          absl::Span<uint8_t>(parity_scratch_).subspan(0, chunk.size());
+      cipher->Process(chunk, encrypted);
+      chunk = encrypted;
+    }
+    XorInto(chunk, remaining);
+  }
+
+  return packet;
+}
+
+void RtpPacketizer::PopulateHeaderTemplate(const EncodedFrame& frame,
+                                           int num_packets,
+                                           HeaderTemplate* header) const {
+  absl::Span<uint8_t> buffer(*header);
 
-  // RTP Header.
+  // RTP Header. The marker bit and sequence number are filled-in per-packet.
   AppendField<uint8_t>(kRtpRequiredFirstByte, &buffer);
-  AppendField<uint8_t>(
-      (is_last_packet ? kRtpMarkerBitMask : 0) | payload_type_7bits_, &buffer);
-  AppendField<uint16_t>(sequence_number_++, &buffer);
+  AppendField<uint8_t>(payload_type_7bits_, &buffer);
+  AppendField<uint16_t>(0, &buffer);
   AppendField<uint32_t>(frame.rtp_timestamp.lower_32_bits(), &buffer);
   AppendField<uint32_t>(sender_ssrc_, &buffer);
 
-  // Cast Header.
+  // Cast Header. The extension count and packet ID are filled-in per-packet.
   AppendField<uint8_t>(
       ((frame.dependency == EncodedFrame::KEY_FRAME) ? kRtpKeyFrameBitMask
                                                      : 0) |
-          kRtpHasReferenceFrameIdBitMask |
-          (include_adaptive_latency_change ? 1 : 0),
+          kRtpHasReferenceFrameIdBitMask,
       &buffer);
   AppendField<uint8_t>(frame.frame_id.lower_8_bits(), &buffer);
-  AppendField<uint16_t>(packet_id, &buffer);
+  AppendField<uint16_t>(0, &buffer);
   AppendField<uint16_t>(num_packets - 1, &buffer);
   AppendField<uint8_t>(frame.referenced_frame_id.lower_8_bits(), &buffer);
 
-  // Extension of Cast Header for Adaptive Latency change.
-  if (include_adaptive_latency_change) {
-    AppendField<uint16_t>(
-        (kAdaptiveLatencyRtpExtensionType << kNumExtensionDataSizeFieldBits) |
-            sizeof(uint16_t),
-        &buffer);
-    AppendField<uint16_t>(frame.new_playout_delay.count(), &buffer);
-  }
-
-  // Sanity-check the pointer math, to ensure the packet is being entirely
-  // populated, with no underrun or overrun.
-  OSP_DCHECK_EQ(buffer.data() + data_chunk_size, packet.end());
+  OSP_DCHECK(buffer.empty());
+}
 
-  // Copy the encrypted payload data into the packet.
-  memcpy(buffer.data(), frame.data.data() + data_chunk_start, data_chunk_size);
+int RtpPacketizer::ComputePacketSize(const EncodedFrame& frame,
+                                     int payload_size,
+                                     int num_packets,
+                                     FramePacketId packet_id) const {
+  OSP_DCHECK_LT(int{packet_id}, num_packets);
 
-  return packet;
+  // The packet size is the number of bytes of header plus the number of bytes
+  // of payload. Note that the optional Adaptive Latency information is only
+  // added to the first packet.
+  int packet_size = kBaseRtpHeaderSize;
+  if (packet_id == 0 &&
+      frame.new_playout_delay > std::chrono::milliseconds(0)) {
+    packet_size += kAdaptiveLatencyHeaderSize;
+  }
+  const int data_chunk_start = max_payload_size() * int{packet_id};
+  if (int{packet_id} == (num_packets - 1)) {
+    packet_size += payload_size - data_chunk_start;
+  } else {
+    packet_size += max_payload_size();
+  }
+  OSP_DCHECK_LE(packet_size, max_packet_size_);
+  return packet_size;
 }
 
-int RtpPacketizer::ComputeNumberOfPackets(const EncryptedFrame& frame) const {
-  // The total number of packets is computed by assuming the payload will be
-  // split-up across as few packets as possible.
-  int num_packets = DividePositivesRoundingUp(
-      static_cast<int>(frame.data.size()), max_payload_size());
-  // Edge case: There must always be at least one packet, even when there are no
-  // payload bytes. Some audio codecs, for example, use zero bytes to represent
-  // a period of silence.
-  num_packets = std::max(1, num_packets);
+absl::Span<uint8_t> RtpPacketizer::WritePacketHeaders(
+    const EncodedFrame& frame,
+    int num_packets,
+    FramePacketId packet_id,
+    const HeaderTemplate& header,
+    absl::Span<uint8_t> packet) {
+  OSP_DCHECK_LT(int{packet_id}, num_packets);
+  const bool is_last_packet = int{packet_id} == (num_packets - 1);
+  const bool include_adaptive_latency_change =
+      (packet_id == 0 &&
+       frame.new_playout_delay > std::chrono::milliseconds(0));
 
-  // Ensure that the entire range of FramePacketIds can be represented.
-  return num_packets <= int{kMaxAllowedFramePacketId} ? num_packets : -1;
+  // Copy the common header fields, and then overwrite the ones specific to
+  // this packet.
+  uint8_t* const packet_start = packet.data();
+  memcpy(packet_start, header.data(), header.size());
+  if (is_last_packet) {
+    packet_start[kMarkerAndPayloadTypeOffset] |= kRtpMarkerBitMask;
+  }
+  WriteBigEndian<uint16_t>(sequence_number_++,
+                           packet_start + kSequenceNumberOffset);
+  if (include_adaptive_latency_change) {
+    packet_start[kCastFlagsOffset] |= 1;  // One header extension.
+  }
+  WriteBigEndian<uint16_t>(packet_id, packet_start + kPacketIdOffset);
+  packet.remove_prefix(header.size());
+
+  // Extension of Cast Header for Adaptive Latency change.
+  if (include_adaptive_latency_change) {
+    AppendAdaptiveLatencyExtension(frame.new_playout_delay, &packet);
+  }
+
+  return packet;
 }
 
 }  // namespace cast
@@ -7,6 +7,9 @@
 
 #include <stdint.h>
 
+#include <array>
+#include <vector>
+
 #include "absl/types/span.h"
 #include "cast/streaming/frame_crypto.h"
 #include "cast/streaming/rtp_defines.h"
@@ -26,12 +29,20 @@ class RtpPacketizer {
   // The |max_packet_size| argument depends on the optimal over-the-wire size of
   // packets for the network medium being used. See discussion in rtp_defines.h
   // for further info.
+  //
+  // If |fec_enabled|, space is reserved in every packet for the FEC Parity
+  // header extension, so that GenerateParityPacket() may be used. This should
+  // only be set if the Receiver supports FEC (see rtp_defines.h).
   RtpPacketizer(RtpPayloadType payload_type,
                 Ssrc sender_ssrc,
-                int max_packet_size);
+                int max_packet_size,
+                bool fec_enabled = false);
 
   ~RtpPacketizer();
 
+  int max_packet_size() const { return max_packet_size_; }
+  bool fec_enabled() const { return fec_enabled_; }
+
   // Wire-format one of the RTP packets for the given frame, which must only be
   // transmitted once. This method should be called in the same sequence that
   // packets will be transmitted. This also means that, if a packet needs to be
@@ -42,10 +53,60 @@ class RtpPacketizer {
                                      FramePacketId packet_id,
                                      absl::Span<uint8_t> buffer);
 
+  // Like GeneratePacket(), but wire-formats the packets for each of the given
+  // |packet_ids| of the same |frame|, in order, back-to-back in |buffer|. The
+  // header fields common to all of the frame's packets are only computed once.
+  // Appends the packets to |packets|, and returns the number generated. This is
+  // less than |packet_ids.size()| only if |buffer| runs out of space.
+  int GeneratePackets(const EncryptedFrame& frame,
+                      absl::Span<const FramePacketId> packet_ids,
+                      absl::Span<uint8_t> buffer,
+                      std::vector<absl::Span<const uint8_t>>* packets);
+
+  // Same as the above, but for a frame whose payload has not been encrypted
+  // yet: Each packet's slice of the |plaintext| payload is encrypted by
+  // |crypto| directly into the packet. |frame_metadata| provides the frame ID
+  // and all other metadata, and its |data| member is ignored.
+  absl::Span<uint8_t> GeneratePacket(const EncodedFrame& frame_metadata,
+                                     absl::Span<const uint8_t> plaintext,
+                                     const FrameCrypto& crypto,
+                                     FramePacketId packet_id,
+                                     absl::Span<uint8_t> buffer);
+  int GeneratePackets(const EncodedFrame& frame_metadata,
+                      absl::Span<const uint8_t> plaintext,
+                      const FrameCrypto& crypto,
+                      absl::Span<const FramePacketId> packet_ids,
+                      absl::Span<uint8_t> buffer,
+                      std::vector<absl::Span<const uint8_t>>* packets);
+
+  // Wire-formats a FEC Parity packet for the given |frame|, whose payload is
+  // the XOR of the payloads of the |num_protected| packets starting at
+  // |first_packet_id| (see rtp_defines.h). Like the data packets, this must
+  // only be transmitted once. Returns the subspan of |buffer| that contains the
+  // packet. Requires |fec_enabled| to have been passed to the constructor.
+  absl::Span<uint8_t> GenerateParityPacket(const EncryptedFrame& frame,
+                                           FramePacketId first_packet_id,
+                                           int num_protected,
+                                           absl::Span<uint8_t> buffer);
+
+  // Same as the above, but for a frame whose payload has not been encrypted
+  // yet. See the similar GeneratePacket() overload.
+  absl::Span<uint8_t> GenerateParityPacket(const EncodedFrame& frame_metadata,
+                                           absl::Span<const uint8_t> plaintext,
+                                           const FrameCrypto& crypto,
+                                           FramePacketId first_packet_id,
+                                           int num_protected,
+                                           absl::Span<uint8_t> buffer);
+
   // Given |frame|, compute the total number of packets over which the whole
   // frame will be split-up. Returns -1 if the frame is too large and cannot be
   // packetized.
-  int ComputeNumberOfPackets(const EncryptedFrame& frame) const;
+  int ComputeNumberOfPackets(const EncryptedFrame& frame) const {
+    return ComputeNumberOfPackets(frame.data.size());
+  }
+
+  // Same as the above, but given just the size of the frame's payload.
+  int ComputeNumberOfPackets(size_t payload_size) const;
 
   // See rtp_defines.h for wire-format diagram.
   static constexpr int kBaseRtpHeaderSize =
@@ -55,12 +116,66 @@ class RtpPacketizer {
   static constexpr int kAdaptiveLatencyHeaderSize = 4;
   static constexpr int kMaxRtpHeaderSize =
       kBaseRtpHeaderSize + kAdaptiveLatencyHeaderSize;
+  static constexpr int kFecParityHeaderSize = 6;
+  static constexpr int kMaxRtpHeaderSizeWithFec =
+      kMaxRtpHeaderSize + kFecParityHeaderSize;
 
  private:
+  // The RTP and Cast headers of one of a frame's packets, minus the optional
+  // Adaptive Latency extension. Only a few of these fields vary between the
+  // packets of the same frame (see WritePacketHeaders()).
+  using HeaderTemplate = std::array<uint8_t, kBaseRtpHeaderSize>;
+
+  // Implement both variants of GeneratePacket() and GeneratePackets(). If
+  // |crypto| is null, the |payload| is already encrypted.
+  absl::Span<uint8_t> GeneratePacketInternal(const EncodedFrame& frame,
+                                             absl::Span<const uint8_t> payload,
+                                             const FrameCrypto* crypto,
+                                             FramePacketId packet_id,
+                                             absl::Span<uint8_t> buffer);
+  int GeneratePacketsInternal(const EncodedFrame& frame,
+                              absl::Span<const uint8_t> payload,
+                              const FrameCrypto* crypto,
+                              absl::Span<const FramePacketId> packet_ids,
+                              absl::Span<uint8_t> buffer,
+                              std::vector<absl::Span<const uint8_t>>* packets);
+
+  // Implements both variants of GenerateParityPacket(). If |crypto| is null,
+  // the |payload| is already encrypted.
+  absl::Span<uint8_t> GenerateParityPacketInternal(
+      const EncodedFrame& frame,
+      absl::Span<const uint8_t> payload,
+      const FrameCrypto* crypto,
+      FramePacketId first_packet_id,
+      int num_protected,
+      absl::Span<uint8_t> buffer);
+
+  // Populates |header| with the fields common to all the packets of |frame|.
+  void PopulateHeaderTemplate(const EncodedFrame& frame,
+                              int num_packets,
+                              HeaderTemplate* header) const;
+
+  // Returns the size of the given packet of a frame.
+  int ComputePacketSize(const EncodedFrame& frame,
+                        int payload_size,
+                        int num_packets,
+                        FramePacketId packet_id) const;
+
+  // Wire-formats the headers for one packet of |frame| into the front of
+  // |packet|, by copying |header| and then filling-in the packet-specific
+  // fields. |packet| must be exactly the size returned by ComputePacketSize().
+  // Returns the remaining part of |packet|, for the payload.
+  absl::Span<uint8_t> WritePacketHeaders(const EncodedFrame& frame,
+                                         int num_packets,
+                                         FramePacketId packet_id,
+                                         const HeaderTemplate& header,
+                                         absl::Span<uint8_t> packet);
+
   int max_payload_size() const {
     // Start with the configured max packet size, then subtract reserved space
     // for packet header fields. The rest can be allocated to the payload.
-    return max_packet_size_ - kMaxRtpHeaderSize;
+    return max_packet_size_ -
+           (fec_enabled_ ? kMaxRtpHeaderSizeWithFec : kMaxRtpHeaderSize);
   }
 
   // The validated ctor RtpPayloadType arg, in wire-format form.
@@ -68,8 +183,13 @@ class RtpPacketizer {
 
   const Ssrc sender_ssrc_;
   const int max_packet_size_;
+  const bool fec_enabled_;
+
+  // Scratch space used by GenerateParityPacket(), to hold the encrypted
+  // payload of each protected packet while it is XOR'ed into the parity.
+  std::vector<uint8_t> parity_scratch_;
 
-  // Incremented each time GeneratePacket() is called. Every packet, even those
+  // Incremented each time a packet is generated. Every packet, even those
   // re-transmitted, must have different sequence numbers (within wrap-around
   // concerns) per the RTP spec.
   uint16_t sequence_number_;
@@ -4,8 +4,12 @@
 
 #include "cast/streaming/rtp_packetizer.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "absl/types/optional.h"
 #include "cast/streaming/frame_crypto.h"
+#include "cast/streaming/packet_util.h"
 #include "cast/streaming/rtp_defines.h"
 #include "cast/streaming/rtp_packet_parser.h"
 #include "cast/streaming/ssrc.h"
@@ -31,6 +35,7 @@ class RtpPacketizerTest : public testing::Test {
   ~RtpPacketizerTest() = default;
 
   RtpPacketizer* packetizer() { return &packetizer_; }
+  const FrameCrypto& crypto() const { return crypto_; }
 
   EncryptedFrame CreateFrame(FrameId frame_id,
                              bool is_key_frame,
@@ -54,11 +59,22 @@ class RtpPacketizerTest : public testing::Test {
     return crypto_.Encrypt(frame);
   }
 
-  // Generates one of the frame's packets, then parses it and checks for the
-  // expected values. Thus, this test assumes PacketParser is already working
-  // (i.e., all RtpPacketParser unit tests are passing).
+  // Generates one of the frame's packets, then checks it with CheckPacket().
   void TestGeneratePacket(const EncryptedFrame& frame,
                           FramePacketId packet_id) {
+    uint8_t scratch[kMaxRtpPacketSizeForIpv4UdpOnEthernet];
+    memset(scratch, 0, sizeof(scratch));
+    const auto packet = packetizer_.GeneratePacket(frame, packet_id, scratch);
+    ASSERT_TRUE(IsSubspan(packet, scratch));
+    CheckPacket(frame, packet_id, packet);
+  }
+
+  // Parses one of the frame's packets and checks for the expected values. Thus,
+  // this test assumes PacketParser is already working (i.e., all
+  // RtpPacketParser unit tests are passing).
+  void CheckPacket(const EncryptedFrame& frame,
+                   FramePacketId packet_id,
+                   absl::Span<const uint8_t> packet) {
     SCOPED_TRACE(testing::Message() << "packet_id=" << packet_id);
 
     const int frame_payload_size = frame.data.size();
@@ -69,12 +85,6 @@ class RtpPacketizerTest : public testing::Test {
         frame_payload_size % packet_payload_size;
     const int num_packets = 1 + frame_payload_size / packet_payload_size;
 
-    // Generate a RTP packet and parse it.
-    uint8_t scratch[kMaxRtpPacketSizeForIpv4UdpOnEthernet];
-    memset(scratch, 0, sizeof(scratch));
-    const auto packet = packetizer_.GeneratePacket(frame, packet_id, scratch);
-    ASSERT_TRUE(IsSubspan(packet, scratch));
-
     const auto result = parser_.Parse(packet);
     ASSERT_TRUE(result);
 
@@ -129,7 +139,7 @@ class RtpPacketizerTest : public testing::Test {
   RtpPacketParser parser_{ssrc_};
 
   // absl::nullopt until the random starting sequence number, from the first
-  // packet generated by TestGeneratePacket(), is known.
+  // packet checked by CheckPacket(), is known.
   absl::optional<uint16_t> last_sequence_number_;
 };
 
@@ -202,6 +212,158 @@ TEST_F(RtpPacketizerTest, GeneratesPacketForRetransmission) {
   }
 }
 
+// Tests that several packets of the same frame, in any order, are generated
+// back-to-back into one buffer, and that generation stops once the buffer runs
+// out of space.
+TEST_F(RtpPacketizerTest, GeneratesSeveralPacketsAtOnce) {
+  const int frame_payload_size = 38383;
+  const EncryptedFrame frame =
+      CreateFrame(FrameId::first() + 42, true, std::chrono::milliseconds(543),
+                  frame_payload_size);
+  ASSERT_EQ(27, packetizer()->ComputeNumberOfPackets(frame));
+
+  // Generate the last packet (which is smaller), the first packet (which has
+  // the Adaptive Latency extension), and two in the middle; plus one that won't
+  // fit in the buffer.
+  const std::vector<FramePacketId> packet_ids = {26, 0, 5, 6, 7};
+  std::vector<uint8_t> buffer(4 * kMaxRtpPacketSizeForIpv4UdpOnEthernet);
+  std::vector<absl::Span<const uint8_t>> packets;
+  ASSERT_EQ(4, packetizer()->GeneratePackets(frame, packet_ids,
+                                             absl::Span<uint8_t>(buffer),
+                                             &packets));
+  ASSERT_EQ(4u, packets.size());
+
+  const uint8_t* expected_packet_start = buffer.data();
+  for (size_t i = 0; i < packets.size(); ++i) {
+    EXPECT_EQ(expected_packet_start, packets[i].data());
+    expected_packet_start += packets[i].size();
+    CheckPacket(frame, packet_ids[i], packets[i]);
+  }
+  EXPECT_LE(expected_packet_start, buffer.data() + buffer.size());
+}
+
+// Tests that packets generated from a frame's plaintext payload, encrypting
+// each packet's slice of it on-the-fly, are exactly the same as those generated
+// from the frame after it was encrypted in whole.
+TEST_F(RtpPacketizerTest, EncryptsPayloadWhileGeneratingPackets) {
+  const int frame_payload_size = 12345;
+  const EncryptedFrame frame =
+      CreateFrame(FrameId::first() + 3, false, std::chrono::milliseconds(0),
+                  frame_payload_size);
+  // The same plaintext CreateFrame() encrypted.
+  std::vector<uint8_t> plaintext(frame_payload_size);
+  for (int i = 0; i < frame_payload_size; ++i) {
+    plaintext[i] = static_cast<uint8_t>(i);
+  }
+  ASSERT_EQ(9, packetizer()->ComputeNumberOfPackets(plaintext.size()));
+
+  // Some packets are contiguous and some are not, and the last one is smaller.
+  const std::vector<FramePacketId> packet_ids = {0, 1, 2, 5, 8, 3, 4};
+  std::vector<uint8_t> buffer(packet_ids.size() *
+                              kMaxRtpPacketSizeForIpv4UdpOnEthernet);
+  std::vector<absl::Span<const uint8_t>> packets;
+  ASSERT_EQ(static_cast<int>(packet_ids.size()),
+            packetizer()->GeneratePackets(frame, plaintext, crypto(),
+                                          packet_ids,
+                                          absl::Span<uint8_t>(buffer),
+                                          &packets));
+  for (size_t i = 0; i < packets.size(); ++i) {
+    CheckPacket(frame, packet_ids[i], packets[i]);
+  }
+
+  uint8_t scratch[kMaxRtpPacketSizeForIpv4UdpOnEthernet];
+  for (FramePacketId packet_id : {7, 0}) {
+    const auto packet = packetizer()->GeneratePacket(frame, plaintext,
+                                                     crypto(), packet_id,
+                                                     scratch);
+    ASSERT_TRUE(IsSubspan(packet, scratch));
+    CheckPacket(frame, packet_id, packet);
+  }
+}
+
+// Tests that, when FEC is enabled, FEC Parity packets are generated whose
+// payloads are the XOR of the protected packets' payloads, whether or not the
+// frame's payload was encrypted beforehand.
+TEST_F(RtpPacketizerTest, GeneratesFecParityPackets) {
+  const Ssrc ssrc = GenerateSsrc(true);
+  RtpPacketizer packetizer(kPayloadType, ssrc,
+                           kMaxRtpPacketSizeForIpv4UdpOnEthernet, true);
+  RtpPacketParser parser(ssrc);
+  ASSERT_TRUE(packetizer.fec_enabled());
+
+  const int frame_payload_size = 12345;
+  const EncryptedFrame frame =
+      CreateFrame(FrameId::first() + 3, true, std::chrono::milliseconds(543),
+                  frame_payload_size);
+  std::vector<uint8_t> plaintext(frame_payload_size);
+  for (int i = 0; i < frame_payload_size; ++i) {
+    plaintext[i] = static_cast<uint8_t>(i);
+  }
+  // Space is reserved for the FEC Parity header in every packet.
+  const int num_packets = packetizer.ComputeNumberOfPackets(frame);
+  ASSERT_EQ(9, num_packets);
+
+  // Generate and parse all the data packets.
+  std::vector<std::vector<uint8_t>> payloads;
+  uint8_t scratch[kMaxRtpPacketSizeForIpv4UdpOnEthernet];
+  for (int i = 0; i < num_packets; ++i) {
+    const auto packet = packetizer.GeneratePacket(
+        frame, static_cast<FramePacketId>(i), scratch);
+    const auto result = parser.Parse(packet);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(0, result->fec_num_protected_packets);
+    payloads.emplace_back(result->payload.begin(), result->payload.end());
+  }
+
+  // Generate a Parity packet for each group of 4 packets. The last "group" is
+  // just the last packet, which is smaller.
+  constexpr int kGroupSize = 4;
+  for (int first = 0; first < num_packets; first += kGroupSize) {
+    SCOPED_TRACE(testing::Message() << "first=" << first);
+    const int num_protected = std::min(kGroupSize, num_packets - first);
+
+    std::vector<uint8_t> expected_payload;
+    uint16_t expected_size_xor = 0;
+    for (int i = first; i < first + num_protected; ++i) {
+      const std::vector<uint8_t>& payload = payloads[i];
+      expected_payload.resize(std::max(expected_payload.size(),
+                                       payload.size()));
+      XorInto(payload, absl::Span<uint8_t>(expected_payload));
+      expected_size_xor ^= static_cast<uint16_t>(payload.size());
+    }
+
+    for (bool encrypt_while_packetizing : {false, true}) {
+      const auto packet =
+          encrypt_while_packetizing
+              ? packetizer.GenerateParityPacket(
+                    frame, plaintext, crypto(),
+                    static_cast<FramePacketId>(first), num_protected, scratch)
+              : packetizer.GenerateParityPacket(
+                    frame, static_cast<FramePacketId>(first), num_protected,
+                    scratch);
+      ASSERT_TRUE(IsSubspan(packet, scratch));
+      ASSERT_LE(static_cast<int>(packet.size()), packetizer.max_packet_size());
+      EXPECT_EQ(0, packet[1] & kRtpMarkerBitMask);
+
+      const auto result = parser.Parse(packet);
+      ASSERT_TRUE(result);
+      EXPECT_EQ(frame.frame_id, result->frame_id);
+      EXPECT_TRUE(result->is_key_frame);
+      EXPECT_EQ(static_cast<FramePacketId>(first), result->packet_id);
+      EXPECT_EQ(static_cast<FramePacketId>(num_packets - 1),
+                result->max_packet_id);
+      EXPECT_EQ(num_protected, result->fec_num_protected_packets);
+      EXPECT_EQ(expected_size_xor, result->fec_payload_size_xor);
+      // Only the Parity packet protecting the first packet carries the same
+      // playout delay change.
+      EXPECT_EQ(first == 0 ? frame.new_playout_delay
+                           : std::chrono::milliseconds(0),
+                result->new_playout_delay);
+      EXPECT_EQ(absl::Span<const uint8_t>(expected_payload), result->payload);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace cast
 }  // namespace openscreen
@@ -4,8 +4,11 @@
 
 #include "cast/streaming/sender.h"
 
+#include <limits.h>
+
 #include <algorithm>
 #include <ratio>  // NOLINT
+#include <utility>
 
 #include "cast/streaming/session_config.h"
 #include "util/osp_logging.h"
@@ -16,11 +19,36 @@ namespace cast {
 
 using openscreen::operator<<;  // For std::chrono::duration logging.
 
+namespace {
+
+// Returns the number of data packets each FEC Parity packet should protect,
+// given the |fraction_lost| most recently reported by the Receiver; or zero if
+// the loss is low enough for re-transmits alone to be sufficient. The parity
+// overhead (one packet per group) is kept at about twice the loss rate, since
+// each Parity packet can only recover one lost packet in its group.
+int ComputeFecGroupSize(double fraction_lost) {
+  constexpr double kMinFractionLostForFec = 0.01;
+  constexpr int kMinGroupSize = 2;
+  constexpr int kMaxGroupSize = 16;
+  if (fraction_lost < kMinFractionLostForFec) {
+    return 0;
+  }
+  const int group_size = static_cast<int>(1.0 / (2.0 * fraction_lost));
+  return std::max(kMinGroupSize, std::min(kMaxGroupSize, group_size));
+}
+
+// The maximum burst of re-transmits, as the duration over which the
+// re-transmit allowance accrues before it stops growing.
+constexpr milliseconds kRetransmitAllowanceWindow{100};
+
+}  // namespace
+
 Sender::Sender(Environment* environment,
                SenderPacketRouter* packet_router,
                const SessionConfig& config,
                RtpPayloadType rtp_payload_type)
-    : packet_router_(packet_router),
+    : environment_(environment),
+      packet_router_(packet_router),
       rtcp_session_(config.sender_ssrc,
                     config.receiver_ssrc,
                     environment->now()),
@@ -28,7 +56,8 @@ Sender::Sender(Environment* environment,
       sender_report_builder_(&rtcp_session_),
       rtp_packetizer_(rtp_payload_type,
                       config.sender_ssrc,
-                      packet_router_->max_packet_size()),
+                      packet_router_->max_packet_size(),
+                      config.fec_enabled),
       rtp_timebase_(config.rtp_timebase),
       crypto_(config.aes_secret_key, config.aes_iv_mask),
       target_playout_delay_(config.target_playout_delay) {
@@ -50,6 +79,14 @@ void Sender::SetObserver(Sender::Observer* observer) {
   observer_ = observer;
 }
 
+void Sender::SetMaxRetransmitFraction(double fraction) {
+  OSP_DCHECK_GE(fraction, 0.0);
+  OSP_DCHECK_LE(fraction, 1.0);
+  // Accrue the allowance at the old rate up to now, before changing it.
+  UpdateRetransmitAllowance(environment_->now());
+  max_retransmit_fraction_ = fraction;
+}
+
 int Sender::GetInFlightFrameCount() const {
   return num_frames_in_flight_;
 }
@@ -83,6 +120,32 @@ Clock::duration Sender::GetMaxInFlightMediaDuration() const {
   return (target_playout_delay_ / 2) + (round_trip_time_ / 2);
 }
 
+Clock::time_point Sender::PredictFrameArrivalTime(int payload_size) const {
+  OSP_DCHECK_GE(payload_size, 0);
+
+  // Count the bytes that would have to be sent first: The remaining packets of
+  // the in-flight frames (assuming full-size packets), plus the whole frame.
+  int64_t num_bytes = 0;
+  for (const PendingFrameSlot& slot : pending_frames_) {
+    if (slot.frame) {
+      num_bytes += int64_t{slot.num_packets_needing_send} *
+                   rtp_packetizer_.max_packet_size();
+    }
+  }
+  const int num_packets =
+      std::max(rtp_packetizer_.ComputeNumberOfPackets(payload_size), 1);
+  num_bytes += payload_size + num_packets * RtpPacketizer::kMaxRtpHeaderSize;
+
+  return environment_->now() + ComputeTransmitDuration(num_bytes) +
+         round_trip_time_ / 2;
+}
+
+bool Sender::CanFrameArriveInTime(int payload_size,
+                                  Clock::time_point reference_time) const {
+  return PredictFrameArrivalTime(payload_size) <=
+         reference_time + target_playout_delay_;
+}
+
 bool Sender::NeedsKeyFrame() const {
   return last_enqueued_key_frame_id_ <= picture_lost_at_frame_id_;
 }
@@ -92,15 +155,63 @@ FrameId Sender::GetNextFrameId() const {
 }
 
 Sender::EnqueueFrameResult Sender::EnqueueFrame(const EncodedFrame& frame) {
+  OSP_DCHECK(frame.data.data());
+  return EnqueueFrameInternal(frame, nullptr);
+}
+
+Sender::EnqueueFrameResult Sender::EnqueueFrame(
+    const EncodedFrame& frame,
+    std::shared_ptr<const std::vector<uint8_t>> plaintext_payload) {
+  OSP_DCHECK(plaintext_payload);
+  return EnqueueFrameInternal(frame, std::move(plaintext_payload));
+}
+
+Sender::FrameQueue* Sender::CreateFrameQueue(int capacity) {
+  OSP_DCHECK(!frame_queue_);
+  frame_queue_.reset(new FrameQueue(this, capacity));
+  // Have the packet router start polling this Sender (see GetRtpResumeTime()).
+  packet_router_->RequestRtpSend(rtcp_session_.receiver_ssrc());
+  return frame_queue_.get();
+}
+
+void Sender::TakeFramesFromQueue() {
+  if (!frame_queue_) {
+    return;
+  }
+  while (FrameQueue::Entry* const entry = frame_queue_->entries_.Front()) {
+    // Drop the frames the producer submitted before it learned of the last
+    // rejection. Their FrameIds are being re-used.
+    if (entry->num_rejections_seen !=
+        frame_queue_->num_rejections_.load(std::memory_order_relaxed)) {
+      frame_queue_->entries_.PopFront();
+      continue;
+    }
+    const EnqueueFrameResult result =
+        entry->plaintext_payload
+            ? EnqueueFrameInternal(entry->frame, entry->plaintext_payload)
+            : EnqueueFrameInternal(entry->frame, nullptr, &entry->frame);
+    if (result == REACHED_ID_SPAN_LIMIT || result == MAX_DURATION_IN_FLIGHT) {
+      // As with EnqueueFrame(), reject the frame rather than sending it late.
+      frame_queue_->OnFrameRejected(entry->frame.frame_id);
+    } else {
+      OSP_DCHECK_EQ(result, OK);
+    }
+    frame_queue_->entries_.PopFront();
+  }
+}
+
+Sender::EnqueueFrameResult Sender::EnqueueFrameInternal(
+    const EncodedFrame& frame,
+    std::shared_ptr<const std::vector<uint8_t>> plaintext_payload,
+    EncryptedFrame* encrypted_frame) {
   // Assume the fields of the |frame| have all been set correctly, with
-  // monotonically increasing timestamps and a valid pointer to the data.
+  // monotonically increasing timestamps.
   OSP_DCHECK_EQ(frame.frame_id, GetNextFrameId());
   OSP_DCHECK_GE(frame.referenced_frame_id, FrameId::first());
   if (frame.frame_id != FrameId::first()) {
     OSP_DCHECK_GT(frame.rtp_timestamp, pending_sender_report_.rtp_timestamp);
     OSP_DCHECK_GT(frame.reference_time, pending_sender_report_.reference_time);
   }
-  OSP_DCHECK(frame.data.data());
 
   // Check whether enqueuing the frame would exceed the design limit for the
   // span of FrameIds. Even if |num_frames_in_flight_| is less than
@@ -116,17 +227,47 @@ Sender::EnqueueFrameResult Sender::EnqueueFrame(const EncodedFrame& frame) {
     return MAX_DURATION_IN_FLIGHT;
   }
 
-  // Encrypt the frame and initialize the slot tracking its sending.
+  // Encrypt the frame (or, just retain a reference to its plaintext payload)
+  // and initialize the slot tracking its sending.
   PendingFrameSlot* const slot = get_slot_for(frame.frame_id);
   OSP_DCHECK(!slot->frame);
-  slot->frame = crypto_.Encrypt(frame);
-  const int packet_count = rtp_packetizer_.ComputeNumberOfPackets(*slot->frame);
+  if (encrypted_frame) {
+    slot->frame = std::move(*encrypted_frame);
+  } else if (plaintext_payload) {
+    slot->frame.emplace();
+    frame.CopyMetadataTo(&*slot->frame);
+    slot->plaintext_payload = std::move(plaintext_payload);
+  } else {
+    slot->frame = crypto_.Encrypt(frame);
+  }
+  const int packet_count =
+      rtp_packetizer_.ComputeNumberOfPackets(slot->payload_size());
   if (packet_count <= 0) {
     slot->frame.reset();
+    slot->plaintext_payload.reset();
     return PAYLOAD_TOO_LARGE;
   }
-  slot->send_flags.Resize(packet_count, YetAnotherBitVector::SET);
-  slot->packet_sent_times.assign(packet_count, SenderPacketRouter::kNever);
+  // FEC Parity packets, if any, are sent after all the data packets.
+  int num_parity_packets = 0;
+  if (fec_group_size_ > 0) {
+    num_parity_packets =
+        (packet_count + fec_group_size_ - 1) / fec_group_size_;
+    if (packet_count + num_parity_packets > int{kMaxAllowedFramePacketId}) {
+      num_parity_packets = 0;  // Too many to index. Skip FEC for this frame.
+    }
+  }
+  slot->num_data_packets = packet_count;
+  slot->fec_group_size = (num_parity_packets > 0) ? fec_group_size_ : 0;
+  const int total_packet_count = packet_count + num_parity_packets;
+  slot->send_flags.Resize(total_packet_count, YetAnotherBitVector::SET);
+  slot->num_packets_needing_send = total_packet_count;
+  slot->num_unsent_packets_needing_send = total_packet_count;
+  slot->first_packet_needing_send = 0;
+  slot->first_unsent_packet = 0;
+  slots_needing_send_.Set(get_slot_index_for(frame.frame_id));
+  slots_needing_first_send_.Set(get_slot_index_for(frame.frame_id));
+  slot->packet_sent_times.assign(total_packet_count,
+                                 SenderPacketRouter::kNever);
 
   // Officially record the "enqueue."
   ++num_frames_in_flight_;
@@ -142,6 +283,8 @@ Sender::EnqueueFrameResult Sender::EnqueueFrame(const EncodedFrame& frame) {
     target_playout_delay_ = slot->frame->new_playout_delay;
     playout_delay_change_at_frame_id_ = slot->frame->frame_id;
   }
+  slot->playout_deadline = slot->frame->reference_time + target_playout_delay_;
+  slot->is_dropped = false;
 
   // Update the lip-sync information for the next Sender Report.
   pending_sender_report_.reference_time = slot->frame->reference_time;
@@ -161,6 +304,13 @@ Sender::EnqueueFrameResult Sender::EnqueueFrame(const EncodedFrame& frame) {
     packet_router_->RequestRtcpSend(rtcp_session_.receiver_ssrc());
   }
 
+  // A frame that depends on a dropped frame cannot be decoded, and so is
+  // dropped right away.
+  if (drop_late_frames_ && IsReferencingDroppedFrame(*slot->frame)) {
+    DropFrameAndDependents(slot);
+    return OK;
+  }
+
   // Re-activate RTP sending if it was suspended.
   packet_router_->RequestRtpSend(rtcp_session_.receiver_ssrc());
 
@@ -174,6 +324,8 @@ void Sender::OnReceivedRtcpPacket(Clock::time_point arrival_time,
   // the current call stack:
   if (rtcp_parser_.Parse(packet, last_enqueued_frame_id_)) {
     packet_router_->OnRtcpReceived(arrival_time, round_trip_time_);
+    // Frames waiting in the queue might fit now, if any were ACK'ed.
+    TakeFramesFromQueue();
   }
 }
 
@@ -202,7 +354,7 @@ absl::Span<uint8_t> Sender::GetRtcpPacketForImmediateSend(
 absl::Span<uint8_t> Sender::GetRtpPacketForImmediateSend(
     Clock::time_point send_time,
     absl::Span<uint8_t> buffer) {
-  ChosenPacket chosen = ChooseNextRtpPacketNeedingSend();
+  ChosenPacket chosen = ChooseNextRtpPacketNeedingSend(send_time);
 
   // If no packets need sending (i.e., all packets have been sent at least once
   // and do not need to be re-sent yet), check whether a Kickstart packet should
@@ -222,30 +374,99 @@ absl::Span<uint8_t> Sender::GetRtpPacketForImmediateSend(
     OSP_DCHECK(chosen);
   }
 
-  const absl::Span<uint8_t> result = rtp_packetizer_.GeneratePacket(
-      *chosen.slot->frame, chosen.packet_id, buffer);
-  chosen.slot->send_flags.Clear(chosen.packet_id);
-  chosen.slot->packet_sent_times[chosen.packet_id] = send_time;
+  const absl::Span<uint8_t> result =
+      GeneratePacket(*chosen.slot, chosen.packet_id, buffer);
+  OnRtpPacketGenerated(chosen.slot, chosen.packet_id, send_time, result);
+  return result;
+}
 
-  ++pending_sender_report_.send_packet_count;
-  // According to RFC3550, the octet count does not include the RTP header. The
-  // following is just a good approximation, however, because the header size
-  // will very infrequently be 4 bytes greater (see
-  // RtpPacketizer::kAdaptiveLatencyHeaderSize). No known Cast Streaming
-  // Receiver implementations use this for anything, and so this should be fine.
-  const int approximate_octet_count =
-      static_cast<int>(result.size()) - RtpPacketizer::kBaseRtpHeaderSize;
-  OSP_DCHECK_GE(approximate_octet_count, 0);
-  pending_sender_report_.send_octet_count += approximate_octet_count;
+int Sender::GetRtpPacketsForImmediateSend(
+    Clock::time_point send_time,
+    int max_packets,
+    absl::Span<uint8_t> buffer,
+    std::vector<absl::Span<const uint8_t>>* packets) {
+  OSP_DCHECK_GT(max_packets, 0);
+  const int max_packets_in_buffer =
+      static_cast<int>(buffer.size()) / rtp_packetizer_.max_packet_size();
+  OSP_DCHECK_GT(max_packets_in_buffer, 0);
+  max_packets = std::min(max_packets, max_packets_in_buffer);
+
+  int num_generated = 0;
+  while (num_generated < max_packets) {
+    const ChosenPacket chosen = ChooseNextRtpPacketNeedingSend(send_time);
+    if (!chosen) {
+      break;
+    }
 
-  return result;
+    // The next packets to be chosen would be the rest of the ones needing to be
+    // sent from the same frame, in order. Collect them, so that they can all be
+    // generated together. Re-transmits are only collected while they can
+    // arrive in time and the allowance lasts (assuming full-size packets). The
+    // rest are left for ChooseNextRtpPacketNeedingSend() to sort out.
+    PendingFrameSlot* const slot = chosen.slot;
+    chosen_packet_ids_.clear();
+    int packet_id = chosen.packet_id;
+    const bool can_arrive_in_time = CanArriveInTime(*slot, send_time);
+    double allowance = retransmit_allowance_;
+    do {
+      if (slot->packet_sent_times[packet_id] != SenderPacketRouter::kNever) {
+        if (!can_arrive_in_time || allowance <= 0) {
+          break;
+        }
+        allowance -= rtp_packetizer_.max_packet_size();
+      }
+      chosen_packet_ids_.push_back(static_cast<FramePacketId>(packet_id));
+      packet_id = slot->send_flags.FindFirstSet(packet_id + 1);
+    } while (packet_id < slot->send_flags.size() &&
+             num_generated + static_cast<int>(chosen_packet_ids_.size()) <
+                 max_packets);
+
+    const size_t first_new_packet = packets->size();
+    const int count =
+        GeneratePackets(*slot, chosen_packet_ids_, buffer, packets);
+    OSP_DCHECK_EQ(count, static_cast<int>(chosen_packet_ids_.size()));
+    for (int i = 0; i < count; ++i) {
+      const absl::Span<const uint8_t> packet = (*packets)[first_new_packet + i];
+      OnRtpPacketGenerated(slot, chosen_packet_ids_[i], send_time, packet);
+      buffer.remove_prefix(packet.size());
+    }
+    num_generated += count;
+  }
+
+  // If no packets need sending, check whether a Kickstart packet should be
+  // sent.
+  if (num_generated == 0) {
+    const absl::Span<uint8_t> packet =
+        GetRtpPacketForImmediateSend(send_time, buffer);
+    if (!packet.empty()) {
+      packets->push_back(packet);
+      num_generated = 1;
+    }
+  }
+
+  return num_generated;
+}
+
+void Sender::OnBurstStarting(Clock::time_point burst_time) {
+  TakeFramesFromQueue();
 }
 
 Clock::time_point Sender::GetRtpResumeTime() {
-  if (ChooseNextRtpPacketNeedingSend()) {
+  if (ChooseNextRtpPacketNeedingSend(environment_->now())) {
     return Alarm::kImmediately;
   }
-  return ChooseKickstartPacket().when;
+  Clock::time_point resume_time = ChooseKickstartPacket().when;
+  // Any packets still flagged are re-transmits waiting for more allowance.
+  if (slots_needing_send_.FindFirstSet() < slots_needing_send_.size()) {
+    resume_time = std::min(resume_time, GetRetransmitResumeTime());
+  }
+  // Frames submitted through the FrameQueue are taken in at the start of each
+  // burst (see OnBurstStarting()), so keep the bursts coming.
+  if (frame_queue_) {
+    resume_time = std::min(
+        resume_time, environment_->now() + packet_router_->burst_interval());
+  }
+  return resume_time;
 }
 
 void Sender::OnReceiverReferenceTimeAdvanced(Clock::time_point reference_time) {
@@ -278,6 +499,18 @@ void Sender::OnReceiverReport(const RtcpReportBlock& receiver_report) {
   const Clock::duration measurement =
       std::max(total_delay - non_network_delay, kNearZeroRoundTripTime);
 
+  // Congestion control uses all measurements, since a round trip time that
+  // fails the validation below is a strong signal in itself.
+  packet_router_->OnReceiverReport(rtcp_packet_arrival_time_, measurement,
+                                   receiver_report);
+
+  // Adjust the amount of FEC for the frames to be enqueued next.
+  if (rtp_packetizer_.fec_enabled()) {
+    fec_group_size_ = ComputeFecGroupSize(
+        static_cast<double>(receiver_report.packet_fraction_lost_numerator) /
+        RtcpReportBlock::kPacketFractionLostDenominator);
+  }
+
   // Validate the measurement by using the current target playout delay as a
   // "reasonable upper-bound." It's certainly possible that the actual network
   // round-trip time could exceed the target playout delay, but that would mean
@@ -349,10 +582,18 @@ void Sender::OnReceiverCheckpoint(FrameId frame_id,
   }
   latest_expected_frame_id_ = std::max(latest_expected_frame_id_, frame_id);
 
-  if (playout_delay != target_playout_delay_ &&
-      frame_id >= playout_delay_change_at_frame_id_) {
-    OSP_LOG_WARN << "Sender's target playout delay (" << target_playout_delay_
-                 << ") disagrees with the Receiver's (" << playout_delay << ")";
+  if (frame_id >= playout_delay_change_at_frame_id_) {
+    if (playout_delay == target_playout_delay_) {
+      receiver_requested_playout_delay_ = milliseconds::zero();
+    } else if (playout_delay != receiver_requested_playout_delay_) {
+      OSP_LOG_INFO << "Receiver requests a target playout delay of "
+                   << playout_delay << " (currently " << target_playout_delay_
+                   << ").";
+      receiver_requested_playout_delay_ = playout_delay;
+      if (observer_) {
+        observer_->OnPlayoutDelayRequested(playout_delay);
+      }
+    }
   }
 }
 
@@ -415,13 +656,25 @@ void Sender::OnReceiverIsMissingPackets(std::vector<PacketNack> nacks) {
 
     latest_expected_frame_id_ = std::max(latest_expected_frame_id_, frame_id);
 
+    // Don't waste bandwidth re-transmitting packets that would arrive too late
+    // for the frame to be played out, or those of dropped frames. The Receiver
+    // will skip over the frame.
+    if (slot->is_dropped ||
+        !CanArriveInTime(*slot, rtcp_packet_arrival_time_)) {
+      for (++nack_it; nack_it != nacks.end() && nack_it->frame_id == frame_id;
+           ++nack_it) {
+      }
+      continue;
+    }
+
     const auto HandleIndividualNack = [&](FramePacketId packet_id) {
       if (slot->packet_sent_times[packet_id] <= too_recent_a_send_time) {
-        slot->send_flags.Set(packet_id);
+        SetPacketNeedsSend(slot, packet_id);
         need_to_send = true;
       }
     };
-    const FramePacketId range_end = slot->packet_sent_times.size();
+    // Note: FEC Parity packets are never re-transmitted.
+    const FramePacketId range_end = slot->num_data_packets;
     if (nack_it->packet_id == kAllPacketsLost) {
       for (FramePacketId packet_id = 0; packet_id < range_end; ++packet_id) {
         HandleIndividualNack(packet_id);
@@ -446,21 +699,311 @@ void Sender::OnReceiverIsMissingPackets(std::vector<PacketNack> nacks) {
   }
 }
 
-Sender::ChosenPacket Sender::ChooseNextRtpPacketNeedingSend() {
-  // Find the oldest packet needing to be sent (or re-sent).
-  for (FrameId frame_id = checkpoint_frame_id_ + 1;
+absl::Span<uint8_t> Sender::GeneratePacket(const PendingFrameSlot& slot,
+                                           FramePacketId packet_id,
+                                           absl::Span<uint8_t> buffer) {
+  if (int{packet_id} >= slot.num_data_packets) {
+    return GenerateParityPacket(slot, packet_id - slot.num_data_packets,
+                                buffer);
+  }
+  if (slot.plaintext_payload) {
+    return rtp_packetizer_.GeneratePacket(*slot.frame, *slot.plaintext_payload,
+                                          crypto_, packet_id, buffer);
+  }
+  return rtp_packetizer_.GeneratePacket(*slot.frame, packet_id, buffer);
+}
+
+int Sender::GeneratePackets(const PendingFrameSlot& slot,
+                            absl::Span<const FramePacketId> packet_ids,
+                            absl::Span<uint8_t> buffer,
+                            std::vector<absl::Span<const uint8_t>>* packets) {
+  // The |packet_ids| are in increasing order, so any FEC Parity packets are at
+  // the end.
+  const auto parity_begin =
+      std::lower_bound(packet_ids.begin(), packet_ids.end(),
+                       static_cast<FramePacketId>(slot.num_data_packets));
+  const absl::Span<const FramePacketId> data_packet_ids =
+      packet_ids.subspan(0, parity_begin - packet_ids.begin());
+  const size_t first_new_packet = packets->size();
+  int count;
+  if (data_packet_ids.empty()) {
+    count = 0;
+  } else if (slot.plaintext_payload) {
+    count = rtp_packetizer_.GeneratePackets(*slot.frame,
+                                            *slot.plaintext_payload, crypto_,
+                                            data_packet_ids, buffer, packets);
+  } else {
+    count = rtp_packetizer_.GeneratePackets(*slot.frame, data_packet_ids,
+                                            buffer, packets);
+  }
+  if (count < static_cast<int>(data_packet_ids.size())) {
+    return count;
+  }
+
+  for (size_t i = first_new_packet; i < packets->size(); ++i) {
+    buffer.remove_prefix((*packets)[i].size());
+  }
+  for (auto it = parity_begin; it != packet_ids.end(); ++it) {
+    if (static_cast<int>(buffer.size()) < rtp_packetizer_.max_packet_size()) {
+      break;
+    }
+    const absl::Span<uint8_t> packet =
+        GenerateParityPacket(slot, *it - slot.num_data_packets, buffer);
+    packets->push_back(packet);
+    buffer.remove_prefix(packet.size());
+    ++count;
+  }
+  return count;
+}
+
+absl::Span<uint8_t> Sender::GenerateParityPacket(const PendingFrameSlot& slot,
+                                                 int parity_index,
+                                                 absl::Span<uint8_t> buffer) {
+  OSP_DCHECK_GT(slot.fec_group_size, 0);
+  const int first_packet_id = parity_index * slot.fec_group_size;
+  const int num_protected = std::min(slot.fec_group_size,
+                                     slot.num_data_packets - first_packet_id);
+  if (slot.plaintext_payload) {
+    return rtp_packetizer_.GenerateParityPacket(
+        *slot.frame, *slot.plaintext_payload, crypto_,
+        static_cast<FramePacketId>(first_packet_id), num_protected, buffer);
+  }
+  return rtp_packetizer_.GenerateParityPacket(
+      *slot.frame, static_cast<FramePacketId>(first_packet_id), num_protected,
+      buffer);
+}
+
+void Sender::OnRtpPacketGenerated(PendingFrameSlot* slot,
+                                  FramePacketId packet_id,
+                                  Clock::time_point send_time,
+                                  absl::Span<const uint8_t> packet) {
+  ClearPacketNeedsSend(slot, packet_id);
+  if (slot->packet_sent_times[packet_id] != SenderPacketRouter::kNever) {
+    retransmit_allowance_ -= packet.size();
+  }
+  slot->packet_sent_times[packet_id] = send_time;
+  while (slot->first_unsent_packet <
+             static_cast<int>(slot->packet_sent_times.size()) &&
+         slot->packet_sent_times[slot->first_unsent_packet] !=
+             SenderPacketRouter::kNever) {
+    ++slot->first_unsent_packet;
+  }
+
+  ++pending_sender_report_.send_packet_count;
+  // According to RFC3550, the octet count does not include the RTP header. The
+  // following is just a good approximation, however, because the header size
+  // will very infrequently be 4 bytes greater (see
+  // RtpPacketizer::kAdaptiveLatencyHeaderSize). No known Cast Streaming
+  // Receiver implementations use this for anything, and so this should be fine.
+  const int approximate_octet_count =
+      static_cast<int>(packet.size()) - RtpPacketizer::kBaseRtpHeaderSize;
+  OSP_DCHECK_GE(approximate_octet_count, 0);
+  pending_sender_report_.send_octet_count += approximate_octet_count;
+}
+
+void Sender::SetPacketNeedsSend(PendingFrameSlot* slot,
+                                FramePacketId packet_id) {
+  OSP_DCHECK(slot->frame);
+  if (slot->send_flags.IsSet(packet_id)) {
+    return;
+  }
+  slot->send_flags.Set(packet_id);
+  ++slot->num_packets_needing_send;
+  slot->first_packet_needing_send =
+      std::min<int>(slot->first_packet_needing_send, packet_id);
+  slots_needing_send_.Set(get_slot_index_for(slot->frame->frame_id));
+  if (slot->packet_sent_times[packet_id] == SenderPacketRouter::kNever) {
+    ++slot->num_unsent_packets_needing_send;
+    slots_needing_first_send_.Set(get_slot_index_for(slot->frame->frame_id));
+  }
+}
+
+void Sender::ClearPacketNeedsSend(PendingFrameSlot* slot,
+                                  FramePacketId packet_id) {
+  OSP_DCHECK(slot->frame);
+  if (!slot->send_flags.IsSet(packet_id)) {
+    return;
+  }
+  slot->send_flags.Clear(packet_id);
+  OSP_DCHECK_GT(slot->num_packets_needing_send, 0);
+  if (--slot->num_packets_needing_send == 0) {
+    slots_needing_send_.Clear(get_slot_index_for(slot->frame->frame_id));
+  }
+  if (slot->packet_sent_times[packet_id] == SenderPacketRouter::kNever) {
+    OSP_DCHECK_GT(slot->num_unsent_packets_needing_send, 0);
+    if (--slot->num_unsent_packets_needing_send == 0) {
+      slots_needing_first_send_.Clear(
+          get_slot_index_for(slot->frame->frame_id));
+    }
+  }
+}
+
+Sender::ChosenPacket Sender::ChooseNextRtpPacketNeedingSend(
+    Clock::time_point now) {
+  UpdateRetransmitAllowance(now);
+
+  // While re-transmits are waiting for more allowance, only packets that have
+  // never been sent can go, and so only the frames having those are examined.
+  const bool retransmits_deferred = retransmit_allowance_ <= 0;
+  const YetAnotherBitVector& candidate_slots =
+      retransmits_deferred ? slots_needing_first_send_ : slots_needing_send_;
+
+  // Examine the frames having packets needing to be sent (or re-sent), oldest
+  // first. The slots are a ring buffer, so the search starts at the slot for
+  // the oldest in-flight frame and wraps around, if necessary.
+  const int oldest_slot_index = get_slot_index_for(checkpoint_frame_id_ + 1);
+  int slot_index = candidate_slots.FindFirstSet(oldest_slot_index);
+  bool wrapped = false;
+  while (true) {
+    if (slot_index == candidate_slots.size() && !wrapped) {
+      slot_index = candidate_slots.FindFirstSet();
+      wrapped = true;
+    }
+    if (wrapped && slot_index >= oldest_slot_index) {
+      return {};  // Nothing needs to be sent.
+    }
+
+    // Find the first packet needing to be sent in that frame, starting from
+    // the position where the prior search left off. When re-transmits are
+    // deferred, start from the first packet never sent instead.
+    PendingFrameSlot* const slot = &pending_frames_[slot_index];
+    OSP_DCHECK(slot->frame);
+    OSP_DCHECK_GT(slot->num_packets_needing_send, 0);
+    int packet_id;
+    if (retransmits_deferred) {
+      OSP_DCHECK_GT(slot->num_unsent_packets_needing_send, 0);
+      packet_id = slot->send_flags.FindFirstSet(slot->first_unsent_packet);
+    } else {
+      packet_id =
+          slot->send_flags.FindFirstSet(slot->first_packet_needing_send);
+      slot->first_packet_needing_send = packet_id;
+    }
+    OSP_DCHECK_LT(packet_id, slot->send_flags.size());
+
+    // If none of the frame's packets have been sent yet, and it would be late,
+    // drop it (unless it is a key frame).
+    if (drop_late_frames_ &&
+        slot->packet_sent_times[0] == SenderPacketRouter::kNever &&
+        slot->frame->dependency != EncodedFrame::KEY_FRAME) {
+      const int64_t num_bytes =
+          static_cast<int64_t>(slot->payload_size()) +
+          int64_t{slot->num_packets_needing_send} *
+              RtpPacketizer::kMaxRtpHeaderSize;
+      if (now + ComputeTransmitDuration(num_bytes) + round_trip_time_ / 2 >
+          slot->playout_deadline) {
+        DropFrameAndDependents(slot);
+        slot_index = candidate_slots.FindFirstSet(slot_index + 1);
+        continue;
+      }
+    }
+
+    // Packets being sent for the first time always go. Re-transmits are
+    // dropped if they would be late, or passed-over if they must wait for more
+    // allowance.
+    const bool can_arrive_in_time = CanArriveInTime(*slot, now);
+    for (; packet_id < slot->send_flags.size();
+         packet_id = slot->send_flags.FindFirstSet(packet_id + 1)) {
+      if (slot->packet_sent_times[packet_id] == SenderPacketRouter::kNever ||
+          (can_arrive_in_time && retransmit_allowance_ > 0)) {
+        return {slot, static_cast<FramePacketId>(packet_id)};
+      }
+      if (!can_arrive_in_time) {
+        ClearPacketNeedsSend(slot, static_cast<FramePacketId>(packet_id));
+      }
+    }
+
+    slot_index = candidate_slots.FindFirstSet(slot_index + 1);
+  }
+}
+
+bool Sender::CanArriveInTime(const PendingFrameSlot& slot,
+                             Clock::time_point send_time) const {
+  return send_time + round_trip_time_ / 2 <= slot.playout_deadline;
+}
+
+void Sender::UpdateRetransmitAllowance(Clock::time_point now) {
+  const double bytes_per_second =
+      max_retransmit_fraction_ * packet_router_->GetTargetBitrate() / CHAR_BIT;
+  // Always allow at least one packet, so that re-transmits are never stalled
+  // completely at low bitrates.
+  const double max_allowance = std::max<double>(
+      bytes_per_second *
+          duration_cast<std::chrono::duration<double>>(
+              kRetransmitAllowanceWindow)
+              .count(),
+      (bytes_per_second > 0) ? rtp_packetizer_.max_packet_size() : 0);
+
+  if (retransmit_allowance_updated_at_ == SenderPacketRouter::kNever) {
+    retransmit_allowance_ = max_allowance;
+  } else if (now > retransmit_allowance_updated_at_) {
+    const double elapsed_seconds =
+        duration_cast<std::chrono::duration<double>>(
+            now - retransmit_allowance_updated_at_)
+            .count();
+    retransmit_allowance_ = std::min(
+        max_allowance,
+        retransmit_allowance_ + bytes_per_second * elapsed_seconds);
+  } else {
+    return;
+  }
+  retransmit_allowance_updated_at_ = now;
+}
+
+Clock::duration Sender::ComputeTransmitDuration(int64_t num_bytes) const {
+  const int bitrate = packet_router_->GetTargetBitrate();
+  OSP_DCHECK_GT(bitrate, 0);
+  return duration_cast<Clock::duration>(std::chrono::duration<double>(
+      static_cast<double>(num_bytes) * CHAR_BIT / bitrate));
+}
+
+bool Sender::IsReferencingDroppedFrame(const EncryptedFrame& frame) const {
+  if (frame.dependency == EncodedFrame::KEY_FRAME ||
+      frame.referenced_frame_id <= checkpoint_frame_id_ ||
+      frame.referenced_frame_id >= frame.frame_id) {
+    return false;
+  }
+  const PendingFrameSlot* const referenced_slot =
+      get_slot_for(frame.referenced_frame_id);
+  return referenced_slot->is_active_for_frame(frame.referenced_frame_id) &&
+         referenced_slot->is_dropped;
+}
+
+void Sender::DropFrameAndDependents(PendingFrameSlot* slot) {
+  const FrameId dropped_frame_id = slot->frame->frame_id;
+  for (FrameId frame_id = dropped_frame_id;
        frame_id <= last_enqueued_frame_id_; ++frame_id) {
-    PendingFrameSlot* const slot = get_slot_for(frame_id);
-    if (!slot->is_active_for_frame(frame_id)) {
-      continue;  // Frame was canceled. None of its packets need to be sent.
+    PendingFrameSlot* const candidate = get_slot_for(frame_id);
+    if (!candidate->is_active_for_frame(frame_id) || candidate->is_dropped ||
+        (frame_id != dropped_frame_id &&
+         !IsReferencingDroppedFrame(*candidate->frame))) {
+      continue;
     }
-    const FramePacketId packet_id = slot->send_flags.FindFirstSet();
-    if (packet_id < slot->send_flags.size()) {
-      return {slot, packet_id};
+
+    for (int packet_id = candidate->send_flags.FindFirstSet();
+         packet_id < candidate->send_flags.size();
+         packet_id = candidate->send_flags.FindFirstSet(packet_id + 1)) {
+      ClearPacketNeedsSend(candidate, static_cast<FramePacketId>(packet_id));
+    }
+    candidate->is_dropped = true;
+    // Dependent frames will not be decodable until the next key frame.
+    picture_lost_at_frame_id_ = std::max(picture_lost_at_frame_id_, frame_id);
+    if (observer_) {
+      observer_->OnFrameDropped(frame_id);
     }
   }
+}
 
-  return {};  // Nothing needs to be sent.
+Clock::time_point Sender::GetRetransmitResumeTime() const {
+  const double bytes_per_second =
+      max_retransmit_fraction_ * packet_router_->GetTargetBitrate() / CHAR_BIT;
+  if (bytes_per_second <= 0) {
+    return SenderPacketRouter::kNever;
+  }
+  // Resume once the allowance is back above zero (by at least one byte).
+  const std::chrono::duration<double> wait(
+      std::max(0.0, 1.0 - retransmit_allowance_) / bytes_per_second);
+  return retransmit_allowance_updated_at_ +
+         duration_cast<Clock::duration>(wait);
 }
 
 Sender::ChosenPacketAndWhen Sender::ChooseKickstartPacket() {
@@ -475,12 +1018,20 @@ Sender::ChosenPacketAndWhen Sender::ChooseKickstartPacket() {
   // should be chosen? Any would do, since all packets contain the frame's total
   // packet count. For historical reasons, all sender implementations have
   // always just sent the last packet; and so that tradition is continued here.
+  // Dropped frames are never sent, and so the last frame that was not dropped
+  // is used instead.
+  FrameId frame_id = last_enqueued_frame_id_;
+  while (get_slot_for(frame_id)->is_dropped) {
+    if (--frame_id <= latest_expected_frame_id_) {
+      return {};
+    }
+  }
   ChosenPacketAndWhen chosen;
-  chosen.slot = get_slot_for(last_enqueued_frame_id_);
+  chosen.slot = get_slot_for(frame_id);
   // Note: This frame cannot have been canceled since
   // |latest_expected_frame_id_| hasn't yet reached this point.
-  OSP_DCHECK(chosen.slot->is_active_for_frame(last_enqueued_frame_id_));
-  chosen.packet_id = chosen.slot->send_flags.size() - 1;
+  OSP_DCHECK(chosen.slot->is_active_for_frame(frame_id));
+  chosen.packet_id = chosen.slot->num_data_packets - 1;
 
   const Clock::time_point time_last_sent =
       chosen.slot->packet_sent_times[chosen.packet_id];
@@ -516,9 +1067,12 @@ void Sender::CancelPendingFrame(FrameId frame_id) {
   }
 
   packet_router_->OnPayloadReceived(
-      slot->frame->data.size(), rtcp_packet_arrival_time_, round_trip_time_);
+      slot->payload_size(), rtcp_packet_arrival_time_, round_trip_time_);
 
   slot->frame.reset();
+  slot->plaintext_payload.reset();
+  slots_needing_send_.Clear(get_slot_index_for(frame_id));
+  slots_needing_first_send_.Clear(get_slot_index_for(frame_id));
   OSP_DCHECK_GT(num_frames_in_flight_, 0);
   --num_frames_in_flight_;
   if (observer_) {
@@ -526,8 +1080,74 @@ void Sender::CancelPendingFrame(FrameId frame_id) {
   }
 }
 
+Sender::FrameQueue::FrameQueue(Sender* sender, int capacity)
+    : crypto_(sender->crypto_),
+      rtp_packetizer_(sender->rtp_packetizer_),
+      entries_(capacity),
+      next_frame_id_(sender->GetNextFrameId()) {
+  OSP_DCHECK_GT(capacity, 0);
+}
+
+Sender::FrameQueue::~FrameQueue() = default;
+
+bool Sender::FrameQueue::SubmitFrame(const EncodedFrame& frame) {
+  OSP_DCHECK(frame.data.data());
+  if (RewindIfFrameWasRejected()) {
+    return false;
+  }
+  OSP_DCHECK_EQ(frame.frame_id, next_frame_id_);
+  if (rtp_packetizer_.ComputeNumberOfPackets(frame.data.size()) <= 0) {
+    return false;
+  }
+  return Push(Entry{crypto_.Encrypt(frame), nullptr, num_rejections_seen_});
+}
+
+bool Sender::FrameQueue::SubmitFrame(
+    const EncodedFrame& frame,
+    std::shared_ptr<const std::vector<uint8_t>> plaintext_payload) {
+  OSP_DCHECK(plaintext_payload);
+  if (RewindIfFrameWasRejected()) {
+    return false;
+  }
+  OSP_DCHECK_EQ(frame.frame_id, next_frame_id_);
+  if (rtp_packetizer_.ComputeNumberOfPackets(plaintext_payload->size()) <= 0) {
+    return false;
+  }
+  Entry entry{EncryptedFrame(), std::move(plaintext_payload),
+              num_rejections_seen_};
+  frame.CopyMetadataTo(&entry.frame);
+  return Push(std::move(entry));
+}
+
+bool Sender::FrameQueue::RewindIfFrameWasRejected() {
+  const int num_rejections = num_rejections_.load(std::memory_order_acquire);
+  if (num_rejections == num_rejections_seen_) {
+    return false;
+  }
+  num_rejections_seen_ = num_rejections;
+  next_frame_id_ = FrameId::first() + rewind_to_frame_offset_.load(
+                                          std::memory_order_relaxed);
+  return true;
+}
+
+bool Sender::FrameQueue::Push(Entry entry) {
+  if (!entries_.TryPush(std::move(entry))) {
+    return false;
+  }
+  ++next_frame_id_;
+  return true;
+}
+
+void Sender::FrameQueue::OnFrameRejected(FrameId frame_id) {
+  rewind_to_frame_offset_.store(frame_id - FrameId::first(),
+                                std::memory_order_relaxed);
+  num_rejections_.fetch_add(1, std::memory_order_release);
+}
+
 void Sender::Observer::OnFrameCanceled(FrameId frame_id) {}
 void Sender::Observer::OnPictureLost() {}
+void Sender::Observer::OnFrameDropped(FrameId frame_id) {}
+void Sender::Observer::OnPlayoutDelayRequested(milliseconds delay) {}
 Sender::Observer::~Observer() = default;
 
 Sender::PendingFrameSlot::PendingFrameSlot() = default;
@@ -8,7 +8,9 @@
 #include <stdint.h>
 
 #include <array>
+#include <atomic>
 #include <chrono>  // NOLINT
+#include <memory>
 #include <vector>
 
 #include "absl/types/span.h"
@@ -22,6 +24,7 @@
 #include "cast/streaming/sender_packet_router.h"
 #include "cast/streaming/sender_report_builder.h"
 #include "platform/api/time.h"
+#include "util/spsc_queue.h"
 #include "util/yet_another_bit_vector.h"
 
 namespace openscreen {
@@ -84,6 +87,21 @@ class Sender final : public SenderPacketRouter::Sender,
     // a key frame.
     virtual void OnPictureLost();
 
+    // Called when the Sender drops a frame, without having sent any of its
+    // packets, because it would have arrived too late for playout (see
+    // SetDropLateFrames()). All the in-flight frames depending on it are
+    // dropped too, and NeedsKeyFrame() will return true until the next key
+    // frame is enqueued. Note: OnFrameCanceled() is still called later, once
+    // the Receiver has skipped over the frame.
+    virtual void OnFrameDropped(FrameId frame_id);
+
+    // Called when the Receiver requests a different target playout delay than
+    // the current one (e.g., because it is running an adaptive jitter buffer).
+    // The application may honor the request by setting the
+    // |new_playout_delay| of the next frame it enqueues. This is called again
+    // only if the Receiver's request changes.
+    virtual void OnPlayoutDelayRequested(std::chrono::milliseconds delay);
+
    protected:
     virtual ~Observer();
   };
@@ -108,6 +126,79 @@ class Sender final : public SenderPacketRouter::Sender,
     MAX_DURATION_IN_FLIGHT,
   };
 
+  // A thread-safe handoff of frames from one producer thread (e.g., that of a
+  // video encoder) to the Sender, without posting a task per frame. Frames are
+  // taken in by the Sender at the start of each packet burst. See
+  // Sender::CreateFrameQueue().
+  class FrameQueue {
+   public:
+    ~FrameQueue();
+
+    // Returns the FrameId to use for the next frame submitted. Producer-only.
+    FrameId GetNextFrameId() const { return next_frame_id_; }
+
+    // Submits the |frame| for sending, encrypting its payload on the calling
+    // thread. The frame's fields must be set as for Sender::EnqueueFrame(),
+    // except that the |frame_id| must be GetNextFrameId(). Returns false if the
+    // queue is full (i.e., the Sender is not keeping up), or the payload is too
+    // large. In that case, the FrameId is not used-up, and the producer should
+    // make the next frame a key frame. Producer-only.
+    //
+    // Also returns false if, since the last call, the Sender has rejected a
+    // submitted frame for the same reasons Sender::EnqueueFrame() would (i.e.,
+    // REACHED_ID_SPAN_LIMIT or MAX_DURATION_IN_FLIGHT). The rejected frame,
+    // and all those submitted after it, are dropped; and GetNextFrameId() is
+    // rewound to the rejected frame's FrameId. The producer should then call
+    // GetNextFrameId() again, and make the next frame a key frame.
+    [[nodiscard]] bool SubmitFrame(const EncodedFrame& frame);
+
+    // Same as the above, except that the payload is encrypted later, while
+    // packetizing, as with the corresponding Sender::EnqueueFrame().
+    [[nodiscard]] bool SubmitFrame(
+        const EncodedFrame& frame,
+        std::shared_ptr<const std::vector<uint8_t>> plaintext_payload);
+
+   private:
+    friend class Sender;
+
+    struct Entry {
+      EncryptedFrame frame;
+      std::shared_ptr<const std::vector<uint8_t>> plaintext_payload;
+
+      // The number of rejections the producer had seen when submitting the
+      // frame. The Sender drops the frames submitted before the producer saw
+      // the latest one.
+      int num_rejections_seen;
+    };
+
+    FrameQueue(Sender* sender, int capacity);
+
+    // Returns true, and rewinds |next_frame_id_|, if the Sender has rejected
+    // a frame since the last call. Producer-only.
+    bool RewindIfFrameWasRejected();
+
+    // Pushes the |entry| for the Sender to take in at its next burst.
+    bool Push(Entry entry);
+
+    // Called by the Sender when it rejects the frame having |frame_id|.
+    void OnFrameRejected(FrameId frame_id);
+
+    const FrameCrypto& crypto_;
+    const RtpPacketizer& rtp_packetizer_;
+
+    SpscQueue<Entry> entries_;
+
+    // Only accessed by the producer.
+    FrameId next_frame_id_;
+    int num_rejections_seen_ = 0;
+
+    // Incremented by the Sender each time it rejects a frame, after setting
+    // |rewind_to_frame_offset_| to the rejected frame's offset from
+    // FrameId::first().
+    std::atomic<int> num_rejections_{0};
+    std::atomic<int64_t> rewind_to_frame_offset_{0};
+  };
+
   // Constructs a Sender that attaches to the given |environment|-provided
   // resources and |packet_router|. The |config| contains the settings that were
   // agreed-upon by both sides from the OFFER/ANSWER exchange (i.e., the part of
@@ -124,10 +215,23 @@ class Sender final : public SenderPacketRouter::Sender,
   Ssrc ssrc() const { return rtcp_session_.sender_ssrc(); }
   int rtp_timebase() const { return rtp_timebase_; }
 
+  // Returns the number of packets each FEC Parity packet protects in the frames
+  // being enqueued, or zero if no FEC Parity packets are being sent. If FEC was
+  // enabled in the SessionConfig, this is adjusted according to the packet loss
+  // reported by the Receiver.
+  int fec_group_size() const { return fec_group_size_; }
+
   // Sets an observer for receiving notifications. Call with nullptr to stop
   // observing.
   void SetObserver(Observer* observer);
 
+  // Returns/Sets the maximum fraction of the SenderPacketRouter's target
+  // bitrate that may be spent re-transmitting packets the Receiver has NACKed.
+  // Re-transmits beyond this are deferred, so that they do not crowd out the
+  // packets of newer frames during loss bursts. Zero disables re-transmits.
+  double max_retransmit_fraction() const { return max_retransmit_fraction_; }
+  void SetMaxRetransmitFraction(double fraction);
+
   // Returns the number of frames currently in-flight. This is only meant to be
   // informative. Clients should use GetInFlightMediaDuration() to make
   // throttling decisions.
@@ -146,6 +250,27 @@ class Sender final : public SenderPacketRouter::Sender,
   // target playout delay setting and end-to-end network/system conditions.
   Clock::duration GetMaxInFlightMediaDuration() const;
 
+  // Returns the predicted point-in-time at which all the packets of a frame
+  // having the given |payload_size| would have arrived at the Receiver, were
+  // it enqueued now. This accounts for the packets of the in-flight frames
+  // still waiting to be sent, the SenderPacketRouter's target bitrate (which
+  // it paces all media to), and the network round trip time.
+  Clock::time_point PredictFrameArrivalTime(int payload_size) const;
+
+  // Returns true if a frame having the given |payload_size| and
+  // |reference_time| is predicted to arrive at the Receiver before its playout
+  // deadline, were it enqueued now. Clients can use this to skip encoding
+  // frames that would only be dropped by the Receiver.
+  bool CanFrameArriveInTime(int payload_size,
+                            Clock::time_point reference_time) const;
+
+  // Returns/Sets whether the Sender automatically drops frames that are
+  // predicted to arrive too late for playout. Only non-key frames none of whose
+  // packets have been sent yet are dropped, when they are next in line to be
+  // sent. Frames depending on a dropped frame are dropped along with it.
+  bool is_dropping_late_frames() const { return drop_late_frames_; }
+  void SetDropLateFrames(bool enabled) { drop_late_frames_ = enabled; }
+
   // Returns true if the Receiver requires a key frame. Note that this will
   // return true until a key frame is accepted by EnqueueFrame(). Thus, when
   // encoding is pipelined, care should be taken to instruct the encoder to
@@ -167,6 +292,28 @@ class Sender final : public SenderPacketRouter::Sender,
   // prior frame; and the frame's |data| pointer must be set.
   [[nodiscard]] EnqueueFrameResult EnqueueFrame(const EncodedFrame& frame);
 
+  // Same as the above, except that the Sender retains a reference to the
+  // un-encrypted |plaintext_payload| instead of making an encrypted copy of the
+  // whole frame up-front. Each packet's slice of the payload is encrypted
+  // directly into the outgoing packet, each time it is sent. This saves one
+  // copy of the frame data (and the memory to hold it) for large frames. The
+  // |frame|'s |data| field is ignored; and the |plaintext_payload| must not be
+  // modified while the Sender holds a reference to it.
+  [[nodiscard]] EnqueueFrameResult EnqueueFrame(
+      const EncodedFrame& frame,
+      std::shared_ptr<const std::vector<uint8_t>> plaintext_payload);
+
+  // Creates the FrameQueue through which another thread will provide all
+  // further frames to this Sender, in place of calling EnqueueFrame(). The
+  // queue holds up to |capacity| frames, and is owned by the Sender. The
+  // producer must stop using it before the Sender is destroyed. While the
+  // queue exists, the Sender keeps the SenderPacketRouter's bursts coming at
+  // least once per burst interval, to take in the submitted frames.
+  FrameQueue* CreateFrameQueue(int capacity);
+
+  // The default for SetMaxRetransmitFraction().
+  static constexpr double kDefaultMaxRetransmitFraction = 0.5;
+
  private:
   // Tracking/Storage for frames that are ready-to-send, and until they are
   // fully received at the other end.
@@ -174,24 +321,102 @@ class Sender final : public SenderPacketRouter::Sender,
     // The frame to send, or nullopt if this slot is not in use.
     absl::optional<EncryptedFrame> frame;
 
+    // If set, the un-encrypted payload of the frame, which is encrypted one
+    // packet at a time as the packets are sent. In this case, the |data| of
+    // |frame| is empty, and |frame| only provides the frame's metadata.
+    std::shared_ptr<const std::vector<uint8_t>> plaintext_payload;
+
+    // The number of data packets in the frame, and the number of them that are
+    // protected by each FEC Parity packet (zero if there are none).
+    int num_data_packets = 0;
+    int fec_group_size = 0;
+
     // Represents which packets need to be sent. Elements are indexed by
-    // FramePacketId. A set bit means a packet needs to be sent (or re-sent).
+    // FramePacketId, followed by one element for each FEC Parity packet. A set
+    // bit means a packet needs to be sent (or re-sent).
+    // Use Sender::SetPacketNeedsSend() and Sender::ClearPacketNeedsSend() to
+    // mutate these, so that |num_packets_needing_send|,
+    // |num_unsent_packets_needing_send|, |first_packet_needing_send|,
+    // |Sender::slots_needing_send_|, and |Sender::slots_needing_first_send_|
+    // are kept up-to-date.
     YetAnotherBitVector send_flags;
 
+    // The number of bits set in |send_flags|, and how many of those are for
+    // packets that have never been sent (i.e., are not re-transmits).
+    int num_packets_needing_send = 0;
+    int num_unsent_packets_needing_send = 0;
+
+    // No bits before this position are set in |send_flags|. This allows
+    // searches for the next packet to send to skip over the leading bits that
+    // were cleared by the prior searches.
+    int first_packet_needing_send = 0;
+
+    // All packets before this position have been sent at least once. This
+    // allows searches for the next never-sent packet to skip over the
+    // re-transmits, while those are waiting for more allowance.
+    int first_unsent_packet = 0;
+
     // The time when each of the packets was last sent, or
     // |SenderPacketRouter::kNever| if the packet has not been sent yet.
-    // Elements are indexed by FramePacketId. This is used to avoid
+    // Elements are indexed the same as |send_flags|. This is used to avoid
     // re-transmitting any given packet too frequently.
     std::vector<Clock::time_point> packet_sent_times;
 
+    // The latest time at which the frame's packets can arrive at the Receiver
+    // and still be played out: The frame's reference time plus the target
+    // playout delay in effect for it.
+    Clock::time_point playout_deadline;
+
+    // Set if the frame was dropped without being sent (see
+    // Sender::DropFrameAndDependents()).
+    bool is_dropped = false;
+
     PendingFrameSlot();
     ~PendingFrameSlot();
 
     bool is_active_for_frame(FrameId frame_id) const {
       return frame && frame->frame_id == frame_id;
     }
+
+    // Returns the size of the frame's payload, whether or not it has been
+    // encrypted yet.
+    size_t payload_size() const {
+      return plaintext_payload ? plaintext_payload->size() : frame->data.size();
+    }
   };
 
+  // Implements both EnqueueFrame() variants, and the taking-in of frames from
+  // the FrameQueue. If |encrypted_frame| is provided, it is the already
+  // encrypted |frame|, and is moved-from unless the in-flight limits cause
+  // REACHED_ID_SPAN_LIMIT or MAX_DURATION_IN_FLIGHT to be returned. Otherwise,
+  // if |plaintext_payload| is null, the |frame|'s data is encrypted up-front;
+  // or else, it is ignored.
+  EnqueueFrameResult EnqueueFrameInternal(
+      const EncodedFrame& frame,
+      std::shared_ptr<const std::vector<uint8_t>> plaintext_payload,
+      EncryptedFrame* encrypted_frame = nullptr);
+
+  // Enqueues the frames waiting in the |frame_queue_|, in order, until it is
+  // empty. A frame that cannot be enqueued (e.g., too many frames are
+  // in-flight) is dropped, along with the frames submitted after it, and the
+  // producer is told via its next FrameQueue::SubmitFrame().
+  void TakeFramesFromQueue();
+
+  // Wire-formats the given packets of the frame in |slot|, encrypting the
+  // payload on-the-fly if necessary. See RtpPacketizer::GeneratePacket[s]().
+  // The "packet IDs" past the frame's data packets identify its FEC Parity
+  // packets (see |PendingFrameSlot::send_flags|).
+  absl::Span<uint8_t> GeneratePacket(const PendingFrameSlot& slot,
+                                     FramePacketId packet_id,
+                                     absl::Span<uint8_t> buffer);
+  int GeneratePackets(const PendingFrameSlot& slot,
+                      absl::Span<const FramePacketId> packet_ids,
+                      absl::Span<uint8_t> buffer,
+                      std::vector<absl::Span<const uint8_t>>* packets);
+  absl::Span<uint8_t> GenerateParityPacket(const PendingFrameSlot& slot,
+                                           int parity_index,
+                                           absl::Span<uint8_t> buffer);
+
   // Return value from the ChooseXYZ() helper methods.
   struct ChosenPacket {
     PendingFrameSlot* slot = nullptr;
@@ -215,7 +440,13 @@ class Sender final : public SenderPacketRouter::Sender,
   absl::Span<uint8_t> GetRtpPacketForImmediateSend(
       Clock::time_point send_time,
       absl::Span<uint8_t> buffer) final;
+  int GetRtpPacketsForImmediateSend(
+      Clock::time_point send_time,
+      int max_packets,
+      absl::Span<uint8_t> buffer,
+      std::vector<absl::Span<const uint8_t>>* packets) final;
   Clock::time_point GetRtpResumeTime() final;
+  void OnBurstStarting(Clock::time_point burst_time) final;
 
   // CompoundRtcpParser::Client implementation.
   void OnReceiverReferenceTimeAdvanced(Clock::time_point reference_time) final;
@@ -226,9 +457,54 @@ class Sender final : public SenderPacketRouter::Sender,
   void OnReceiverHasFrames(std::vector<FrameId> acks) final;
   void OnReceiverIsMissingPackets(std::vector<PacketNack> nacks) final;
 
+  // Helpers to set/clear the "need to send" flag for one packet, keeping all
+  // the related indexing data structures up-to-date.
+  void SetPacketNeedsSend(PendingFrameSlot* slot, FramePacketId packet_id);
+  void ClearPacketNeedsSend(PendingFrameSlot* slot, FramePacketId packet_id);
+
+  // Records that the |packet|, just generated for the given frame |slot| and
+  // |packet_id|, is being sent at |send_time|.
+  void OnRtpPacketGenerated(PendingFrameSlot* slot,
+                            FramePacketId packet_id,
+                            Clock::time_point send_time,
+                            absl::Span<const uint8_t> packet);
+
   // Helper to choose which packet to send, from those that have been flagged as
-  // "need to send." Returns a "false" result if nothing needs to be sent.
-  ChosenPacket ChooseNextRtpPacketNeedingSend();
+  // "need to send." Returns a "false" result if nothing needs to be sent. This
+  // chooses the first such packet in the oldest frame (i.e., the one nearest
+  // its playout deadline), and runs in amortized constant time (see
+  // |slots_needing_send_|). Along the way, re-transmits are dropped for frames
+  // that can no longer arrive in time. While the re-transmit bandwidth
+  // allowance is exhausted, re-transmits are left flagged and not examined at
+  // all (see |slots_needing_first_send_|).
+  ChosenPacket ChooseNextRtpPacketNeedingSend(Clock::time_point now);
+
+  // Returns true if a packet of the frame in |slot|, sent at |send_time|, is
+  // expected to reach the Receiver before the frame's playout deadline.
+  bool CanArriveInTime(const PendingFrameSlot& slot,
+                       Clock::time_point send_time) const;
+
+  // Tops-up |retransmit_allowance_| for the time elapsed since the last update,
+  // at the re-transmit share of the packet router's target bitrate.
+  void UpdateRetransmitAllowance(Clock::time_point now);
+
+  // Returns how long it takes to send |num_bytes| at the packet router's target
+  // bitrate.
+  Clock::duration ComputeTransmitDuration(int64_t num_bytes) const;
+
+  // Returns true if |frame| is a non-key frame referencing an in-flight frame
+  // that was dropped.
+  bool IsReferencingDroppedFrame(const EncryptedFrame& frame) const;
+
+  // Drops the frame in |slot|, along with any in-flight frames that reference
+  // it (directly or indirectly), so that none of their packets are sent (or
+  // re-sent) anymore. The frames remain in-flight until the Receiver skips over
+  // them.
+  void DropFrameAndDependents(PendingFrameSlot* slot);
+
+  // Returns the point-in-time at which |retransmit_allowance_| will permit
+  // re-transmits again, or kNever if re-transmits are disabled.
+  Clock::time_point GetRetransmitResumeTime() const;
 
   // Helper that returns the packet that should be used to kick-start the
   // Receiver, and the time at which the packet should be sent. Returns a kNever
@@ -240,17 +516,19 @@ class Sender final : public SenderPacketRouter::Sender,
   // the corresponding entry in |pending_frames_| and notifies the Observer.
   void CancelPendingFrame(FrameId frame_id);
 
-  // Inline helper to return the slot that would contain the tracking info for
-  // the given |frame_id|.
+  // Inline helpers to return the slot (or its index) that would contain the
+  // tracking info for the given |frame_id|.
+  static int get_slot_index_for(FrameId frame_id) {
+    return (frame_id - FrameId::first()) % kMaxUnackedFrames;
+  }
   const PendingFrameSlot* get_slot_for(FrameId frame_id) const {
-    return &pending_frames_[(frame_id - FrameId::first()) %
-                            pending_frames_.size()];
+    return &pending_frames_[get_slot_index_for(frame_id)];
   }
   PendingFrameSlot* get_slot_for(FrameId frame_id) {
-    return &pending_frames_[(frame_id - FrameId::first()) %
-                            pending_frames_.size()];
+    return &pending_frames_[get_slot_index_for(frame_id)];
   }
 
+  Environment* const environment_;
   SenderPacketRouter* const packet_router_;
   RtcpSession rtcp_session_;
   CompoundRtcpParser rtcp_parser_;
@@ -264,10 +542,32 @@ class Sender final : public SenderPacketRouter::Sender,
   // access the correct slot for a given FrameId.
   std::array<PendingFrameSlot, kMaxUnackedFrames> pending_frames_{};
 
+  // Scratch space used by GetRtpPacketsForImmediateSend(), to collect the IDs
+  // of the packets to be generated from the same frame.
+  std::vector<FramePacketId> chosen_packet_ids_;
+
+  // Indexed the same as |pending_frames_|, a set bit means the slot contains an
+  // in-flight frame having one or more packets that need to be sent. This
+  // allows ChooseNextRtpPacketNeedingSend() to skip over all the frames that
+  // have nothing to send, rather than examining each one.
+  YetAnotherBitVector slots_needing_send_{kMaxUnackedFrames,
+                                          YetAnotherBitVector::CLEARED};
+
+  // Like |slots_needing_send_|, but a set bit means the frame has one or more
+  // packets that have never been sent. While re-transmits are waiting for more
+  // allowance, ChooseNextRtpPacketNeedingSend() only examines these frames,
+  // rather than re-scanning all the deferred re-transmits.
+  YetAnotherBitVector slots_needing_first_send_{kMaxUnackedFrames,
+                                                YetAnotherBitVector::CLEARED};
+
   // A count of the number of frames in-flight (i.e., the number of active
   // entries in |pending_frames_|).
   int num_frames_in_flight_ = 0;
 
+  // The number of packets protected by each FEC Parity packet, for the frames
+  // being enqueued. Zero means no FEC Parity packets are sent.
+  int fec_group_size_ = 0;
+
   // The ID of the last frame enqueued.
   FrameId last_enqueued_frame_id_ = FrameId::leader();
 
@@ -284,6 +584,10 @@ class Sender final : public SenderPacketRouter::Sender,
   std::chrono::milliseconds target_playout_delay_;
   FrameId playout_delay_change_at_frame_id_ = FrameId::first();
 
+  // The last target playout delay requested by the Receiver that disagreed with
+  // |target_playout_delay_|, or zero if the two agree.
+  std::chrono::milliseconds receiver_requested_playout_delay_{0};
+
   // The exact arrival time of the last RTCP packet.
   Clock::time_point rtcp_packet_arrival_time_ = SenderPacketRouter::kNever;
 
@@ -292,6 +596,16 @@ class Sender final : public SenderPacketRouter::Sender,
   // round trip time has not been measured yet.
   Clock::duration round_trip_time_{0};
 
+  // A token bucket, in bytes, that limits the bandwidth spent on re-transmits.
+  // It is refilled at |max_retransmit_fraction_| times the packet router's
+  // target bitrate, and drained by each packet that is sent more than once. It
+  // may go negative, since a whole packet is sent whenever any allowance
+  // remains.
+  double max_retransmit_fraction_ = kDefaultMaxRetransmitFraction;
+  double retransmit_allowance_ = 0;
+  Clock::time_point retransmit_allowance_updated_at_ =
+      SenderPacketRouter::kNever;
+
   // Maintain current stats in a Sender Report that is ready for sending at any
   // time. This includes up-to-date lip-sync information, and packet and byte
   // count stats.
@@ -308,8 +622,15 @@ class Sender final : public SenderPacketRouter::Sender,
   FrameId picture_lost_at_frame_id_ = FrameId::leader();
   FrameId last_enqueued_key_frame_id_ = FrameId::leader();
 
+  // Whether late frames are automatically dropped.
+  bool drop_late_frames_ = false;
+
   // The current observer (optional).
   Observer* observer_ = nullptr;
+
+  // The queue through which frames are handed-off from another thread, if
+  // CreateFrameQueue() was called.
+  std::unique_ptr<FrameQueue> frame_queue_;
 };
 
 }  // namespace cast
@@ -0,0 +1,177 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the Sender's cost of choosing and producing each RTP packet under
+// simulated heavy-NACK conditions: Many frames are in-flight, none are ever
+// ACK'ed, and the Receiver repeatedly NACKs all the packets of the newest
+// frame. Choosing the next packet to send should cost the same no matter how
+// many frames are in-flight.
+//
+// Usage: sender_benchmark
+
+#include <stdint.h>
+
+#include <array>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cast/streaming/compound_rtcp_builder.h"
+#include "cast/streaming/constants.h"
+#include "cast/streaming/encoded_frame.h"
+#include "cast/streaming/environment.h"
+#include "cast/streaming/frame_id.h"
+#include "cast/streaming/packet_util.h"
+#include "cast/streaming/rtcp_common.h"
+#include "cast/streaming/rtcp_session.h"
+#include "cast/streaming/rtp_defines.h"
+#include "cast/streaming/rtp_time.h"
+#include "cast/streaming/sender.h"
+#include "cast/streaming/sender_packet_router.h"
+#include "cast/streaming/session_config.h"
+#include "cast/streaming/ssrc.h"
+#include "platform/api/time.h"
+#include "platform/base/ip_address.h"
+#include "platform/test/fake_clock.h"
+#include "platform/test/fake_task_runner.h"
+#include "util/osp_logging.h"
+
+namespace openscreen {
+namespace cast {
+namespace {
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+constexpr Ssrc kSenderSsrc = 1;
+constexpr Ssrc kReceiverSsrc = 2;
+constexpr int kRtpTimebase = 90000;
+constexpr milliseconds kTargetPlayoutDelay{400};
+constexpr std::array<uint8_t, 16> kAesKey{};
+constexpr std::array<uint8_t, 16> kCastIvMask{};
+
+// Frames are 1 ms apart, in media time, so that the maximum number of frames
+// can be in-flight without exceeding the Sender's in-flight media duration
+// limit.
+constexpr int kRtpTicksPerFrame = kRtpTimebase / 1000;
+
+// The size of each frame, which is split into several packets.
+constexpr int kPayloadBytesPerFrame = 10000;
+
+// The number of NACK+re-send rounds measured for each configuration.
+constexpr int kRounds = 2000;
+
+// The SenderPacketRouter is configured to never be the bottleneck.
+constexpr int kPacketsPerBurst = 10000;
+constexpr milliseconds kBurstInterval{1};
+
+// An Environment that counts the outbound RTP packets, and drops all outbound
+// packets.
+class CountingEnvironment : public Environment {
+ public:
+  explicit CountingEnvironment(TaskRunner* task_runner)
+      : Environment(&FakeClock::now, task_runner) {}
+  ~CountingEnvironment() override = default;
+
+  int64_t packets_sent() const { return packets_sent_; }
+
+  void SendPacket(absl::Span<const uint8_t> packet) override {
+    if (InspectPacketForRouting(packet).first == ApparentPacketType::RTP) {
+      ++packets_sent_;
+    }
+  }
+
+ private:
+  int64_t packets_sent_ = 0;
+};
+
+// Enqueues |frames_in_flight| frames, sends them all once, and then measures
+// the average time it takes for the Sender to process a NACK for the newest
+// frame and re-send all of its packets. Returns nanoseconds per packet sent.
+double MeasureNanosecondsPerPacket(int frames_in_flight) {
+  FakeClock clock(Clock::now());
+  FakeTaskRunner task_runner(&clock);
+  CountingEnvironment environment(&task_runner);
+  const IPEndpoint receiver_endpoint{IPAddress(192, 168, 1, 2), 2344};
+  environment.set_remote_endpoint(receiver_endpoint);
+  SenderPacketRouter router(&environment, kPacketsPerBurst, kBurstInterval);
+  Sender sender(&environment, &router,
+                {/* .sender_ssrc = */ kSenderSsrc,
+                 /* .receiver_ssrc = */ kReceiverSsrc,
+                 /* .rtp_timebase = */ kRtpTimebase,
+                 /* .channels = */ 1,
+                 /* .target_playout_delay = */ kTargetPlayoutDelay,
+                 /* .aes_secret_key = */ kAesKey,
+                 /* .aes_iv_mask = */ kCastIvMask},
+                RtpPayloadType::kVideoVp8);
+
+  std::vector<uint8_t> payload(kPayloadBytesPerFrame, 0x42);
+  FrameId newest_frame_id = FrameId::first();
+  for (int i = 0; i < frames_in_flight; ++i) {
+    EncodedFrame frame;
+    frame.dependency = (i == 0) ? EncodedFrame::KEY_FRAME
+                                : EncodedFrame::DEPENDS_ON_ANOTHER;
+    frame.frame_id = sender.GetNextFrameId();
+    frame.referenced_frame_id =
+        (i == 0) ? frame.frame_id : (frame.frame_id - 1);
+    frame.rtp_timestamp =
+        RtpTimeTicks() + RtpTimeDelta::FromTicks(kRtpTicksPerFrame * i);
+    frame.reference_time =
+        FakeClock::now() - milliseconds(frames_in_flight - i);
+    frame.data = absl::Span<uint8_t>(payload);
+    const Sender::EnqueueFrameResult result = sender.EnqueueFrame(frame);
+    OSP_CHECK_EQ(result, Sender::OK);
+    newest_frame_id = frame.frame_id;
+  }
+  clock.Advance(kBurstInterval);
+  OSP_CHECK_EQ(environment.packets_sent() % frames_in_flight, 0);
+  const int64_t packets_per_frame =
+      environment.packets_sent() / frames_in_flight;
+
+  // Prepare the RTCP NACK packets to be "received" from the Receiver, one per
+  // round. The checkpoint never advances, so all frames remain in-flight.
+  RtcpSession rtcp_session(kSenderSsrc, kReceiverSsrc, FakeClock::now());
+  CompoundRtcpBuilder rtcp_builder(&rtcp_session);
+  rtcp_builder.SetPlayoutDelay(kTargetPlayoutDelay);
+  uint8_t buffer[kMaxRtpPacketSizeForIpv4UdpOnEthernet];
+  Environment::PacketConsumer* const consumer = &router;
+
+  const int64_t packets_sent_before = environment.packets_sent();
+  BenchmarkClock::duration elapsed{};
+  for (int i = 0; i < kRounds; ++i) {
+    rtcp_builder.IncludeFeedbackInNextPacket(
+        {PacketNack{newest_frame_id, kAllPacketsLost}}, {});
+    const absl::Span<uint8_t> packet =
+        rtcp_builder.BuildPacket(FakeClock::now(), buffer);
+    std::vector<uint8_t> rtcp_packet(packet.begin(), packet.end());
+
+    const auto start = BenchmarkClock::now();
+    consumer->OnReceivedPacket(receiver_endpoint, FakeClock::now(),
+                               std::move(rtcp_packet));
+    clock.Advance(kBurstInterval);
+    elapsed += BenchmarkClock::now() - start;
+  }
+  const int64_t packets_resent =
+      environment.packets_sent() - packets_sent_before;
+  OSP_CHECK_EQ(packets_resent, kRounds * packets_per_frame);
+
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         packets_resent;
+}
+
+}  // namespace
+}  // namespace cast
+}  // namespace openscreen
+
+int main(int argc, char* argv[]) {
+  using openscreen::cast::kMaxUnackedFrames;
+  using openscreen::cast::MeasureNanosecondsPerPacket;
+
+  std::printf("%-24s %12s\n", "frames in-flight", "ns/packet");
+  for (int frames_in_flight : {1, 10, 60, kMaxUnackedFrames - 1}) {
+    std::printf("%-24d %12.1f\n", frames_in_flight,
+                MeasureNanosecondsPerPacket(frames_in_flight));
+  }
+  return 0;
+}
@@ -16,6 +16,18 @@
 namespace openscreen {
 namespace cast {
 
+using openscreen::operator<<;  // For std::chrono::duration logging.
+
+namespace {
+
+// The maximum number of packets to assemble before handing them to the
+// Environment for sending. Usually, this means all packets in a burst are sent
+// together; but this upper-bound prevents the router from holding an
+// unreasonably large buffer when configured for huge bursts.
+constexpr int kMaxPacketsPerSend = 64;
+
+}  // namespace
+
 SenderPacketRouter::SenderPacketRouter(Environment* environment,
                                        int max_burst_bitrate)
     : SenderPacketRouter(
@@ -33,12 +45,17 @@ SenderPacketRouter::SenderPacketRouter(Environment* environment,
                          environment->now()),
       environment_(environment),
       packet_buffer_size_(environment->GetMaxPacketSize()),
-      packet_buffer_(new uint8_t[packet_buffer_size_]),
+      burst_buffer_size_(
+          packet_buffer_size_ *
+          std::max(1, std::min(max_packets_per_burst, kMaxPacketsPerSend))),
+      burst_buffer_(new uint8_t[burst_buffer_size_]),
       max_packets_per_burst_(max_packets_per_burst),
       burst_interval_(burst_interval),
       max_burst_bitrate_(ComputeMaxBurstBitrate(packet_buffer_size_,
                                                 max_packets_per_burst_,
                                                 burst_interval_)),
+      packets_per_burst_(max_packets_per_burst_),
+      current_burst_interval_(burst_interval_),
       alarm_(environment_->now_function(), environment_->task_runner()) {
   OSP_DCHECK(environment_);
   OSP_DCHECK_GT(packet_buffer_size_, kRequiredNetworkPacketSize);
@@ -58,12 +75,16 @@ void SenderPacketRouter::OnSenderCreated(Ssrc receiver_ssrc, Sender* sender) {
     // Sort the list of Senders so that they are iterated in priority order.
     std::sort(senders_.begin(), senders_.end());
   }
+  drr_index_ = 0;
+  drr_turn_in_progress_ = false;
 }
 
 void SenderPacketRouter::OnSenderDestroyed(Ssrc receiver_ssrc) {
   const auto it = FindEntry(receiver_ssrc);
   OSP_DCHECK(it != senders_.end());
   senders_.erase(it);
+  drr_index_ = 0;
+  drr_turn_in_progress_ = false;
 
   // If there are no longer any Senders, suspend receiving RTCP packets.
   if (senders_.empty()) {
@@ -71,6 +92,60 @@ void SenderPacketRouter::OnSenderDestroyed(Ssrc receiver_ssrc) {
   }
 }
 
+void SenderPacketRouter::SetCongestionController(
+    std::unique_ptr<CongestionController> controller) {
+  congestion_controller_ = std::move(controller);
+  UpdatePacing();
+}
+
+int SenderPacketRouter::GetTargetBitrate() const {
+  return congestion_controller_ ? congestion_controller_->GetTargetBitrate()
+                                : max_burst_bitrate_;
+}
+
+void SenderPacketRouter::OnReceiverReport(
+    Clock::time_point arrival_time,
+    Clock::duration round_trip_time,
+    const RtcpReportBlock& receiver_report) {
+  if (!congestion_controller_) {
+    return;
+  }
+  congestion_controller_->OnReceiverReport(
+      arrival_time, round_trip_time,
+      static_cast<double>(receiver_report.packet_fraction_lost_numerator) /
+          RtcpReportBlock::kPacketFractionLostDenominator);
+  UpdatePacing();
+}
+
+void SenderPacketRouter::SetSchedulingMode(SchedulingMode mode) {
+  scheduling_mode_ = mode;
+  for (SenderEntry& entry : senders_) {
+    entry.deficit = 0;
+  }
+  drr_index_ = 0;
+  drr_turn_in_progress_ = false;
+}
+
+void SenderPacketRouter::SetSenderWeight(Ssrc receiver_ssrc,
+                                         int weight,
+                                         bool send_first) {
+  OSP_DCHECK_GT(weight, 0);
+  const auto it = FindEntry(receiver_ssrc);
+  OSP_DCHECK(it != senders_.end());
+  it->weight = weight;
+  it->send_first = send_first;
+}
+
+SenderPacketRouter::SenderMetrics SenderPacketRouter::GetSenderMetrics(
+    Ssrc receiver_ssrc) const {
+  const auto it = std::find_if(senders_.begin(), senders_.end(),
+                               [receiver_ssrc](const SenderEntry& entry) {
+                                 return entry.receiver_ssrc == receiver_ssrc;
+                               });
+  OSP_DCHECK(it != senders_.end());
+  return it->metrics;
+}
+
 void SenderPacketRouter::RequestRtcpSend(Ssrc receiver_ssrc) {
   const auto it = FindEntry(receiver_ssrc);
   OSP_DCHECK(it != senders_.end());
@@ -82,6 +157,7 @@ void SenderPacketRouter::RequestRtpSend(Ssrc receiver_ssrc) {
   const auto it = FindEntry(receiver_ssrc);
   OSP_DCHECK(it != senders_.end());
   it->next_rtp_send_time = Alarm::kImmediately;
+  it->waiting_since = std::min(it->waiting_since, environment_->now());
   ScheduleNextBurst();
 }
 
@@ -125,7 +201,7 @@ void SenderPacketRouter::ScheduleNextBurst() {
   // Determine the next burst time by scanning for the earliest of the
   // next-scheduled send times for each Sender.
   const Clock::time_point earliest_allowed_burst_time =
-      last_burst_time_ + burst_interval_;
+      last_burst_time_ + current_burst_interval_;
   Clock::time_point next_burst_time = kNever;
   for (const SenderEntry& entry : senders_) {
     const auto next_send_time =
@@ -155,19 +231,102 @@ void SenderPacketRouter::SendBurstOfPackets() {
   // on the number to send. Practically, this will always be limited by the
   // number of Senders; so, this won't be a huge number of packets.
   const Clock::time_point burst_time = environment_->now();
+  for (const SenderEntry& entry : senders_) {
+    entry.sender->OnBurstStarting(burst_time);
+  }
   const int num_rtcp_packets_sent = SendJustTheRtcpPackets(burst_time);
   // Now send all the RTP packets, up to the maximum number allowed in a burst.
   // Higher priority Senders' RTP packets are sent first.
   const int num_rtp_packets_sent = SendJustTheRtpPackets(
-      burst_time, max_packets_per_burst_ - num_rtcp_packets_sent);
+      burst_time, packets_per_burst_ - num_rtcp_packets_sent);
+  FlushBurst();
   last_burst_time_ = burst_time;
 
   BandwidthEstimator::OnBurstComplete(
       num_rtcp_packets_sent + num_rtp_packets_sent, burst_time);
+  if (congestion_controller_) {
+    congestion_controller_->OnNetworkBandwidthEstimate(
+        burst_time, ComputeNetworkBandwidth());
+    UpdatePacing();
+  }
 
   ScheduleNextBurst();
 }
 
+void SenderPacketRouter::UpdatePacing() {
+  if (!congestion_controller_) {
+    packets_per_burst_ = max_packets_per_burst_;
+    current_burst_interval_ = burst_interval_;
+    BandwidthEstimator::SetPacing(packets_per_burst_, current_burst_interval_);
+    return;
+  }
+
+  // Compute how many packets can be sent per |burst_interval_| at the pacing
+  // bitrate, assuming all packets are maximum-sized.
+  const double pacing_bitrate =
+      kPacingFactor * congestion_controller_->GetTargetBitrate();
+  const double bits_per_packet = 8.0 * packet_buffer_size_;
+  const double packets_per_second = pacing_bitrate / bits_per_packet;
+  const int packets_per_burst = static_cast<int>(
+      packets_per_second * burst_interval_.count() / 1000);
+  if (packets_per_burst >= 1) {
+    packets_per_burst_ = std::min(packets_per_burst, max_packets_per_burst_);
+    current_burst_interval_ = burst_interval_;
+  } else {
+    // Too low a bitrate for one packet per |burst_interval_|: Send one packet
+    // per burst, less frequently.
+    packets_per_burst_ = 1;
+    current_burst_interval_ = std::min(
+        kMaxBurstInterval,
+        milliseconds(static_cast<int64_t>(1000 / packets_per_second) + 1));
+  }
+
+  // The BandwidthEstimator must model the paced capacity, or else it would see
+  // the paced bursts as a low utilization of the network, and over-estimate.
+  BandwidthEstimator::SetPacing(packets_per_burst_, current_burst_interval_);
+}
+
+absl::Span<uint8_t> SenderPacketRouter::GetBufferForNextPacket() {
+  if (burst_buffer_size_ - burst_buffer_used_ < packet_buffer_size_) {
+    FlushBurst();
+  }
+  return absl::Span<uint8_t>(burst_buffer_.get() + burst_buffer_used_,
+                             packet_buffer_size_);
+}
+
+absl::Span<uint8_t> SenderPacketRouter::GetBufferForNextPackets() {
+  if (burst_buffer_size_ - burst_buffer_used_ < packet_buffer_size_) {
+    FlushBurst();
+  }
+  return absl::Span<uint8_t>(burst_buffer_.get() + burst_buffer_used_,
+                             burst_buffer_size_ - burst_buffer_used_);
+}
+
+void SenderPacketRouter::AppendToBurst(absl::Span<const uint8_t> packet) {
+  const uint8_t* const packet_end = packet.data() + packet.size();
+  OSP_DCHECK_GE(packet.data(), burst_buffer_.get() + burst_buffer_used_);
+  OSP_DCHECK_LE(packet_end, burst_buffer_.get() + burst_buffer_size_);
+  burst_buffer_used_ = static_cast<int>(packet_end - burst_buffer_.get());
+  burst_packets_.push_back(packet);
+}
+
+void SenderPacketRouter::OnPacketsAppendedToBurst() {
+  OSP_DCHECK(!burst_packets_.empty());
+  const absl::Span<const uint8_t> last_packet = burst_packets_.back();
+  const uint8_t* const packets_end = last_packet.data() + last_packet.size();
+  OSP_DCHECK_GE(packets_end, burst_buffer_.get() + burst_buffer_used_);
+  OSP_DCHECK_LE(packets_end, burst_buffer_.get() + burst_buffer_size_);
+  burst_buffer_used_ = static_cast<int>(packets_end - burst_buffer_.get());
+}
+
+void SenderPacketRouter::FlushBurst() {
+  if (!burst_packets_.empty()) {
+    environment_->SendPackets(burst_packets_);
+    burst_packets_.clear();
+  }
+  burst_buffer_used_ = 0;
+}
+
 int SenderPacketRouter::SendJustTheRtcpPackets(Clock::time_point send_time) {
   int num_sent = 0;
   for (SenderEntry& entry : senders_) {
@@ -181,11 +340,10 @@ int SenderPacketRouter::SendJustTheRtcpPackets(Clock::time_point send_time) {
     // burst would mean that all but the last one are old/irrelevant snapshots
     // of Sender state, and this would just thrash/confuse the Receiver.
     const absl::Span<uint8_t> packet =
-        entry.sender->GetRtcpPacketForImmediateSend(
-            send_time,
-            absl::Span<uint8_t>(packet_buffer_.get(), packet_buffer_size_));
+        entry.sender->GetRtcpPacketForImmediateSend(send_time,
+                                                    GetBufferForNextPacket());
     if (!packet.empty()) {
-      environment_->SendPacket(packet);
+      AppendToBurst(packet);
       entry.next_rtcp_send_time = send_time + kRtcpReportInterval;
       ++num_sent;
     }
@@ -196,6 +354,10 @@ int SenderPacketRouter::SendJustTheRtcpPackets(Clock::time_point send_time) {
 
 int SenderPacketRouter::SendJustTheRtpPackets(Clock::time_point send_time,
                                               int num_packets_to_send) {
+  const bool is_fair = (scheduling_mode_ == SchedulingMode::kFairQueuing);
+
+  // Serve the Senders in priority order: All of them in kStrictPriority mode,
+  // or just the "send first" ones in kFairQueuing mode.
   int num_sent = 0;
   for (SenderEntry& entry : senders_) {
     if (num_sent >= num_packets_to_send) {
@@ -204,18 +366,112 @@ int SenderPacketRouter::SendJustTheRtpPackets(Clock::time_point send_time,
     if (entry.next_rtp_send_time > send_time) {
       continue;
     }
+    if (is_fair && !entry.send_first) {
+      continue;
+    }
+    bool drained;
+    num_sent += SendRtpPacketsFrom(&entry, send_time,
+                                   num_packets_to_send - num_sent, &drained);
+  }
+
+  if (is_fair && num_sent < num_packets_to_send) {
+    num_sent += SendRtpPacketsFairly(send_time, num_packets_to_send - num_sent);
+  }
+
+  return num_sent;
+}
 
-    for (; num_sent < num_packets_to_send; ++num_sent) {
-      const absl::Span<uint8_t> packet =
-          entry.sender->GetRtpPacketForImmediateSend(
-              send_time,
-              absl::Span<uint8_t>(packet_buffer_.get(), packet_buffer_size_));
-      if (packet.empty()) {
-        break;
-      }
-      environment_->SendPacket(packet);
+int SenderPacketRouter::SendRtpPacketsFairly(Clock::time_point send_time,
+                                             int num_packets_to_send) {
+  // Deficit round robin: Each Sender's turn allows it to send up to |weight|
+  // packets, plus whatever it could not send in its prior turn. Packets are
+  // counted instead of bytes, since nearly all RTP packets are max-sized. If a
+  // burst ends in the middle of a Sender's turn, the turn continues in the next
+  // burst.
+  const int num_senders = static_cast<int>(senders_.size());
+  int num_sent = 0;
+  int num_unproductive_visits = 0;
+  while (num_sent < num_packets_to_send &&
+         num_unproductive_visits < num_senders) {
+    if (drr_index_ >= num_senders) {
+      drr_index_ = 0;
     }
-    entry.next_rtp_send_time = entry.sender->GetRtpResumeTime();
+    SenderEntry& entry = senders_[drr_index_];
+
+    // Skip Senders that have nothing to send, and do not allow them to
+    // accumulate credit for later.
+    if (entry.send_first || entry.next_rtp_send_time > send_time) {
+      entry.deficit = 0;
+      drr_turn_in_progress_ = false;
+      ++drr_index_;
+      ++num_unproductive_visits;
+      continue;
+    }
+
+    if (!drr_turn_in_progress_) {
+      entry.deficit += entry.weight;
+      drr_turn_in_progress_ = true;
+    }
+    const int max_packets =
+        std::min(entry.deficit, num_packets_to_send - num_sent);
+    bool drained;
+    const int count =
+        SendRtpPacketsFrom(&entry, send_time, max_packets, &drained);
+    num_sent += count;
+    entry.deficit -= count;
+    num_unproductive_visits = (count == 0) ? (num_unproductive_visits + 1) : 0;
+
+    if (drained || entry.next_rtp_send_time > send_time) {
+      entry.deficit = 0;
+    }
+    if (entry.deficit == 0) {
+      drr_turn_in_progress_ = false;
+      ++drr_index_;
+    }
+  }
+
+  return num_sent;
+}
+
+int SenderPacketRouter::SendRtpPacketsFrom(SenderEntry* entry,
+                                           Clock::time_point send_time,
+                                           int max_packets,
+                                           bool* drained) {
+  OSP_DCHECK_GT(max_packets, 0);
+
+  // Have the Sender write as many packets as it can into the burst buffer at
+  // once. This repeats only when the burst buffer fills up and must be flushed,
+  // or if the Sender provides packets one at a time.
+  int num_sent = 0;
+  *drained = false;
+  while (num_sent < max_packets) {
+    const int count = entry->sender->GetRtpPacketsForImmediateSend(
+        send_time, max_packets - num_sent, GetBufferForNextPackets(),
+        &burst_packets_);
+    if (count == 0) {
+      *drained = true;
+      break;
+    }
+    OSP_DCHECK_LE(count, max_packets - num_sent);
+    OnPacketsAppendedToBurst();
+    num_sent += count;
+  }
+  entry->next_rtp_send_time = entry->sender->GetRtpResumeTime();
+
+  // Update the metrics, and then track when the next packet started waiting:
+  // either now, if packets remain ready to send; or when the Sender will resume
+  // sending.
+  if (num_sent > 0) {
+    const Clock::duration queueing_delay =
+        (entry->waiting_since < send_time) ? (send_time - entry->waiting_since)
+                                           : Clock::duration::zero();
+    entry->metrics.num_packets_sent += num_sent;
+    entry->metrics.total_queueing_delay += num_sent * queueing_delay;
+    entry->metrics.max_queueing_delay =
+        std::max(entry->metrics.max_queueing_delay, queueing_delay);
+  }
+  if (*drained || entry->next_rtp_send_time > send_time) {
+    entry->waiting_since = std::max(entry->next_rtp_send_time, send_time);
   }
 
   return num_sent;
@@ -257,6 +513,24 @@ int SenderPacketRouter::ComputeMaxBurstBitrate(int packet_size,
   return saturate_cast<int>(max_bits_per_burst * bursts_per_second);
 }
 
+int SenderPacketRouter::Sender::GetRtpPacketsForImmediateSend(
+    Clock::time_point send_time,
+    int max_packets,
+    absl::Span<uint8_t> buffer,
+    std::vector<absl::Span<const uint8_t>>* packets) {
+  OSP_DCHECK_GT(max_packets, 0);
+  const absl::Span<uint8_t> packet =
+      GetRtpPacketForImmediateSend(send_time, buffer);
+  if (packet.empty()) {
+    return 0;
+  }
+  packets->push_back(packet);
+  return 1;
+}
+
+void SenderPacketRouter::Sender::OnBurstStarting(
+    Clock::time_point burst_time) {}
+
 SenderPacketRouter::Sender::~Sender() = default;
 
 // static
@@ -264,6 +538,10 @@ constexpr int SenderPacketRouter::kDefaultMaxBurstBitrate;
 // static
 constexpr milliseconds SenderPacketRouter::kDefaultBurstInterval;
 // static
+constexpr double SenderPacketRouter::kPacingFactor;
+// static
+constexpr milliseconds SenderPacketRouter::kMaxBurstInterval;
+// static
 constexpr Clock::time_point SenderPacketRouter::kNever;
 
 }  // namespace cast
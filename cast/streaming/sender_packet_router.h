@@ -13,7 +13,9 @@
 
 #include "absl/types/span.h"
 #include "cast/streaming/bandwidth_estimator.h"
+#include "cast/streaming/congestion_controller.h"
 #include "cast/streaming/environment.h"
+#include "cast/streaming/rtcp_common.h"
 #include "cast/streaming/ssrc.h"
 #include "platform/api/time.h"
 #include "util/alarm.h"
@@ -38,6 +40,20 @@ namespace cast {
 // packets can be sent together as one larger transmission unit, and this can be
 // critical for good performance over shared-medium networks (such as 802.11
 // WiFi). https://en.wikipedia.org/wiki/Frame-bursting
+//
+// Congestion control: Optionally, a CongestionController can be installed to
+// decide the target bitrate for all media. Then, the number of packets per
+// burst, and the time between bursts, are adjusted to pace the packets at a
+// rate a little above the target bitrate. Otherwise, bursts are paced at the
+// maximum burst bitrate.
+//
+// Scheduling among Senders: By default, each burst's RTP packets are taken
+// from the Senders in strict priority order (as implied by their SSRCs), which
+// means a high-bitrate Sender can starve the lower-priority ones. In the
+// kFairQueuing mode, the packets are instead shared among the Senders in
+// proportion to configurable weights, using deficit round robin; except that
+// the Senders marked as "send first" (e.g., audio) are always served before all
+// others.
 class SenderPacketRouter : public BandwidthEstimator,
                            public Environment::PacketConsumer {
  public:
@@ -60,16 +76,57 @@ class SenderPacketRouter : public BandwidthEstimator,
         Clock::time_point send_time,
         absl::Span<uint8_t> buffer) = 0;
 
+    // Populates the given |buffer| with up to |max_packets| RTP packets,
+    // back-to-back, that will be sent immediately. Appends each packet to
+    // |packets|, and returns the number appended, or zero if nothing is ready
+    // to send. |buffer| always has room for at least one packet. The default
+    // implementation provides at most one packet per call, from
+    // GetRtpPacketForImmediateSend().
+    virtual int GetRtpPacketsForImmediateSend(
+        Clock::time_point send_time,
+        int max_packets,
+        absl::Span<uint8_t> buffer,
+        std::vector<absl::Span<const uint8_t>>* packets);
+
     // Returns the point-in-time at which RTP sending should resume, or kNever
     // if it should be suspended until an explicit call to RequestRtpSend(). The
     // implementation may return a value on or before "now" to indicate an
     // immediate resume is desired.
     virtual Clock::time_point GetRtpResumeTime() = 0;
 
+    // Called at the start of each burst, before any of the Senders are asked
+    // for packets. This gives a Sender the chance to take in any work handed
+    // off to it from other threads, and call RequestRtpSend() for it to be
+    // included in the burst. The default implementation does nothing.
+    virtual void OnBurstStarting(Clock::time_point burst_time);
+
    protected:
     virtual ~Sender();
   };
 
+  // How the RTP packets in each burst are shared among the Senders.
+  enum class SchedulingMode {
+    // Senders are served in strict priority order.
+    kStrictPriority,
+
+    // The "send first" Senders are served in strict priority order, and then
+    // all other Senders share the rest of the burst via deficit round robin.
+    kFairQueuing,
+  };
+
+  // Per-Sender metrics, for monitoring how well the scheduling is working.
+  struct SenderMetrics {
+    // The total number of RTP packets sent.
+    int64_t num_packets_sent = 0;
+
+    // The sum, and maximum, of the amount of time each RTP packet waited to be
+    // sent. A packet starts waiting when its Sender first has packets ready to
+    // send (e.g., upon RequestRtpSend()), and stops waiting when it is sent in
+    // a burst.
+    Clock::duration total_queueing_delay{};
+    Clock::duration max_queueing_delay{};
+  };
+
   // Constructs an instance with default burst parameters appropriate for the
   // given |max_burst_bitrate|.
   explicit SenderPacketRouter(Environment* environment,
@@ -86,12 +143,52 @@ class SenderPacketRouter : public BandwidthEstimator,
   int max_packet_size() const { return packet_buffer_size_; }
   int max_burst_bitrate() const { return max_burst_bitrate_; }
 
+  // The current burst parameters, which only differ from the ones provided to
+  // the constructor if a CongestionController is installed.
+  int packets_per_burst() const { return packets_per_burst_; }
+  std::chrono::milliseconds burst_interval() const {
+    return current_burst_interval_;
+  }
+
+  // Installs the |controller| that decides the target bitrate and, therefore,
+  // the burst parameters. Passing nullptr reverts to pacing at
+  // max_burst_bitrate().
+  void SetCongestionController(
+      std::unique_ptr<CongestionController> controller);
+
+  // Returns the current target bitrate for all media sent through this router,
+  // in bits per second. Applications should configure their encoders such that
+  // their combined output follows this. This is max_burst_bitrate() if no
+  // CongestionController is installed.
+  int GetTargetBitrate() const;
+
+  // Called by a Sender for each Receiver Report, with the Sender's
+  // |round_trip_time| measurement that was based on it.
+  void OnReceiverReport(Clock::time_point arrival_time,
+                        Clock::duration round_trip_time,
+                        const RtcpReportBlock& receiver_report);
+
   // Called from a Sender constructor/destructor to register/deregister a Sender
   // instance that processes RTP/RTCP packets from a Receiver having the given
   // SSRC.
   void OnSenderCreated(Ssrc receiver_ssrc, Sender* client);
   void OnSenderDestroyed(Ssrc receiver_ssrc);
 
+  SchedulingMode scheduling_mode() const { return scheduling_mode_; }
+  void SetSchedulingMode(SchedulingMode mode);
+
+  // Configures the scheduling of the RTP packets of a registered Sender in the
+  // kFairQueuing mode: |weight| is the Sender's share of each burst relative to
+  // the other Senders; and, if |send_first| is true, all of its packets are
+  // sent before those of the other Senders. Senders that require little
+  // bandwidth but are very sensitive to delay, such as audio, should be marked
+  // "send first." By default, Senders have a weight of 1 and are not marked
+  // "send first."
+  void SetSenderWeight(Ssrc receiver_ssrc, int weight, bool send_first = false);
+
+  // Returns the metrics for a registered Sender.
+  SenderMetrics GetSenderMetrics(Ssrc receiver_ssrc) const;
+
   // Requests an immediate send of a RTCP packet, and then RTCP sending will
   // repeat at regular intervals (see kRtcpSendInterval) until the Sender is
   // de-registered.
@@ -114,6 +211,16 @@ class SenderPacketRouter : public BandwidthEstimator,
   // This value came from the original Chrome Cast Streaming implementation.
   static constexpr std::chrono::milliseconds kDefaultBurstInterval{10};
 
+  // When a CongestionController is installed, packets are paced at this
+  // multiple of the target bitrate. This allows for the short-term variance in
+  // the encoders' output (e.g., key frames) and for re-transmits, without
+  // backing-up frames in the Senders.
+  static constexpr double kPacingFactor = 1.5;
+
+  // When pacing at a low bitrate, the time between bursts is stretched (up to
+  // this limit) to keep at least one packet in each burst.
+  static constexpr std::chrono::milliseconds kMaxBurstInterval{100};
+
   // A special time_point value representing "never."
   static constexpr Clock::time_point kNever = Clock::time_point::max();
 
@@ -124,6 +231,18 @@ class SenderPacketRouter : public BandwidthEstimator,
     Clock::time_point next_rtcp_send_time;
     Clock::time_point next_rtp_send_time;
 
+    // Scheduling configuration and deficit round robin state. The deficit is
+    // the number of packets the Sender may still send in its current turn.
+    int weight = 1;
+    bool send_first = false;
+    int deficit = 0;
+
+    // When the Sender's oldest unsent RTP packet started waiting to be sent, or
+    // kNever if the Sender has nothing to send.
+    Clock::time_point waiting_since = kNever;
+
+    SenderMetrics metrics;
+
     // Entries are ordered by the transmission priority (high→low), as implied
     // by their SSRC. See ssrc.h for details.
     bool operator<(const SenderEntry& other) const {
@@ -149,6 +268,30 @@ class SenderPacketRouter : public BandwidthEstimator,
   // Performs a burst-send of packets. This is called whevener the Alarm fires.
   void SendBurstOfPackets();
 
+  // Re-computes |packets_per_burst_| and |current_burst_interval_| from the
+  // CongestionController's target bitrate.
+  void UpdatePacing();
+
+  // Returns the region of |burst_buffer_| into which the next packet should be
+  // written. If not enough space remains, the packets already assembled are
+  // sent first.
+  absl::Span<uint8_t> GetBufferForNextPacket();
+
+  // Like GetBufferForNextPacket(), but returns all of the remaining space in
+  // |burst_buffer_|, for writing one or more packets.
+  absl::Span<uint8_t> GetBufferForNextPackets();
+
+  // Adds a |packet|, just written into the region returned by
+  // GetBufferForNextPacket(), to the set of packets pending transmission.
+  void AppendToBurst(absl::Span<const uint8_t> packet);
+
+  // Accounts for the packets that were just appended to |burst_packets_|,
+  // having been written into the region returned by GetBufferForNextPackets().
+  void OnPacketsAppendedToBurst();
+
+  // Sends all pending packets, in one call to Environment::SendPackets().
+  void FlushBurst();
+
   // Send an RTCP packet from each Sender that has one ready, and return the
   // number of packets sent.
   int SendJustTheRtcpPackets(Clock::time_point send_time);
@@ -158,6 +301,20 @@ class SenderPacketRouter : public BandwidthEstimator,
   int SendJustTheRtpPackets(Clock::time_point send_time,
                             int num_packets_to_send);
 
+  // Helper for SendJustTheRtpPackets() in kFairQueuing mode, which sends the
+  // RTP packets from the Senders that are not marked "send first."
+  int SendRtpPacketsFairly(Clock::time_point send_time,
+                           int num_packets_to_send);
+
+  // Has the Sender in |entry| provide up to |max_packets| RTP packets for the
+  // burst, then updates its next send time and metrics. Returns the number of
+  // packets sent, and sets |drained| to whether the Sender ran out of packets
+  // to send.
+  int SendRtpPacketsFrom(SenderEntry* entry,
+                         Clock::time_point send_time,
+                         int max_packets,
+                         bool* drained);
+
   // Returns the maximum number of packets to send in one burst, based on the
   // given parameters.
   static int ComputeMaxPacketsPerBurst(
@@ -172,11 +329,24 @@ class SenderPacketRouter : public BandwidthEstimator,
 
   Environment* const environment_;
   const int packet_buffer_size_;
-  const std::unique_ptr<uint8_t[]> packet_buffer_;
+
+  // Packets are assembled back-to-back in this buffer, and then they are all
+  // sent together. This minimizes the per-packet system call overhead.
+  const int burst_buffer_size_;
+  const std::unique_ptr<uint8_t[]> burst_buffer_;
+  int burst_buffer_used_ = 0;
+  std::vector<absl::Span<const uint8_t>> burst_packets_;
+
   const int max_packets_per_burst_;
   const std::chrono::milliseconds burst_interval_;
   const int max_burst_bitrate_;
 
+  // The optional congestion controller, and the burst parameters currently in
+  // effect.
+  std::unique_ptr<CongestionController> congestion_controller_;
+  int packets_per_burst_;
+  std::chrono::milliseconds current_burst_interval_;
+
   // Schedules the task that calls back into this SenderPacketRouter at a later
   // time to send the next burst of packets.
   Alarm alarm_;
@@ -185,6 +355,13 @@ class SenderPacketRouter : public BandwidthEstimator,
   // maintained in order of the priority implied by the Sender SSRC's.
   SenderEntries senders_;
 
+  SchedulingMode scheduling_mode_ = SchedulingMode::kStrictPriority;
+
+  // Deficit round robin state: The index of the Sender in |senders_| whose
+  // turn it is, and whether its turn started in a prior burst.
+  int drr_index_ = 0;
+  bool drr_turn_in_progress_ = false;
+
   // The last time a burst of packets was sent. This is used to determine the
   // next burst time.
   Clock::time_point last_burst_time_ = Clock::time_point::min();
@@ -4,6 +4,10 @@
 
 #include "cast/streaming/sender_packet_router.h"
 
+#include <map>
+#include <memory>
+#include <utility>
+
 #include "cast/streaming/constants.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -126,11 +130,19 @@ absl::Span<uint8_t> ToEmptyPacketBuffer(Clock::time_point send_time,
 class MockEnvironment : public Environment {
  public:
   MockEnvironment(ClockNowFunctionPtr now_function, TaskRunner* task_runner)
-      : Environment(now_function, task_runner) {}
+      : Environment(now_function, task_runner) {
+    ON_CALL(*this, SendPackets(_))
+        .WillByDefault(
+            Invoke([this](absl::Span<const absl::Span<const uint8_t>> packets) {
+              Environment::SendPackets(packets);
+            }));
+  }
 
   ~MockEnvironment() override = default;
 
   MOCK_METHOD1(SendPacket, void(absl::Span<const uint8_t> packet));
+  MOCK_METHOD1(SendPackets,
+               void(absl::Span<const absl::Span<const uint8_t>> packets));
 };
 
 class MockSender : public SenderPacketRouter::Sender {
@@ -154,6 +166,83 @@ class MockSender : public SenderPacketRouter::Sender {
   MOCK_METHOD(Clock::time_point, GetRtpResumeTime, (), (override));
 };
 
+// A MockSender that has more RTP packets to send (by default, an unlimited
+// number), and provides as many as allowed in each call to
+// GetRtpPacketsForImmediateSend().
+class BatchingMockSender : public MockSender {
+ public:
+  explicit BatchingMockSender(char flag = 'V') : flag_(flag) {}
+
+  int num_batch_calls() const { return num_batch_calls_; }
+  int packets_remaining() const { return packets_remaining_; }
+  void set_packets_remaining(int count) { packets_remaining_ = count; }
+
+  // Configures GetRtpResumeTime() to request sending resume immediately while
+  // there are packets remaining.
+  void ResumeWhilePacketsRemain() {
+    ON_CALL(*this, GetRtpResumeTime()).WillByDefault(Invoke([this] {
+      return (packets_remaining_ != 0) ? Alarm::kImmediately
+                                       : SenderPacketRouter::kNever;
+    }));
+  }
+
+  int GetRtpPacketsForImmediateSend(
+      Clock::time_point send_time,
+      int max_packets,
+      absl::Span<uint8_t> buffer,
+      std::vector<absl::Span<const uint8_t>>* packets) override {
+    ++num_batch_calls_;
+    int count = 0;
+    for (; count < max_packets && packets_remaining_ != 0; ++count) {
+      const absl::Span<uint8_t> packet =
+          MakeFakePacketWithFlag(flag_, send_time, buffer);
+      packets->push_back(packet);
+      buffer.remove_prefix(packet.size());
+      if (packets_remaining_ > 0) {
+        --packets_remaining_;
+      }
+    }
+    return count;
+  }
+
+ private:
+  const char flag_;
+  int num_batch_calls_ = 0;
+  int packets_remaining_ = -1;  // Unlimited.
+};
+
+// A CongestionController with a fixed target bitrate, which records the
+// feedback provided to it.
+class FakeCongestionController : public CongestionController {
+ public:
+  explicit FakeCongestionController(int target_bitrate)
+      : target_bitrate_(target_bitrate) {}
+  ~FakeCongestionController() override = default;
+
+  double last_fraction_lost() const { return last_fraction_lost_; }
+  int num_bandwidth_estimates() const { return num_bandwidth_estimates_; }
+
+  void set_target_bitrate(int target_bitrate) {
+    target_bitrate_ = target_bitrate;
+  }
+
+  void OnReceiverReport(Clock::time_point arrival_time,
+                        Clock::duration round_trip_time,
+                        double fraction_lost) override {
+    last_fraction_lost_ = fraction_lost;
+  }
+  void OnNetworkBandwidthEstimate(Clock::time_point now,
+                                  int network_bandwidth) override {
+    ++num_bandwidth_estimates_;
+  }
+  int GetTargetBitrate() const override { return target_bitrate_; }
+
+ private:
+  int target_bitrate_;
+  double last_fraction_lost_ = -1.0;
+  int num_bandwidth_estimates_ = 0;
+};
+
 class SenderPacketRouterTest : public testing::Test {
  public:
   SenderPacketRouterTest()
@@ -608,6 +697,291 @@ TEST_F(SenderPacketRouterTest, SchedulesAndTransmitsAccountingForPriority) {
   router()->OnSenderDestroyed(kAudioReceiverSsrc);
 }
 
+// Tests that all the packets in a burst are assembled and then handed to the
+// Environment in a single call, in transmit priority order.
+TEST_F(SenderPacketRouterTest, SendsAllPacketsInABurstTogether) {
+  env()->set_remote_endpoint(kRemoteEndpoint);
+  router()->OnSenderCreated(kAudioReceiverSsrc, audio_sender());
+  router()->OnSenderCreated(kVideoReceiverSsrc, video_sender());
+
+  ON_CALL(*audio_sender(), GetRtcpPacketForImmediateSend(_, _))
+      .WillByDefault(
+          Invoke([](Clock::time_point send_time, absl::Span<uint8_t> buffer) {
+            return MakeFakePacketWithFlag('A', send_time, buffer);
+          }));
+  ON_CALL(*video_sender(), GetRtpPacketForImmediateSend(_, _))
+      .WillByDefault(
+          Invoke([](Clock::time_point send_time, absl::Span<uint8_t> buffer) {
+            return MakeFakePacketWithFlag('V', send_time, buffer);
+          }));
+  ON_CALL(*video_sender(), GetRtpResumeTime())
+      .WillByDefault(Return(SenderPacketRouter::kNever));
+
+  std::vector<std::vector<std::vector<uint8_t>>> batches_sent;
+  EXPECT_CALL(*env(), SendPacket(_)).Times(0);
+  EXPECT_CALL(*env(), SendPackets(_))
+      .WillOnce(
+          Invoke([&](absl::Span<const absl::Span<const uint8_t>> packets) {
+            batches_sent.emplace_back();
+            for (absl::Span<const uint8_t> packet : packets) {
+              batches_sent.back().emplace_back(packet.begin(), packet.end());
+            }
+          }));
+
+  router()->RequestRtcpSend(kAudioReceiverSsrc);
+  router()->RequestRtpSend(kVideoReceiverSsrc);
+  RunTasksUntilIdle();
+  Mock::VerifyAndClear(env());
+
+  // The burst should contain the audio RTCP packet, followed by as many video
+  // RTP packets as would fit.
+  ASSERT_EQ(1, static_cast<int>(batches_sent.size()));
+  const auto& batch = batches_sent.front();
+  ASSERT_EQ(kMaxPacketsPerBurst, static_cast<int>(batch.size()));
+  EXPECT_EQ('A', ParseFlag(batch[0]));
+  for (int i = 1; i < kMaxPacketsPerBurst; ++i) {
+    EXPECT_EQ('V', ParseFlag(batch[i]));
+  }
+
+  router()->OnSenderDestroyed(kAudioReceiverSsrc);
+  router()->OnSenderDestroyed(kVideoReceiverSsrc);
+}
+
+// Tests that a Sender may provide all of its RTP packets for a burst in a
+// single call, and that these are sent along with the rest of the burst.
+TEST_F(SenderPacketRouterTest, TakesManyRtpPacketsFromSenderAtOnce) {
+  env()->set_remote_endpoint(kRemoteEndpoint);
+  testing::NiceMock<BatchingMockSender> video_sender;
+  router()->OnSenderCreated(kAudioReceiverSsrc, audio_sender());
+  router()->OnSenderCreated(kVideoReceiverSsrc, &video_sender);
+
+  ON_CALL(*audio_sender(), GetRtcpPacketForImmediateSend(_, _))
+      .WillByDefault(
+          Invoke([](Clock::time_point send_time, absl::Span<uint8_t> buffer) {
+            return MakeFakePacketWithFlag('A', send_time, buffer);
+          }));
+  EXPECT_CALL(video_sender, GetRtpPacketForImmediateSend(_, _)).Times(0);
+  ON_CALL(video_sender, GetRtpResumeTime())
+      .WillByDefault(Return(SenderPacketRouter::kNever));
+
+  std::vector<std::vector<uint8_t>> packets_sent;
+  EXPECT_CALL(*env(), SendPackets(_))
+      .WillOnce(
+          Invoke([&](absl::Span<const absl::Span<const uint8_t>> packets) {
+            for (absl::Span<const uint8_t> packet : packets) {
+              packets_sent.emplace_back(packet.begin(), packet.end());
+            }
+          }));
+
+  router()->RequestRtcpSend(kAudioReceiverSsrc);
+  router()->RequestRtpSend(kVideoReceiverSsrc);
+  RunTasksUntilIdle();
+  Mock::VerifyAndClear(env());
+
+  // The burst should contain the audio RTCP packet, followed by the video RTP
+  // packets from a single call into the video Sender.
+  EXPECT_EQ(1, video_sender.num_batch_calls());
+  ASSERT_EQ(kMaxPacketsPerBurst, static_cast<int>(packets_sent.size()));
+  EXPECT_EQ('A', ParseFlag(packets_sent[0]));
+  for (int i = 1; i < kMaxPacketsPerBurst; ++i) {
+    EXPECT_EQ('V', ParseFlag(packets_sent[i]));
+  }
+
+  router()->OnSenderDestroyed(kAudioReceiverSsrc);
+  router()->OnSenderDestroyed(kVideoReceiverSsrc);
+}
+
+// Tests that the burst parameters are adjusted to pace packets according to
+// an installed CongestionController's target bitrate, and that the controller
+// receives the network feedback.
+TEST_F(SenderPacketRouterTest, PacesBurstsAtCongestionControllerTargetBitrate) {
+  EXPECT_EQ(router()->max_burst_bitrate(), router()->GetTargetBitrate());
+  EXPECT_EQ(kMaxPacketsPerBurst, router()->packets_per_burst());
+  EXPECT_EQ(kBurstInterval, router()->burst_interval());
+
+  // Choose a target bitrate that, when paced, allows exactly two max-sized
+  // packets per burst interval.
+  const int bits_per_packet = router()->max_packet_size() * 8;
+  const int bursts_per_second = seconds(1) / kBurstInterval;
+  const int two_packets_per_burst_bitrate = static_cast<int>(
+      (2.5 * bits_per_packet * bursts_per_second) /
+      SenderPacketRouter::kPacingFactor);
+  auto owned_controller =
+      std::make_unique<FakeCongestionController>(two_packets_per_burst_bitrate);
+  FakeCongestionController* const controller = owned_controller.get();
+  router()->SetCongestionController(std::move(owned_controller));
+  EXPECT_EQ(two_packets_per_burst_bitrate, router()->GetTargetBitrate());
+  EXPECT_EQ(2, router()->packets_per_burst());
+  EXPECT_EQ(kBurstInterval, router()->burst_interval());
+
+  // The Sender's RTP packets are sent two per burst.
+  env()->set_remote_endpoint(kRemoteEndpoint);
+  testing::NiceMock<BatchingMockSender> video_sender;
+  router()->OnSenderCreated(kVideoReceiverSsrc, &video_sender);
+  ON_CALL(video_sender, GetRtpResumeTime())
+      .WillByDefault(Return(SenderPacketRouter::kNever));
+  int num_packets_sent = 0;
+  EXPECT_CALL(*env(), SendPackets(_))
+      .WillOnce(Invoke([&](absl::Span<const absl::Span<const uint8_t>> p) {
+        num_packets_sent += p.size();
+      }));
+  router()->RequestRtpSend(kVideoReceiverSsrc);
+  RunTasksUntilIdle();
+  Mock::VerifyAndClear(env());
+  EXPECT_EQ(2, num_packets_sent);
+  EXPECT_EQ(1, controller->num_bandwidth_estimates());
+
+  // At a very low target bitrate, bursts are one packet each, and spaced
+  // farther apart (up to a limit).
+  controller->set_target_bitrate(bits_per_packet * 20);
+  RtcpReportBlock report;
+  report.packet_fraction_lost_numerator = 64;
+  router()->OnReceiverReport(FakeClock::now(), milliseconds(30), report);
+  EXPECT_DOUBLE_EQ(0.25, controller->last_fraction_lost());
+  EXPECT_EQ(1, router()->packets_per_burst());
+  EXPECT_LT(kBurstInterval, router()->burst_interval());
+  EXPECT_GE(milliseconds(34), router()->burst_interval());
+  controller->set_target_bitrate(bits_per_packet);
+  router()->OnReceiverReport(FakeClock::now(), milliseconds(30), report);
+  EXPECT_EQ(SenderPacketRouter::kMaxBurstInterval, router()->burst_interval());
+
+  // The burst size never exceeds the maximum, regardless of target bitrate.
+  controller->set_target_bitrate(router()->max_burst_bitrate() * 2);
+  router()->OnReceiverReport(FakeClock::now(), milliseconds(30), report);
+  EXPECT_EQ(kMaxPacketsPerBurst, router()->packets_per_burst());
+  EXPECT_EQ(kBurstInterval, router()->burst_interval());
+
+  // Removing the controller reverts to the original burst parameters.
+  router()->SetCongestionController(nullptr);
+  EXPECT_EQ(router()->max_burst_bitrate(), router()->GetTargetBitrate());
+
+  router()->OnSenderDestroyed(kVideoReceiverSsrc);
+}
+
+// Tests that, in the kFairQueuing mode, the RTP packets in each burst are
+// shared among the Senders according to their weights, and that "send first"
+// Senders are always served first.
+TEST_F(SenderPacketRouterTest, SharesBurstsAmongSendersByWeight) {
+  env()->set_remote_endpoint(kRemoteEndpoint);
+  testing::NiceMock<BatchingMockSender> audio_sender('A');
+  testing::NiceMock<BatchingMockSender> video_sender('V');
+  audio_sender.ResumeWhilePacketsRemain();
+  video_sender.ResumeWhilePacketsRemain();
+  router()->OnSenderCreated(kAudioReceiverSsrc, &audio_sender);
+  router()->OnSenderCreated(kVideoReceiverSsrc, &video_sender);
+
+  std::map<char, int> packet_counts;
+  EXPECT_CALL(*env(), SendPackets(_))
+      .WillRepeatedly(
+          Invoke([&](absl::Span<const absl::Span<const uint8_t>> packets) {
+            for (absl::Span<const uint8_t> packet : packets) {
+              ++packet_counts[ParseFlag(packet)];
+            }
+          }));
+  const auto run_bursts = [&](int num_bursts) {
+    packet_counts.clear();
+    for (int i = 0; i < num_bursts; ++i) {
+      AdvanceClockAndRunTasks(kBurstInterval);
+    }
+  };
+  router()->RequestRtpSend(kAudioReceiverSsrc);
+  router()->RequestRtpSend(kVideoReceiverSsrc);
+  RunTasksUntilIdle();
+
+  // In the default kStrictPriority mode, the audio Sender starves the video
+  // Sender.
+  run_bursts(10);
+  EXPECT_EQ(10 * kMaxPacketsPerBurst, packet_counts['A']);
+  EXPECT_EQ(0, packet_counts['V']);
+
+  // With equal weights, the Senders share the bursts equally.
+  router()->SetSchedulingMode(SenderPacketRouter::SchedulingMode::kFairQueuing);
+  run_bursts(10);
+  EXPECT_EQ(15, packet_counts['A']);
+  EXPECT_EQ(15, packet_counts['V']);
+
+  // With a 1:2 weighting, the video Sender gets two thirds of each burst.
+  router()->SetSenderWeight(kVideoReceiverSsrc, 2);
+  run_bursts(10);
+  EXPECT_EQ(10, packet_counts['A']);
+  EXPECT_EQ(20, packet_counts['V']);
+
+  // A "send first" Sender's packets are always sent before the others. Here,
+  // the audio Sender has only one packet remaining.
+  router()->SetSenderWeight(kAudioReceiverSsrc, 1, true);
+  audio_sender.set_packets_remaining(1);
+  run_bursts(1);
+  EXPECT_EQ(1, packet_counts['A']);
+  EXPECT_EQ(kMaxPacketsPerBurst - 1, packet_counts['V']);
+  run_bursts(1);
+  EXPECT_EQ(0, packet_counts['A']);
+  EXPECT_EQ(kMaxPacketsPerBurst, packet_counts['V']);
+
+  router()->OnSenderDestroyed(kAudioReceiverSsrc);
+  router()->OnSenderDestroyed(kVideoReceiverSsrc);
+}
+
+// Tests that the per-Sender queueing delay metrics account for how long each
+// packet waited to be sent, and that fair queuing reduces the queueing delay
+// for a lower-priority Sender.
+TEST_F(SenderPacketRouterTest, TracksPerSenderQueueingDelay) {
+  env()->set_remote_endpoint(kRemoteEndpoint);
+  EXPECT_CALL(*env(), SendPackets(_)).Times(testing::AnyNumber());
+
+  // Simulates the audio Sender having 9 packets to send, and the video Sender
+  // having 3 packets to send, starting at the same time; and then returns the
+  // metrics for each.
+  const auto simulate = [&](SenderPacketRouter::SchedulingMode mode) {
+    testing::NiceMock<BatchingMockSender> audio_sender('A');
+    testing::NiceMock<BatchingMockSender> video_sender('V');
+    audio_sender.set_packets_remaining(9);
+    video_sender.set_packets_remaining(3);
+    audio_sender.ResumeWhilePacketsRemain();
+    video_sender.ResumeWhilePacketsRemain();
+    router()->OnSenderCreated(kAudioReceiverSsrc, &audio_sender);
+    router()->OnSenderCreated(kVideoReceiverSsrc, &video_sender);
+    router()->SetSchedulingMode(mode);
+
+    router()->RequestRtpSend(kAudioReceiverSsrc);
+    router()->RequestRtpSend(kVideoReceiverSsrc);
+    RunTasksUntilIdle();
+    for (int i = 0; i < 5; ++i) {
+      AdvanceClockAndRunTasks(kBurstInterval);
+    }
+    EXPECT_EQ(0, audio_sender.packets_remaining());
+    EXPECT_EQ(0, video_sender.packets_remaining());
+
+    const auto metrics =
+        std::make_pair(router()->GetSenderMetrics(kAudioReceiverSsrc),
+                       router()->GetSenderMetrics(kVideoReceiverSsrc));
+    router()->OnSenderDestroyed(kAudioReceiverSsrc);
+    router()->OnSenderDestroyed(kVideoReceiverSsrc);
+    AdvanceClockAndRunTasks(seconds(1));
+    return metrics;
+  };
+
+  // In strict priority order, the audio packets are sent in the first three
+  // bursts, and the video packets wait until the fourth burst.
+  const auto strict =
+      simulate(SenderPacketRouter::SchedulingMode::kStrictPriority);
+  EXPECT_EQ(9, strict.first.num_packets_sent);
+  EXPECT_EQ(3 * (0 + 1 + 2) * kBurstInterval,
+            strict.first.total_queueing_delay);
+  EXPECT_EQ(2 * kBurstInterval, strict.first.max_queueing_delay);
+  EXPECT_EQ(3, strict.second.num_packets_sent);
+  EXPECT_EQ(3 * 3 * kBurstInterval, strict.second.total_queueing_delay);
+  EXPECT_EQ(3 * kBurstInterval, strict.second.max_queueing_delay);
+
+  // With fair queuing, the video packets are all sent within the first two
+  // bursts.
+  const auto fair = simulate(SenderPacketRouter::SchedulingMode::kFairQueuing);
+  EXPECT_EQ(9, fair.first.num_packets_sent);
+  EXPECT_EQ(3, fair.second.num_packets_sent);
+  EXPECT_EQ(kBurstInterval, fair.second.max_queueing_delay);
+  EXPECT_LT(fair.second.total_queueing_delay,
+            strict.second.total_queueing_delay);
+}
+
 }  // namespace
 }  // namespace cast
 }  // namespace openscreen
@@ -11,11 +11,14 @@
 #include <chrono>  // NOLINT
 #include <limits>
 #include <map>
+#include <memory>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
+#include "cast/streaming/answer_messages.h"
 #include "cast/streaming/compound_rtcp_builder.h"
 #include "cast/streaming/constants.h"
 #include "cast/streaming/encoded_frame.h"
@@ -36,6 +39,7 @@
 #include "platform/test/fake_clock.h"
 #include "platform/test/fake_task_runner.h"
 #include "util/alarm.h"
+#include "util/json/json_serialization.h"
 #include "util/yet_another_bit_vector.h"
 
 using testing::_;
@@ -187,14 +191,21 @@ class MockReceiver : public Environment::PacketConsumer {
     return false;
   }
 
+  void SetPlayoutDelay(milliseconds delay) {
+    rtcp_builder_.SetPlayoutDelay(delay);
+  }
+
   void SetPictureLossIndicator(bool picture_is_lost) {
     rtcp_builder_.SetPictureLossIndicator(picture_is_lost);
   }
 
   void SetReceiverReport(StatusReportId reply_for,
-                         RtcpReportBlock::Delay processing_delay) {
+                         RtcpReportBlock::Delay processing_delay,
+                         int packet_fraction_lost_numerator = 0) {
     RtcpReportBlock receiver_report;
     receiver_report.ssrc = kSenderSsrc;
+    receiver_report.packet_fraction_lost_numerator =
+        packet_fraction_lost_numerator;
     receiver_report.last_status_report_id = reply_for;
     receiver_report.delay_since_last_report = processing_delay;
     rtcp_builder_.IncludeReceiverReportInNextPacket(receiver_report);
@@ -318,11 +329,13 @@ class MockObserver : public Sender::Observer {
  public:
   MOCK_METHOD1(OnFrameCanceled, void(FrameId frame_id));
   MOCK_METHOD0(OnPictureLost, void());
+  MOCK_METHOD1(OnFrameDropped, void(FrameId frame_id));
+  MOCK_METHOD1(OnPlayoutDelayRequested, void(milliseconds delay));
 };
 
 class SenderTest : public testing::Test {
  public:
-  SenderTest()
+  explicit SenderTest(bool fec_enabled = false)
       : fake_clock_(Clock::now()),
         task_runner_(&fake_clock_),
         sender_environment_(&FakeClock::now, &task_runner_),
@@ -331,13 +344,7 @@ class SenderTest : public testing::Test {
                               kBurstInterval),
         sender_(&sender_environment_,
                 &sender_packet_router_,
-                {/* .sender_ssrc = */ kSenderSsrc,
-                 /* .receiver_ssrc = */ kReceiverSsrc,
-                 /* .rtp_timebase = */ kRtpTimebase,
-                 /* .channels = */ 2,
-                 /* .target_playout_delay = */ kTargetPlayoutDelay,
-                 /* .aes_secret_key = */ kAesKey,
-                 /* .aes_iv_mask = */ kCastIvMask},
+                MakeSessionConfig(fec_enabled),
                 kRtpPayloadType),
         receiver_to_sender_pipe_(&task_runner_, &sender_packet_router_),
         receiver_(&receiver_to_sender_pipe_),
@@ -355,6 +362,18 @@ class SenderTest : public testing::Test {
 
   ~SenderTest() override = default;
 
+  static SessionConfig MakeSessionConfig(bool fec_enabled) {
+    SessionConfig config(/* .sender_ssrc = */ kSenderSsrc,
+                         /* .receiver_ssrc = */ kReceiverSsrc,
+                         /* .rtp_timebase = */ kRtpTimebase,
+                         /* .channels = */ 2,
+                         /* .target_playout_delay = */ kTargetPlayoutDelay,
+                         /* .aes_secret_key = */ kAesKey,
+                         /* .aes_iv_mask = */ kCastIvMask,
+                         /* .fec_enabled = */ fec_enabled);
+    return config;
+  }
+
   Sender* sender() { return &sender_; }
   MockReceiver* receiver() { return &receiver_; }
 
@@ -489,6 +508,40 @@ TEST_F(SenderTest, SendsFramesEfficiently) {
   ExpectFramesReceivedCorrectly(frames, receiver()->TakeCompleteFrames());
 }
 
+// Tests that the Sender can send frames whose payloads are encrypted
+// packet-by-packet as they are sent, and that it releases its references to
+// the plaintext payloads once the frames are no longer in-flight.
+TEST_F(SenderTest, SendsFramesEncryptingWhilePacketizing) {
+  ON_CALL(*receiver(), OnFrameComplete(_)).WillByDefault(InvokeWithoutArgs([&] {
+    if (receiver()->AutoAdvanceCheckpoint()) {
+      receiver()->TransmitRtcpFeedbackPacket();
+    }
+  }));
+
+  EncodedFrameWithBuffer frames[3];
+  std::weak_ptr<const std::vector<uint8_t>> payload_refs[3];
+  constexpr int kFrameDataSizes[] = {9999, 0, 1432};
+  for (int i = 0; i < 3; ++i) {
+    PopulateFrameWithDefaults(FrameId::first() + i,
+                              FakeClock::now() - kCaptureDelay, 0x42 + i,
+                              kFrameDataSizes[i], &frames[i]);
+    auto payload = std::make_shared<const std::vector<uint8_t>>(
+        frames[i].buffer.begin(), frames[i].buffer.end());
+    payload_refs[i] = payload;
+    EncodedFrame metadata;
+    frames[i].CopyMetadataTo(&metadata);
+    ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(metadata, std::move(payload)));
+    EXPECT_FALSE(payload_refs[i].expired());
+    SimulateExecution(kFrameDuration);
+  }
+  SimulateExecution(kTargetPlayoutDelay);
+
+  ExpectFramesReceivedCorrectly(frames, receiver()->TakeCompleteFrames());
+  for (const auto& ref : payload_refs) {
+    EXPECT_TRUE(ref.expired());
+  }
+}
+
 // Tests that the Sender correctly computes the current in-flight media
 // duration, a backlog signal for clients.
 TEST_F(SenderTest, ComputesInFlightMediaDuration) {
@@ -606,6 +659,175 @@ TEST_F(SenderTest, RespondsToNetworkLatencyChanges) {
                       sender()->GetMaxInFlightMediaDuration(), kEpsilon);
 }
 
+// Tests that the Sender predicts whether frames would arrive in time for
+// playout, based on their size and reference time, and the amount of data
+// already waiting to be sent.
+TEST_F(SenderTest, PredictsWhetherFramesCanArriveInTime) {
+  // At the packet router's target bitrate (24 Mbps), a 600 KB frame takes
+  // about half of the target playout delay to send.
+  constexpr int kLargeFrameSize = 600 * 1000;
+  const Clock::time_point now = FakeClock::now();
+  EXPECT_TRUE(sender()->CanFrameArriveInTime(1000, now));
+  EXPECT_TRUE(sender()->CanFrameArriveInTime(kLargeFrameSize, now));
+  EXPECT_FALSE(sender()->CanFrameArriveInTime(2 * 1000 * 1000, now));
+  EXPECT_FALSE(
+      sender()->CanFrameArriveInTime(1000, now - kTargetPlayoutDelay));
+  EXPECT_LT(sender()->PredictFrameArrivalTime(1000),
+            sender()->PredictFrameArrivalTime(kLargeFrameSize));
+
+  // Once a large frame is waiting to be sent, another one would be late.
+  EncodedFrameWithBuffer frame;
+  PopulateFrameWithDefaults(FrameId::first(), now, 0, kLargeFrameSize, &frame);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frame));
+  EXPECT_FALSE(sender()->CanFrameArriveInTime(kLargeFrameSize, now));
+  EXPECT_TRUE(sender()->CanFrameArriveInTime(1000, now));
+}
+
+// Tests that, when enabled, the Sender drops non-key frames that would arrive
+// too late, along with the frames that depend on them, until the next key
+// frame.
+TEST_F(SenderTest, DropsLateFramesAndTheirDependents) {
+  NiceMock<MockObserver> observer;
+  sender()->SetObserver(&observer);
+  sender()->SetDropLateFrames(true);
+  EXPECT_TRUE(sender()->is_dropping_late_frames());
+
+  std::set<FrameId> frames_with_packets_sent;
+  EXPECT_CALL(*receiver(), OnRtpPacket(_))
+      .WillRepeatedly(Invoke([&](const RtpPacketParser::ParseResult& packet) {
+        frames_with_packets_sent.insert(packet.frame_id);
+      }));
+
+  // Frames 0 and 1 are already too late when enqueued. However, frame 0 is a
+  // key frame, and so it is sent anyway.
+  EncodedFrameWithBuffer frames[4];
+  PopulateFrameWithDefaults(FrameId::first(),
+                            FakeClock::now() - (kTargetPlayoutDelay * 5 / 4),
+                            0, 1000, &frames[0]);
+  PopulateFrameWithDefaults(FrameId::first() + 1,
+                            FakeClock::now() - (kTargetPlayoutDelay * 9 / 8),
+                            1, 1000, &frames[1]);
+  EXPECT_CALL(observer, OnFrameDropped(FrameId::first() + 1)).Times(1);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[0]));
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[1]));
+  SimulateExecution(kFrameDuration);
+  Mock::VerifyAndClearExpectations(&observer);
+  EXPECT_TRUE(sender()->NeedsKeyFrame());
+
+  // Frame 2 is on time, but depends on frame 1. So, it is dropped too.
+  PopulateFrameWithDefaults(FrameId::first() + 2, FakeClock::now(), 2, 1000,
+                            &frames[2]);
+  EXPECT_CALL(observer, OnFrameDropped(FrameId::first() + 2)).Times(1);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[2]));
+  SimulateExecution(kFrameDuration);
+  Mock::VerifyAndClearExpectations(&observer);
+  EXPECT_TRUE(sender()->NeedsKeyFrame());
+
+  // Frame 3, a key frame, gets things going again.
+  PopulateFrameWithDefaults(FrameId::first() + 3, FakeClock::now(), 3, 1000,
+                            &frames[3]);
+  frames[3].dependency = EncodedFrame::KEY_FRAME;
+  frames[3].referenced_frame_id = frames[3].frame_id;
+  EXPECT_CALL(observer, OnFrameDropped(_)).Times(0);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[3]));
+  EXPECT_FALSE(sender()->NeedsKeyFrame());
+  SimulateExecution(kFrameDuration);
+
+  EXPECT_EQ((std::set<FrameId>{FrameId::first(), FrameId::first() + 3}),
+            frames_with_packets_sent);
+  const auto received_frames = receiver()->TakeCompleteFrames();
+  EXPECT_EQ(2u, received_frames.size());
+  EXPECT_EQ(1u, received_frames.count(FrameId::first()));
+  EXPECT_EQ(1u, received_frames.count(FrameId::first() + 3));
+}
+
+// Tests that frames handed-off through a FrameQueue are sent, whether they
+// were encrypted by the producer or are to be encrypted while packetizing.
+TEST_F(SenderTest, SendsFramesSubmittedThroughFrameQueue) {
+  ON_CALL(*receiver(), OnFrameComplete(_)).WillByDefault(InvokeWithoutArgs([&] {
+    if (receiver()->AutoAdvanceCheckpoint()) {
+      receiver()->TransmitRtcpFeedbackPacket();
+    }
+  }));
+
+  Sender::FrameQueue* const queue = sender()->CreateFrameQueue(2);
+  EXPECT_EQ(FrameId::first(), queue->GetNextFrameId());
+
+  EncodedFrameWithBuffer frames[3];
+  for (int i = 0; i < 3; ++i) {
+    PopulateFrameWithDefaults(
+        FrameId::first() + i,
+        FakeClock::now() - kCaptureDelay + kFrameDuration * i, 0x20 + i,
+        1000 + 3000 * i, &frames[i]);
+  }
+  EXPECT_TRUE(queue->SubmitFrame(frames[0]));
+  EncodedFrame metadata;
+  frames[1].CopyMetadataTo(&metadata);
+  EXPECT_TRUE(queue->SubmitFrame(
+      metadata, std::make_shared<const std::vector<uint8_t>>(
+                    frames[1].buffer.begin(), frames[1].buffer.end())));
+
+  // The queue is full, and so the next frame is rejected without using-up its
+  // FrameId.
+  EXPECT_FALSE(queue->SubmitFrame(frames[2]));
+  EXPECT_EQ(FrameId::first() + 2, queue->GetNextFrameId());
+
+  // The Sender takes in the frames at its next burst, making room for the
+  // next one.
+  SimulateExecution(kBurstInterval);
+  EXPECT_EQ(FrameId::first() + 2, sender()->GetNextFrameId());
+  EXPECT_TRUE(queue->SubmitFrame(frames[2]));
+  SimulateExecution(kTargetPlayoutDelay);
+
+  ExpectFramesReceivedCorrectly(frames, receiver()->TakeCompleteFrames());
+}
+
+// Tests that a frame submitted through the FrameQueue is dropped, rather than
+// sent late, if the Sender cannot accept it; and that the producer is told to
+// rewind its FrameId and send a key frame.
+TEST_F(SenderTest, DropsFramesFromFrameQueueThatCannotBeEnqueued) {
+  Sender::FrameQueue* const queue = sender()->CreateFrameQueue(4);
+
+  // The second frame is far enough ahead of the first, in media time, that it
+  // cannot be in-flight along with it. The third frame depends on the second.
+  EncodedFrameWithBuffer frames[3];
+  PopulateFrameWithDefaults(FrameId::first(), FakeClock::now(), 0, 1000,
+                            &frames[0]);
+  for (int i = 1; i < 3; ++i) {
+    PopulateFrameWithDefaults(FrameId::first() + i, FakeClock::now(), i, 1000,
+                              &frames[i]);
+    frames[i].rtp_timestamp += RtpTimeDelta::FromDuration(
+        kTargetPlayoutDelay + kFrameDuration * i, kRtpTimebase);
+    frames[i].reference_time += kTargetPlayoutDelay + kFrameDuration * i;
+  }
+  ASSERT_LT(sender()->GetMaxInFlightMediaDuration(),
+            duration_cast<Clock::duration>(kTargetPlayoutDelay));
+
+  EXPECT_TRUE(queue->SubmitFrame(frames[0]));
+  EXPECT_TRUE(queue->SubmitFrame(frames[1]));
+  EXPECT_TRUE(queue->SubmitFrame(frames[2]));
+  SimulateExecution(kBurstInterval);
+  EXPECT_EQ(FrameId::first() + 1, sender()->GetNextFrameId());
+
+  // The next submission fails, and the producer is rewound to the FrameId of
+  // the dropped frame.
+  EncodedFrameWithBuffer key_frame;
+  PopulateFrameWithDefaults(FrameId::first() + 3, FakeClock::now(), 3, 1000,
+                            &key_frame);
+  EXPECT_FALSE(queue->SubmitFrame(key_frame));
+  EXPECT_EQ(FrameId::first() + 1, queue->GetNextFrameId());
+
+  // A key frame submitted with the rewound FrameId is taken in.
+  PopulateFrameWithDefaults(FrameId::first() + 1, FakeClock::now(), 3, 1000,
+                            &key_frame);
+  key_frame.dependency = EncodedFrame::KEY_FRAME;
+  key_frame.referenced_frame_id = key_frame.frame_id;
+  EXPECT_TRUE(queue->SubmitFrame(key_frame));
+  EXPECT_EQ(FrameId::first() + 2, queue->GetNextFrameId());
+  SimulateExecution(kBurstInterval);
+  EXPECT_EQ(FrameId::first() + 2, sender()->GetNextFrameId());
+}
+
 // Tests that the Sender rejects frames if too large a span of FrameIds would be
 // in-flight at once.
 TEST_F(SenderTest, RejectsEnqueuingBeforeProtocolDesignLimit) {
@@ -834,6 +1056,58 @@ TEST_F(SenderTest, ManagesReceiverPictureLossWorkflow) {
   ExpectFramesReceivedCorrectly(frames, receiver()->TakeCompleteFrames());
 }
 
+// Tests that the Sender notifies its Observer when the Receiver requests a
+// different target playout delay, but only once per distinct request, and not
+// after the Sender has adopted the requested setting.
+TEST_F(SenderTest, NotifiesObserverOfRequestedPlayoutDelay) {
+  constexpr milliseconds kRequestedDelay{150};
+  constexpr milliseconds kAnotherRequestedDelay{200};
+
+  NiceMock<MockObserver> observer;
+  sender()->SetObserver(&observer);
+
+  EncodedFrameWithBuffer frames[3];
+  for (int i = 0; i < 2; ++i) {
+    PopulateFrameWithDefaults(FrameId::first() + i,
+                              FakeClock::now() - kCaptureDelay, 0,
+                              24 /* bytes */, &frames[i]);
+    ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[i]));
+    SimulateExecution(kFrameDuration);
+  }
+
+  // The Receiver requests a shorter playout delay, repeatedly.
+  EXPECT_CALL(observer, OnPlayoutDelayRequested(kRequestedDelay)).Times(1);
+  receiver()->SetPlayoutDelay(kRequestedDelay);
+  receiver()->SetCheckpointFrame(frames[0].frame_id);
+  receiver()->TransmitRtcpFeedbackPacket();
+  SimulateExecution();  // RTCP transmitted to Sender.
+  receiver()->TransmitRtcpFeedbackPacket();
+  SimulateExecution();  // RTCP transmitted to Sender.
+  Mock::VerifyAndClearExpectations(&observer);
+
+  // The application honors the request with the next frame. Once the Receiver
+  // reports the same setting, there should be no further notifications.
+  EXPECT_CALL(observer, OnPlayoutDelayRequested(_)).Times(0);
+  PopulateFrameWithDefaults(FrameId::first() + 2,
+                            FakeClock::now() - kCaptureDelay, 0,
+                            24 /* bytes */, &frames[2]);
+  frames[2].new_playout_delay = kRequestedDelay;
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[2]));
+  SimulateExecution(kFrameDuration);
+  receiver()->SetCheckpointFrame(frames[2].frame_id);
+  receiver()->TransmitRtcpFeedbackPacket();
+  SimulateExecution();  // RTCP transmitted to Sender.
+  Mock::VerifyAndClearExpectations(&observer);
+
+  // A later, different request results in another notification.
+  EXPECT_CALL(observer, OnPlayoutDelayRequested(kAnotherRequestedDelay))
+      .Times(1);
+  receiver()->SetPlayoutDelay(kAnotherRequestedDelay);
+  receiver()->TransmitRtcpFeedbackPacket();
+  SimulateExecution();  // RTCP transmitted to Sender.
+  Mock::VerifyAndClearExpectations(&observer);
+}
+
 // Tests that the Receiver should get a Sender Report just before the first RTP
 // packet, and at regular intervals thereafter. The Sender Report contains the
 // lip-sync information necessary for play-out timing.
@@ -984,7 +1258,9 @@ TEST_F(SenderTest, ResendsIndividuallyNackedPackets) {
     ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[i]));
     SimulateExecution(kFrameDuration);
   }
-  SimulateExecution(kTargetPlayoutDelay);
+  // Note: The NACKs must reach the Sender well before the frames' playout
+  // deadlines, since re-transmits of late frames are dropped.
+  SimulateExecution(kTargetPlayoutDelay / 2);
   Mock::VerifyAndClearExpectations(receiver());
   EXPECT_EQ(3, sender()->GetInFlightFrameCount());
 
@@ -1032,6 +1308,141 @@ TEST_F(SenderTest, ResendsIndividuallyNackedPackets) {
   ExpectFramesReceivedCorrectly(frames, receiver()->TakeCompleteFrames());
 }
 
+// Tests that the Sender does not re-transmit the packets of frames that could
+// no longer arrive at the Receiver before their playout deadline.
+TEST_F(SenderTest, DropsRetransmitsThatWouldArriveLate) {
+  constexpr int kFrameDataSize = 3 * kMaxRtpPacketSizeForIpv6UdpOnEthernet;
+  constexpr milliseconds kOneWayNetworkDelay{1};
+  SetSenderToReceiverNetworkDelay(kOneWayNetworkDelay);
+  SetReceiverToSenderNetworkDelay(kOneWayNetworkDelay);
+
+  const std::vector<PacketNack> dropped_packets{
+      {FrameId::first(), FramePacketId{1}},
+  };
+  receiver()->SetIgnoreList(dropped_packets);
+  EncodedFrameWithBuffer frame;
+  PopulateFrameWithDefaults(FrameId::first(), FakeClock::now() - kCaptureDelay,
+                            0, kFrameDataSize, &frame);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frame));
+
+  // Wait until the frame is past its playout deadline, then NACK the dropped
+  // packet. The Sender should ignore the NACK. Note: Kickstart packets may
+  // still be sent, to let the Receiver know the frame exists.
+  SimulateExecution(kTargetPlayoutDelay);
+  receiver()->SetIgnoreList({});
+  EXPECT_CALL(*receiver(), OnRtpPacket(_))
+      .WillRepeatedly(Invoke([&](const RtpPacketParser::ParseResult& packet) {
+        EXPECT_NE(dropped_packets[0].packet_id, packet.packet_id);
+      }));
+  EXPECT_CALL(*receiver(), OnFrameComplete(_)).Times(0);
+  receiver()->SetNacksAndAcks(dropped_packets, {});
+  receiver()->TransmitRtcpFeedbackPacket();
+  SimulateExecution(kTargetPlayoutDelay);
+  Mock::VerifyAndClearExpectations(receiver());
+  EXPECT_EQ(1, sender()->GetInFlightFrameCount());
+}
+
+// Tests that re-transmits are limited to the configured share of the target
+// bitrate, and that the deferred ones are sent once more allowance accrues.
+TEST_F(SenderTest, LimitsRetransmitBandwidth) {
+  constexpr int kFrameDataSize = 10 * kMaxRtpPacketSizeForIpv6UdpOnEthernet;
+  constexpr milliseconds kOneWayNetworkDelay{1};
+  SetSenderToReceiverNetworkDelay(kOneWayNetworkDelay);
+  SetReceiverToSenderNetworkDelay(kOneWayNetworkDelay);
+
+  // At 2% of the target bitrate, the Sender may re-transmit a few packets
+  // right away, and then several more every |kBurstInterval| * 10.
+  sender()->SetMaxRetransmitFraction(0.02);
+  EXPECT_EQ(0.02, sender()->max_retransmit_fraction());
+
+  // The whole frame is lost the first time it is sent.
+  const std::vector<PacketNack> all_lost{{FrameId::first(), kAllPacketsLost}};
+  receiver()->SetIgnoreList(all_lost);
+  EncodedFrameWithBuffer frame;
+  PopulateFrameWithDefaults(FrameId::first(), FakeClock::now() - kCaptureDelay,
+                            0, kFrameDataSize, &frame);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frame));
+  SimulateExecution(kFrameDuration);
+  receiver()->SetIgnoreList({});
+
+  std::set<FramePacketId> retransmitted;
+  FramePacketId max_packet_id{};
+  EXPECT_CALL(*receiver(), OnRtpPacket(_))
+      .WillRepeatedly(Invoke([&](const RtpPacketParser::ParseResult& packet) {
+        EXPECT_TRUE(retransmitted.insert(packet.packet_id).second);
+        max_packet_id = packet.max_packet_id;
+      }));
+  EXPECT_CALL(*receiver(), OnFrameComplete(FrameId::first())).Times(1);
+  receiver()->SetNacksAndAcks(all_lost, {});
+  receiver()->TransmitRtcpFeedbackPacket();
+  SimulateExecution(2 * kOneWayNetworkDelay);
+  const size_t num_sent_at_once = retransmitted.size();
+  EXPECT_LE(1u, num_sent_at_once);
+  EXPECT_GT(size_t{max_packet_id} + 1, num_sent_at_once);
+
+  // More are sent over time, until the whole frame has been re-transmitted.
+  SimulateExecution(10 * kBurstInterval);
+  EXPECT_LT(num_sent_at_once, retransmitted.size());
+  SimulateExecution(kTargetPlayoutDelay / 2);
+  Mock::VerifyAndClearExpectations(receiver());
+  EXPECT_EQ(size_t{max_packet_id} + 1, retransmitted.size());
+}
+
+// Tests that, while re-transmits are waiting for more allowance, the packets of
+// newer frames are still sent right away.
+TEST_F(SenderTest, SendsNewFramesWhileRetransmitsAreDeferred) {
+  constexpr int kFrameDataSize = 10 * kMaxRtpPacketSizeForIpv6UdpOnEthernet;
+  constexpr milliseconds kOneWayNetworkDelay{1};
+  SetSenderToReceiverNetworkDelay(kOneWayNetworkDelay);
+  SetReceiverToSenderNetworkDelay(kOneWayNetworkDelay);
+  sender()->SetMaxRetransmitFraction(0.02);
+
+  // The whole first frame is lost, and then NACKed, which uses up the
+  // allowance and leaves most of its packets waiting to be re-transmitted.
+  const std::vector<PacketNack> all_lost{{FrameId::first(), kAllPacketsLost}};
+  receiver()->SetIgnoreList(all_lost);
+  EncodedFrameWithBuffer frames[2];
+  PopulateFrameWithDefaults(FrameId::first(), FakeClock::now() - kCaptureDelay,
+                            0, kFrameDataSize, &frames[0]);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[0]));
+  SimulateExecution(kFrameDuration);
+  receiver()->SetIgnoreList({});
+  std::set<FramePacketId> retransmitted;
+  EXPECT_CALL(*receiver(), OnRtpPacket(_))
+      .WillRepeatedly(Invoke([&](const RtpPacketParser::ParseResult& packet) {
+        EXPECT_EQ(FrameId::first(), packet.frame_id);
+        retransmitted.insert(packet.packet_id);
+      }));
+  receiver()->SetNacksAndAcks(all_lost, {});
+  receiver()->TransmitRtcpFeedbackPacket();
+  SimulateExecution(2 * kOneWayNetworkDelay);
+  Mock::VerifyAndClearExpectations(receiver());
+  const size_t num_retransmitted = retransmitted.size();
+  ASSERT_LE(1u, num_retransmitted);
+
+  // All the packets of the next frame go out within the next burst, while
+  // the first frame's re-transmits remain deferred.
+  std::set<FramePacketId> sent_for_second_frame;
+  FramePacketId max_packet_id{};
+  EXPECT_CALL(*receiver(), OnRtpPacket(_))
+      .WillRepeatedly(Invoke([&](const RtpPacketParser::ParseResult& packet) {
+        if (packet.frame_id == FrameId::first()) {
+          retransmitted.insert(packet.packet_id);
+        } else {
+          EXPECT_EQ(FrameId::first() + 1, packet.frame_id);
+          sent_for_second_frame.insert(packet.packet_id);
+          max_packet_id = packet.max_packet_id;
+        }
+      }));
+  PopulateFrameWithDefaults(FrameId::first() + 1, FakeClock::now(), 0,
+                            kFrameDataSize, &frames[1]);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[1]));
+  SimulateExecution(kBurstInterval);
+  Mock::VerifyAndClearExpectations(receiver());
+  EXPECT_EQ(size_t{max_packet_id} + 1, sent_for_second_frame.size());
+  EXPECT_EQ(num_retransmitted, retransmitted.size());
+}
+
 // Tests that the Sender retransmits an entire frame if the Receiver requests it
 // (i.e., a full frame NACK), but does not retransmit any packets for frames
 // (before or after) that have been acknowledged.
@@ -1127,6 +1538,89 @@ TEST_F(SenderTest, ResendsMissingFrames) {
   ExpectFramesReceivedCorrectly(frames, receiver()->TakeCompleteFrames());
 }
 
+class SenderFecTest : public SenderTest {
+ public:
+  SenderFecTest() : SenderTest(IsFecEnabledInAnswer()) {}
+
+  // Returns whether the Receiver's ANSWER accepted the FEC Parity packets
+  // offered for the Sender's stream, which has send index 1.
+  static bool IsFecEnabledInAnswer() {
+    constexpr char kAnswer[] = R"({
+      "castMode": "mirroring",
+      "udpPort": 1234,
+      "sendIndexes": [0, 1],
+      "ssrcs": [11, 2],
+      "fecSendIndexes": [1]
+    })";
+    const auto root = json::Parse(kAnswer);
+    OSP_CHECK(root.is_value());
+    const ErrorOr<Answer> answer = Answer::Parse(root.value());
+    OSP_CHECK(answer.is_value());
+    return answer.value().IsFecEnabled(1);
+  }
+};
+
+// Tests that the Sender, once FEC was negotiated in the ANSWER, only adds FEC
+// Parity packets to frames once the Receiver reports packet loss, and that the
+// Receiver can then reconstruct a frame with a lost packet without waiting for
+// a re-transmit.
+TEST_F(SenderFecTest, SendsParityPacketsOnceReceiverReportsLoss) {
+  // Roughly 10% packet loss, for which each Parity packet should protect a
+  // group of four data packets.
+  constexpr int kFractionLostNumerator = 26;
+  constexpr int kExpectedGroupSize = 4;
+
+  EXPECT_EQ(0, sender()->fec_group_size());
+
+  // Enqueue a frame to start the exchange of RTCP reports, and have the
+  // Receiver reply with a loss-reporting Receiver Report.
+  EncodedFrameWithBuffer frames[2];
+  PopulateFrameWithDefaults(FrameId::first(), FakeClock::now(), 0,
+                            1 /* byte */, &frames[0]);
+  EXPECT_CALL(*receiver(), OnRtpPacket(_))
+      .WillRepeatedly(
+          Invoke([&](const RtpPacketParser::ParseResult& parsed_packet) {
+            EXPECT_EQ(0, parsed_packet.fec_num_protected_packets);
+          }));
+  EXPECT_CALL(*receiver(), OnSenderReport(_))
+      .WillRepeatedly(Invoke(
+          [&](const SenderReportParser::SenderReportWithId& sender_report) {
+            receiver()->SetReceiverReport(sender_report.report_id,
+                                          RtcpReportBlock::Delay::zero(),
+                                          kFractionLostNumerator);
+            receiver()->TransmitRtcpFeedbackPacket();
+          }));
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[0]));
+  SimulateExecution(kRtcpReportInterval);
+  Mock::VerifyAndClearExpectations(receiver());
+  EXPECT_EQ(kExpectedGroupSize, sender()->fec_group_size());
+
+  // Simulate the network dropping one data packet of the next frame. The
+  // Receiver never NACKs it, so only recovery from parity can complete the
+  // frame.
+  receiver()->SetIgnoreList({{FrameId::first() + 1, FramePacketId{1}}});
+  int num_parity_packets = 0;
+  EXPECT_CALL(*receiver(), OnRtpPacket(_))
+      .WillRepeatedly(
+          Invoke([&](const RtpPacketParser::ParseResult& parsed_packet) {
+            if (parsed_packet.fec_num_protected_packets > 0) {
+              EXPECT_EQ(FrameId::first() + 1, parsed_packet.frame_id);
+              ++num_parity_packets;
+            }
+          }));
+  EXPECT_CALL(*receiver(), OnFrameComplete(FrameId::first() + 1)).Times(1);
+  PopulateFrameWithDefaults(FrameId::first() + 1, FakeClock::now(), 0x33,
+                            8000 /* bytes */, &frames[1]);
+  ASSERT_EQ(Sender::OK, sender()->EnqueueFrame(frames[1]));
+  SimulateExecution(kFrameDuration);
+  Mock::VerifyAndClearExpectations(receiver());
+
+  // 8000 bytes span more than four data packets, and so need two Parity
+  // packets.
+  EXPECT_EQ(2, num_parity_packets);
+  ExpectFramesReceivedCorrectly(frames, receiver()->TakeCompleteFrames());
+}
+
 }  // namespace
 }  // namespace cast
 }  // namespace openscreen
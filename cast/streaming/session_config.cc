@@ -13,14 +13,16 @@ SessionConfig::SessionConfig(Ssrc sender_ssrc,
                              int channels,
                              std::chrono::milliseconds target_playout_delay,
                              std::array<uint8_t, 16> aes_secret_key,
-                             std::array<uint8_t, 16> aes_iv_mask)
+                             std::array<uint8_t, 16> aes_iv_mask,
+                             bool fec_enabled)
     : sender_ssrc(sender_ssrc),
       receiver_ssrc(receiver_ssrc),
       rtp_timebase(rtp_timebase),
       channels(channels),
       target_playout_delay(target_playout_delay),
       aes_secret_key(aes_secret_key),
-      aes_iv_mask(aes_iv_mask) {}
+      aes_iv_mask(aes_iv_mask),
+      fec_enabled(fec_enabled) {}
 
 }  // namespace cast
 }  // namespace openscreen
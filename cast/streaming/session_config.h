@@ -24,7 +24,8 @@ struct SessionConfig final {
                 int channels,
                 std::chrono::milliseconds target_playout_delay,
                 std::array<uint8_t, 16> aes_secret_key,
-                std::array<uint8_t, 16> aes_iv_mask);
+                std::array<uint8_t, 16> aes_iv_mask,
+                bool fec_enabled = false);
   SessionConfig(const SessionConfig&) = default;
   SessionConfig(SessionConfig&&) noexcept = default;
   SessionConfig& operator=(const SessionConfig&) = default;
@@ -50,6 +51,10 @@ struct SessionConfig final {
   // The AES-128 crypto key and initialization vector.
   std::array<uint8_t, 16> aes_secret_key{};
   std::array<uint8_t, 16> aes_iv_mask{};
+
+  // Whether the Receiver supports FEC Parity packets, as negotiated via the
+  // OFFER/ANSWER exchange. See rtp_defines.h.
+  bool fec_enabled = false;
 };
 
 }  // namespace cast
@@ -5,10 +5,12 @@
 #ifndef PLATFORM_API_TASK_RUNNER_H_
 #define PLATFORM_API_TASK_RUNNER_H_
 
-#include <future>  // NOLINT
+#include <stdint.h>
+
 #include <utility>
 
 #include "platform/api/time.h"
+#include "platform/base/inline_task.h"
 
 namespace openscreen {
 
@@ -22,7 +24,13 @@ namespace openscreen {
 //     B runs (even if A and B run on different threads).
 class TaskRunner {
  public:
-  using Task = std::packaged_task<void() noexcept>;
+  // A move-only callable. Tasks with small bound state (e.g., lambdas capturing
+  // a few pointers or values) are posted without allocating memory.
+  using Task = InlineTask;
+
+  // Identifies a task posted by PostCancelablePackagedTaskWithDelay(). Zero
+  // means the task cannot be canceled.
+  using DelayedTaskId = uint64_t;
 
   virtual ~TaskRunner() = default;
 
@@ -48,6 +56,36 @@ class TaskRunner {
   virtual void PostPackagedTask(Task task) = 0;
   virtual void PostPackagedTaskWithDelay(Task task, Clock::duration delay) = 0;
 
+  // Same as PostPackagedTaskWithDelay(), but returns an ID that may be passed
+  // to CancelDelayedTask(). This is meant for clients that frequently cancel
+  // or re-schedule their delayed tasks (e.g., Alarm), to allow implementations
+  // to reclaim the resources of those tasks early.
+  //
+  // Implementations are not required to support cancellation. The default
+  // implementation just calls PostPackagedTaskWithDelay() and returns zero.
+  virtual DelayedTaskId PostCancelablePackagedTaskWithDelay(
+      Task task,
+      Clock::duration delay) {
+    PostPackagedTaskWithDelay(std::move(task), delay);
+    return 0;
+  }
+
+  // Removes the task identified by |id| from the queue, destroying it without
+  // running it. Returns false if this could not be done (e.g., because |id| is
+  // zero, or the task is already about to run), in which case the task may
+  // still run.
+  virtual bool CancelDelayedTask(DelayedTaskId id) { return false; }
+
+  // Changes the task identified by |id| to run no sooner than |delay| time from
+  // now, instead of when it was originally due. The task keeps its ID. Returns
+  // false if this could not be done (e.g., because |id| is zero, or the task is
+  // already about to run), in which case the task's timing is unchanged. This
+  // lets clients that re-schedule often (e.g., Alarm) avoid cancelling and
+  // re-posting their tasks.
+  virtual bool RescheduleDelayedTask(DelayedTaskId id, Clock::duration delay) {
+    return false;
+  }
+
   // Return true if the calling thread is the thread that task runner is using
   // to run tasks, false otherwise.
   virtual bool IsRunningOnTaskRunner() = 0;
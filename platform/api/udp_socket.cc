@@ -4,9 +4,31 @@
 
 #include "platform/api/udp_socket.h"
 
+#include <utility>
+
 namespace openscreen {
 
 UdpSocket::UdpSocket() = default;
 UdpSocket::~UdpSocket() = default;
 
+void UdpSocket::SendMessages(const MessageBuffer* messages,
+                             size_t count,
+                             const IPEndpoint& dest) {
+  for (size_t i = 0; i < count; ++i) {
+    SendMessage(messages[i].data, messages[i].length, dest);
+  }
+}
+
+void UdpSocket::SetReceiveBatching(int max_batch_size,
+                                   size_t max_packet_size) {}
+
+void UdpSocket::SetReceiveBufferPool(PacketBufferPool* buffer_pool) {}
+
+void UdpSocket::Client::OnReadBatch(UdpSocket* socket,
+                                    std::vector<UdpPacket> packets) {
+  for (UdpPacket& packet : packets) {
+    OnRead(socket, std::move(packet));
+  }
+}
+
 }  // namespace openscreen
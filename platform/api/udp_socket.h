@@ -9,10 +9,12 @@
 #include <stdint.h>  // uint8_t
 
 #include <memory>
+#include <vector>
 
 #include "platform/api/network_interface.h"
 #include "platform/base/error.h"
 #include "platform/base/ip_address.h"
+#include "platform/base/packet_buffer_pool.h"
 #include "platform/base/udp_packet.h"
 
 namespace openscreen {
@@ -45,6 +47,13 @@ class UdpSocket {
 
     // Method called when a packet is read.
     virtual void OnRead(UdpSocket* socket, ErrorOr<UdpPacket> packet) = 0;
+
+    // Method called when a batch of packets has been read all at once (see
+    // UdpSocket::SetReceiveBatching()). The |packets| are in arrival order.
+    // The default implementation calls OnRead() once for each packet; Clients
+    // that might destroy |socket| (or themselves) from within OnRead() should
+    // override this.
+    virtual void OnReadBatch(UdpSocket* socket, std::vector<UdpPacket> packets);
   };
 
   // Constants used to specify how we want packets sent from this socket.
@@ -64,6 +73,12 @@ class UdpSocket {
 
   using Version = IPAddress::Version;
 
+  // References the payload of one message to be sent by SendMessages().
+  struct MessageBuffer {
+    const void* data;
+    size_t length;
+  };
+
   // Creates a new, scoped UdpSocket within the IPv4 or IPv6 family.
   // |local_endpoint| may be zero (see comments for Bind()). This method must be
   // defined in the platform-level implementation. All |client| methods called
@@ -108,9 +123,33 @@ class UdpSocket {
                            size_t length,
                            const IPEndpoint& dest) = 0;
 
+  // Sends |count| messages, in order, to the same |dest|. The outcome is the
+  // same as calling SendMessage() for each of the |messages|, except that
+  // implementations may hand them all to the operating system at once, and may
+  // drop the remainder of the messages after the first send error. The default
+  // implementation just calls SendMessage() for each.
+  virtual void SendMessages(const MessageBuffer* messages,
+                            size_t count,
+                            const IPEndpoint& dest);
+
   // Sets the DSCP value to use for all messages sent from this socket.
   virtual void SetDscp(DscpMode state) = 0;
 
+  // Requests that up to |max_batch_size| packets be read from the socket each
+  // time it becomes readable, and then be delivered all together in one call
+  // to Client::OnReadBatch(). Batch reads require pre-sizing the receive
+  // buffers: Packets larger than |max_packet_size| bytes will be dropped. A
+  // |max_batch_size| of 1 or less restores the default one-packet-at-a-time
+  // behavior. This is only a hint, and the default implementation ignores it.
+  virtual void SetReceiveBatching(int max_batch_size, size_t max_packet_size);
+
+  // Requests that the buffers for received packets be taken from |buffer_pool|,
+  // which must outlive this UdpSocket. The Client may then return the buffers
+  // of the packets it is done with to the same pool. Passing nullptr restores
+  // the default behavior of allocating a new buffer for each packet. This is
+  // only a hint, and the default implementation ignores it.
+  virtual void SetReceiveBufferPool(PacketBufferPool* buffer_pool);
+
  protected:
   UdpSocket();
 };
@@ -0,0 +1,12 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/base/inline_task.h"
+
+namespace openscreen {
+
+// static
+constexpr size_t InlineTask::kInlineStorageSize;
+
+}  // namespace openscreen
@@ -0,0 +1,160 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PLATFORM_BASE_INLINE_TASK_H_
+#define PLATFORM_BASE_INLINE_TASK_H_
+
+#include <stddef.h>
+
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace openscreen {
+
+// A move-only wrapper around any callable target taking no arguments (e.g., a
+// lambda-expression, std::bind result, or function pointer), whose result is
+// discarded. This is the type of TaskRunner::Task.
+//
+// Callables of up to kInlineStorageSize bytes (e.g., lambdas capturing a few
+// pointers or values) are stored within the InlineTask itself, and so
+// creating, moving, and running an InlineTask does not allocate memory. Larger
+// callables are moved to the heap.
+//
+// For compatibility with code written against std::packaged_task (the previous
+// TaskRunner::Task type), valid() reports whether a callable is held. Unlike
+// std::packaged_task, there is no future, and so running an InlineTask more
+// than once is allowed, provided the callable itself allows it.
+class InlineTask {
+ public:
+  static constexpr size_t kInlineStorageSize = 48;
+
+  // Returns true if instances of |Functor| are stored inline.
+  template <typename Functor>
+  static constexpr bool IsStoredInline() {
+    return sizeof(Functor) <= kInlineStorageSize &&
+           alignof(Functor) <= alignof(Storage) &&
+           std::is_nothrow_move_constructible<Functor>::value;
+  }
+
+  InlineTask() noexcept = default;
+  InlineTask(std::nullptr_t) noexcept {}  // NOLINT(runtime/explicit)
+
+  template <typename Functor,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<Functor>::type,
+                InlineTask>::value>::type>
+  explicit InlineTask(Functor functor) {
+    Emplace(std::move(functor),
+            std::integral_constant<bool, IsStoredInline<Functor>()>());
+  }
+
+  InlineTask(InlineTask&& other) noexcept { MoveFrom(&other); }
+
+  InlineTask& operator=(InlineTask&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  InlineTask& operator=(std::nullptr_t) noexcept {
+    Reset();
+    return *this;
+  }
+
+  ~InlineTask() { Reset(); }
+
+  bool valid() const { return ops_ != nullptr; }
+  explicit operator bool() const { return valid(); }
+
+  void operator()() noexcept {
+    assert(valid());
+    ops_->invoke(&storage_);
+  }
+
+ private:
+  using Storage = typename std::aligned_storage<kInlineStorageSize>::type;
+
+  // The type-specific operations on the callable held in |storage_|.
+  struct Ops {
+    void (*invoke)(void* storage);
+    // Move-constructs the callable into |to| and destroys the one in |from|.
+    void (*relocate)(void* from, void* to);
+    void (*destroy)(void* storage);
+  };
+
+  template <typename Functor>
+  struct InlineOps {
+    static void Invoke(void* storage) {
+      (*static_cast<Functor*>(storage))();
+    }
+    static void Relocate(void* from, void* to) {
+      Functor* const functor = static_cast<Functor*>(from);
+      new (to) Functor(std::move(*functor));
+      functor->~Functor();
+    }
+    static void Destroy(void* storage) {
+      static_cast<Functor*>(storage)->~Functor();
+    }
+    static constexpr Ops kOps = {&Invoke, &Relocate, &Destroy};
+  };
+
+  template <typename Functor>
+  struct HeapOps {
+    static Functor*& Get(void* storage) {
+      return *static_cast<Functor**>(storage);
+    }
+    static void Invoke(void* storage) { (*Get(storage))(); }
+    static void Relocate(void* from, void* to) {
+      new (to) Functor*(Get(from));
+    }
+    static void Destroy(void* storage) { delete Get(storage); }
+    static constexpr Ops kOps = {&Invoke, &Relocate, &Destroy};
+  };
+
+  template <typename Functor>
+  void Emplace(Functor functor, std::true_type stored_inline) {
+    new (&storage_) Functor(std::move(functor));
+    ops_ = &InlineOps<Functor>::kOps;
+  }
+
+  template <typename Functor>
+  void Emplace(Functor functor, std::false_type stored_inline) {
+    new (&storage_) Functor*(new Functor(std::move(functor)));
+    ops_ = &HeapOps<Functor>::kOps;
+  }
+
+  void MoveFrom(InlineTask* other) {
+    if (other->ops_) {
+      other->ops_->relocate(&other->storage_, &storage_);
+      ops_ = other->ops_;
+      other->ops_ = nullptr;
+    }
+  }
+
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  Storage storage_;
+  const Ops* ops_ = nullptr;
+};
+
+// static
+template <typename Functor>
+constexpr InlineTask::Ops InlineTask::InlineOps<Functor>::kOps;
+
+// static
+template <typename Functor>
+constexpr InlineTask::Ops InlineTask::HeapOps<Functor>::kOps;
+
+}  // namespace openscreen
+
+#endif  // PLATFORM_BASE_INLINE_TASK_H_
@@ -0,0 +1,121 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/base/inline_task.h"
+
+#include <array>
+#include <memory>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace {
+
+// Counts how many instances exist, to check that InlineTask destroys the
+// callables it holds exactly once.
+class Counted {
+ public:
+  explicit Counted(int* instance_count) : instance_count_(instance_count) {
+    ++*instance_count_;
+  }
+  Counted(Counted&& other) noexcept : instance_count_(other.instance_count_) {
+    ++*instance_count_;
+  }
+  ~Counted() { --*instance_count_; }
+
+ private:
+  int* const instance_count_;
+};
+
+TEST(InlineTaskTest, DefaultConstructedIsNotValid) {
+  InlineTask task;
+  EXPECT_FALSE(task.valid());
+  EXPECT_FALSE(task);
+  InlineTask null_task = nullptr;
+  EXPECT_FALSE(null_task.valid());
+}
+
+TEST(InlineTaskTest, RunsSmallCallable) {
+  int value = 0;
+  auto functor = [&value] { value += 1; };
+  static_assert(InlineTask::IsStoredInline<decltype(functor)>(),
+                "should fit inline");
+  InlineTask task(functor);
+  ASSERT_TRUE(task.valid());
+  task();
+  EXPECT_EQ(1, value);
+  std::move(task)();
+  EXPECT_EQ(2, value);
+}
+
+TEST(InlineTaskTest, RunsFunctionPointer) {
+  static int value;
+  value = 0;
+  InlineTask task(+[] { value = 42; });
+  task();
+  EXPECT_EQ(42, value);
+}
+
+TEST(InlineTaskTest, RunsMutableAndMoveOnlyCallables) {
+  auto owned = std::make_unique<int>(5);
+  int result = 0;
+  InlineTask task([owned = std::move(owned), &result]() mutable {
+    result = ++*owned;
+  });
+  task();
+  EXPECT_EQ(6, result);
+}
+
+TEST(InlineTaskTest, StoresLargeCallablesOnTheHeap) {
+  std::array<int, 32> big{};
+  big[31] = 7;
+  int result = 0;
+  auto functor = [big, &result] { result = big[31]; };
+  static_assert(!InlineTask::IsStoredInline<decltype(functor)>(),
+                "should not fit inline");
+  InlineTask task(std::move(functor));
+  InlineTask moved(std::move(task));
+  EXPECT_FALSE(task.valid());
+  moved();
+  EXPECT_EQ(7, result);
+}
+
+TEST(InlineTaskTest, DestroysCallablesExactlyOnce) {
+  int instance_count = 0;
+  {
+    InlineTask task([counted = Counted(&instance_count)] {});
+    EXPECT_EQ(1, instance_count);
+
+    InlineTask moved(std::move(task));
+    EXPECT_EQ(1, instance_count);
+
+    InlineTask assigned;
+    assigned = std::move(moved);
+    EXPECT_EQ(1, instance_count);
+
+    // Assigning over a valid task destroys its callable.
+    assigned = InlineTask([counted = Counted(&instance_count)] {});
+    EXPECT_EQ(1, instance_count);
+
+    assigned = nullptr;
+    EXPECT_EQ(0, instance_count);
+
+    assigned = InlineTask([counted = Counted(&instance_count)] {});
+    EXPECT_EQ(1, instance_count);
+  }
+  EXPECT_EQ(0, instance_count);
+
+  // Same, for callables stored on the heap.
+  {
+    std::array<char, 2 * InlineTask::kInlineStorageSize> padding{};
+    InlineTask task([padding, counted = Counted(&instance_count)] {});
+    InlineTask moved(std::move(task));
+    EXPECT_EQ(1, instance_count);
+  }
+  EXPECT_EQ(0, instance_count);
+}
+
+}  // namespace
+}  // namespace openscreen
@@ -0,0 +1,53 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/base/packet_buffer_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace openscreen {
+
+PacketBufferPool::PacketBufferPool(size_t buffer_size,
+                                   size_t max_pooled_buffers)
+    : buffer_size_(buffer_size), max_pooled_buffers_(max_pooled_buffers) {
+  free_buffers_.reserve(max_pooled_buffers_);
+}
+
+PacketBufferPool::~PacketBufferPool() = default;
+
+std::vector<uint8_t> PacketBufferPool::Acquire(size_t size) {
+  std::vector<uint8_t> buffer;
+  if (size <= buffer_size_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_buffers_.empty()) {
+      buffer = std::move(free_buffers_.back());
+      free_buffers_.pop_back();
+    }
+  }
+  if (buffer.capacity() == 0) {
+    // Allocate the full |buffer_size_|, so that the buffer can be pooled later.
+    buffer.reserve(std::max(size, buffer_size_));
+  }
+  buffer.resize(size);
+  return buffer;
+}
+
+void PacketBufferPool::Release(std::vector<uint8_t> buffer) {
+  if (buffer.capacity() < buffer_size_) {
+    return;
+  }
+  buffer.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_buffers_.size() < max_pooled_buffers_) {
+    free_buffers_.push_back(std::move(buffer));
+  }
+}
+
+size_t PacketBufferPool::GetPooledBufferCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_buffers_.size();
+}
+
+}  // namespace openscreen
@@ -0,0 +1,60 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PLATFORM_BASE_PACKET_BUFFER_POOL_H_
+#define PLATFORM_BASE_PACKET_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "platform/base/macros.h"
+
+namespace openscreen {
+
+// A thread-safe free list of byte buffers, each able to hold one network
+// packet. Received packets are read into buffers taken from the pool, and
+// whichever code ends up owning a packet returns its buffer to the pool once
+// done with it. In the steady state, this means packets are received without
+// any heap allocations.
+//
+// Buffers are plain std::vector<uint8_t>s, so that code unaware of the pool
+// can still own and free them normally: Returning a buffer to the pool is an
+// optimization, not a requirement.
+class PacketBufferPool {
+ public:
+  // |buffer_size| is the capacity of each pooled buffer, and
+  // |max_pooled_buffers| limits how many unused buffers are retained.
+  PacketBufferPool(size_t buffer_size, size_t max_pooled_buffers);
+  ~PacketBufferPool();
+
+  size_t buffer_size() const { return buffer_size_; }
+
+  // Returns a buffer of |size| bytes, with unspecified contents. If |size| is
+  // not greater than buffer_size(), this re-uses a pooled buffer, if any.
+  std::vector<uint8_t> Acquire(size_t size);
+
+  // Returns the storage of |buffer| to the pool, for re-use by a later call to
+  // Acquire(). If the pool is full, or |buffer| is too small to be re-used, it
+  // is freed instead.
+  void Release(std::vector<uint8_t> buffer);
+
+  // Returns the number of unused buffers currently in the pool.
+  size_t GetPooledBufferCount() const;
+
+ private:
+  const size_t buffer_size_;
+  const size_t max_pooled_buffers_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::vector<uint8_t>> free_buffers_;
+
+  OSP_DISALLOW_COPY_AND_ASSIGN(PacketBufferPool);
+};
+
+}  // namespace openscreen
+
+#endif  // PLATFORM_BASE_PACKET_BUFFER_POOL_H_
@@ -0,0 +1,85 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/base/packet_buffer_pool.h"
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace {
+
+TEST(PacketBufferPoolTest, ReusesReleasedBuffers) {
+  PacketBufferPool pool(1500, 8);
+  EXPECT_EQ(0u, pool.GetPooledBufferCount());
+
+  std::vector<uint8_t> buffer = pool.Acquire(1500);
+  EXPECT_EQ(1500u, buffer.size());
+  const uint8_t* const storage = buffer.data();
+
+  // A shrunk buffer (e.g., after receiving a small packet) is still re-usable.
+  buffer.resize(42);
+  pool.Release(std::move(buffer));
+  EXPECT_EQ(1u, pool.GetPooledBufferCount());
+
+  std::vector<uint8_t> reused = pool.Acquire(1000);
+  EXPECT_EQ(1000u, reused.size());
+  EXPECT_EQ(storage, reused.data());
+  EXPECT_EQ(0u, pool.GetPooledBufferCount());
+}
+
+TEST(PacketBufferPoolTest, AllocatesWhenEmptyOrForOversizedBuffers) {
+  PacketBufferPool pool(100, 8);
+  pool.Release(pool.Acquire(100));
+  ASSERT_EQ(1u, pool.GetPooledBufferCount());
+
+  // Oversized requests never take buffers from the pool.
+  std::vector<uint8_t> big = pool.Acquire(101);
+  EXPECT_EQ(101u, big.size());
+  EXPECT_EQ(1u, pool.GetPooledBufferCount());
+
+  std::vector<uint8_t> first = pool.Acquire(100);
+  std::vector<uint8_t> second = pool.Acquire(100);
+  EXPECT_NE(first.data(), second.data());
+  EXPECT_EQ(0u, pool.GetPooledBufferCount());
+}
+
+TEST(PacketBufferPoolTest, DoesNotRetainTooSmallOrTooManyBuffers) {
+  PacketBufferPool pool(100, 2);
+
+  // Buffers not from the pool, and too small to be re-used, are just freed.
+  pool.Release(std::vector<uint8_t>(99));
+  pool.Release(std::vector<uint8_t>());
+  EXPECT_EQ(0u, pool.GetPooledBufferCount());
+
+  for (int i = 0; i < 5; ++i) {
+    pool.Release(std::vector<uint8_t>(100));
+  }
+  EXPECT_EQ(2u, pool.GetPooledBufferCount());
+}
+
+TEST(PacketBufferPoolTest, IsThreadSafe) {
+  PacketBufferPool pool(64, 16);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&pool] {
+      for (int i = 0; i < 1000; ++i) {
+        std::vector<uint8_t> buffer = pool.Acquire(64);
+        buffer[0] = static_cast<uint8_t>(i);
+        pool.Release(std::move(buffer));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(pool.GetPooledBufferCount(), 4u);
+  EXPECT_GE(pool.GetPooledBufferCount(), 1u);
+}
+
+}  // namespace
+}  // namespace openscreen
@@ -8,26 +8,53 @@
 #include <vector>
 
 #include "platform/impl/udp_socket_reader_posix.h"
+#include "util/osp_logging.h"
+
+#if defined(__linux__)
+#include "platform/impl/socket_handle_waiter_linux.h"
+#endif
 
 namespace openscreen {
 
+namespace {
+
+std::unique_ptr<SocketHandleWaiterPosix> CreateSocketHandleWaiter(
+    PlatformClientPosix::SocketWaiterType waiter_type) {
+#if defined(__linux__)
+  if (waiter_type == PlatformClientPosix::SocketWaiterType::kEpoll) {
+    ErrorOr<std::unique_ptr<SocketHandleWaiterLinux>> result =
+        SocketHandleWaiterLinux::Create(&Clock::now);
+    if (result) {
+      return std::move(result.value());
+    }
+    OSP_LOG_WARN << "Unable to use epoll, falling back to select(): "
+                 << result.error();
+  }
+#endif
+  return std::make_unique<SocketHandleWaiterPosix>(&Clock::now);
+}
+
+}  // namespace
+
 // static
 PlatformClientPosix* PlatformClientPosix::instance_ = nullptr;
 
 // static
 void PlatformClientPosix::Create(Clock::duration networking_operation_timeout,
                                  Clock::duration networking_loop_interval,
-                                 std::unique_ptr<TaskRunnerImpl> task_runner) {
+                                 std::unique_ptr<TaskRunnerImpl> task_runner,
+                                 SocketWaiterType waiter_type) {
   SetInstance(new PlatformClientPosix(networking_operation_timeout,
                                       networking_loop_interval,
-                                      std::move(task_runner)));
+                                      std::move(task_runner), waiter_type));
 }
 
 // static
 void PlatformClientPosix::Create(Clock::duration networking_operation_timeout,
-                                 Clock::duration networking_loop_interval) {
-  SetInstance(new PlatformClientPosix(networking_operation_timeout,
-                                      networking_loop_interval));
+                                 Clock::duration networking_loop_interval,
+                                 SocketWaiterType waiter_type) {
+  SetInstance(new PlatformClientPosix(
+      networking_operation_timeout, networking_loop_interval, waiter_type));
 }
 
 // static
@@ -58,7 +85,21 @@ TaskRunner* PlatformClientPosix::GetTaskRunner() {
   return task_runner_.get();
 }
 
+TaskRunnerPool* PlatformClientPosix::GetTaskRunnerPool() {
+  std::call_once(task_runner_pool_initialization_, [this]() {
+    task_runner_pool_ =
+        std::make_unique<TaskRunnerPool>(std::thread::hardware_concurrency());
+  });
+  return task_runner_pool_.get();
+}
+
 PlatformClientPosix::~PlatformClientPosix() {
+  if (task_runner_pool_) {
+    OSP_DVLOG << "Shutting down the Task Runner pool...";
+    task_runner_pool_.reset();
+    OSP_DVLOG << "\tTask Runner pool shutdown complete!";
+  }
+
   OSP_DVLOG << "Shutting down the Task Runner...";
   task_runner_->RequestStopSoon();
   if (task_runner_thread_ && task_runner_thread_->joinable()) {
@@ -80,11 +121,13 @@ void PlatformClientPosix::SetInstance(PlatformClientPosix* instance) {
 
 PlatformClientPosix::PlatformClientPosix(
     Clock::duration networking_operation_timeout,
-    Clock::duration networking_loop_interval)
+    Clock::duration networking_loop_interval,
+    SocketWaiterType waiter_type)
     : networking_loop_(networking_operations(),
                        networking_operation_timeout,
                        networking_loop_interval),
       task_runner_(new TaskRunnerImpl(Clock::now)),
+      waiter_type_(waiter_type),
       networking_loop_thread_(&OperationLoop::RunUntilStopped,
                               &networking_loop_),
       task_runner_thread_(
@@ -93,17 +136,19 @@ PlatformClientPosix::PlatformClientPosix(
 PlatformClientPosix::PlatformClientPosix(
     Clock::duration networking_operation_timeout,
     Clock::duration networking_loop_interval,
-    std::unique_ptr<TaskRunnerImpl> task_runner)
+    std::unique_ptr<TaskRunnerImpl> task_runner,
+    SocketWaiterType waiter_type)
     : networking_loop_(networking_operations(),
                        networking_operation_timeout,
                        networking_loop_interval),
       task_runner_(std::move(task_runner)),
+      waiter_type_(waiter_type),
       networking_loop_thread_(&OperationLoop::RunUntilStopped,
                               &networking_loop_) {}
 
 SocketHandleWaiterPosix* PlatformClientPosix::socket_handle_waiter() {
   std::call_once(waiter_initialization_, [this]() {
-    waiter_ = std::make_unique<SocketHandleWaiterPosix>(&Clock::now);
+    waiter_ = CreateSocketHandleWaiter(waiter_type_);
     waiter_created_.store(true);
   });
   return waiter_.get();
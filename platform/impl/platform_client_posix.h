@@ -15,6 +15,7 @@
 #include "platform/base/macros.h"
 #include "platform/impl/socket_handle_waiter_posix.h"
 #include "platform/impl/task_runner.h"
+#include "platform/impl/task_runner_pool.h"
 #include "platform/impl/tls_data_router_posix.h"
 #include "util/operation_loop.h"
 
@@ -36,6 +37,18 @@ class UdpSocketReaderPosix;
 // FIXME: Remove Create and Shutdown and use the ctor/dtor directly.
 class PlatformClientPosix {
  public:
+  // The mechanism used by the networking thread to wait for sockets to become
+  // ready.
+  enum class SocketWaiterType {
+    // select(): Portable, but the cost of each wait grows with the number of
+    // watched sockets, and socket descriptors are limited to FD_SETSIZE.
+    kSelect,
+
+    // epoll: Sockets are registered once, and each wait only returns the ready
+    // ones. Linux only. Falls back to kSelect if unavailable.
+    kEpoll,
+  };
+
   // Initializes the platform implementation.
   //
   // |networking_loop_interval| sets the minimum amount of time that should pass
@@ -47,14 +60,18 @@ class PlatformClientPosix {
   // single networking operation type.
   //
   // |task_runner| is a client-provided TaskRunner implementation.
+  //
+  // |waiter_type| selects the mechanism used to wait for socket events.
   static void Create(Clock::duration networking_operation_timeout,
                      Clock::duration networking_loop_interval,
-                     std::unique_ptr<TaskRunnerImpl> task_runner);
+                     std::unique_ptr<TaskRunnerImpl> task_runner,
+                     SocketWaiterType waiter_type = SocketWaiterType::kEpoll);
 
   // Initializes the platform implementation and creates a new TaskRunner (which
   // starts a new thread).
   static void Create(Clock::duration networking_operation_timeout,
-                     Clock::duration networking_loop_interval);
+                     Clock::duration networking_loop_interval,
+                     SocketWaiterType waiter_type = SocketWaiterType::kEpoll);
 
   // Shuts down and deletes the PlatformClient instance currently stored as a
   // singleton. This method is expected to be called before program exit. After
@@ -76,6 +93,12 @@ class PlatformClientPosix {
   // NOTE: This method is expected to be thread safe.
   TaskRunner* GetTaskRunner();
 
+  // Returns a pool of additional TaskRunners, one per hardware thread, that
+  // independent streaming sessions may be pinned to so that they run in
+  // parallel (see TaskRunnerPool). The pool is created on first use.
+  // NOTE: This method is thread-safe.
+  TaskRunnerPool* GetTaskRunnerPool();
+
  protected:
   // Called by ShutDown().
   ~PlatformClientPosix();
@@ -84,11 +107,13 @@ class PlatformClientPosix {
 
  private:
   PlatformClientPosix(Clock::duration networking_operation_timeout,
-                      Clock::duration networking_loop_interval);
+                      Clock::duration networking_loop_interval,
+                      SocketWaiterType waiter_type);
 
   PlatformClientPosix(Clock::duration networking_operation_timeout,
                       Clock::duration networking_loop_interval,
-                      std::unique_ptr<TaskRunnerImpl> task_runner);
+                      std::unique_ptr<TaskRunnerImpl> task_runner,
+                      SocketWaiterType waiter_type);
 
   // This method is thread-safe.
   SocketHandleWaiterPosix* socket_handle_waiter();
@@ -105,6 +130,8 @@ class PlatformClientPosix {
 
   std::unique_ptr<TaskRunnerImpl> task_runner_;
 
+  const SocketWaiterType waiter_type_;
+
   // Track whether the associated instance variable has been created yet.
   std::atomic_bool waiter_created_{false};
   std::atomic_bool tls_data_router_created_{false};
@@ -114,11 +141,13 @@ class PlatformClientPosix {
   std::once_flag waiter_initialization_;
   std::once_flag udp_socket_reader_initialization_;
   std::once_flag tls_data_router_initialization_;
+  std::once_flag task_runner_pool_initialization_;
 
   // Instance objects are created at runtime when they are first needed.
   std::unique_ptr<SocketHandleWaiterPosix> waiter_;
   std::unique_ptr<UdpSocketReaderPosix> udp_socket_reader_;
   std::unique_ptr<TlsDataRouterPosix> tls_data_router_;
+  std::unique_ptr<TaskRunnerPool> task_runner_pool_;
 
   // Threads for running TaskRunner and OperationLoop instances.
   // NOTE: These must be declared last to avoid nondterministic failures.
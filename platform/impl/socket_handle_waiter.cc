@@ -20,6 +20,7 @@ void SocketHandleWaiter::Subscribe(Subscriber* subscriber,
   std::lock_guard<std::mutex> lock(mutex_);
   if (handle_mappings_.find(handle) == handle_mappings_.end()) {
     handle_mappings_.emplace(handle, SocketSubscription{subscriber});
+    OnHandleWatched(handle);
   }
 }
 
@@ -29,6 +30,7 @@ void SocketHandleWaiter::Unsubscribe(Subscriber* subscriber,
   auto iterator = handle_mappings_.find(handle);
   if (handle_mappings_.find(handle) != handle_mappings_.end()) {
     handle_mappings_.erase(iterator);
+    OnHandleUnwatched(handle);
   }
 }
 
@@ -36,6 +38,7 @@ void SocketHandleWaiter::UnsubscribeAll(Subscriber* subscriber) {
   std::lock_guard<std::mutex> lock(mutex_);
   for (auto it = handle_mappings_.begin(); it != handle_mappings_.end();) {
     if (it->second.subscriber == subscriber) {
+      OnHandleUnwatched(it->first);
       it = handle_mappings_.erase(it);
     } else {
       it++;
@@ -50,6 +53,7 @@ void SocketHandleWaiter::OnHandleDeletion(Subscriber* subscriber,
   auto it = handle_mappings_.find(handle);
   if (it != handle_mappings_.end()) {
     handle_mappings_.erase(it);
+    OnHandleUnwatched(handle);
     if (!disable_locking_for_testing) {
       handles_being_deleted_.push_back(handle);
 
@@ -68,6 +72,13 @@ void SocketHandleWaiter::OnHandleDeletion(Subscriber* subscriber,
   }
 }
 
+void SocketHandleWaiter::SetWriteInterest(SocketHandleRef handle,
+                                          bool is_interested) {}
+
+void SocketHandleWaiter::OnHandleWatched(SocketHandleRef handle) {}
+
+void SocketHandleWaiter::OnHandleUnwatched(SocketHandleRef handle) {}
+
 void SocketHandleWaiter::ProcessReadyHandles(
     std::vector<HandleWithSubscription>* handles,
     Clock::duration timeout) {
@@ -62,6 +62,16 @@ class SocketHandleWaiter {
                         SocketHandleRef handle,
                         bool disable_locking_for_testing = false);
 
+  // Sets whether the subscriber for |handle| should be told when the handle is
+  // writeable. Subscribers should only express interest while they have data
+  // waiting to be written, since a connected socket is nearly always writeable
+  // and would otherwise wake every wait. This may be called from any thread,
+  // including from within Subscriber::ProcessReadyHandle(), but only while
+  // |handle| is subscribed to. The default implementation does nothing, which
+  // is appropriate for implementations that check every handle for
+  // writeability on every call to AwaitSocketsReadable().
+  virtual void SetWriteInterest(SocketHandleRef handle, bool is_interested);
+
   OSP_DISALLOW_COPY_AND_ASSIGN(SocketHandleWaiter);
 
   // Gets all socket handles to process, checks them for readable data, and
@@ -81,6 +91,14 @@ class SocketHandleWaiter {
       const std::vector<SocketHandleRef>& socket_fds,
       const Clock::duration& timeout) = 0;
 
+  // Called whenever a |handle| starts or stops being watched, while the
+  // internal lock is held. Implementations that register the watched handles
+  // with the operating system once, rather than on every call to
+  // AwaitSocketsReadable(), override these. The default implementations do
+  // nothing.
+  virtual void OnHandleWatched(SocketHandleRef handle);
+  virtual void OnHandleUnwatched(SocketHandleRef handle);
+
  private:
   struct SocketSubscription {
     Subscriber* subscriber = nullptr;
@@ -0,0 +1,161 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/impl/socket_handle_waiter_linux.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "platform/impl/socket_handle_posix.h"
+#include "util/osp_logging.h"
+
+namespace openscreen {
+
+namespace {
+
+// The maximum number of events returned by one epoll_wait() call. Any other
+// ready handles will be reported by the next call.
+constexpr size_t kMaxEventsPerWait = 256;
+
+// Converts the |timeout| to the millisecond value expected by epoll_wait(),
+// rounding up so that short timeouts do not become busy-polls.
+int ToEpollTimeout(Clock::duration timeout) {
+  if (timeout <= Clock::duration::zero()) {
+    return 0;
+  }
+  auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(timeout);
+  if (millis < timeout) {
+    ++millis;
+  }
+  return static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+      millis.count(), std::numeric_limits<int>::max()));
+}
+
+}  // namespace
+
+// static
+ErrorOr<std::unique_ptr<SocketHandleWaiterLinux>>
+SocketHandleWaiterLinux::Create(ClockNowFunctionPtr now_function) {
+  const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1) {
+    return Error(Error::Code::kIOFailure, strerror(errno));
+  }
+  return std::unique_ptr<SocketHandleWaiterLinux>(
+      new SocketHandleWaiterLinux(now_function, epoll_fd));
+}
+
+SocketHandleWaiterLinux::SocketHandleWaiterLinux(
+    ClockNowFunctionPtr now_function,
+    int epoll_fd)
+    : SocketHandleWaiterPosix(now_function), epoll_fd_(epoll_fd) {}
+
+SocketHandleWaiterLinux::~SocketHandleWaiterLinux() {
+  close(epoll_fd_);
+}
+
+ErrorOr<std::vector<SocketHandleWaiterLinux::ReadyHandle>>
+SocketHandleWaiterLinux::AwaitSocketsReadable(
+    const std::vector<SocketHandleRef>& socket_handles,
+    const Clock::duration& timeout) {
+  // Match the select() implementation, which fails when there is nothing to
+  // watch.
+  if (socket_handles.empty()) {
+    return Error::Code::kIOFailure;
+  }
+
+  events_.resize(std::min(socket_handles.size(), kMaxEventsPerWait));
+  const int rv = epoll_wait(epoll_fd_, events_.data(),
+                            static_cast<int>(events_.size()),
+                            ToEpollTimeout(timeout));
+  if (rv == -1) {
+    return (errno == EINTR) ? Error::Code::kAgain : Error::Code::kIOFailure;
+  } else if (rv == 0) {
+    // This occurs when no sockets have a pending read.
+    return Error::Code::kAgain;
+  }
+
+  std::vector<ReadyHandle> changed_handles;
+  changed_handles.reserve(rv);
+  for (int i = 0; i < rv; ++i) {
+    const epoll_event& event = events_[i];
+    uint32_t flags = 0;
+    // Like select(), report error and hang-up conditions as "readable," so that
+    // the subscriber's next read will surface them.
+    if (event.events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      flags |= Flags::kReadable;
+    }
+    if (event.events & EPOLLOUT) {
+      flags |= Flags::kWriteable;
+    }
+    if (flags) {
+      const SocketHandle* const handle =
+          static_cast<const SocketHandle*>(event.data.ptr);
+      changed_handles.push_back({std::cref(*handle), flags});
+    }
+  }
+
+  return changed_handles;
+}
+
+void SocketHandleWaiterLinux::SetWriteInterest(SocketHandleRef handle,
+                                               bool is_interested) {
+  // epoll_ctl() is thread-safe, and modifying a registration takes effect even
+  // for an epoll_wait() that is already in progress on another thread.
+  const uint32_t events = is_interested ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  const auto it = registered_events_.find(handle.get().fd);
+  if (it == registered_events_.end() || it->second == events) {
+    return;
+  }
+  if (UpdateRegistration(EPOLL_CTL_MOD, handle, events) == -1) {
+    OSP_LOG_WARN << "Unable to update socket " << handle.get().fd << ": "
+                 << strerror(errno);
+    return;
+  }
+  it->second = events;
+}
+
+void SocketHandleWaiterLinux::OnHandleWatched(SocketHandleRef handle) {
+  // Writeability is only watched for once the subscriber asks for it.
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  if (UpdateRegistration(EPOLL_CTL_ADD, handle, EPOLLIN) == -1) {
+    // The fd may have been closed and then re-used without being unwatched, in
+    // which case it must be re-associated with the new SocketHandle.
+    if (errno != EEXIST ||
+        UpdateRegistration(EPOLL_CTL_MOD, handle, EPOLLIN) == -1) {
+      OSP_LOG_WARN << "Unable to watch socket " << handle.get().fd << ": "
+                   << strerror(errno);
+      registered_events_.erase(handle.get().fd);
+      return;
+    }
+  }
+  registered_events_[handle.get().fd] = EPOLLIN;
+}
+
+void SocketHandleWaiterLinux::OnHandleUnwatched(SocketHandleRef handle) {
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  registered_events_.erase(handle.get().fd);
+  // Note: Failure is expected if the fd has already been closed, since the
+  // kernel automatically removes closed fds from the epoll set.
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, handle.get().fd, nullptr);
+}
+
+int SocketHandleWaiterLinux::UpdateRegistration(int op,
+                                                SocketHandleRef handle,
+                                                uint32_t events) {
+  epoll_event event = {};
+  event.events = events;
+  // The SocketHandle outlives its registration: It is always unwatched (see
+  // OnHandleDeletion()) before being destroyed.
+  event.data.ptr = const_cast<SocketHandle*>(&handle.get());
+  return epoll_ctl(epoll_fd_, op, handle.get().fd, &event);
+}
+
+}  // namespace openscreen
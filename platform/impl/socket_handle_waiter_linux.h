@@ -0,0 +1,85 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PLATFORM_IMPL_SOCKET_HANDLE_WAITER_LINUX_H_
+#define PLATFORM_IMPL_SOCKET_HANDLE_WAITER_LINUX_H_
+
+#include <sys/epoll.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "platform/base/error.h"
+#include "platform/base/macros.h"
+#include "platform/impl/socket_handle_waiter_posix.h"
+
+namespace openscreen {
+
+// A SocketHandleWaiter that uses epoll instead of select(). Handles are
+// registered with the kernel once, when they start being watched, and each wait
+// only returns the handles that are ready. So, unlike select(), the cost of
+// waiting does not grow with the number of watched handles, and there is no
+// FD_SETSIZE limit.
+//
+// Registrations are level-triggered, matching the select() behavior that
+// subscribers rely on: A subscriber that does not drain all available data from
+// a handle (or that has more data to write) will be notified again after the
+// next wait. Handles are only watched for writeability while their subscriber
+// has expressed interest via SetWriteInterest(): Otherwise, every connected
+// socket would be reported as writeable by every wait.
+class SocketHandleWaiterLinux : public SocketHandleWaiterPosix {
+ public:
+  using SocketHandleRef = SocketHandleWaiter::SocketHandleRef;
+
+  // Returns a new instance, or an error if the epoll instance could not be
+  // created.
+  static ErrorOr<std::unique_ptr<SocketHandleWaiterLinux>> Create(
+      ClockNowFunctionPtr now_function);
+
+  ~SocketHandleWaiterLinux() override;
+
+  // SocketHandleWaiter overrides.
+  void SetWriteInterest(SocketHandleRef handle, bool is_interested) override;
+
+  OSP_DISALLOW_COPY_AND_ASSIGN(SocketHandleWaiterLinux);
+
+ protected:
+  using SocketHandleWaiter::ReadyHandle;
+
+  // SocketHandleWaiter overrides.
+  ErrorOr<std::vector<ReadyHandle>> AwaitSocketsReadable(
+      const std::vector<SocketHandleRef>& socket_fds,
+      const Clock::duration& timeout) override;
+  void OnHandleWatched(SocketHandleRef handle) override;
+  void OnHandleUnwatched(SocketHandleRef handle) override;
+
+ private:
+  SocketHandleWaiterLinux(ClockNowFunctionPtr now_function, int epoll_fd);
+
+  // Registers or re-registers |handle| with the epoll instance, to wait for the
+  // given |events|. |op| is EPOLL_CTL_ADD or EPOLL_CTL_MOD. Must be called with
+  // |registration_mutex_| held.
+  int UpdateRegistration(int op, SocketHandleRef handle, uint32_t events);
+
+  const int epoll_fd_;
+
+  // Guards |registered_events_|, since SetWriteInterest() may be called from
+  // any thread.
+  std::mutex registration_mutex_;
+
+  // The events each watched fd is currently registered for, so that
+  // SetWriteInterest() can skip the epoll_ctl() call when nothing changes.
+  std::unordered_map<int, uint32_t> registered_events_;
+
+  // Receives the events from each epoll_wait() call. This is only accessed from
+  // AwaitSocketsReadable(), and is retained to avoid re-allocating it for every
+  // call.
+  std::vector<epoll_event> events_;
+};
+
+}  // namespace openscreen
+
+#endif  // PLATFORM_IMPL_SOCKET_HANDLE_WAITER_LINUX_H_
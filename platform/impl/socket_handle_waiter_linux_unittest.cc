@@ -0,0 +1,164 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/impl/socket_handle_waiter_linux.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "platform/impl/socket_handle_posix.h"
+#include "util/osp_logging.h"
+
+namespace openscreen {
+namespace {
+
+using ::testing::_;
+using ::testing::Eq;
+using ::testing::Invoke;
+using ::testing::StrictMock;
+
+constexpr Clock::duration kTimeout = std::chrono::milliseconds(100);
+
+class MockSubscriber : public SocketHandleWaiter::Subscriber {
+ public:
+  using SocketHandleRef = SocketHandleWaiter::SocketHandleRef;
+  MOCK_METHOD2(ProcessReadyHandle, void(SocketHandleRef, uint32_t));
+};
+
+// Owns a connected pair of datagram sockets.
+class SocketPair {
+ public:
+  SocketPair() {
+    int fds[2];
+    OSP_CHECK_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+    local_ = std::make_unique<SocketHandle>(fds[0]);
+    remote_fd_ = fds[1];
+  }
+
+  ~SocketPair() {
+    close(local_->fd);
+    close(remote_fd_);
+  }
+
+  const SocketHandle& local() const { return *local_; }
+
+  void SendToLocal() {
+    constexpr char kMessage[] = "hello";
+    OSP_CHECK_EQ(write(remote_fd_, kMessage, sizeof(kMessage)),
+                 static_cast<ssize_t>(sizeof(kMessage)));
+  }
+
+ private:
+  std::unique_ptr<SocketHandle> local_;
+  int remote_fd_ = -1;
+};
+
+class SocketHandleWaiterLinuxTest : public ::testing::Test {
+ public:
+  SocketHandleWaiterLinuxTest() {
+    auto result = SocketHandleWaiterLinux::Create(&Clock::now);
+    OSP_CHECK(result) << result.error();
+    waiter_ = std::move(result.value());
+  }
+
+ protected:
+  std::unique_ptr<SocketHandleWaiterLinux> waiter_;
+};
+
+TEST_F(SocketHandleWaiterLinuxTest, ReportsWriteableHandlesOnlyWhenInterested) {
+  StrictMock<MockSubscriber> subscriber;
+  SocketPair pair;
+  waiter_->Subscribe(&subscriber, std::cref(pair.local()));
+
+  // The socket is writeable, but nobody has asked to know about it.
+  EXPECT_EQ(Error::Code::kAgain, waiter_->ProcessHandles(kTimeout).code());
+
+  waiter_->SetWriteInterest(std::cref(pair.local()), true);
+  EXPECT_CALL(subscriber,
+              ProcessReadyHandle(_, Eq(SocketHandleWaiter::kWriteable)));
+  EXPECT_TRUE(waiter_->ProcessHandles(kTimeout).ok());
+
+  waiter_->SetWriteInterest(std::cref(pair.local()), false);
+  EXPECT_EQ(Error::Code::kAgain, waiter_->ProcessHandles(kTimeout).code());
+
+  waiter_->Unsubscribe(&subscriber, std::cref(pair.local()));
+}
+
+TEST_F(SocketHandleWaiterLinuxTest, IgnoresRepeatedWriteInterestChanges) {
+  StrictMock<MockSubscriber> subscriber;
+  SocketPair pair;
+  waiter_->Subscribe(&subscriber, std::cref(pair.local()));
+
+  waiter_->SetWriteInterest(std::cref(pair.local()), false);
+  EXPECT_EQ(Error::Code::kAgain, waiter_->ProcessHandles(kTimeout).code());
+
+  waiter_->SetWriteInterest(std::cref(pair.local()), true);
+  waiter_->SetWriteInterest(std::cref(pair.local()), true);
+  EXPECT_CALL(subscriber,
+              ProcessReadyHandle(_, Eq(SocketHandleWaiter::kWriteable)));
+  EXPECT_TRUE(waiter_->ProcessHandles(kTimeout).ok());
+
+  waiter_->SetWriteInterest(std::cref(pair.local()), false);
+  waiter_->SetWriteInterest(std::cref(pair.local()), false);
+  EXPECT_EQ(Error::Code::kAgain, waiter_->ProcessHandles(kTimeout).code());
+
+  // Re-watching the handle starts over without write interest.
+  waiter_->SetWriteInterest(std::cref(pair.local()), true);
+  waiter_->Unsubscribe(&subscriber, std::cref(pair.local()));
+  waiter_->Subscribe(&subscriber, std::cref(pair.local()));
+  EXPECT_EQ(Error::Code::kAgain, waiter_->ProcessHandles(kTimeout).code());
+
+  waiter_->Unsubscribe(&subscriber, std::cref(pair.local()));
+}
+
+TEST_F(SocketHandleWaiterLinuxTest, ReportsReadableHandlesToTheirSubscribers) {
+  StrictMock<MockSubscriber> subscriber;
+  StrictMock<MockSubscriber> subscriber2;
+  SocketPair pair;
+  SocketPair pair2;
+  waiter_->Subscribe(&subscriber, std::cref(pair.local()));
+  waiter_->Subscribe(&subscriber2, std::cref(pair2.local()));
+
+  pair2.SendToLocal();
+  EXPECT_CALL(subscriber2,
+              ProcessReadyHandle(_, Eq(SocketHandleWaiter::kReadable)))
+      .WillOnce(Invoke(
+          [&](SocketHandleWaiter::SocketHandleRef handle, uint32_t flags) {
+            EXPECT_EQ(&pair2.local(), &handle.get());
+          }));
+  EXPECT_TRUE(waiter_->ProcessHandles(kTimeout).ok());
+
+  waiter_->UnsubscribeAll(&subscriber);
+  waiter_->UnsubscribeAll(&subscriber2);
+}
+
+TEST_F(SocketHandleWaiterLinuxTest, StopsReportingUnwatchedHandles) {
+  StrictMock<MockSubscriber> subscriber;
+  SocketPair pair;
+  SocketPair pair2;
+  waiter_->Subscribe(&subscriber, std::cref(pair.local()));
+  waiter_->Subscribe(&subscriber, std::cref(pair2.local()));
+  waiter_->Unsubscribe(&subscriber, std::cref(pair.local()));
+
+  pair.SendToLocal();
+  pair2.SendToLocal();
+  EXPECT_CALL(subscriber,
+              ProcessReadyHandle(_, Eq(SocketHandleWaiter::kReadable)))
+      .WillOnce(Invoke(
+          [&](SocketHandleWaiter::SocketHandleRef handle, uint32_t flags) {
+            EXPECT_EQ(&pair2.local(), &handle.get());
+          }));
+  EXPECT_TRUE(waiter_->ProcessHandles(kTimeout).ok());
+
+  waiter_->OnHandleDeletion(&subscriber, std::cref(pair2.local()), true);
+  EXPECT_EQ(Error::Code::kIOFailure, waiter_->ProcessHandles(kTimeout).code());
+}
+
+}  // namespace
+}  // namespace openscreen
@@ -0,0 +1,158 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Counts the heap allocations made while creating, moving, and running tasks,
+// comparing TaskRunner::Task (InlineTask) against std::packaged_task (the
+// previous TaskRunner::Task type); and while posting tasks to, and running them
+// on, a TaskRunnerImpl. Global operator new is replaced to do the counting.
+//
+// Usage: task_allocation_benchmark
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>  // NOLINT
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "platform/api/task_runner.h"
+#include "platform/api/time.h"
+#include "platform/impl/task_runner.h"
+
+namespace {
+
+std::atomic<uint64_t> g_allocation_count{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+  g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* const memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  std::abort();
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t size) noexcept {
+  std::free(memory);
+}
+
+namespace openscreen {
+namespace {
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+constexpr int kIterations = 100000;
+
+struct Result {
+  double allocations_per_task;
+  double nanoseconds_per_task;
+};
+
+// Runs |body| kIterations times, and returns the per-iteration averages.
+template <typename Body>
+Result Measure(Body body) {
+  const uint64_t allocations_before = g_allocation_count.load();
+  const auto start = BenchmarkClock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    body();
+  }
+  const auto elapsed = BenchmarkClock::now() - start;
+  const uint64_t allocations = g_allocation_count.load() - allocations_before;
+  return Result{
+      static_cast<double>(allocations) / kIterations,
+      std::chrono::duration<double, std::nano>(elapsed).count() / kIterations};
+}
+
+// Creates a task from |functor|, moves it twice (as happens when it is posted
+// and then dequeued), and runs it.
+template <typename TaskType, typename Functor>
+Result MeasureTaskLifecycle(Functor functor) {
+  return Measure([&functor] {
+    TaskType task(functor);
+    TaskType queued(std::move(task));
+    TaskType running(std::move(queued));
+    running();
+  });
+}
+
+// Posts |kIterations| copies of |functor| to a TaskRunnerImpl, in batches, and
+// runs them. One warm-up batch is run first, so that the TaskRunnerImpl's
+// internal buffers reach their steady-state sizes.
+template <typename Functor>
+Result MeasurePostAndRun(Functor functor) {
+  constexpr int kBatchSize = 1000;
+  TaskRunnerImpl runner(&Clock::now);
+  const auto run_batch = [&runner, &functor] {
+    for (int i = 0; i < kBatchSize; ++i) {
+      runner.PostTask(functor);
+    }
+    runner.RequestStopSoon();
+    runner.RunUntilStopped();
+  };
+  run_batch();
+
+  const uint64_t allocations_before = g_allocation_count.load();
+  const auto start = BenchmarkClock::now();
+  for (int i = 0; i < kIterations / kBatchSize; ++i) {
+    run_batch();
+  }
+  const auto elapsed = BenchmarkClock::now() - start;
+  const uint64_t allocations = g_allocation_count.load() - allocations_before;
+  return Result{
+      static_cast<double>(allocations) / kIterations,
+      std::chrono::duration<double, std::nano>(elapsed).count() / kIterations};
+}
+
+void PrintResult(const char* name, const Result& result) {
+  std::printf("%-48s %12.2f %12.1f\n", name, result.allocations_per_task,
+              result.nanoseconds_per_task);
+}
+
+}  // namespace
+}  // namespace openscreen
+
+int main(int argc, char* argv[]) {
+  using openscreen::InlineTask;
+  using openscreen::MeasurePostAndRun;
+  using openscreen::MeasureTaskLifecycle;
+  using openscreen::PrintResult;
+
+  // Note: The previous TaskRunner::Task was std::packaged_task<void()
+  // noexcept>, which allocates in the same way.
+  using PackagedTask = std::packaged_task<void()>;
+
+  int counter = 0;
+  int* const counter_ptr = &counter;
+  const auto small_lambda = [counter_ptr, &counter] {
+    *counter_ptr += counter & 1;
+  };
+  std::array<int, 32> big_array{};
+  const auto large_lambda = [big_array, counter_ptr] {
+    *counter_ptr += big_array[0];
+  };
+
+  std::printf("%-48s %12s %12s\n", "", "allocs/task", "ns/task");
+  PrintResult("small capture, std::packaged_task",
+              MeasureTaskLifecycle<PackagedTask>(small_lambda));
+  PrintResult("small capture, InlineTask",
+              MeasureTaskLifecycle<InlineTask>(small_lambda));
+  PrintResult("large capture, std::packaged_task",
+              MeasureTaskLifecycle<PackagedTask>(large_lambda));
+  PrintResult("large capture, InlineTask",
+              MeasureTaskLifecycle<InlineTask>(large_lambda));
+  PrintResult("small capture, TaskRunnerImpl post+run",
+              MeasurePostAndRun(small_lambda));
+  PrintResult("large capture, TaskRunnerImpl post+run",
+              MeasurePostAndRun(large_lambda));
+
+  return 0;
+}
@@ -44,29 +44,70 @@ TaskRunnerImpl::~TaskRunnerImpl() {
 }
 
 void TaskRunnerImpl::PostPackagedTask(Task task) {
-  std::lock_guard<std::mutex> lock(task_mutex_);
-  tasks_.emplace_back(std::move(task));
-  if (task_waiter_) {
-    task_waiter_->OnTaskPosted();
-  } else {
-    run_loop_wakeup_.notify_one();
-  }
+  tasks_.Push(std::move(task));
+  WakeUpRunLoopIfParked();
 }
 
 void TaskRunnerImpl::PostPackagedTaskWithDelay(Task task,
                                                Clock::duration delay) {
-  std::lock_guard<std::mutex> lock(task_mutex_);
+  PostCancelablePackagedTaskWithDelay(std::move(task), delay);
+}
+
+TaskRunner::DelayedTaskId TaskRunnerImpl::PostCancelablePackagedTaskWithDelay(
+    Task task,
+    Clock::duration delay) {
   if (delay <= Clock::duration::zero()) {
-    tasks_.emplace_back(std::move(task));
-  } else {
-    delayed_tasks_.emplace(
-        std::make_pair(now_function_() + delay, std::move(task)));
+    PostPackagedTask(std::move(task));
+    return 0;
   }
-  if (task_waiter_) {
-    task_waiter_->OnTaskPosted();
-  } else {
-    run_loop_wakeup_.notify_one();
+
+  std::lock_guard<std::mutex> lock(task_mutex_);
+  const DelayedTaskId id =
+      delayed_tasks_.Insert(now_function_() + delay, std::move(task));
+  // Since |task_mutex_| is held, the run loop cannot be between the point
+  // where it decides how long to sleep and the point where it starts sleeping.
+  if (run_loop_parked_.load(std::memory_order_relaxed)) {
+    if (task_waiter_) {
+      task_waiter_->OnTaskPosted();
+    } else {
+      run_loop_wakeup_.notify_one();
+    }
+  }
+  return id;
+}
+
+bool TaskRunnerImpl::CancelDelayedTask(DelayedTaskId id) {
+  if (id == 0) {
+    return false;
+  }
+  absl::optional<TaskWithMetadata> canceled_task;
+  {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    canceled_task = delayed_tasks_.Remove(id);
+  }
+  // Note: |canceled_task| is destroyed here, outside of the lock, since its
+  // destruction might re-entrantly call into this TaskRunner.
+  return canceled_task.has_value();
+}
+
+bool TaskRunnerImpl::RescheduleDelayedTask(DelayedTaskId id,
+                                           Clock::duration delay) {
+  if (id == 0) {
+    return false;
   }
+  std::lock_guard<std::mutex> lock(task_mutex_);
+  if (!delayed_tasks_.Reschedule(id, now_function_() + delay)) {
+    return false;
+  }
+  // The task may now be due before the run loop was going to wake up.
+  if (run_loop_parked_.load(std::memory_order_relaxed)) {
+    if (task_waiter_) {
+      task_waiter_->OnTaskPosted();
+    } else {
+      run_loop_wakeup_.notify_one();
+    }
+  }
+  return true;
 }
 
 bool TaskRunnerImpl::IsRunningOnTaskRunner() {
@@ -137,23 +178,26 @@ void TaskRunnerImpl::RunRunnableTasks() {
 }
 
 void TaskRunnerImpl::ScheduleDelayedTasks() {
-  std::lock_guard<std::mutex> lock(task_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    if (delayed_tasks_.IsEmpty()) {
+      return;
+    }
+    // Getting the time can be expensive on some platforms, so only get it
+    // once.
+    delayed_tasks_.PopExpired(now_function_(), &due_tasks_);
+  }
 
-  // Getting the time can be expensive on some platforms, so only get it once.
-  const auto current_time = now_function_();
-  const auto end_of_range = delayed_tasks_.upper_bound(current_time);
-  for (auto it = delayed_tasks_.begin(); it != end_of_range; ++it) {
-    tasks_.push_back(std::move(it->second));
+  for (TaskWithMetadata& task : due_tasks_) {
+    tasks_.Push(std::move(task));
   }
-  delayed_tasks_.erase(delayed_tasks_.begin(), end_of_range);
+  due_tasks_.clear();
 }
 
 bool TaskRunnerImpl::GrabMoreRunnableTasks() {
   OSP_DCHECK(running_tasks_.empty());
 
-  std::unique_lock<std::mutex> lock(task_mutex_);
-  if (!tasks_.empty()) {
-    running_tasks_.swap(tasks_);
+  if (tasks_.PopAll(&running_tasks_) > 0) {
     return true;
   }
 
@@ -161,27 +205,50 @@ bool TaskRunnerImpl::GrabMoreRunnableTasks() {
     return false;  // Stop was requested. Don't wait for more tasks.
   }
 
+  // Announce that the run loop is about to sleep, and then check |tasks_| one
+  // last time. Either this check will see a task posted concurrently, or the
+  // posting thread will see |run_loop_parked_| and issue a wake-up.
+  std::unique_lock<std::mutex> lock(task_mutex_);
+  run_loop_parked_.store(true, std::memory_order_seq_cst);
+  if (!tasks_.IsEmpty()) {
+    run_loop_parked_.store(false, std::memory_order_relaxed);
+    return false;
+  }
+
+  const Clock::time_point next_wake_up_time =
+      delayed_tasks_.GetNextWakeUpTime();
   if (task_waiter_) {
     Clock::duration timeout = waiter_timeout_;
-    if (!delayed_tasks_.empty()) {
-      Clock::duration next_task_delta =
-          delayed_tasks_.begin()->first - now_function_();
+    if (next_wake_up_time != Clock::time_point::max()) {
+      Clock::duration next_task_delta = next_wake_up_time - now_function_();
       if (next_task_delta < timeout) {
         timeout = next_task_delta;
       }
     }
     lock.unlock();
     task_waiter_->WaitForTaskToBePosted(timeout);
-    return false;
-  }
-
-  if (delayed_tasks_.empty()) {
+  } else if (next_wake_up_time == Clock::time_point::max()) {
     run_loop_wakeup_.wait(lock);
   } else {
-    run_loop_wakeup_.wait_for(lock,
-                              delayed_tasks_.begin()->first - now_function_());
+    run_loop_wakeup_.wait_for(lock, next_wake_up_time - now_function_());
   }
+
+  run_loop_parked_.store(false, std::memory_order_relaxed);
   return false;
 }
 
+void TaskRunnerImpl::WakeUpRunLoopIfParked() {
+  // This load must not be reordered before the store that made the new task
+  // visible (see comments in GrabMoreRunnableTasks()).
+  if (!run_loop_parked_.load(std::memory_order_seq_cst)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(task_mutex_);
+  if (task_waiter_) {
+    task_waiter_->OnTaskPosted();
+  } else {
+    run_loop_wakeup_.notify_one();
+  }
+}
+
 }  // namespace openscreen
@@ -5,8 +5,8 @@
 #ifndef PLATFORM_IMPL_TASK_RUNNER_H_
 #define PLATFORM_IMPL_TASK_RUNNER_H_
 
+#include <atomic>
 #include <condition_variable>  // NOLINT
-#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <thread>
@@ -18,6 +18,8 @@
 #include "platform/api/task_runner.h"
 #include "platform/api/time.h"
 #include "platform/base/error.h"
+#include "util/mpsc_queue.h"
+#include "util/timer_wheel.h"
 #include "util/trace_logging.h"
 
 namespace openscreen {
@@ -55,6 +57,11 @@ class TaskRunnerImpl final : public TaskRunner {
   ~TaskRunnerImpl() final;
   void PostPackagedTask(Task task) final;
   void PostPackagedTaskWithDelay(Task task, Clock::duration delay) final;
+  DelayedTaskId PostCancelablePackagedTaskWithDelay(
+      Task task,
+      Clock::duration delay) final;
+  bool CancelDelayedTask(DelayedTaskId id) final;
+  bool RescheduleDelayedTask(DelayedTaskId id, Clock::duration delay) final;
   bool IsRunningOnTaskRunner() final;
 
   // Blocks the current thread, executing tasks from the queue with the desired
@@ -114,19 +121,32 @@ class TaskRunnerImpl final : public TaskRunner {
   // transferred.
   bool GrabMoreRunnableTasks();
 
+  // Wakes up the run loop, but only if it is parked (or about to park) waiting
+  // for new tasks. Must be called after the task has been made visible in
+  // |tasks_| or |delayed_tasks_|.
+  void WakeUpRunLoopIfParked();
+
   const ClockNowFunctionPtr now_function_;
 
   // Flag that indicates whether the task runner loop should continue. This is
   // only meant to be read/written on the thread executing RunUntilStopped().
   bool is_running_;
 
-  // This mutex is used for |tasks_| and |delayed_tasks_|, and also for
-  // notifying the run loop to wake up when it is waiting for a task to be added
-  // to the queue in |run_loop_wakeup_|.
+  // Immediately-runnable tasks. Any thread may post to this queue without
+  // taking a lock; only the thread executing RunUntilStopped() consumes from
+  // it.
+  MpscQueue<TaskWithMetadata> tasks_;
+
+  // This mutex is used for |delayed_tasks_|, and also for notifying the run
+  // loop to wake up when it is waiting for a task to be added to the queue in
+  // |run_loop_wakeup_|.
   std::mutex task_mutex_;
-  std::vector<TaskWithMetadata> tasks_ GUARDED_BY(task_mutex_);
-  std::multimap<Clock::time_point, TaskWithMetadata> delayed_tasks_
-      GUARDED_BY(task_mutex_);
+  TimerWheel<TaskWithMetadata> delayed_tasks_ GUARDED_BY(task_mutex_);
+
+  // Set by the run loop, while holding |task_mutex_|, just before it re-checks
+  // |tasks_| and goes to sleep; and cleared once it wakes up. Posting threads
+  // only need to take |task_mutex_| and issue a wake-up while this is true.
+  std::atomic_bool run_loop_parked_{false};
 
   // When |task_waiter_| is nullptr, |run_loop_wakeup_| is used for sleeping the
   // task runner.  Otherwise, |run_loop_wakeup_| isn't used and |task_waiter_|
@@ -135,11 +155,15 @@ class TaskRunnerImpl final : public TaskRunner {
   TaskWaiter* const task_waiter_;
   Clock::duration waiter_timeout_;
 
-  // To prevent excessive re-allocation of the underlying array of the |tasks_|
-  // vector, use an A/B vector-swap mechanism. |running_tasks_| starts out
-  // empty, and is swapped with |tasks_| when it is time to run the Tasks.
+  // Tasks are moved out of |tasks_| into |running_tasks_| in batches before
+  // being run. The vector is re-used, to prevent excessive re-allocation of
+  // its underlying array.
   std::vector<TaskWithMetadata> running_tasks_;
 
+  // Scratch space used by ScheduleDelayedTasks() when moving tasks from
+  // |delayed_tasks_| to |tasks_|.
+  std::vector<TaskWithMetadata> due_tasks_;
+
   std::thread::id task_runner_thread_id_;
 
   OSP_DISALLOW_COPY_AND_ASSIGN(TaskRunnerImpl);
@@ -0,0 +1,132 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/impl/task_runner_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "util/osp_logging.h"
+
+namespace openscreen {
+
+TaskRunnerPool::Member::Member(ClockNowFunctionPtr now_function)
+    : runner(now_function),
+      thread(&TaskRunnerImpl::RunUntilStopped, &runner) {}
+
+TaskRunnerPool::TaskRunnerPool(size_t runner_count,
+                               ClockNowFunctionPtr now_function) {
+  runner_count = std::max<size_t>(runner_count, 1);
+  runners_.reserve(runner_count);
+  for (size_t i = 0; i < runner_count; ++i) {
+    runners_.emplace_back(new Member(now_function));
+  }
+}
+
+TaskRunnerPool::~TaskRunnerPool() {
+  for (const std::unique_ptr<Member>& member : runners_) {
+    member->runner.RequestStopSoon();
+  }
+  for (const std::unique_ptr<Member>& member : runners_) {
+    member->thread.join();
+  }
+
+  // A pool member stops once it has run the tasks queued before its stop
+  // request, and so the RunOneThreadSafeTask() calls posted after that (e.g.,
+  // by a thread-safe task, or by RunOneThreadSafeTask() re-posting itself) are
+  // dropped. Run the tasks they would have run here instead; they are
+  // thread-safe, and so may run on any thread. Tasks that post more
+  // thread-safe tasks are handled by re-checking until none remain.
+  while (true) {
+    TaskRunner::Task task;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (thread_safe_tasks_.empty()) {
+        break;
+      }
+      task = std::move(thread_safe_tasks_.front());
+      thread_safe_tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+TaskRunner* TaskRunnerPool::GetRunner(size_t index) {
+  OSP_DCHECK_LT(index, runners_.size());
+  return &runners_[index]->runner;
+}
+
+TaskRunner* TaskRunnerPool::PinSession(SessionId session_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = pins_.find(session_id);
+  if (it != pins_.end()) {
+    ++it->second.pin_count;
+    return &runners_[it->second.member_index]->runner;
+  }
+
+  size_t best_index = 0;
+  for (size_t i = 1; i < runners_.size(); ++i) {
+    if (runners_[i]->pinned_session_count <
+        runners_[best_index]->pinned_session_count) {
+      best_index = i;
+    }
+  }
+  ++runners_[best_index]->pinned_session_count;
+  pins_.emplace(session_id, Pin{best_index, 1});
+  return &runners_[best_index]->runner;
+}
+
+void TaskRunnerPool::UnpinSession(SessionId session_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = pins_.find(session_id);
+  OSP_DCHECK(it != pins_.end());
+  if (--it->second.pin_count == 0) {
+    --runners_[it->second.member_index]->pinned_session_count;
+    pins_.erase(it);
+  }
+}
+
+int TaskRunnerPool::GetPinnedSessionCount(size_t index) const {
+  OSP_DCHECK_LT(index, runners_.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  return runners_[index]->pinned_session_count;
+}
+
+void TaskRunnerPool::PostThreadSafePackagedTask(TaskRunner::Task task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_safe_tasks_.push_back(std::move(task));
+  }
+  const size_t index = next_stealer_index_.fetch_add(1) % runners_.size();
+  PostRunThreadSafeTasks(index);
+}
+
+void TaskRunnerPool::PostRunThreadSafeTasks(size_t index) {
+  runners_[index]->runner.PostTask(
+      [this, index] { RunOneThreadSafeTask(index); });
+}
+
+void TaskRunnerPool::RunOneThreadSafeTask(size_t index) {
+  TaskRunner::Task task;
+  bool more_tasks_remain;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (thread_safe_tasks_.empty()) {
+      return;  // Other pool members already ran them all.
+    }
+    task = std::move(thread_safe_tasks_.front());
+    thread_safe_tasks_.pop_front();
+    more_tasks_remain = !thread_safe_tasks_.empty();
+  }
+  task();
+
+  // Keep going, but yield to the tasks already queued on this pool member
+  // first. The remaining thread-safe tasks may be queued behind a busy pool
+  // member, which would otherwise get to them much later.
+  if (more_tasks_remain) {
+    PostRunThreadSafeTasks(index);
+  }
+}
+
+}  // namespace openscreen
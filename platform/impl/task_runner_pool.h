@@ -0,0 +1,125 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PLATFORM_IMPL_TASK_RUNNER_POOL_H_
+#define PLATFORM_IMPL_TASK_RUNNER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "platform/api/task_runner.h"
+#include "platform/api/time.h"
+#include "platform/base/macros.h"
+#include "platform/impl/task_runner.h"
+
+namespace openscreen {
+
+// A fixed-size set of TaskRunnerImpls, each running on its own thread. This
+// allows independent units of work (e.g., the Environment, Senders, and
+// Receivers of separate streaming sessions) to run in parallel, while each one
+// keeps the single-threaded, sequenced execution guarantees of TaskRunner.
+//
+// Code that is not thread-safe must always run on the same pool member. To
+// that end, a "session" is pinned to one pool member with PinSession(), and
+// the returned TaskRunner is used to construct all of its objects (e.g.,
+// passed to the Environment constructor). New sessions are pinned to the pool
+// member with the fewest pinned sessions.
+//
+// Additionally, tasks that are explicitly thread-safe may be posted with
+// PostThreadSafeTask(). These run on whichever pool member gets to them first,
+// so that an idle pool member takes over work that is queued behind a busy one.
+//
+// All public methods are thread-safe.
+class TaskRunnerPool {
+ public:
+  // Identifies a session, for PinSession() and UnpinSession(). The values are
+  // chosen by the client.
+  using SessionId = uint64_t;
+
+  // Creates |runner_count| TaskRunnerImpls (at least one), and starts a thread
+  // for each.
+  explicit TaskRunnerPool(size_t runner_count,
+                          ClockNowFunctionPtr now_function = &Clock::now);
+
+  // Stops all pool members, after they have run all of their immediately-
+  // runnable tasks, and joins their threads. Then, any thread-safe tasks that
+  // the pool members did not get to (e.g., those posted while they were
+  // stopping) are run on the calling thread.
+  ~TaskRunnerPool();
+
+  size_t size() const { return runners_.size(); }
+
+  // Returns the pool member at |index|, which must be less than size().
+  TaskRunner* GetRunner(size_t index);
+
+  // Returns the pool member that |session_id| is pinned to. If the session is
+  // not yet pinned, it is pinned to the pool member having the fewest pinned
+  // sessions. Every call must be balanced by a call to UnpinSession().
+  TaskRunner* PinSession(SessionId session_id);
+
+  // Releases one pin of |session_id|. Once all of its pins are released, the
+  // next PinSession() call for the same ID may choose a different pool member.
+  void UnpinSession(SessionId session_id);
+
+  // Returns the number of sessions currently pinned to the pool member at
+  // |index|.
+  int GetPinnedSessionCount(size_t index) const;
+
+  // Posts a |task| that may run on any pool member, in any order relative to
+  // other tasks. The task must be safe to run concurrently with all other
+  // tasks, including other thread-safe tasks.
+  template <typename Functor>
+  void PostThreadSafeTask(Functor f) {
+    PostThreadSafePackagedTask(TaskRunner::Task(std::move(f)));
+  }
+  void PostThreadSafePackagedTask(TaskRunner::Task task);
+
+ private:
+  struct Member {
+    explicit Member(ClockNowFunctionPtr now_function);
+
+    TaskRunnerImpl runner;
+    int pinned_session_count = 0;
+    std::thread thread;
+  };
+
+  struct Pin {
+    size_t member_index;
+    int pin_count;
+  };
+
+  // Posts a call to RunOneThreadSafeTask() to the pool member at |index|.
+  void PostRunThreadSafeTasks(size_t index);
+
+  // Runs the oldest task in |thread_safe_tasks_|, if any, on the pool member at
+  // |index|; and then re-posts itself if more remain. One of these is posted
+  // for each thread-safe task, so that pool members whose run loops are not
+  // busy do most of the work.
+  void RunOneThreadSafeTask(size_t index);
+
+  std::vector<std::unique_ptr<Member>> runners_;
+
+  mutable std::mutex mutex_;
+  std::map<SessionId, Pin> pins_ GUARDED_BY(mutex_);
+  std::deque<TaskRunner::Task> thread_safe_tasks_ GUARDED_BY(mutex_);
+
+  // Round-robin index of the pool member to receive the RunOneThreadSafeTask()
+  // call for the next thread-safe task.
+  std::atomic<size_t> next_stealer_index_{0};
+
+  OSP_DISALLOW_COPY_AND_ASSIGN(TaskRunnerPool);
+};
+
+}  // namespace openscreen
+
+#endif  // PLATFORM_IMPL_TASK_RUNNER_POOL_H_
@@ -0,0 +1,159 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/impl/task_runner_pool.h"
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace {
+
+// Blocks the calling thread until Signal() is called.
+class Latch {
+ public:
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    signaled_cv_.wait(lock, [this] { return signaled_; });
+  }
+
+  void Signal() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    signaled_ = true;
+    signaled_cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable signaled_cv_;
+  bool signaled_ = false;
+};
+
+TEST(TaskRunnerPoolTest, EachRunnerRunsItsTasksInOrderOnOneThread) {
+  constexpr int kTaskCount = 1000;
+  std::vector<int> results[3];
+  std::thread::id thread_ids[3];
+  {
+    TaskRunnerPool pool(3);
+    ASSERT_EQ(3u, pool.size());
+    for (int i = 0; i < kTaskCount; ++i) {
+      for (size_t r = 0; r < pool.size(); ++r) {
+        TaskRunner* const runner = pool.GetRunner(r);
+        pool.GetRunner(r)->PostTask([&, runner, r, i] {
+          EXPECT_TRUE(runner->IsRunningOnTaskRunner());
+          if (i == 0) {
+            thread_ids[r] = std::this_thread::get_id();
+          }
+          EXPECT_EQ(thread_ids[r], std::this_thread::get_id());
+          results[r].push_back(i);
+        });
+      }
+    }
+  }  // Destroying the pool runs all pending tasks.
+
+  for (const std::vector<int>& result : results) {
+    ASSERT_EQ(static_cast<size_t>(kTaskCount), result.size());
+    for (int i = 0; i < kTaskCount; ++i) {
+      EXPECT_EQ(i, result[i]);
+    }
+  }
+  EXPECT_NE(thread_ids[0], thread_ids[1]);
+  EXPECT_NE(thread_ids[1], thread_ids[2]);
+  EXPECT_NE(thread_ids[0], thread_ids[2]);
+}
+
+TEST(TaskRunnerPoolTest, PinsSessionsToTheLeastLoadedRunner) {
+  TaskRunnerPool pool(2);
+
+  TaskRunner* const first = pool.PinSession(100);
+  TaskRunner* const second = pool.PinSession(200);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(1, pool.GetPinnedSessionCount(0));
+  EXPECT_EQ(1, pool.GetPinnedSessionCount(1));
+
+  // Pinning the same session again always returns the same runner.
+  EXPECT_EQ(first, pool.PinSession(100));
+  EXPECT_EQ(1, pool.GetPinnedSessionCount(0));
+
+  // Once the session with ID 200 is completely unpinned, its runner is the
+  // least loaded one.
+  pool.UnpinSession(200);
+  EXPECT_EQ(0, pool.GetPinnedSessionCount(1));
+  EXPECT_EQ(second, pool.PinSession(300));
+
+  // The session with ID 100 stays pinned until both of its pins are released.
+  pool.UnpinSession(100);
+  EXPECT_EQ(first, pool.PinSession(400));
+  EXPECT_EQ(2, pool.GetPinnedSessionCount(0));
+  pool.UnpinSession(100);
+  EXPECT_EQ(1, pool.GetPinnedSessionCount(0));
+
+  pool.UnpinSession(300);
+  pool.UnpinSession(400);
+}
+
+TEST(TaskRunnerPoolTest, IdleRunnersTakeOverThreadSafeTasks) {
+  constexpr int kTaskCount = 100;
+  Latch unblock_runner;
+  Latch all_tasks_ran;
+  std::atomic<int> run_count{0};
+  std::mutex mutex;
+  std::set<std::thread::id> thread_ids;
+  {
+    TaskRunnerPool pool(2);
+
+    // Block one of the runners. Half of the thread-safe tasks are queued
+    // behind it, but the other runner must run them all.
+    pool.GetRunner(0)->PostTask([&] { unblock_runner.Wait(); });
+    for (int i = 0; i < kTaskCount; ++i) {
+      pool.PostThreadSafeTask([&] {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          thread_ids.insert(std::this_thread::get_id());
+        }
+        if (run_count.fetch_add(1) + 1 == kTaskCount) {
+          all_tasks_ran.Signal();
+        }
+      });
+    }
+
+    all_tasks_ran.Wait();
+    EXPECT_EQ(1u, thread_ids.size());
+    unblock_runner.Signal();
+  }
+  EXPECT_EQ(kTaskCount, run_count.load());
+}
+
+TEST(TaskRunnerPoolTest, RunsThreadSafeTasksLeftBehindByStoppedRunners) {
+  Latch first_runner_stopping;
+  std::atomic<int> run_count{0};
+  {
+    TaskRunnerPool pool(2);
+
+    // Stop the first runner early. Then, from the second runner, post a
+    // thread-safe task. The call to run it is posted to the first runner, which
+    // will never get to it (once it has finished stopping), and so it must be
+    // run when the pool is destroyed.
+    pool.GetRunner(0)->PostTask([&] {
+      static_cast<TaskRunnerImpl*>(pool.GetRunner(0))->RequestStopSoon();
+      first_runner_stopping.Signal();
+    });
+    pool.GetRunner(1)->PostTask([&] {
+      first_runner_stopping.Wait();
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      pool.PostThreadSafeTask([&] { ++run_count; });
+    });
+  }
+  EXPECT_EQ(1, run_count.load());
+}
+
+}  // namespace
+}  // namespace openscreen
@@ -8,6 +8,7 @@
 
 #include <atomic>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -217,6 +218,69 @@ TEST(TaskRunnerImplTest, TaskRunnerDelayedTasksDontBlockImmediateTasks) {
   EXPECT_EQ(ran_tasks, "1");
 }
 
+TEST(TaskRunnerImplTest, CancelsDelayedTasks) {
+  FakeClock fake_clock{Clock::time_point(milliseconds(1337))};
+  TaskRunnerImpl runner(&fake_clock.now);
+
+  std::string ran_tasks;
+  const TaskRunner::DelayedTaskId id_a =
+      runner.PostCancelablePackagedTaskWithDelay(
+          TaskRunner::Task([&ran_tasks] { ran_tasks += "A"; }),
+          milliseconds(10));
+  const TaskRunner::DelayedTaskId id_b =
+      runner.PostCancelablePackagedTaskWithDelay(
+          TaskRunner::Task([&ran_tasks] { ran_tasks += "B"; }),
+          milliseconds(20));
+  EXPECT_NE(id_a, TaskRunner::DelayedTaskId{0});
+  EXPECT_NE(id_a, id_b);
+  EXPECT_TRUE(runner.CancelDelayedTask(id_a));
+  EXPECT_FALSE(runner.CancelDelayedTask(id_a));
+
+  // Tasks that are not delayed cannot be canceled.
+  EXPECT_EQ(TaskRunner::DelayedTaskId{0},
+            runner.PostCancelablePackagedTaskWithDelay(
+                TaskRunner::Task([&ran_tasks] { ran_tasks += "1"; }),
+                Clock::duration::zero()));
+  EXPECT_FALSE(runner.CancelDelayedTask(0));
+
+  fake_clock.Advance(milliseconds(20));
+  runner.RequestStopSoon();
+  runner.RunUntilStopped();
+  EXPECT_EQ(ran_tasks, "1B");
+  EXPECT_FALSE(runner.CancelDelayedTask(id_b));
+}
+
+TEST(TaskRunnerImplTest, ReschedulesDelayedTasks) {
+  FakeClock fake_clock{Clock::time_point(milliseconds(1337))};
+  TaskRunnerImpl runner(&fake_clock.now);
+
+  std::string ran_tasks;
+  const TaskRunner::DelayedTaskId id_a =
+      runner.PostCancelablePackagedTaskWithDelay(
+          TaskRunner::Task([&ran_tasks] { ran_tasks += "A"; }),
+          milliseconds(1000));
+  const TaskRunner::DelayedTaskId id_b =
+      runner.PostCancelablePackagedTaskWithDelay(
+          TaskRunner::Task([&ran_tasks] { ran_tasks += "B"; }),
+          milliseconds(20));
+  EXPECT_TRUE(runner.RescheduleDelayedTask(id_a, milliseconds(10)));
+  EXPECT_FALSE(runner.RescheduleDelayedTask(0, milliseconds(10)));
+
+  fake_clock.Advance(milliseconds(10));
+  runner.RequestStopSoon();
+  runner.RunUntilStopped();
+  EXPECT_EQ(ran_tasks, "A");
+
+  // The task keeps its ID until it runs.
+  EXPECT_FALSE(runner.RescheduleDelayedTask(id_a, milliseconds(10)));
+  EXPECT_TRUE(runner.RescheduleDelayedTask(id_b, milliseconds(30)));
+  fake_clock.Advance(milliseconds(20));
+  runner.RequestStopSoon();
+  runner.RunUntilStopped();
+  EXPECT_EQ(ran_tasks, "A");
+  EXPECT_TRUE(runner.CancelDelayedTask(id_b));
+}
+
 TEST(TaskRunnerImplTest, TaskRunnerUsesEventWaiter) {
   std::unique_ptr<TaskRunnerImpl> runner =
       TaskRunnerWithWaiterFactory::Create(Clock::now);
@@ -269,6 +333,46 @@ TEST(TaskRunnerImplTest, WakesEventWaiterOnPostTask) {
   t.join();
 }
 
+TEST(TaskRunnerImplTest, RunsTasksPostedConcurrentlyFromManyThreads) {
+  TaskRunnerImpl runner(Clock::now);
+  std::thread t([&runner] { runner.RunUntilStopped(); });
+
+  constexpr int kNumPostingThreads = 4;
+  constexpr int kTasksPerThread = 2500;
+  std::vector<int> last_seen(kNumPostingThreads, -1);
+  std::atomic<int> tasks_run{0};
+  std::atomic<bool> out_of_order{false};
+  std::vector<std::thread> posting_threads;
+  for (int i = 0; i < kNumPostingThreads; ++i) {
+    posting_threads.emplace_back([&, i] {
+      for (int j = 0; j < kTasksPerThread; ++j) {
+        runner.PostTask([&, i, j] {
+          if (last_seen[i] != j - 1) {
+            out_of_order = true;
+          }
+          last_seen[i] = j;
+          ++tasks_run;
+        });
+        // Occasionally give the run loop a chance to go idle, so that wake-ups
+        // of a parked run loop are exercised too.
+        if (j % 500 == 0) {
+          std::this_thread::sleep_for(kTaskRunnerSleepTime);
+        }
+      }
+    });
+  }
+  for (std::thread& posting_thread : posting_threads) {
+    posting_thread.join();
+  }
+
+  WaitUntilCondition([&tasks_run] {
+    return tasks_run == kNumPostingThreads * kTasksPerThread;
+  });
+  EXPECT_FALSE(out_of_order);
+  runner.RequestStopSoon();
+  t.join();
+}
+
 class RepeatedClass {
  public:
   MOCK_METHOD0(Repeat, absl::optional<Clock::duration>());
@@ -23,6 +23,7 @@
 #include "platform/api/task_runner.h"
 #include "platform/base/error.h"
 #include "platform/impl/stream_socket.h"
+#include "platform/impl/tls_data_router_posix.h"
 #include "util/crypto/openssl_util.h"
 #include "util/osp_logging.h"
 
@@ -93,7 +94,13 @@ void TlsConnectionPosix::SetClient(Client* client) {
 
 bool TlsConnectionPosix::Send(const void* data, size_t len) {
   OSP_DCHECK(task_runner_->IsRunningOnTaskRunner());
-  return buffer_.Push(data, len);
+  if (!buffer_.Push(data, len)) {
+    return false;
+  }
+  if (platform_client_) {
+    platform_client_->tls_data_router()->SetHasPendingWrites(this, true);
+  }
+  return true;
 }
 
 IPEndpoint TlsConnectionPosix::GetLocalEndpoint() const {
@@ -117,24 +124,37 @@ void TlsConnectionPosix::RegisterConnectionWithDataRouter(
   OSP_DCHECK(!platform_client_);
   platform_client_ = platform_client;
   platform_client_->tls_data_router()->RegisterConnection(this);
+  // Data may have been buffered by Send() before registration.
+  if (!buffer_.GetReadableRegion().empty()) {
+    platform_client_->tls_data_router()->SetHasPendingWrites(this, true);
+  }
 }
 
 void TlsConnectionPosix::SendAvailableBytes() {
   absl::Span<const uint8_t> sendable_bytes = buffer_.GetReadableRegion();
-  if (sendable_bytes.empty()) {
-    return;
+  if (!sendable_bytes.empty()) {
+    ClearOpenSSLERRStack(CURRENT_LOCATION);
+    const int result =
+        SSL_write(ssl_.get(), sendable_bytes.data(), sendable_bytes.size());
+    if (result <= 0) {
+      const Error result_error = GetSSLError(ssl_.get(), result);
+      if (!result_error.ok() && (result_error.code() != Error::Code::kAgain)) {
+        DispatchError(result_error);
+      }
+    } else {
+      buffer_.Consume(static_cast<size_t>(result));
+    }
   }
 
-  ClearOpenSSLERRStack(CURRENT_LOCATION);
-  const int result =
-      SSL_write(ssl_.get(), sendable_bytes.data(), sendable_bytes.size());
-  if (result <= 0) {
-    const Error result_error = GetSSLError(ssl_.get(), result);
-    if (!result_error.ok() && (result_error.code() != Error::Code::kAgain)) {
-      DispatchError(result_error);
+  // Stop waiting for the socket to become writeable once the buffer has been
+  // drained. Send() may push more data concurrently, so check again after
+  // giving up interest, to make sure that data is not stranded.
+  if (platform_client_ && buffer_.GetReadableRegion().empty()) {
+    TlsDataRouterPosix* const router = platform_client_->tls_data_router();
+    router->SetHasPendingWrites(this, false);
+    if (!buffer_.GetReadableRegion().empty()) {
+      router->SetHasPendingWrites(this, true);
     }
-  } else {
-    buffer_.Consume(static_cast<size_t>(result));
   }
 }
 
@@ -45,6 +45,11 @@ void TlsDataRouterPosix::DeregisterConnection(TlsConnectionPosix* connection) {
   waiter_->OnHandleDeletion(this, connection->socket_handle());
 }
 
+void TlsDataRouterPosix::SetHasPendingWrites(TlsConnectionPosix* connection,
+                                             bool has_pending_writes) {
+  waiter_->SetWriteInterest(connection->socket_handle(), has_pending_writes);
+}
+
 void TlsDataRouterPosix::RegisterAcceptObserver(
     std::unique_ptr<StreamSocketPosix> socket,
     SocketObserver* observer) {
@@ -56,6 +56,12 @@ class TlsDataRouterPosix : public SocketHandleWaiter::Subscriber {
   // Deregister a TlsConnection.
   void DeregisterConnection(TlsConnectionPosix* connection);
 
+  // Sets whether a registered |connection| has data waiting to be written, and
+  // so should have SendAvailableBytes() called once its socket is writeable.
+  // May be called from any thread.
+  void SetHasPendingWrites(TlsConnectionPosix* connection,
+                           bool has_pending_writes);
+
   // Takes ownership of a StreamSocket and registers that it should be watched
   // for incoming TCP connections with the SocketHandleWaiter.
   void RegisterAcceptObserver(std::unique_ptr<StreamSocketPosix> socket,
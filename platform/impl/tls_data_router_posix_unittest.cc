@@ -28,6 +28,7 @@ class MockNetworkWaiter final : public SocketHandleWaiter {
       AwaitSocketsReadable,
       ErrorOr<std::vector<ReadyHandle>>(const std::vector<SocketHandleRef>&,
                                         const Clock::duration&));
+  MOCK_METHOD2(SetWriteInterest, void(SocketHandleRef, bool));
 };
 
 class MockSocket : public StreamSocketPosix {
@@ -79,6 +80,7 @@ class TlsNetworkingManagerPosixTest : public testing::Test {
 
   FakeTaskRunner* task_runner() { return &task_runner_; }
   TestingDataRouter* network_manager() { return &network_manager_; }
+  MockNetworkWaiter* network_waiter() { return &network_waiter_; }
 
  private:
   FakeClock clock_;
@@ -134,4 +136,17 @@ TEST_F(TlsNetworkingManagerPosixTest, CallsReadySocket) {
                                         SocketHandleWaiter::Flags::kWriteable);
 }
 
+TEST_F(TlsNetworkingManagerPosixTest, ForwardsPendingWritesToWaiter) {
+  MockConnection connection(1, task_runner());
+  network_manager()->RegisterConnection(&connection);
+
+  EXPECT_CALL(*network_waiter(),
+              SetWriteInterest(std::cref(connection.socket_handle()), true));
+  network_manager()->SetHasPendingWrites(&connection, true);
+
+  EXPECT_CALL(*network_waiter(),
+              SetWriteInterest(std::cref(connection.socket_handle()), false));
+  network_manager()->SetHasPendingWrites(&connection, false);
+}
+
 }  // namespace openscreen
@@ -8,11 +8,14 @@
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <netinet/udp.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
 #include <memory>
 #include <sstream>
@@ -371,8 +374,209 @@ bool IsPacketInfo<in6_pktinfo>(cmsghdr* cmh) {
   return cmh->cmsg_level == IPPROTO_IPV6 && cmh->cmsg_type == IPV6_PKTINFO;
 }
 
+#if !defined(__linux__)
+// recvmmsg() is Linux-specific. Elsewhere, emulate it with multiple recvmsg()
+// calls: This still amortizes the cost of dispatching the packets.
+struct mmsghdr {
+  msghdr msg_hdr;
+  unsigned int msg_len;
+};
+
+int recvmmsg(int fd,
+             mmsghdr* messages,
+             unsigned int count,
+             int flags,
+             timespec* timeout) {
+  unsigned int num_received = 0;
+  for (; num_received < count; ++num_received) {
+    const ssize_t bytes_received =
+        recvmsg(fd, &messages[num_received].msg_hdr, flags);
+    if (bytes_received == -1) {
+      break;
+    }
+    messages[num_received].msg_len = static_cast<unsigned int>(bytes_received);
+  }
+  return num_received > 0 ? static_cast<int>(num_received) : -1;
+}
+
+// Likewise, emulate sendmmsg() with multiple sendmsg() calls.
+int sendmmsg(int fd, mmsghdr* messages, unsigned int count, int flags) {
+  unsigned int num_sent = 0;
+  for (; num_sent < count; ++num_sent) {
+    const ssize_t bytes_sent = sendmsg(fd, &messages[num_sent].msg_hdr, flags);
+    if (bytes_sent == -1) {
+      break;
+    }
+    messages[num_sent].msg_len = static_cast<unsigned int>(bytes_sent);
+  }
+  return num_sent > 0 ? static_cast<int>(num_sent) : -1;
+}
+#endif  // !defined(__linux__)
+
+// The maximum number of messages passed to one sendmmsg() call.
+constexpr size_t kMaxSendBatchSize = 64;
+
+#if defined(UDP_SEGMENT)
+// The kernel's limit on the number of segments in one UDP GSO send
+// (UDP_MAX_SEGMENTS), and the maximum UDP payload size for all of them.
+constexpr size_t kMaxGsoSegments = 64;
+constexpr size_t kMaxGsoPayloadSize = 65507;
+
+// Returns the segment size that would allow the |messages| to be sent as one
+// UDP generic segmentation offload (GSO) "super-datagram," or zero if they are
+// not eligible. The kernel splits a GSO send into equal-sized datagrams, with
+// only the last one possibly being shorter.
+size_t ComputeGsoSegmentSize(const UdpSocket::MessageBuffer* messages,
+                             size_t count) {
+  if (count < 2) {
+    return 0;  // Nothing to gain.
+  }
+  const size_t segment_size = messages[0].length;
+  if (segment_size == 0 || segment_size > kMaxGsoPayloadSize) {
+    return 0;
+  }
+  for (size_t i = 1; i < count - 1; ++i) {
+    if (messages[i].length != segment_size) {
+      return 0;
+    }
+  }
+  const size_t last_size = messages[count - 1].length;
+  return (last_size > 0 && last_size <= segment_size) ? segment_size : 0;
+}
+
+// Sends the |messages|, which must all be |segment_size| bytes (except the
+// last), using UDP GSO. Returns the number of messages sent, or -1 with |errno|
+// set if none could be sent.
+int SendWithGso(int fd,
+                const UdpSocket::MessageBuffer* messages,
+                size_t count,
+                size_t segment_size,
+                sockaddr* sa,
+                socklen_t sa_len) {
+  const size_t max_segments_per_send =
+      std::min(kMaxGsoSegments, kMaxGsoPayloadSize / segment_size);
+
+  size_t num_sent = 0;
+  while (num_sent < count) {
+    const size_t num_segments =
+        std::min(max_segments_per_send, count - num_sent);
+    iovec iovs[kMaxGsoSegments];
+    for (size_t i = 0; i < num_segments; ++i) {
+      const UdpSocket::MessageBuffer& message = messages[num_sent + i];
+      iovs[i] = {const_cast<void*>(message.data), message.length};
+    }
+
+    alignas(alignof(cmsghdr)) uint8_t control_buffer[CMSG_SPACE(
+        sizeof(uint16_t))] = {};
+    msghdr msg = {};
+    msg.msg_name = sa;
+    msg.msg_namelen = sa_len;
+    msg.msg_iov = iovs;
+    msg.msg_iovlen = num_segments;
+    msg.msg_control = control_buffer;
+    msg.msg_controllen = sizeof(control_buffer);
+    cmsghdr* const cmh = CMSG_FIRSTHDR(&msg);
+    cmh->cmsg_level = IPPROTO_UDP;
+    cmh->cmsg_type = UDP_SEGMENT;
+    cmh->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    const uint16_t gso_size = static_cast<uint16_t>(segment_size);
+    memcpy(CMSG_DATA(cmh), &gso_size, sizeof(gso_size));
+
+    if (sendmsg(fd, &msg, 0) == -1) {
+      break;
+    }
+    num_sent += num_segments;
+  }
+  return num_sent > 0 ? static_cast<int>(num_sent) : -1;
+}
+
+// Returns true if a GSO send failed because segmentation offload is not
+// supported by the kernel or the outbound network device.
+bool IsGsoUnsupportedError(decltype(errno) posix_errno) {
+  return posix_errno == EIO || posix_errno == EINVAL ||
+         posix_errno == ENOPROTOOPT || posix_errno == EOPNOTSUPP;
+}
+#endif  // defined(UDP_SEGMENT)
+
+// Populates |storage| with the socket address for sending to |dest| from a
+// socket of the given IP |version|, and returns its length.
+socklen_t ToSockAddr(UdpSocket::Version version,
+                     const IPEndpoint& dest,
+                     sockaddr_storage* storage) {
+  *storage = {};
+  switch (version) {
+    case UdpSocket::Version::kV4: {
+      sockaddr_in* const sa = reinterpret_cast<sockaddr_in*>(storage);
+      sa->sin_family = AF_INET;
+      sa->sin_port = htons(dest.port);
+      dest.address.CopyToV4(reinterpret_cast<uint8_t*>(&sa->sin_addr.s_addr));
+      return sizeof(*sa);
+    }
+    case UdpSocket::Version::kV6: {
+      sockaddr_in6* const sa = reinterpret_cast<sockaddr_in6*>(storage);
+      sa->sin6_family = AF_INET6;
+      sa->sin6_port = htons(dest.port);
+      dest.address.CopyToV6(reinterpret_cast<uint8_t*>(&sa->sin6_addr.s6_addr));
+      return sizeof(*sa);
+    }
+  }
+  OSP_NOTREACHED();
+  return 0;
+}
+
+// Returns the local port |fd| is bound to, calling getsockname() only if
+// |*cached_port| has not been resolved yet. Returns zero on failure.
+template <class SockAddrType>
+uint16_t ResolveLocalPort(int fd, uint16_t* cached_port) {
+  if (*cached_port == 0) {
+    SockAddrType sa;
+    socklen_t sa_len = sizeof(sa);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&sa), &sa_len) == 0) {
+      *cached_port = GetPortFromFromSockAddr(sa);
+    }
+  }
+  return *cached_port;
+}
+
+// Sets the source and, if known, the destination of the |packet| that was just
+// received via |msg|.
 template <class SockAddrType, class PktInfoType>
-Error ReceiveMessageInternal(int fd, UdpPacket* packet) {
+void PopulateEndpoints(int fd,
+                       const SockAddrType& sa,
+                       msghdr* msg,
+                       uint16_t* cached_local_port,
+                       UdpPacket* packet) {
+  IPEndpoint source_endpoint = {.address = GetIPAddressFromSockAddr(sa),
+                                .port = GetPortFromFromSockAddr(sa)};
+  packet->set_source(std::move(source_endpoint));
+
+  // For multicast sockets, the packet's original destination address may be
+  // the host address (since we called bind()) but it may also be a
+  // multicast address.  This may be relevant for handling multicast data;
+  // specifically, mDNSResponder requires this information to work properly.
+  if ((msg->msg_flags & MSG_CTRUNC) != 0) {
+    return;
+  }
+  const uint16_t local_port =
+      ResolveLocalPort<SockAddrType>(fd, cached_local_port);
+  if (local_port == 0) {
+    return;
+  }
+  for (cmsghdr* cmh = CMSG_FIRSTHDR(msg); cmh; cmh = CMSG_NXTHDR(msg, cmh)) {
+    if (IsPacketInfo<PktInfoType>(cmh)) {
+      PktInfoType* pktinfo = reinterpret_cast<PktInfoType*>(CMSG_DATA(cmh));
+      IPEndpoint destination_endpoint = {
+          .address = GetIPAddressFromPktInfo(*pktinfo), .port = local_port};
+      packet->set_destination(std::move(destination_endpoint));
+      break;
+    }
+  }
+}
+
+template <class SockAddrType, class PktInfoType>
+Error ReceiveMessageInternal(int fd,
+                             uint16_t* cached_local_port,
+                             UdpPacket* packet) {
   SockAddrType sa;
   iovec iov = {packet->data(), packet->size()};
   alignas(alignof(cmsghdr)) uint8_t control_buffer[1024];
@@ -392,29 +596,64 @@ Error ReceiveMessageInternal(int fd, UdpPacket* packet) {
 
   OSP_DCHECK_EQ(static_cast<size_t>(bytes_received), packet->size());
 
-  IPEndpoint source_endpoint = {.address = GetIPAddressFromSockAddr(sa),
-                                .port = GetPortFromFromSockAddr(sa)};
-  packet->set_source(std::move(source_endpoint));
+  PopulateEndpoints<SockAddrType, PktInfoType>(fd, sa, &msg, cached_local_port,
+                                               packet);
+  return Error::Code::kNone;
+}
 
-  // For multicast sockets, the packet's original destination address may be
-  // the host address (since we called bind()) but it may also be a
-  // multicast address.  This may be relevant for handling multicast data;
-  // specifically, mDNSResponder requires this information to work properly.
+// Receives up to |buffers->size()| packets in one go, moving each of the
+// |buffers| that was filled into |packets| (right-sized, and in arrival order).
+// The moved-from elements of |buffers| are left empty, while the others keep
+// their storage. Returns an error only if no packets at all could be received.
+template <class SockAddrType, class PktInfoType>
+Error ReceiveMessagesInternal(int fd,
+                              uint16_t* cached_local_port,
+                              std::vector<UdpPacket>* buffers,
+                              std::vector<UdpPacket>* packets) {
+  constexpr int kMaxBatchSize = UdpSocketPosix::kMaxReceiveBatchSize;
+  // Only the packet info control message is ever requested (see
+  // JoinMulticastGroup()), so just enough space for that is provided.
+  constexpr size_t kControlBufferSize = CMSG_SPACE(sizeof(PktInfoType));
+
+  const int batch_size = static_cast<int>(buffers->size());
+  OSP_DCHECK_LE(batch_size, kMaxBatchSize);
+  SockAddrType addresses[kMaxBatchSize];
+  iovec iovs[kMaxBatchSize];
+  alignas(alignof(cmsghdr)) uint8_t
+      control_buffers[kMaxBatchSize][kControlBufferSize];
+  mmsghdr messages[kMaxBatchSize];
+  for (int i = 0; i < batch_size; ++i) {
+    UdpPacket& buffer = (*buffers)[i];
+    iovs[i] = {buffer.data(), buffer.size()};
+    msghdr& msg = messages[i].msg_hdr;
+    msg.msg_name = &addresses[i];
+    msg.msg_namelen = sizeof(addresses[i]);
+    msg.msg_iov = &iovs[i];
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_buffers[i];
+    msg.msg_controllen = kControlBufferSize;
+    msg.msg_flags = 0;
+    messages[i].msg_len = 0;
+  }
 
-  socklen_t sa_len = sizeof(sa);
-  if (((msg.msg_flags & MSG_CTRUNC) != 0) ||
-      (getsockname(fd, reinterpret_cast<sockaddr*>(&sa), &sa_len) == -1)) {
-    return Error::Code::kNone;
+  const int num_received = recvmmsg(fd, messages, batch_size, 0, nullptr);
+  if (num_received == -1) {
+    return ChooseError(errno, Error::Code::kSocketReadFailure);
   }
-  for (cmsghdr* cmh = CMSG_FIRSTHDR(&msg); cmh; cmh = CMSG_NXTHDR(&msg, cmh)) {
-    if (IsPacketInfo<PktInfoType>(cmh)) {
-      PktInfoType* pktinfo = reinterpret_cast<PktInfoType*>(CMSG_DATA(cmh));
-      IPEndpoint destination_endpoint = {
-          .address = GetIPAddressFromPktInfo(*pktinfo),
-          .port = GetPortFromFromSockAddr(sa)};
-      packet->set_destination(std::move(destination_endpoint));
-      break;
+
+  packets->reserve(num_received);
+  for (int i = 0; i < num_received; ++i) {
+    msghdr& msg = messages[i].msg_hdr;
+    if ((msg.msg_flags & MSG_TRUNC) != 0) {
+      OSP_LOG_WARN << "Dropping UDP packet larger than the "
+                   << (*buffers)[i].size() << "-byte batch read buffer.";
+      continue;
     }
+    UdpPacket packet = std::move((*buffers)[i]);
+    packet.resize(messages[i].msg_len);
+    PopulateEndpoints<SockAddrType, PktInfoType>(fd, addresses[i], &msg,
+                                                 cached_local_port, &packet);
+    packets->push_back(std::move(packet));
   }
   return Error::Code::kNone;
 }
@@ -436,6 +675,14 @@ void UdpSocketPosix::ReceiveMessage() {
     return;
   }
 
+  const int max_batch_size =
+      receive_batch_size_.load(std::memory_order_acquire);
+  if (max_batch_size > 1) {
+    ReceiveMessageBatch(max_batch_size,
+                        receive_packet_size_.load(std::memory_order_relaxed));
+    return;
+  }
+
   ssize_t bytes_available = recv(handle_.fd, nullptr, 0, MSG_PEEK | MSG_TRUNC);
   if (bytes_available == -1) {
     task_runner_->PostTask(
@@ -450,18 +697,19 @@ void UdpSocketPosix::ReceiveMessage() {
         });
     return;
   }
-  UdpPacket packet(bytes_available);
+  UdpPacket packet;
+  AllocateReceiveBuffer(bytes_available, &packet);
   packet.set_socket(this);
   Error result = Error::Code::kUnknownError;
   switch (local_endpoint_.address.version()) {
     case UdpSocket::Version::kV4: {
-      result =
-          ReceiveMessageInternal<sockaddr_in, in_pktinfo>(handle_.fd, &packet);
+      result = ReceiveMessageInternal<sockaddr_in, in_pktinfo>(
+          handle_.fd, &receive_local_port_, &packet);
       break;
     }
     case UdpSocket::Version::kV6: {
-      result = ReceiveMessageInternal<sockaddr_in6, in6_pktinfo>(handle_.fd,
-                                                                 &packet);
+      result = ReceiveMessageInternal<sockaddr_in6, in6_pktinfo>(
+          handle_.fd, &receive_local_port_, &packet);
       break;
     }
     default: {
@@ -482,6 +730,77 @@ void UdpSocketPosix::ReceiveMessage() {
       });
 }
 
+void UdpSocketPosix::ReceiveMessageBatch(int max_batch_size,
+                                         size_t max_packet_size) {
+  // Top-up the set of pre-sized receive buffers, in place. Only the slots
+  // whose buffers were handed off with the packets from the prior batch read
+  // (or whose size no longer matches) need a new buffer; the rest are re-used
+  // as-is.
+  if (spare_receive_buffers_.size() != static_cast<size_t>(max_batch_size)) {
+    spare_receive_buffers_.resize(max_batch_size);
+  }
+  for (UdpPacket& buffer : spare_receive_buffers_) {
+    if (buffer.size() != max_packet_size) {
+      AllocateReceiveBuffer(max_packet_size, &buffer);
+    }
+  }
+
+  std::vector<UdpPacket> packets;
+  Error result = Error::Code::kUnknownError;
+  switch (local_endpoint_.address.version()) {
+    case UdpSocket::Version::kV4: {
+      result = ReceiveMessagesInternal<sockaddr_in, in_pktinfo>(
+          handle_.fd, &receive_local_port_, &spare_receive_buffers_, &packets);
+      break;
+    }
+    case UdpSocket::Version::kV6: {
+      result = ReceiveMessagesInternal<sockaddr_in6, in6_pktinfo>(
+          handle_.fd, &receive_local_port_, &spare_receive_buffers_, &packets);
+      break;
+    }
+    default: {
+      OSP_NOTREACHED();
+    }
+  }
+
+  if (!result.ok()) {
+    task_runner_->PostTask([weak_this = weak_factory_.GetWeakPtr(),
+                            error = std::move(result)]() mutable {
+      if (auto* self = weak_this.get()) {
+        if (auto* client = self->client_) {
+          client->OnRead(self, std::move(error));
+        }
+      }
+    });
+    return;
+  }
+
+  if (packets.empty()) {
+    return;  // All packets read were dropped.
+  }
+  for (UdpPacket& packet : packets) {
+    packet.set_socket(this);
+  }
+  task_runner_->PostTask([weak_this = weak_factory_.GetWeakPtr(),
+                          packets = std::move(packets)]() mutable {
+    if (auto* self = weak_this.get()) {
+      if (auto* client = self->client_) {
+        client->OnReadBatch(self, std::move(packets));
+      }
+    }
+  });
+}
+
+void UdpSocketPosix::AllocateReceiveBuffer(size_t size, UdpPacket* packet) {
+  PacketBufferPool* const pool =
+      receive_buffer_pool_.load(std::memory_order_acquire);
+  if (pool) {
+    static_cast<std::vector<uint8_t>&>(*packet) = pool->Acquire(size);
+  } else {
+    packet->resize(size);
+  }
+}
+
 // TODO(yakimakha): Consider changing the interface to accept UdpPacket as
 // an input parameter.
 void UdpSocketPosix::SendMessage(const void* data,
@@ -542,6 +861,76 @@ void UdpSocketPosix::SendMessage(const void* data,
   OSP_DCHECK_EQ(static_cast<size_t>(num_bytes_sent), length);
 }
 
+void UdpSocketPosix::SendMessages(const MessageBuffer* messages,
+                                  size_t count,
+                                  const IPEndpoint& dest) {
+  if (is_closed()) {
+    if (client_) {
+      client_->OnSendError(this, Error::Code::kSocketClosedFailure);
+    }
+    return;
+  }
+
+  sockaddr_storage sa;
+  const socklen_t sa_len =
+      ToSockAddr(local_endpoint_.address.version(), dest, &sa);
+  size_t num_sent = 0;
+
+#if defined(UDP_SEGMENT)
+  // When possible, hand the whole batch to the kernel as one UDP GSO send. It
+  // will then only perform the routing and netfilter work once, rather than
+  // once per message.
+  if (!gso_unsupported_) {
+    const size_t segment_size = ComputeGsoSegmentSize(messages, count);
+    if (segment_size > 0) {
+      const int result =
+          SendWithGso(handle_.fd, messages, count, segment_size,
+                      reinterpret_cast<sockaddr*>(&sa), sa_len);
+      if (result == -1) {
+        if (!IsGsoUnsupportedError(errno)) {
+          if (client_) {
+            client_->OnSendError(
+                this, ChooseError(errno, Error::Code::kSocketSendFailure));
+          }
+          return;
+        }
+        OSP_VLOG << "UDP GSO is unavailable, falling back to sendmmsg(): "
+                 << strerror(errno);
+        gso_unsupported_ = true;
+      } else {
+        num_sent = static_cast<size_t>(result);
+      }
+    }
+  }
+#endif  // defined(UDP_SEGMENT)
+
+  while (num_sent < count) {
+    const size_t batch_size = std::min(kMaxSendBatchSize, count - num_sent);
+    iovec iovs[kMaxSendBatchSize];
+    mmsghdr mmsgs[kMaxSendBatchSize];
+    for (size_t i = 0; i < batch_size; ++i) {
+      const MessageBuffer& message = messages[num_sent + i];
+      iovs[i] = {const_cast<void*>(message.data), message.length};
+      mmsgs[i].msg_hdr = {};
+      mmsgs[i].msg_hdr.msg_name = &sa;
+      mmsgs[i].msg_hdr.msg_namelen = sa_len;
+      mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+      mmsgs[i].msg_hdr.msg_iovlen = 1;
+      mmsgs[i].msg_len = 0;
+    }
+
+    const int result = sendmmsg(handle_.fd, mmsgs, batch_size, 0);
+    if (result == -1) {
+      if (client_) {
+        client_->OnSendError(
+            this, ChooseError(errno, Error::Code::kSocketSendFailure));
+      }
+      return;
+    }
+    num_sent += static_cast<size_t>(result);
+  }
+}
+
 void UdpSocketPosix::SetDscp(UdpSocket::DscpMode state) {
   if (is_closed()) {
     OnError(Error::Code::kSocketClosedFailure);
@@ -565,6 +954,18 @@ void UdpSocketPosix::SetDscp(UdpSocket::DscpMode state) {
   }
 }
 
+void UdpSocketPosix::SetReceiveBatching(int max_batch_size,
+                                        size_t max_packet_size) {
+  OSP_DCHECK_LE(max_packet_size, UdpPacket::kUdpMaxPacketSize);
+  receive_packet_size_.store(max_packet_size, std::memory_order_relaxed);
+  receive_batch_size_.store(std::min(max_batch_size, kMaxReceiveBatchSize),
+                            std::memory_order_release);
+}
+
+void UdpSocketPosix::SetReceiveBufferPool(PacketBufferPool* buffer_pool) {
+  receive_buffer_pool_.store(buffer_pool, std::memory_order_release);
+}
+
 void UdpSocketPosix::OnError(Error::Code error_code) {
   // The call to Close() may change |errno|, so save it here.
   const auto original_errno = errno;
@@ -619,4 +1020,7 @@ void UdpSocketPosix::Close() {
   handle_.fd = -1;
 }
 
+// static
+constexpr int UdpSocketPosix::kMaxReceiveBatchSize;
+
 }  // namespace openscreen
@@ -5,6 +5,9 @@
 #ifndef PLATFORM_IMPL_UDP_SOCKET_POSIX_H_
 #define PLATFORM_IMPL_UDP_SOCKET_POSIX_H_
 
+#include <atomic>
+#include <vector>
+
 #include "absl/types/optional.h"
 #include "platform/api/udp_socket.h"
 #include "platform/base/macros.h"
@@ -43,19 +46,38 @@ class UdpSocketPosix : public UdpSocket {
   void SendMessage(const void* data,
                    size_t length,
                    const IPEndpoint& dest) override;
+  void SendMessages(const MessageBuffer* messages,
+                    size_t count,
+                    const IPEndpoint& dest) override;
   void SetDscp(DscpMode state) override;
+  void SetReceiveBatching(int max_batch_size, size_t max_packet_size) override;
+  void SetReceiveBufferPool(PacketBufferPool* buffer_pool) override;
 
   const SocketHandle& GetHandle() const;
 
+  // The maximum number of packets read by one call to ReceiveMessage(), when
+  // batching is enabled.
+  static constexpr int kMaxReceiveBatchSize = 64;
+
  protected:
   friend class UdpSocketReaderPosix;
 
   // Called by UdpSocketReaderPosix to perform a non-blocking read on the socket
   // and then dispatch the packet to this socket's Client. This method is the
-  // only one in this class possibly being called from another thread.
+  // only one in this class possibly being called from another thread. When
+  // batching is enabled (see SetReceiveBatching()), this drains up to
+  // kMaxReceiveBatchSize packets from the socket and dispatches all of them
+  // together.
   void ReceiveMessage();
 
  private:
+  // Helper for ReceiveMessage(), to read and dispatch a batch of packets.
+  void ReceiveMessageBatch(int max_batch_size, size_t max_packet_size);
+
+  // Sets the |packet| to a new buffer of |size| bytes, taken from the receive
+  // buffer pool if one was provided.
+  void AllocateReceiveBuffer(size_t size, UdpPacket* packet);
+
   // Helper to close the socket if |error| is fatal, in addition to dispatching
   // an Error to the |client_|.
   void OnError(Error::Code error);
@@ -79,6 +101,30 @@ class UdpSocketPosix : public UdpSocket {
   // port is non-zero, it is assumed never to change again.
   mutable IPEndpoint local_endpoint_;
 
+  // The current batch read settings. These are set on the TaskRunner thread
+  // and read by ReceiveMessage(). |receive_batch_size_| is always stored last,
+  // so that a reader seeing its updated value will also see the matching
+  // |receive_packet_size_|.
+  std::atomic_int receive_batch_size_{1};
+  std::atomic<size_t> receive_packet_size_{0};
+
+  // Where ReceiveMessage() gets its buffers from, if not null. Set on the
+  // TaskRunner thread, and read by ReceiveMessage().
+  std::atomic<PacketBufferPool*> receive_buffer_pool_{nullptr};
+
+  // The following are only accessed from within ReceiveMessage(). The local
+  // port is resolved (via getsockname()) the first time it is needed to
+  // determine a packet's destination, and is assumed never to change after
+  // that. The spare buffers are pre-sized buffers left unused by the prior
+  // batch read, to be re-used by the next one.
+  uint16_t receive_local_port_ = 0;
+  std::vector<UdpPacket> spare_receive_buffers_;
+
+  // Set to true once a send using UDP generic segmentation offload has failed
+  // because the kernel or network device does not support it. SendMessages()
+  // will then only use sendmmsg().
+  bool gso_unsupported_ = false;
+
   WeakPtrFactory<UdpSocketPosix> weak_factory_{this};
 
   PlatformClientPosix* const platform_client_;
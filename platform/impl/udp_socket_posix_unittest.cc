@@ -0,0 +1,267 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform/impl/udp_socket_posix.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "platform/impl/socket_handle_posix.h"
+#include "platform/test/fake_clock.h"
+#include "platform/test/fake_task_runner.h"
+
+namespace openscreen {
+namespace {
+
+using testing::ElementsAre;
+using testing::ElementsAreArray;
+
+constexpr uint8_t kLoopbackAddress[4] = {127, 0, 0, 1};
+
+// Exposes ReceiveMessage(), which would normally be called by the
+// UdpSocketReaderPosix on the networking thread.
+class TestingUdpSocket : public UdpSocketPosix {
+ public:
+  TestingUdpSocket(TaskRunner* task_runner, Client* client)
+      : UdpSocketPosix(task_runner,
+                       client,
+                       SocketHandle(CreateNonBlockingFd()),
+                       IPEndpoint{IPAddress(kLoopbackAddress), 0},
+                       nullptr) {}
+
+  using UdpSocketPosix::ReceiveMessage;
+
+ private:
+  static int CreateNonBlockingFd() {
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+  }
+};
+
+// Records the packets passed to OnRead() and OnReadBatch() separately.
+class RecordingClient : public UdpSocket::Client {
+ public:
+  void OnError(UdpSocket* socket, Error error) override {
+    ADD_FAILURE() << error;
+  }
+  void OnSendError(UdpSocket* socket, Error error) override {
+    ADD_FAILURE() << error;
+  }
+  void OnRead(UdpSocket* socket, ErrorOr<UdpPacket> packet) override {
+    ASSERT_TRUE(packet) << packet.error();
+    single_reads.push_back(std::move(packet.value()));
+  }
+  void OnReadBatch(UdpSocket* socket, std::vector<UdpPacket> packets) override {
+    batch_sizes.push_back(packets.size());
+    std::move(packets.begin(), packets.end(), std::back_inserter(batch_reads));
+  }
+
+  std::vector<UdpPacket> single_reads;
+  std::vector<UdpPacket> batch_reads;
+  std::vector<size_t> batch_sizes;
+};
+
+class UdpSocketPosixTest : public testing::Test {
+ public:
+  UdpSocketPosixTest() {
+    receiver_.Bind();
+    sender_.Bind();
+  }
+
+  void SendFromSender(std::vector<uint8_t> payload) {
+    sender_.SendMessage(payload.data(), payload.size(),
+                        receiver_.GetLocalEndpoint());
+  }
+
+ protected:
+  FakeClock clock_{Clock::now()};
+  FakeTaskRunner task_runner_{&clock_};
+  RecordingClient client_;
+  TestingUdpSocket receiver_{&task_runner_, &client_};
+  TestingUdpSocket sender_{&task_runner_, &client_};
+};
+
+TEST_F(UdpSocketPosixTest, ReadsOnePacketAtATimeByDefault) {
+  SendFromSender({1, 2, 3});
+  SendFromSender({4, 5});
+
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+  ASSERT_EQ(1u, client_.single_reads.size());
+  EXPECT_THAT(client_.single_reads[0], ElementsAre(1, 2, 3));
+  EXPECT_EQ(sender_.GetLocalEndpoint(), client_.single_reads[0].source());
+
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+  ASSERT_EQ(2u, client_.single_reads.size());
+  EXPECT_THAT(client_.single_reads[1], ElementsAre(4, 5));
+  EXPECT_TRUE(client_.batch_reads.empty());
+}
+
+TEST_F(UdpSocketPosixTest, ReadsAndDispatchesBatchesOfPackets) {
+  receiver_.SetReceiveBatching(4, 32);
+  for (uint8_t i = 0; i < 6; ++i) {
+    SendFromSender(std::vector<uint8_t>(i + 1, i));
+  }
+
+  // The first read should drain up to the maximum batch size, and the second
+  // should get the rest.
+  receiver_.ReceiveMessage();
+  receiver_.ReceiveMessage();
+  EXPECT_TRUE(client_.batch_reads.empty());  // Not until the tasks run.
+  task_runner_.RunTasksUntilIdle();
+
+  EXPECT_THAT(client_.batch_sizes, ElementsAre(4, 2));
+  ASSERT_EQ(6u, client_.batch_reads.size());
+  for (uint8_t i = 0; i < 6; ++i) {
+    const UdpPacket& packet = client_.batch_reads[i];
+    EXPECT_THAT(packet, ElementsAreArray(std::vector<uint8_t>(i + 1, i)));
+    EXPECT_EQ(sender_.GetLocalEndpoint(), packet.source());
+    EXPECT_EQ(&receiver_, packet.socket());
+  }
+  EXPECT_TRUE(client_.single_reads.empty());
+}
+
+TEST_F(UdpSocketPosixTest, DropsPacketsTooLargeForBatchReadBuffers) {
+  receiver_.SetReceiveBatching(4, 4);
+  SendFromSender({1, 2, 3, 4, 5, 6, 7, 8});
+  SendFromSender({9, 10});
+
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+
+  ASSERT_EQ(1u, client_.batch_reads.size());
+  EXPECT_THAT(client_.batch_reads[0], ElementsAre(9, 10));
+}
+
+TEST_F(UdpSocketPosixTest, TakesReceiveBuffersFromPool) {
+  PacketBufferPool pool(32, 8);
+  receiver_.SetReceiveBufferPool(&pool);
+  receiver_.SetReceiveBatching(2, 32);
+  SendFromSender({1, 2, 3});
+  SendFromSender({4, 5});
+
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+  ASSERT_EQ(2u, client_.batch_reads.size());
+
+  // Return the buffers to the pool. The next batch read should re-use them
+  // rather than allocating new ones.
+  const uint8_t* const storage[2] = {client_.batch_reads[0].data(),
+                                     client_.batch_reads[1].data()};
+  for (UdpPacket& packet : client_.batch_reads) {
+    pool.Release(std::move(static_cast<std::vector<uint8_t>&>(packet)));
+  }
+  client_.batch_reads.clear();
+  ASSERT_EQ(2u, pool.GetPooledBufferCount());
+
+  SendFromSender({6});
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+  ASSERT_EQ(1u, client_.batch_reads.size());
+  EXPECT_THAT(client_.batch_reads[0], ElementsAre(6));
+  EXPECT_EQ(0u, pool.GetPooledBufferCount());
+  const uint8_t* const reused = client_.batch_reads[0].data();
+  EXPECT_TRUE(reused == storage[0] || reused == storage[1]);
+}
+
+TEST_F(UdpSocketPosixTest, ReplacesOnlyTheReceiveBuffersHandedOff) {
+  PacketBufferPool pool(32, 8);
+  receiver_.SetReceiveBufferPool(&pool);
+  receiver_.SetReceiveBatching(4, 32);
+  SendFromSender({1});
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+  ASSERT_EQ(1u, client_.batch_reads.size());
+
+  // Only the one buffer that left with the packet should need replacing for
+  // the next batch read; the three unfilled ones are kept.
+  for (int i = 0; i < 4; ++i) {
+    pool.Release(std::vector<uint8_t>(32));
+  }
+  SendFromSender({2});
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+  ASSERT_EQ(2u, client_.batch_reads.size());
+  EXPECT_THAT(client_.batch_reads[1], ElementsAre(2));
+  EXPECT_EQ(3u, pool.GetPooledBufferCount());
+}
+
+TEST_F(UdpSocketPosixTest, DefaultBatchHandlerFallsBackToOnRead) {
+  class SimpleClient : public RecordingClient {
+   public:
+    void OnReadBatch(UdpSocket* socket,
+                     std::vector<UdpPacket> packets) override {
+      UdpSocket::Client::OnReadBatch(socket, std::move(packets));
+    }
+  } client;
+  TestingUdpSocket receiver(&task_runner_, &client);
+  receiver.Bind();
+  receiver.SetReceiveBatching(8, 16);
+  sender_.SendMessage("abc", 3, receiver.GetLocalEndpoint());
+  sender_.SendMessage("de", 2, receiver.GetLocalEndpoint());
+
+  receiver.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+
+  ASSERT_EQ(2u, client.single_reads.size());
+  EXPECT_THAT(client.single_reads[0], ElementsAre('a', 'b', 'c'));
+  EXPECT_THAT(client.single_reads[1], ElementsAre('d', 'e'));
+}
+
+TEST_F(UdpSocketPosixTest, SendsBatchesOfEqualSizedMessages) {
+  // These are eligible to be sent as one generic segmentation offload send,
+  // but they must arrive as separate datagrams either way.
+  const std::vector<uint8_t> payloads[] = {
+      {1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}, {13, 14}};
+  std::vector<UdpSocket::MessageBuffer> messages;
+  for (const auto& payload : payloads) {
+    messages.push_back({payload.data(), payload.size()});
+  }
+  sender_.SendMessages(messages.data(), messages.size(),
+                       receiver_.GetLocalEndpoint());
+
+  receiver_.SetReceiveBatching(8, 32);
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+
+  ASSERT_EQ(4u, client_.batch_reads.size());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_THAT(client_.batch_reads[i], ElementsAreArray(payloads[i]));
+    EXPECT_EQ(sender_.GetLocalEndpoint(), client_.batch_reads[i].source());
+  }
+}
+
+TEST_F(UdpSocketPosixTest, SendsBatchesOfVariableSizedMessages) {
+  std::vector<std::vector<uint8_t>> payloads;
+  std::vector<UdpSocket::MessageBuffer> messages;
+  for (uint8_t i = 0; i < 100; ++i) {
+    payloads.emplace_back((i % 7) + 1, i);
+  }
+  for (const auto& payload : payloads) {
+    messages.push_back({payload.data(), payload.size()});
+  }
+  sender_.SendMessages(messages.data(), messages.size(),
+                       receiver_.GetLocalEndpoint());
+
+  receiver_.SetReceiveBatching(UdpSocketPosix::kMaxReceiveBatchSize, 32);
+  receiver_.ReceiveMessage();
+  receiver_.ReceiveMessage();
+  task_runner_.RunTasksUntilIdle();
+
+  ASSERT_EQ(payloads.size(), client_.batch_reads.size());
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    EXPECT_THAT(client_.batch_reads[i], ElementsAreArray(payloads[i]));
+  }
+}
+
+}  // namespace
+}  // namespace openscreen
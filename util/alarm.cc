@@ -18,7 +18,10 @@ class Alarm::CancelableFunctor {
 
   ~CancelableFunctor() { Cancel(); }
 
-  CancelableFunctor(CancelableFunctor&& other) : alarm_(other.alarm_) {
+  // The move operations are noexcept so that TaskRunner::Task stores the
+  // functor inline, and posting it does not allocate.
+  CancelableFunctor(CancelableFunctor&& other) noexcept
+      : alarm_(other.alarm_) {
     other.alarm_ = nullptr;
     if (alarm_) {
       OSP_DCHECK_EQ(alarm_->queued_fire_, &other);
@@ -26,7 +29,7 @@ class Alarm::CancelableFunctor {
     }
   }
 
-  CancelableFunctor& operator=(CancelableFunctor&& other) {
+  CancelableFunctor& operator=(CancelableFunctor&& other) noexcept {
     Cancel();
     alarm_ = other.alarm_;
     other.alarm_ = nullptr;
@@ -41,6 +44,7 @@ class Alarm::CancelableFunctor {
     if (alarm_) {
       OSP_DCHECK_EQ(alarm_->queued_fire_, this);
       alarm_->queued_fire_ = nullptr;
+      alarm_->queued_fire_id_ = 0;
       alarm_->TryInvoke();
       alarm_ = nullptr;
     }
@@ -65,14 +69,12 @@ Alarm::Alarm(ClockNowFunctionPtr now_function, TaskRunner* task_runner)
 }
 
 Alarm::~Alarm() {
-  if (queued_fire_) {
-    queued_fire_->Cancel();
-    OSP_DCHECK(!queued_fire_);
-  }
+  CancelQueuedFire();
 }
 
 void Alarm::Cancel() {
   scheduled_task_ = TaskRunner::Task();
+  CancelQueuedFire();
 }
 
 void Alarm::ScheduleWithTask(TaskRunner::Task task,
@@ -89,17 +91,44 @@ void Alarm::ScheduleWithTask(TaskRunner::Task task,
     if (next_fire_time_ <= alarm_time_) {
       return;
     }
-    queued_fire_->Cancel();
-    OSP_DCHECK(!queued_fire_);
+    // Move the queued fire earlier, if the TaskRunner supports it, rather than
+    // replacing it.
+    if (queued_fire_id_ != 0 &&
+        task_runner_->RescheduleDelayedTask(queued_fire_id_,
+                                            alarm_time_ - now)) {
+      next_fire_time_ = alarm_time_;
+      return;
+    }
+    CancelQueuedFire();
   }
   InvokeLater(now, alarm_time_);
 }
 
 void Alarm::InvokeLater(Clock::time_point now, Clock::time_point fire_time) {
+  static_assert(TaskRunner::Task::IsStoredInline<CancelableFunctor>(),
+                "Posting a CancelableFunctor should not allocate.");
   OSP_DCHECK(!queued_fire_);
   next_fire_time_ = fire_time;
   // Note: Instantiating the CancelableFunctor below sets |this->queued_fire_|.
-  task_runner_->PostTaskWithDelay(CancelableFunctor(this), fire_time - now);
+  queued_fire_id_ = task_runner_->PostCancelablePackagedTaskWithDelay(
+      TaskRunner::Task(CancelableFunctor(this)), fire_time - now);
+}
+
+void Alarm::CancelQueuedFire() {
+  if (!queued_fire_) {
+    return;
+  }
+  // If the task is removed from the TaskRunner, destroying the
+  // CancelableFunctor clears |queued_fire_|. Otherwise, the functor is
+  // neutered so that it will be a no-op when it runs.
+  if (queued_fire_id_ != 0) {
+    task_runner_->CancelDelayedTask(queued_fire_id_);
+    queued_fire_id_ = 0;
+  }
+  if (queued_fire_) {
+    queued_fire_->Cancel();
+  }
+  OSP_DCHECK(!queued_fire_);
 }
 
 void Alarm::TryInvoke() {
@@ -29,6 +29,13 @@ namespace openscreen {
 // whether the Alarm was canceled in the meantime. From this, it either: a) does
 // nothing; b) re-posts a new cancelable functor to the TaskRunner, to try
 // running the client's Task later; or c) runs the client's Task.
+//
+// When an earlier firing is needed, the queued cancelable functor is moved
+// earlier in the TaskRunner's queue (if the TaskRunner supports it), instead of
+// posting a new one. When that is not possible, or the Alarm is canceled or
+// destroyed, the cancelable functor is removed from the TaskRunner (if the
+// TaskRunner supports it), so that Alarms that are frequently re-scheduled or
+// canceled do not leave behind a trail of no-op tasks.
 class Alarm {
  public:
   Alarm(ClockNowFunctionPtr now_function, TaskRunner* task_runner);
@@ -78,6 +85,10 @@ class Alarm {
   // Posts a delayed call to TryInvoke() to the TaskRunner.
   void InvokeLater(Clock::time_point now, Clock::time_point fire_time);
 
+  // Cancels the queued call to TryInvoke(), if any, and removes it from the
+  // TaskRunner if possible.
+  void CancelQueuedFire();
+
   // Examines whether to invoke the client's Task now; or try again later; or
   // just do nothing. See class-level design comments.
   void TryInvoke();
@@ -95,6 +106,10 @@ class Alarm {
   // by the CancelableFunctor class methods.
   CancelableFunctor* queued_fire_ = nullptr;
 
+  // The TaskRunner's ID for the task holding |queued_fire_|, or zero if
+  // unknown.
+  TaskRunner::DelayedTaskId queued_fire_id_ = 0;
+
   // When the CancelableFunctor is scheduled to run. It may possibly execute
   // later than this, if the TaskRunner is falling behind.
   Clock::time_point next_fire_time_{};
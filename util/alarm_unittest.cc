@@ -5,6 +5,7 @@
 #include "util/alarm.h"
 
 #include <algorithm>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "platform/test/fake_clock.h"
@@ -143,5 +144,116 @@ TEST_F(AlarmTest, CancelsAndRearms) {
   }
 }
 
+// A FakeTaskRunner that hands out IDs for delayed tasks, and records requests
+// to cancel them (without actually removing them).
+class CancelRecordingTaskRunner final : public FakeTaskRunner {
+ public:
+  using FakeTaskRunner::FakeTaskRunner;
+
+  DelayedTaskId PostCancelablePackagedTaskWithDelay(
+      Task task,
+      Clock::duration delay) override {
+    PostPackagedTaskWithDelay(std::move(task), delay);
+    return ++last_id_;
+  }
+
+  bool CancelDelayedTask(DelayedTaskId id) override {
+    canceled_ids_.push_back(id);
+    return false;
+  }
+
+  DelayedTaskId last_id() const { return last_id_; }
+  const std::vector<DelayedTaskId>& canceled_ids() const {
+    return canceled_ids_;
+  }
+
+ private:
+  DelayedTaskId last_id_ = 0;
+  std::vector<DelayedTaskId> canceled_ids_;
+};
+
+// A FakeTaskRunner that hands out IDs for delayed tasks, and records requests
+// to reschedule them (reporting success, without actually moving them).
+class RescheduleRecordingTaskRunner final : public FakeTaskRunner {
+ public:
+  using FakeTaskRunner::FakeTaskRunner;
+
+  DelayedTaskId PostCancelablePackagedTaskWithDelay(
+      Task task,
+      Clock::duration delay) override {
+    PostPackagedTaskWithDelay(std::move(task), delay);
+    return ++post_count_;
+  }
+
+  bool CancelDelayedTask(DelayedTaskId id) override { return false; }
+
+  bool RescheduleDelayedTask(DelayedTaskId id, Clock::duration delay) override {
+    rescheduled_ids_.push_back(id);
+    return true;
+  }
+
+  int post_count() const { return post_count_; }
+  const std::vector<DelayedTaskId>& rescheduled_ids() const {
+    return rescheduled_ids_;
+  }
+
+ private:
+  int post_count_ = 0;
+  std::vector<DelayedTaskId> rescheduled_ids_;
+};
+
+TEST(AlarmCancelationTest, CancelsQueuedFireInTaskRunner) {
+  FakeClock clock(Clock::now());
+  CancelRecordingTaskRunner task_runner(&clock);
+  int run_count = 0;
+  {
+    Alarm alarm(&FakeClock::now, &task_runner);
+
+    // Re-scheduling for a later time re-uses the queued fire.
+    alarm.ScheduleFromNow([&] { ++run_count; }, std::chrono::seconds(1));
+    alarm.ScheduleFromNow([&] { ++run_count; }, std::chrono::seconds(2));
+    EXPECT_EQ(TaskRunner::DelayedTaskId{1}, task_runner.last_id());
+    EXPECT_TRUE(task_runner.canceled_ids().empty());
+
+    // Re-scheduling for an earlier time requires a new one.
+    alarm.ScheduleFromNow([&] { ++run_count; }, std::chrono::milliseconds(10));
+    EXPECT_EQ(TaskRunner::DelayedTaskId{2}, task_runner.last_id());
+    EXPECT_EQ(std::vector<TaskRunner::DelayedTaskId>{1},
+              task_runner.canceled_ids());
+
+    clock.Advance(std::chrono::milliseconds(10));
+    EXPECT_EQ(1, run_count);
+
+    alarm.ScheduleFromNow([&] { ++run_count; }, std::chrono::seconds(1));
+    alarm.Cancel();
+    EXPECT_EQ((std::vector<TaskRunner::DelayedTaskId>{1, 3}),
+              task_runner.canceled_ids());
+
+    alarm.ScheduleFromNow([&] { ++run_count; }, std::chrono::seconds(1));
+    // Destroying the Alarm cancels the queued fire too.
+  }
+  EXPECT_EQ((std::vector<TaskRunner::DelayedTaskId>{1, 3, 4}),
+            task_runner.canceled_ids());
+
+  // None of the canceled fires do anything.
+  clock.Advance(std::chrono::seconds(3));
+  EXPECT_EQ(1, run_count);
+}
+
+TEST(AlarmCancelationTest, ReschedulesQueuedFireInTaskRunner) {
+  FakeClock clock(Clock::now());
+  RescheduleRecordingTaskRunner task_runner(&clock);
+  Alarm alarm(&FakeClock::now, &task_runner);
+
+  // Re-scheduling for an earlier time moves the queued fire, rather than
+  // posting a new one.
+  alarm.ScheduleFromNow([] {}, std::chrono::seconds(1));
+  alarm.ScheduleFromNow([] {}, std::chrono::milliseconds(10));
+  alarm.ScheduleFromNow([] {}, std::chrono::milliseconds(5));
+  EXPECT_EQ(1, task_runner.post_count());
+  EXPECT_EQ((std::vector<TaskRunner::DelayedTaskId>{1, 1}),
+            task_runner.rescheduled_ids());
+}
+
 }  // namespace
 }  // namespace openscreen
@@ -0,0 +1,194 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UTIL_MPSC_QUEUE_H_
+#define UTIL_MPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "platform/base/macros.h"
+
+namespace openscreen {
+
+// A lock-free, unbounded, multi-producer/single-consumer FIFO queue. Push() may
+// be called from any number of threads concurrently, but Pop() and IsEmpty()
+// must only ever be called from one thread at a time (the consumer).
+//
+// This is Dmitry Vyukov's node-based MPSC queue: Each Push() performs a single
+// atomic exchange to link its node in, and never waits on other threads. Each
+// Pop() performs no atomic read-modify-write operations at all. Nodes released
+// by the consumer are recycled for later Push() calls, so that once the queue
+// has grown to its peak size, it stops allocating memory.
+//
+// Caveat: If a producer is pre-empted mid-Push(), the consumer will not be able
+// to see the elements pushed after it (by other producers) until the pre-empted
+// producer resumes. Each element becomes visible no later than the return of
+// the Push() call that added it.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+  ~MpscQueue() {
+    // |tail_| is a placeholder whose value was already consumed, but the nodes
+    // after it hold values.
+    Link* link = tail_->next.load(std::memory_order_acquire);
+    if (tail_ != &stub_) {
+      delete static_cast<Node*>(tail_);
+    }
+    while (link) {
+      Link* const next = link->next.load(std::memory_order_acquire);
+      static_cast<Node*>(link)->value()->~T();
+      delete static_cast<Node*>(link);
+      link = next;
+    }
+    link = free_nodes_.load(std::memory_order_acquire);
+    while (link) {
+      Link* const next = link->next.load(std::memory_order_relaxed);
+      delete static_cast<Node*>(link);
+      link = next;
+    }
+  }
+
+  // Adds |value| to the back of the queue. Thread-safe.
+  void Push(T value) {
+    Node* const node = AcquireNode();
+    new (node->value()) T(std::move(value));
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Link* const prev = head_.exchange(node, std::memory_order_acq_rel);
+    // Note: seq_cst is used, rather than release, so that a consumer checking
+    // IsEmpty() after announcing it is about to sleep (and a producer checking
+    // for that announcement after returning from Push()) cannot both miss the
+    // other's update.
+    prev->next.store(node, std::memory_order_seq_cst);
+  }
+
+  // Moves the element at the front of the queue into |value| and returns true,
+  // or returns false if the queue is empty. Consumer-only.
+  bool Pop(T* value) {
+    Link* const tail = tail_;
+    Link* const next = tail->next.load(std::memory_order_acquire);
+    if (!next) {
+      return false;
+    }
+    // |next| becomes the new placeholder, and so its value is moved-out now.
+    T* const next_value = static_cast<Node*>(next)->value();
+    *value = std::move(*next_value);
+    next_value->~T();
+    tail_ = next;
+    if (tail != &stub_) {
+      tail->next.store(nullptr, std::memory_order_relaxed);
+      ReleaseNodes(tail, tail);
+    }
+    return true;
+  }
+
+  // Moves all elements that are currently available to the back of |out| (via
+  // push_back()), in FIFO order, and returns the number moved. Consumer-only.
+  template <typename Container>
+  size_t PopAll(Container* out) {
+    size_t count = 0;
+    Link* first_released = nullptr;
+    Link* last_released = nullptr;
+    for (Link* next = tail_->next.load(std::memory_order_acquire); next;
+         next = tail_->next.load(std::memory_order_acquire)) {
+      T* const next_value = static_cast<Node*>(next)->value();
+      out->push_back(std::move(*next_value));
+      next_value->~T();
+      if (tail_ != &stub_) {
+        // Chain the released nodes together, to be recycled all at once.
+        if (last_released) {
+          last_released->next.store(tail_, std::memory_order_relaxed);
+        } else {
+          first_released = tail_;
+        }
+        last_released = tail_;
+      }
+      tail_ = next;
+      ++count;
+    }
+    if (last_released) {
+      last_released->next.store(nullptr, std::memory_order_relaxed);
+      ReleaseNodes(first_released, last_released);
+    }
+    return count;
+  }
+
+  // Returns true if there are no elements available to Pop(). Consumer-only.
+  bool IsEmpty() const {
+    return !tail_->next.load(std::memory_order_seq_cst);
+  }
+
+ private:
+  struct Link {
+    std::atomic<Link*> next{nullptr};
+  };
+
+  struct Node : public Link {
+    T* value() { return reinterpret_cast<T*>(&storage); }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  // Takes a node from |free_nodes_| or, if there are none, allocates one.
+  Node* AcquireNode() {
+    // Taking the entire list, rather than popping one node, avoids the ABA
+    // problem. The rest of the list is then returned.
+    Link* const first =
+        free_nodes_.exchange(nullptr, std::memory_order_acquire);
+    if (!first) {
+      return new Node();
+    }
+    Link* const rest = first->next.load(std::memory_order_relaxed);
+    if (rest) {
+      ReleaseNodes(rest, nullptr);
+    }
+    return static_cast<Node*>(first);
+  }
+
+  // Adds the chain of unused nodes from |first| to |last| (or, if |last| is
+  // null, to the end of the chain) to |free_nodes_|.
+  void ReleaseNodes(Link* first, Link* last) {
+    Link* expected = nullptr;
+    if (free_nodes_.compare_exchange_strong(expected, first,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+      return;
+    }
+    if (!last) {
+      last = first;
+      for (Link* next = last->next.load(std::memory_order_relaxed); next;
+           next = last->next.load(std::memory_order_relaxed)) {
+        last = next;
+      }
+    }
+    do {
+      last->next.store(expected, std::memory_order_relaxed);
+    } while (!free_nodes_.compare_exchange_weak(expected, first,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed));
+  }
+
+  // Producers append at the |head_| end, and the consumer pops from the |tail_|
+  // end. |tail_| always points to a placeholder whose value has already been
+  // consumed (initially, the value-less |stub_|); the front element of the
+  // queue is in the node after it.
+  std::atomic<Link*> head_;
+  Link stub_;
+  Link* tail_;
+
+  // A stack of nodes that are not in the queue, available for re-use.
+  std::atomic<Link*> free_nodes_{nullptr};
+
+  OSP_DISALLOW_COPY_AND_ASSIGN(MpscQueue);
+};
+
+}  // namespace openscreen
+
+#endif  // UTIL_MPSC_QUEUE_H_
@@ -0,0 +1,110 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "util/mpsc_queue.h"
+
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace {
+
+using testing::ElementsAre;
+
+TEST(MpscQueueTest, PopsInFifoOrder) {
+  MpscQueue<int> queue;
+  EXPECT_TRUE(queue.IsEmpty());
+  int value = 0;
+  EXPECT_FALSE(queue.Pop(&value));
+
+  queue.Push(1);
+  queue.Push(2);
+  EXPECT_FALSE(queue.IsEmpty());
+  ASSERT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(1, value);
+
+  queue.Push(3);
+  ASSERT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(3, value);
+  EXPECT_FALSE(queue.Pop(&value));
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(MpscQueueTest, PopsAllIntoContainer) {
+  MpscQueue<int> queue;
+  std::vector<int> popped;
+  EXPECT_EQ(0u, queue.PopAll(&popped));
+
+  for (int i = 0; i < 5; ++i) {
+    queue.Push(i);
+  }
+  EXPECT_EQ(5u, queue.PopAll(&popped));
+  EXPECT_TRUE(queue.IsEmpty());
+  queue.Push(5);
+  EXPECT_EQ(1u, queue.PopAll(&popped));
+  EXPECT_THAT(popped, ElementsAre(0, 1, 2, 3, 4, 5));
+}
+
+TEST(MpscQueueTest, HoldsMoveOnlyTypesAndDestroysUnpoppedElements) {
+  auto tracked = std::make_shared<int>(42);
+  {
+    MpscQueue<std::unique_ptr<std::shared_ptr<int>>> queue;
+    queue.Push(std::make_unique<std::shared_ptr<int>>(tracked));
+    queue.Push(std::make_unique<std::shared_ptr<int>>(tracked));
+    queue.Push(std::make_unique<std::shared_ptr<int>>(tracked));
+    EXPECT_EQ(4, tracked.use_count());
+
+    std::unique_ptr<std::shared_ptr<int>> popped;
+    ASSERT_TRUE(queue.Pop(&popped));
+    EXPECT_EQ(42, **popped);
+    popped.reset();
+    EXPECT_EQ(3, tracked.use_count());
+  }
+  EXPECT_EQ(1, tracked.use_count());
+}
+
+TEST(MpscQueueTest, PreservesPerProducerOrderWithConcurrentProducers) {
+  constexpr int kNumProducers = 4;
+  constexpr int kValuesPerProducer = 10000;
+
+  struct Entry {
+    int producer;
+    int sequence;
+  };
+  MpscQueue<Entry> queue;
+  std::vector<std::thread> producers;
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.emplace_back([&queue, i] {
+      for (int j = 0; j < kValuesPerProducer; ++j) {
+        queue.Push(Entry{i, j});
+      }
+    });
+  }
+
+  std::vector<int> next_expected(kNumProducers, 0);
+  int total = 0;
+  Entry entry{};
+  while (total < kNumProducers * kValuesPerProducer) {
+    if (!queue.Pop(&entry)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(next_expected[entry.producer], entry.sequence);
+    ++next_expected[entry.producer];
+    ++total;
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+}  // namespace
+}  // namespace openscreen
@@ -0,0 +1,158 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UTIL_SPSC_QUEUE_H_
+#define UTIL_SPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "platform/base/macros.h"
+#include "util/osp_logging.h"
+
+namespace openscreen {
+
+// A lock-free, bounded, single-producer/single-consumer FIFO queue, backed by a
+// ring buffer. TryPush() must only ever be called from one thread at a time
+// (the producer); and Front(), PopFront(), Pop() and IsEmpty() must only ever
+// be called from one thread at a time (the consumer).
+//
+// Neither side ever waits on the other, performs atomic read-modify-write
+// operations, or allocates memory after construction. Each side keeps a cached
+// copy of the other side's position, and only re-reads the shared one when the
+// cached copy indicates the queue is full (producer) or empty (consumer). This
+// keeps the cache line holding each position from bouncing between cores on
+// every operation.
+template <typename T>
+class SpscQueue {
+ public:
+  // Constructs a queue that can hold up to |capacity| elements at once.
+  explicit SpscQueue(size_t capacity)
+      : num_slots_(capacity + 1), slots_(new Slot[num_slots_]) {
+    OSP_DCHECK_GT(capacity, size_t{0});
+  }
+
+  ~SpscQueue() {
+    const size_t write_index =
+        producer_.write_index.load(std::memory_order_acquire);
+    for (size_t i = consumer_.read_index.load(std::memory_order_relaxed);
+         i != write_index; i = Next(i)) {
+      slots_[i].value()->~T();
+    }
+  }
+
+  size_t capacity() const { return num_slots_ - 1; }
+
+  // Adds |value| to the back of the queue and returns true, or returns false
+  // if the queue is full (in which case |value| is left untouched).
+  // Producer-only.
+  bool TryPush(T&& value) {
+    const size_t write_index =
+        producer_.write_index.load(std::memory_order_relaxed);
+    const size_t next_write_index = Next(write_index);
+    if (next_write_index == producer_.cached_read_index) {
+      producer_.cached_read_index =
+          consumer_.read_index.load(std::memory_order_acquire);
+      if (next_write_index == producer_.cached_read_index) {
+        return false;
+      }
+    }
+    new (slots_[write_index].value()) T(std::move(value));
+    producer_.write_index.store(next_write_index, std::memory_order_release);
+    return true;
+  }
+
+  // Returns the element at the front of the queue, or nullptr if the queue is
+  // empty. The element remains in the queue until PopFront() is called.
+  // Consumer-only.
+  T* Front() {
+    const size_t read_index =
+        consumer_.read_index.load(std::memory_order_relaxed);
+    if (read_index == consumer_.cached_write_index) {
+      consumer_.cached_write_index =
+          producer_.write_index.load(std::memory_order_acquire);
+      if (read_index == consumer_.cached_write_index) {
+        return nullptr;
+      }
+    }
+    return slots_[read_index].value();
+  }
+
+  // Removes the element at the front of the queue, which must have been
+  // confirmed to exist by a prior call to Front(). Consumer-only.
+  void PopFront() {
+    const size_t read_index =
+        consumer_.read_index.load(std::memory_order_relaxed);
+    OSP_DCHECK_NE(read_index, consumer_.cached_write_index);
+    slots_[read_index].value()->~T();
+    consumer_.read_index.store(Next(read_index), std::memory_order_release);
+  }
+
+  // Moves the element at the front of the queue into |value| and returns true,
+  // or returns false if the queue is empty. Consumer-only.
+  bool Pop(T* value) {
+    T* const front = Front();
+    if (!front) {
+      return false;
+    }
+    *value = std::move(*front);
+    PopFront();
+    return true;
+  }
+
+  // Returns true if there are no elements available to Pop(). Consumer-only.
+  bool IsEmpty() { return !Front(); }
+
+ private:
+  struct Slot {
+    T* value() { return reinterpret_cast<T*>(&storage); }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  size_t Next(size_t index) const {
+    return (index + 1 == num_slots_) ? 0 : index + 1;
+  }
+
+  // One slot is always left unused, so that a full queue can be distinguished
+  // from an empty one without a shared element count.
+  const size_t num_slots_;
+  const std::unique_ptr<Slot[]> slots_;
+
+  // The fields each side reads and writes on every operation. Each group is
+  // preceded by a full cache line of padding, and the last one is followed by
+  // one, so that no two groups (nor any neighboring object) ever share a cache
+  // line. Padding is used instead of alignas() because operator new does not
+  // honor extended alignment before C++17.
+  static constexpr size_t kCacheLineSize = 64;
+
+  // The producer's position, and its cached copy of the consumer's position.
+  struct ProducerFields {
+    char leading_padding[kCacheLineSize];
+    std::atomic<size_t> write_index{0};
+    size_t cached_read_index = 0;
+  };
+
+  // The consumer's position, and its cached copy of the producer's position.
+  struct ConsumerFields {
+    char leading_padding[kCacheLineSize];
+    std::atomic<size_t> read_index{0};
+    size_t cached_write_index = 0;
+    char trailing_padding[kCacheLineSize];
+  };
+
+  ProducerFields producer_;
+  ConsumerFields consumer_;
+
+  OSP_DISALLOW_COPY_AND_ASSIGN(SpscQueue);
+};
+
+}  // namespace openscreen
+
+#endif  // UTIL_SPSC_QUEUE_H_
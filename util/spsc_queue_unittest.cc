@@ -0,0 +1,99 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "util/spsc_queue.h"
+
+#include <memory>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace {
+
+TEST(SpscQueueTest, PopsInFifoOrderUntilFull) {
+  SpscQueue<int> queue(3);
+  EXPECT_EQ(3u, queue.capacity());
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_EQ(nullptr, queue.Front());
+  int value = 0;
+  EXPECT_FALSE(queue.Pop(&value));
+
+  EXPECT_TRUE(queue.TryPush(1));
+  EXPECT_TRUE(queue.TryPush(2));
+  EXPECT_TRUE(queue.TryPush(3));
+  EXPECT_FALSE(queue.TryPush(4));
+  EXPECT_FALSE(queue.IsEmpty());
+
+  // Peeking does not remove the element.
+  ASSERT_NE(nullptr, queue.Front());
+  EXPECT_EQ(1, *queue.Front());
+  EXPECT_EQ(1, *queue.Front());
+  queue.PopFront();
+
+  // Wrap around the end of the ring buffer.
+  EXPECT_TRUE(queue.TryPush(4));
+  EXPECT_FALSE(queue.TryPush(5));
+  for (int expected = 2; expected <= 4; ++expected) {
+    ASSERT_TRUE(queue.Pop(&value));
+    EXPECT_EQ(expected, value);
+  }
+  EXPECT_FALSE(queue.Pop(&value));
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(SpscQueueTest, HoldsMoveOnlyTypesAndDestroysUnpoppedElements) {
+  auto tracked = std::make_shared<int>(42);
+  {
+    SpscQueue<std::unique_ptr<std::shared_ptr<int>>> queue(2);
+    EXPECT_TRUE(
+        queue.TryPush(std::make_unique<std::shared_ptr<int>>(tracked)));
+    EXPECT_TRUE(
+        queue.TryPush(std::make_unique<std::shared_ptr<int>>(tracked)));
+
+    // A failed push leaves the value with the caller.
+    auto rejected = std::make_unique<std::shared_ptr<int>>(tracked);
+    EXPECT_FALSE(queue.TryPush(std::move(rejected)));
+    ASSERT_TRUE(rejected);
+    rejected.reset();
+    EXPECT_EQ(3, tracked.use_count());
+
+    std::unique_ptr<std::shared_ptr<int>> popped;
+    ASSERT_TRUE(queue.Pop(&popped));
+    EXPECT_EQ(42, **popped);
+    popped.reset();
+    EXPECT_EQ(2, tracked.use_count());
+  }
+  EXPECT_EQ(1, tracked.use_count());
+}
+
+TEST(SpscQueueTest, TransfersAllValuesInOrderBetweenThreads) {
+  constexpr int kNumValues = 100000;
+
+  SpscQueue<int> queue(16);
+  std::thread producer([&queue] {
+    for (int i = 0; i < kNumValues;) {
+      if (queue.TryPush(int{i})) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int value = 0;
+  for (int expected = 0; expected < kNumValues;) {
+    if (!queue.Pop(&value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(expected, value);
+    ++expected;
+  }
+  producer.join();
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+}  // namespace
+}  // namespace openscreen
@@ -0,0 +1,403 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UTIL_TIMER_WHEEL_H_
+#define UTIL_TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "platform/api/time.h"
+#include "platform/base/macros.h"
+#include "util/osp_logging.h"
+
+namespace openscreen {
+
+// A hashed hierarchical timer wheel: A container of values, each associated
+// with a deadline, from which the values whose deadlines have been reached can
+// be efficiently extracted.
+//
+// Time is divided into ticks of a fixed duration, and each level of the wheel
+// is an array of 64 slots covering 64 times the span of a slot in the level
+// below it. Insert() and Remove() are O(1): They only link/unlink an entry in
+// the one slot covering its deadline. PopExpired() visits only the occupied
+// slots up to "now" (finding them through a per-level occupancy bitmap), and
+// entries in higher levels are cascaded down to lower levels as the wheel
+// advances towards their deadlines.
+//
+// Entries are kept in a pool that recycles the most-recently freed entry
+// first, so that a Remove() followed by an Insert() re-uses the same storage.
+// Reschedule() goes further, moving an entry without touching its value.
+//
+// This class is not thread-safe.
+template <typename T>
+class TimerWheel {
+ public:
+  // Identifies an entry for Remove() and Reschedule(). Never zero.
+  using Id = uint64_t;
+
+  explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1))
+      : tick_(tick) {
+    OSP_DCHECK_GT(tick_, Clock::duration::zero());
+    std::fill(std::begin(heads_), std::end(heads_), kNil);
+    std::fill(std::begin(occupied_), std::end(occupied_), uint64_t{0});
+  }
+
+  ~TimerWheel() = default;
+
+  bool IsEmpty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // Adds |value| to be popped once |deadline| is reached, and returns an ID
+  // for removing it before then.
+  Id Insert(Clock::time_point deadline, T value) {
+    int32_t index;
+    if (free_entries_.empty()) {
+      index = static_cast<int32_t>(entries_.size());
+      entries_.emplace_back();
+    } else {
+      index = free_entries_.back();
+      free_entries_.pop_back();
+    }
+
+    Entry& entry = entries_[index];
+    entry.deadline = deadline;
+    entry.tick = ToTick(deadline);
+    entry.sequence = next_sequence_++;
+    entry.value.emplace(std::move(value));
+    Place(index);
+    ++size_;
+
+    return (static_cast<Id>(entry.generation) << 32) |
+           static_cast<uint32_t>(index);
+  }
+
+  // Removes the entry identified by |id| and returns its value, or returns
+  // nullopt if there is no such entry (e.g., because it was already popped).
+  absl::optional<T> Remove(Id id) {
+    const uint32_t index = static_cast<uint32_t>(id);
+    const uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (index >= entries_.size()) {
+      return absl::nullopt;
+    }
+    Entry& entry = entries_[index];
+    if (entry.generation != generation || entry.bucket == kNoBucket) {
+      return absl::nullopt;
+    }
+    Unlink(index);
+    absl::optional<T> value(std::move(entry.value));
+    Release(index);
+    return value;
+  }
+
+  // Changes the deadline of the entry identified by |id|, keeping its ID and
+  // value. Returns false if there is no such entry (e.g., because it was
+  // already popped). For entries with equal deadlines, a rescheduled entry is
+  // popped after those inserted or rescheduled before it.
+  bool Reschedule(Id id, Clock::time_point deadline) {
+    const uint32_t index = static_cast<uint32_t>(id);
+    const uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (index >= entries_.size()) {
+      return false;
+    }
+    Entry& entry = entries_[index];
+    if (entry.generation != generation || entry.bucket == kNoBucket) {
+      return false;
+    }
+    Unlink(index);
+    entry.deadline = deadline;
+    entry.tick = ToTick(deadline);
+    entry.sequence = next_sequence_++;
+    Place(index);
+    return true;
+  }
+
+  // Moves the values of all entries whose deadlines are on or before |now| to
+  // the back of |out| (via push_back()), in order of their deadlines (and in
+  // order of insertion, for equal deadlines). Returns the number moved.
+  template <typename Container>
+  size_t PopExpired(Clock::time_point now, Container* out) {
+    const uint64_t now_tick = ToTick(now);
+    if (size_ == 0) {
+      current_tick_ = std::max(current_tick_, now_tick);
+      return 0;
+    }
+
+    OSP_DCHECK(expired_.empty());
+    ExpireCurrentSlot(now);
+    while (size_ > expired_.size()) {
+      const uint64_t next_tick = FindNextOccupiedTick();
+      if (next_tick > now_tick) {
+        break;
+      }
+      current_tick_ = next_tick;
+      Cascade();
+      ExpireCurrentSlot(now);
+    }
+    // No entries remain in any of the skipped-over slots.
+    current_tick_ = std::max(current_tick_, now_tick);
+
+    std::sort(expired_.begin(), expired_.end(), [this](int32_t a, int32_t b) {
+      const Entry& entry_a = entries_[a];
+      const Entry& entry_b = entries_[b];
+      return entry_a.deadline < entry_b.deadline ||
+             (entry_a.deadline == entry_b.deadline &&
+              entry_a.sequence < entry_b.sequence);
+    });
+    const size_t count = expired_.size();
+    for (int32_t index : expired_) {
+      out->push_back(std::move(*entries_[index].value));
+      Release(index);
+    }
+    expired_.clear();
+    return count;
+  }
+
+  // Returns the earliest deadline of all entries or, if that would require
+  // cascading entries down from the higher levels of the wheel, a time before
+  // it (possibly in the past, if PopExpired() has not been called recently).
+  // Returns Clock::time_point::max() if empty. This is meant for deciding how
+  // long to wait before calling PopExpired() again.
+  Clock::time_point GetNextWakeUpTime() const {
+    if (size_ == 0) {
+      return Clock::time_point::max();
+    }
+
+    uint64_t tick = current_tick_;
+    if (!(occupied_[0] & (uint64_t{1} << (tick & kSlotMask)))) {
+      tick = FindNextOccupiedTick();
+      // If the next occupied slot is in a higher level, its entries have yet to
+      // be cascaded down, and so all that is known is when the slot begins.
+      if ((tick >> kSlotBits) != (current_tick_ >> kSlotBits)) {
+        return Clock::time_point(tick_ * static_cast<Clock::rep>(tick));
+      }
+    }
+    Clock::time_point earliest = Clock::time_point::max();
+    for (int32_t i = heads_[tick & kSlotMask]; i != kNil;
+         i = entries_[i].next) {
+      earliest = std::min(earliest, entries_[i].deadline);
+    }
+    return earliest;
+  }
+
+ private:
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlotsPerLevel = 1 << kSlotBits;
+  static constexpr uint64_t kSlotMask = kSlotsPerLevel - 1;
+  static constexpr int kLevels = 7;
+  // Deadlines further out than this (about 139 years, for 1 ms ticks) are
+  // treated as being at this tick.
+  static constexpr uint64_t kMaxTick =
+      (uint64_t{1} << (kSlotBits * kLevels)) - 1;
+
+  static constexpr int32_t kNil = -1;
+  static constexpr uint16_t kNoBucket = 0xffff;
+
+  struct Entry {
+    Clock::time_point deadline;
+    uint64_t tick = 0;
+    uint64_t sequence = 0;
+    uint32_t generation = 1;
+
+    // The slot list the entry is linked into, as level * kSlotsPerLevel +
+    // slot, or kNoBucket if the entry is free or being expired.
+    uint16_t bucket = kNoBucket;
+    int32_t prev = kNil;
+    int32_t next = kNil;
+
+    absl::optional<T> value;
+  };
+
+  uint64_t ToTick(Clock::time_point time) const {
+    const Clock::duration since_epoch = time.time_since_epoch();
+    if (since_epoch <= Clock::duration::zero()) {
+      return 0;
+    }
+    return std::min(static_cast<uint64_t>(since_epoch / tick_), kMaxTick);
+  }
+
+  // Returns the level at which an entry for |tick| should be placed: The
+  // lowest one at which |tick| and |current_tick_| fall within the same
+  // revolution of the level.
+  int FindLevel(uint64_t tick) const {
+    int level = 0;
+    while (level < kLevels - 1 &&
+           (tick >> (kSlotBits * (level + 1))) !=
+               (current_tick_ >> (kSlotBits * (level + 1)))) {
+      ++level;
+    }
+    return level;
+  }
+
+  // Links the entry at |index| into the slot that covers its tick, relative to
+  // |current_tick_|. Entries whose tick has passed go into the current slot.
+  void Place(int32_t index) {
+    Entry& entry = entries_[index];
+    const uint64_t tick = std::max(entry.tick, current_tick_);
+    const int level = FindLevel(tick);
+    const int slot =
+        static_cast<int>((tick >> (kSlotBits * level)) & kSlotMask);
+    const int bucket = level * kSlotsPerLevel + slot;
+    entry.bucket = static_cast<uint16_t>(bucket);
+    entry.prev = kNil;
+    entry.next = heads_[bucket];
+    if (entry.next != kNil) {
+      entries_[entry.next].prev = index;
+    }
+    heads_[bucket] = index;
+    occupied_[level] |= uint64_t{1} << slot;
+  }
+
+  void Unlink(int32_t index) {
+    Entry& entry = entries_[index];
+    OSP_DCHECK_NE(entry.bucket, kNoBucket);
+    if (entry.prev != kNil) {
+      entries_[entry.prev].next = entry.next;
+    } else {
+      heads_[entry.bucket] = entry.next;
+      if (entry.next == kNil) {
+        occupied_[entry.bucket / kSlotsPerLevel] &=
+            ~(uint64_t{1} << (entry.bucket % kSlotsPerLevel));
+      }
+    }
+    if (entry.next != kNil) {
+      entries_[entry.next].prev = entry.prev;
+    }
+    entry.bucket = kNoBucket;
+  }
+
+  // Destroys the (possibly moved-from) value of the unlinked entry at |index|,
+  // and returns the entry to the pool.
+  void Release(int32_t index) {
+    Entry& entry = entries_[index];
+    entry.value.reset();
+    if (++entry.generation == 0) {
+      entry.generation = 1;  // Ensure an Id is never zero.
+    }
+    free_entries_.push_back(index);
+    --size_;
+  }
+
+  // Unlinks the entries in the slot for |current_tick_| whose deadlines are on
+  // or before |now|, and appends them to |expired_|.
+  void ExpireCurrentSlot(Clock::time_point now) {
+    int32_t index = heads_[current_tick_ & kSlotMask];
+    while (index != kNil) {
+      const int32_t next = entries_[index].next;
+      if (entries_[index].deadline <= now) {
+        Unlink(index);
+        expired_.push_back(index);
+      }
+      index = next;
+    }
+  }
+
+  // Returns the first tick after |current_tick_| at which an occupied slot
+  // begins, or UINT64_MAX if all entries are in the current slot.
+  uint64_t FindNextOccupiedTick() const {
+    for (int level = 0; level < kLevels; ++level) {
+      const int shift = kSlotBits * level;
+      const uint64_t digit = (current_tick_ >> shift) & kSlotMask;
+      const uint64_t later_slots =
+          occupied_[level] & ~((uint64_t{2} << digit) - 1);
+      if (later_slots) {
+        const uint64_t revolution_start = (current_tick_ >> (shift + kSlotBits))
+                                          << (shift + kSlotBits);
+        return revolution_start |
+               (static_cast<uint64_t>(CountTrailingZeros(later_slots))
+                << shift);
+      }
+    }
+    return UINT64_MAX;
+  }
+
+  // Called after |current_tick_| has advanced to the beginning of a slot in one
+  // or more levels above the first: Moves the entries in those slots down to
+  // the lower levels, starting from the highest.
+  void Cascade() {
+    for (int level = kLevels - 1; level > 0; --level) {
+      const int shift = kSlotBits * level;
+      if (current_tick_ & ((uint64_t{1} << shift) - 1)) {
+        continue;
+      }
+      const int slot = static_cast<int>((current_tick_ >> shift) & kSlotMask);
+      const int bucket = level * kSlotsPerLevel + slot;
+      int32_t index = heads_[bucket];
+      heads_[bucket] = kNil;
+      occupied_[level] &= ~(uint64_t{1} << slot);
+      while (index != kNil) {
+        const int32_t next = entries_[index].next;
+        Place(index);
+        index = next;
+      }
+    }
+  }
+
+  static int CountTrailingZeros(uint64_t bits) {
+    OSP_DCHECK_NE(bits, uint64_t{0});
+#if defined(__clang__) || defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while (!(bits & 1)) {
+      bits >>= 1;
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  const Clock::duration tick_;
+
+  // All entries in slots at or below |current_tick_| whose deadlines were
+  // reached have been popped.
+  uint64_t current_tick_ = 0;
+
+  // The head of each slot's doubly-linked list of entries, indexed by
+  // level * kSlotsPerLevel + slot; and a bitmap of the non-empty slots in each
+  // level.
+  int32_t heads_[kLevels * kSlotsPerLevel];
+  uint64_t occupied_[kLevels];
+
+  std::vector<Entry> entries_;
+  std::vector<int32_t> free_entries_;
+  size_t size_ = 0;
+  uint64_t next_sequence_ = 0;
+
+  // Scratch space used by PopExpired().
+  std::vector<int32_t> expired_;
+
+  OSP_DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+// static
+template <typename T>
+constexpr int TimerWheel<T>::kSlotBits;
+// static
+template <typename T>
+constexpr int TimerWheel<T>::kSlotsPerLevel;
+// static
+template <typename T>
+constexpr uint64_t TimerWheel<T>::kSlotMask;
+// static
+template <typename T>
+constexpr int TimerWheel<T>::kLevels;
+// static
+template <typename T>
+constexpr uint64_t TimerWheel<T>::kMaxTick;
+// static
+template <typename T>
+constexpr int32_t TimerWheel<T>::kNil;
+// static
+template <typename T>
+constexpr uint16_t TimerWheel<T>::kNoBucket;
+
+}  // namespace openscreen
+
+#endif  // UTIL_TIMER_WHEEL_H_
@@ -0,0 +1,214 @@
+// Copyright 2020 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "util/timer_wheel.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace openscreen {
+namespace {
+
+using std::chrono::hours;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+// An arbitrary point in time, not aligned to any tick boundary.
+const Clock::time_point kStart =
+    Clock::time_point(hours(123) + milliseconds(45) + microseconds(678));
+
+TEST(TimerWheelTest, PopsNothingBeforeDeadlines) {
+  TimerWheel<int> wheel;
+  std::vector<int> popped;
+  EXPECT_TRUE(wheel.IsEmpty());
+  EXPECT_EQ(0u, wheel.PopExpired(kStart, &popped));
+  EXPECT_EQ(Clock::time_point::max(), wheel.GetNextWakeUpTime());
+
+  wheel.Insert(kStart + milliseconds(5), 1);
+  EXPECT_FALSE(wheel.IsEmpty());
+  EXPECT_EQ(kStart + milliseconds(5), wheel.GetNextWakeUpTime());
+
+  EXPECT_EQ(0u, wheel.PopExpired(kStart, &popped));
+  EXPECT_EQ(0u, wheel.PopExpired(kStart + microseconds(4999), &popped));
+  EXPECT_THAT(popped, IsEmpty());
+  EXPECT_EQ(1u, wheel.PopExpired(kStart + milliseconds(5), &popped));
+  EXPECT_THAT(popped, ElementsAre(1));
+  EXPECT_TRUE(wheel.IsEmpty());
+}
+
+TEST(TimerWheelTest, PopsInDeadlineOrderThenInsertionOrder) {
+  TimerWheel<int> wheel;
+  std::vector<int> popped;
+  wheel.PopExpired(kStart, &popped);
+  wheel.Insert(kStart + microseconds(300), 3);
+  wheel.Insert(kStart + microseconds(100), 1);
+  wheel.Insert(kStart + microseconds(300), 4);
+  wheel.Insert(kStart + milliseconds(70), 6);
+  wheel.Insert(kStart + microseconds(200), 2);
+  wheel.Insert(kStart + milliseconds(2), 5);
+
+  // Within the same tick, only the entries that are due may be popped.
+  EXPECT_EQ(2u, wheel.PopExpired(kStart + microseconds(200), &popped));
+  EXPECT_THAT(popped, ElementsAre(1, 2));
+  EXPECT_EQ(kStart + microseconds(300), wheel.GetNextWakeUpTime());
+
+  EXPECT_EQ(4u, wheel.PopExpired(kStart + seconds(1), &popped));
+  EXPECT_THAT(popped, ElementsAre(1, 2, 3, 4, 5, 6));
+}
+
+TEST(TimerWheelTest, PopsEntriesWithPastDeadlinesImmediately) {
+  TimerWheel<int> wheel;
+  std::vector<int> popped;
+  wheel.Insert(kStart + seconds(10), 1);
+  EXPECT_EQ(1u, wheel.PopExpired(kStart + seconds(10), &popped));
+
+  // The wheel has now advanced past these deadlines.
+  wheel.Insert(kStart + seconds(5), 3);
+  wheel.Insert(Clock::time_point::min(), 2);
+  EXPECT_LE(wheel.GetNextWakeUpTime(), kStart + seconds(10));
+  EXPECT_EQ(2u, wheel.PopExpired(kStart + seconds(10), &popped));
+  EXPECT_THAT(popped, ElementsAre(1, 2, 3));
+}
+
+TEST(TimerWheelTest, CascadesEntriesFromHigherLevels) {
+  TimerWheel<int> wheel;
+  std::vector<int> popped;
+  wheel.PopExpired(kStart, &popped);
+
+  const Clock::duration kDelays[] = {
+      hours(24 * 400), hours(2), seconds(90), seconds(5), milliseconds(100),
+      milliseconds(1)};
+  for (size_t i = 0; i < sizeof(kDelays) / sizeof(kDelays[0]); ++i) {
+    wheel.Insert(kStart + kDelays[i], static_cast<int>(i));
+  }
+
+  // Walk through time, checking that each entry is popped exactly when its
+  // deadline is reached; and that the next wake-up time never overshoots.
+  Clock::time_point now = kStart;
+  for (int i = 5; i >= 0; --i) {
+    const Clock::time_point deadline = kStart + kDelays[i];
+    while (true) {
+      const Clock::time_point wake_up_time = wheel.GetNextWakeUpTime();
+      ASSERT_LE(wake_up_time, deadline);
+      ASSERT_GT(wake_up_time, now);
+      now = wake_up_time;
+      if (now == deadline) {
+        break;
+      }
+      ASSERT_EQ(0u, wheel.PopExpired(now, &popped));
+    }
+    ASSERT_EQ(0u, wheel.PopExpired(deadline - microseconds(1), &popped));
+    ASSERT_EQ(1u, wheel.PopExpired(deadline, &popped));
+    EXPECT_EQ(i, popped.back());
+  }
+  EXPECT_TRUE(wheel.IsEmpty());
+}
+
+TEST(TimerWheelTest, RemovesEntries) {
+  TimerWheel<int> wheel;
+  std::vector<int> popped;
+  wheel.PopExpired(kStart + seconds(1) - milliseconds(1), &popped);
+  const auto id1 = wheel.Insert(kStart + seconds(1), 1);
+  const auto id2 = wheel.Insert(kStart + seconds(100), 2);
+  const auto id3 = wheel.Insert(kStart + seconds(1), 3);
+  EXPECT_NE(id1, id2);
+  EXPECT_NE(id1, id3);
+  EXPECT_EQ(3u, wheel.size());
+
+  EXPECT_EQ(absl::optional<int>(2), wheel.Remove(id2));
+  EXPECT_EQ(absl::nullopt, wheel.Remove(id2));
+  EXPECT_EQ(absl::optional<int>(1), wheel.Remove(id1));
+  EXPECT_EQ(kStart + seconds(1), wheel.GetNextWakeUpTime());
+
+  EXPECT_EQ(1u, wheel.PopExpired(kStart + seconds(1000), &popped));
+  EXPECT_THAT(popped, ElementsAre(3));
+  EXPECT_EQ(absl::nullopt, wheel.Remove(id3));
+  EXPECT_TRUE(wheel.IsEmpty());
+}
+
+TEST(TimerWheelTest, ReusesStorageWhenRescheduling) {
+  TimerWheel<int> wheel;
+  auto id = wheel.Insert(kStart + seconds(1), 1);
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(wheel.Remove(id));
+    const auto new_id = wheel.Insert(kStart + seconds(1) + milliseconds(i), 1);
+    // Same entry, but a new ID so that the old one cannot remove it.
+    EXPECT_EQ(static_cast<uint32_t>(id), static_cast<uint32_t>(new_id));
+    EXPECT_NE(id, new_id);
+    EXPECT_EQ(absl::nullopt, wheel.Remove(id));
+    id = new_id;
+  }
+  EXPECT_EQ(1u, wheel.size());
+}
+
+TEST(TimerWheelTest, ReschedulesEntries) {
+  TimerWheel<int> wheel;
+  std::vector<int> popped;
+  const auto id1 = wheel.Insert(kStart + seconds(1), 1);
+  const auto id2 = wheel.Insert(kStart + seconds(100), 2);
+
+  // Move |id2| earlier, past a level boundary, and |id1| later.
+  EXPECT_TRUE(wheel.Reschedule(id2, kStart + milliseconds(500)));
+  EXPECT_TRUE(wheel.Reschedule(id1, kStart + seconds(2)));
+  EXPECT_EQ(2u, wheel.size());
+
+  EXPECT_EQ(1u, wheel.PopExpired(kStart + seconds(1), &popped));
+  EXPECT_THAT(popped, ElementsAre(2));
+  EXPECT_FALSE(wheel.Reschedule(id2, kStart + seconds(3)));
+
+  // The ID still identifies the rescheduled entry.
+  EXPECT_TRUE(wheel.Reschedule(id1, kStart + seconds(1) + milliseconds(1)));
+  EXPECT_EQ(kStart + seconds(1) + milliseconds(1), wheel.GetNextWakeUpTime());
+  EXPECT_EQ(absl::optional<int>(1), wheel.Remove(id1));
+  EXPECT_FALSE(wheel.Reschedule(id1, kStart + seconds(3)));
+  EXPECT_TRUE(wheel.IsEmpty());
+}
+
+TEST(TimerWheelTest, MatchesSortedOrderForRandomDeadlines) {
+  TimerWheel<int> wheel;
+  std::vector<std::pair<Clock::time_point, int>> expected;
+  std::vector<TimerWheel<int>::Id> ids;
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> delay_ms(0, 200000);
+  for (int i = 0; i < 2000; ++i) {
+    const Clock::time_point deadline =
+        kStart + milliseconds(delay_ms(random)) + microseconds(i % 1000);
+    ids.push_back(wheel.Insert(deadline, i));
+    expected.emplace_back(deadline, i);
+  }
+  // Remove every third entry.
+  for (int i = 0; i < 2000; i += 3) {
+    ASSERT_TRUE(wheel.Remove(ids[i]));
+  }
+  expected.erase(std::remove_if(expected.begin(), expected.end(),
+                                [](const std::pair<Clock::time_point, int>& e) {
+                                  return e.second % 3 == 0;
+                                }),
+                 expected.end());
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::pair<Clock::time_point, int>& a,
+                      const std::pair<Clock::time_point, int>& b) {
+                     return a.first < b.first;
+                   });
+
+  std::vector<int> popped;
+  for (Clock::time_point now = kStart; !wheel.IsEmpty();
+       now += milliseconds(777)) {
+    wheel.PopExpired(now, &popped);
+  }
+  ASSERT_EQ(expected.size(), popped.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].second, popped[i]);
+  }
+}
+
+}  // namespace
+}  // namespace openscreen
@@ -27,6 +27,36 @@ constexpr uint64_t MakeBitmask(int begin, int count) {
   return bits_in_wrong_position << begin;
 }
 
+// Returns the 0-based index of the least-significant bit set in |bits|, which
+// must not be zero.
+inline int CountTrailingZeros(uint64_t bits) {
+  OSP_DCHECK_NE(bits, uint64_t{0});
+
+  // Almost all processors provide a single instruction to "count trailing
+  // zeros" in an integer, which is great because this is the same as the
+  // 0-based index of the first set bit. So, have the compiler use that
+  // whenever it's available. However, note that the intrinsic (and the CPU
+  // instruction used) provides undefined results when operating on zero.
+#if defined(__clang__) || defined(__GNUC__)
+  return __builtin_ctzll(bits);
+#else
+  // Based on one of the public domain "Bit Twiddling Hacks" heuristics:
+  // https://graphics.stanford.edu/~seander/bithacks.html#ZerosOnRightParallel
+  // clang-format off
+  bits &= ~bits + 1;
+  int count = std::numeric_limits<uint64_t>::digits;
+  if (bits) --count;
+  if (bits & UINT64_C(0x00000000ffffffff)) count -= 32;
+  if (bits & UINT64_C(0x0000ffff0000ffff)) count -= 16;
+  if (bits & UINT64_C(0x00ff00ff00ff00ff)) count -= 8;
+  if (bits & UINT64_C(0x0f0f0f0f0f0f0f0f)) count -= 4;
+  if (bits & UINT64_C(0x3333333333333333)) count -= 2;
+  if (bits & UINT64_C(0x5555555555555555)) count -= 1;
+  return count;
+  // clang-format on
+#endif
+}
+
 }  // namespace
 
 YetAnotherBitVector::YetAnotherBitVector() : size_(0), bits_{.as_integer = 0} {}
@@ -153,43 +183,60 @@ void YetAnotherBitVector::ShiftRight(int steps) {
   }
 }
 
-int YetAnotherBitVector::FindFirstSet() const {
-  // Almost all processors provide a single instruction to "count trailing
-  // zeros" in an integer, which is great because this is the same as the
-  // 0-based index of the first set bit. So, have the compiler use that
-  // whenever it's available. However, note that the intrinsic (and the CPU
-  // instruction used) provides undefined results when operating on zero; and
-  // so that special case is checked and handled.
-#if defined(__clang__) || defined(__GNUC__)
-#define CountTrailingZeros(bits) __builtin_ctzll(bits)
-#else
-  const auto CountTrailingZeros = [](uint64_t bits) -> int {
-    // Based on one of the public domain "Bit Twiddling Hacks" heuristics:
-    // https://graphics.stanford.edu/~seander/bithacks.html#ZerosOnRightParallel
-    // clang-format off
-    bits &= ~bits + 1;
-    int count = kBitsPerInteger;
-    if (bits) --count;
-    if (bits & UINT64_C(0x00000000ffffffff)) count -= 32;
-    if (bits & UINT64_C(0x0000ffff0000ffff)) count -= 16;
-    if (bits & UINT64_C(0x00ff00ff00ff00ff)) count -= 8;
-    if (bits & UINT64_C(0x0f0f0f0f0f0f0f0f)) count -= 4;
-    if (bits & UINT64_C(0x3333333333333333)) count -= 2;
-    if (bits & UINT64_C(0x5555555555555555)) count -= 1;
-    return count;
-    // clang-format on
-  };
-#endif
+int YetAnotherBitVector::FindFirstSet(int begin) const {
+  OSP_DCHECK_LE(0, begin);
+
+  if (begin >= size_) {
+    return size_;
+  }
 
   if (using_array_storage()) {
-    for (int i = 0, end = array_size(); i < end; ++i) {
-      if (bits_.as_array[i] != 0) {
-        return (i * kBitsPerInteger) + CountTrailingZeros(bits_.as_array[i]);
+    // Ignore the bits before |begin| in the first integer examined.
+    int i = begin / kBitsPerInteger;
+    uint64_t bits = bits_.as_array[i] &
+                    MakeBitmask(begin % kBitsPerInteger, kBitsPerInteger);
+    for (const int end = array_size();;) {
+      if (bits != 0) {
+        return (i * kBitsPerInteger) + CountTrailingZeros(bits);
+      }
+      if (++i == end) {
+        return size_;  // All bits are not set.
+      }
+      bits = bits_.as_array[i];
+    }
+  }
+  const uint64_t bits = bits_.as_integer & MakeBitmask(begin, kBitsPerInteger);
+  return (bits != 0) ? CountTrailingZeros(bits) : size_;
+}
+
+int YetAnotherBitVector::FindFirstClear(int begin) const {
+  OSP_DCHECK_LE(0, begin);
+
+  // Same as FindFirstSet(), but searching the inverted bits. The bits beyond
+  // |size_| in the last integer are always cleared (see SetAll()), and so the
+  // result must be clamped to |size_|.
+  if (begin >= size_) {
+    return size_;
+  }
+
+  if (using_array_storage()) {
+    // Ignore the bits before |begin| in the first integer examined.
+    int i = begin / kBitsPerInteger;
+    uint64_t bits = ~bits_.as_array[i] &
+                    MakeBitmask(begin % kBitsPerInteger, kBitsPerInteger);
+    for (const int end = array_size();;) {
+      if (bits != 0) {
+        return std::min(size_,
+                        (i * kBitsPerInteger) + CountTrailingZeros(bits));
+      }
+      if (++i == end) {
+        return size_;  // All bits are set.
       }
+      bits = ~bits_.as_array[i];
     }
-    return size_;  // All bits are not set.
   }
-  return (bits_.as_integer != 0) ? CountTrailingZeros(bits_.as_integer) : size_;
+  const uint64_t bits = ~bits_.as_integer & MakeBitmask(begin, size_ - begin);
+  return (bits != 0) ? CountTrailingZeros(bits) : size_;
 }
 
 int YetAnotherBitVector::CountBitsSet(int begin, int end) const {
@@ -58,8 +58,14 @@ class YetAnotherBitVector {
   // bits. |steps| must be between zero and |size()|.
   void ShiftRight(int steps);
 
-  // Returns the position of the first bit set, or |size()| if no bits are set.
-  int FindFirstSet() const;
+  // Returns the position of the first bit set at or after |begin|, or |size()|
+  // if no such bits are set.
+  int FindFirstSet(int begin = 0) const;
+
+  // Returns the position of the first bit cleared at or after |begin|, or
+  // |size()| if no such bits are cleared. Together with FindFirstSet(), this
+  // allows iterating over runs of consecutive set bits.
+  int FindFirstClear(int begin = 0) const;
 
   // Returns how many of the bits are set in the range [begin, end).
   int CountBitsSet(int begin, int end) const;
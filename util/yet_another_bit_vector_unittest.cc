@@ -172,6 +172,57 @@ TEST(YetAnotherBitVectorTest, FindsTheFirstBitSet) {
   }
 }
 
+// Tests the FindFirstSet() operation, when searching from positions other than
+// the start of the vector.
+TEST(YetAnotherBitVectorTest, FindsTheFirstBitSetAfterAGivenPosition) {
+  YetAnotherBitVector v;
+  for (int size : kTestSizes) {
+    v.Resize(size, YetAnotherBitVector::CLEARED);
+    for (int begin : GetTestSizesInRange(0, size)) {
+      ASSERT_EQ(size, v.FindFirstSet(begin));
+    }
+
+    // Set every third bit, and check that the search always finds the first
+    // one at or after |begin|.
+    for (int i = 0; i < size; i += 3) {
+      v.Set(i);
+    }
+    for (int begin : GetTestSizesInRange(0, size)) {
+      const int expected = std::min(size, (begin + 2) / 3 * 3);
+      ASSERT_EQ(expected, v.FindFirstSet(begin)) << "begin=" << begin;
+    }
+  }
+}
+
+// Tests the FindFirstClear() operation, for various vector sizes and bit
+// patterns, and when searching from positions other than the start of the
+// vector.
+TEST(YetAnotherBitVectorTest, FindsTheFirstBitClearedAfterAGivenPosition) {
+  YetAnotherBitVector v;
+  for (int size : kTestSizes) {
+    v.Resize(size, YetAnotherBitVector::SET);
+    for (int begin : GetTestSizesInRange(0, size)) {
+      ASSERT_EQ(size, v.FindFirstClear(begin));
+    }
+
+    // Clear every third bit, and check that the search always finds the first
+    // one at or after |begin|.
+    for (int i = 0; i < size; i += 3) {
+      v.Clear(i);
+    }
+    for (int begin : GetTestSizesInRange(0, size)) {
+      const int expected = std::min(size, (begin + 2) / 3 * 3);
+      ASSERT_EQ(expected, v.FindFirstClear(begin)) << "begin=" << begin;
+    }
+
+    // With no bits set, the search always finds |begin|.
+    v.ClearAll();
+    for (int begin : GetTestSizesInRange(0, size)) {
+      ASSERT_EQ(std::min(size, begin), v.FindFirstClear(begin));
+    }
+  }
+}
+
 // Tests the CountBitsSet() operation, for various vector sizes, bit patterns,
 // and ranges of bits being counted.
 TEST(YetAnotherBitVector, CountsTheNumberOfBitsSet) {